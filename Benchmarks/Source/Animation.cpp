@@ -0,0 +1,85 @@
+#include "Benchmark.h"
+#include <Engine/Animation.h>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace Engine;
+
+static const size_t nodeCount = 3000;
+static const size_t keyCount = 60;
+static const float clipDuration = 4.f;
+static const unsigned frameCount = 2000;
+
+/*
+ * Time per frame of AnimationPlayer::apply on a clip with a translation,
+ * rotation and scale track for each of 3000 nodes, 60 keys each: first
+ * playing forward at 60 Hz, where the cursors only step to the next key,
+ * then seeking to random times, where every track falls back to a binary
+ * search. The sampled translation is checked against the linear ramp the
+ * keys follow.
+ */
+int main() {
+	vector<float> times(keyCount);
+	for (size_t k = 0; k < keyCount; k++) {
+		times[k] = clipDuration * k / (keyCount - 1);
+	}
+	AnimationClip clip;
+	for (size_t i = 0; i < nodeCount; i++) {
+		vector<glm::vec3> translations(keyCount);
+		vector<glm::quat> rotations(keyCount);
+		vector<glm::vec3> scales(keyCount);
+		for (size_t k = 0; k < keyCount; k++) {
+			translations[k] = glm::vec3((float)k, (float)i, 0.f);
+			rotations[k] = glm::angleAxis(k * 0.1f, glm::vec3(0.f, 1.f, 0.f));
+			scales[k] = glm::vec3(1.f + k * 0.01f);
+		}
+		clip.addTranslationTrack(times, translations);
+		clip.addRotationTrack(times, rotations);
+		clip.addScaleTrack(times, scales);
+	}
+
+	vector<Node> nodes(nodeCount);
+	AnimationPlayer player(&clip);
+	for (size_t i = 0; i < nodeCount; i++) {
+		player.setTarget(AnimationChannel::Translation, (uint32_t)i, &nodes[i]);
+		player.setTarget(AnimationChannel::Rotation, (uint32_t)i, &nodes[i]);
+		player.setTarget(AnimationChannel::Scale, (uint32_t)i, &nodes[i]);
+	}
+
+	float checkTime = 1.03f;
+	player.setTime(checkTime);
+	player.apply();
+	float expected = checkTime / clipDuration * (keyCount - 1);
+	if (fabs(nodes[5].getTranslation().x - expected) > 1e-3f) {
+		fprintf(stderr, "Sampled translation %f, expected %f\n",
+			nodes[5].getTranslation().x, expected);
+		return 1;
+	}
+
+	size_t trackCount = nodeCount * animationChannelCount;
+	printf("%zu tracks, %zu keys each\n", trackCount, keyCount);
+	double sequential = bestTime(5, [&] {
+		for (unsigned f = 0; f < frameCount; f++) {
+			player.advance(1.f / 60.f);
+			player.apply();
+		}
+	}) / frameCount;
+	printf("sequential:  %7.1f us/frame, %5.1f ns/track\n",
+		sequential * 1e6, sequential / trackCount * 1e9);
+
+	mt19937 random(1);
+	uniform_real_distribution<float> seek(0.f, clipDuration);
+	double randomSeek = bestTime(5, [&] {
+		for (unsigned f = 0; f < frameCount; f++) {
+			player.setTime(seek(random));
+			player.apply();
+		}
+	}) / frameCount;
+	printf("random seek: %7.1f us/frame, %5.1f ns/track\n",
+		randomSeek * 1e6, randomSeek / trackCount * 1e9);
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+#include "Benchmark.h"
+#include <Engine/Material.h>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace Engine;
+
+static const unsigned regionCount = 60;
+static const unsigned regionSize = 64;
+static const unsigned drawCount = 10000;
+
+static string regionName(unsigned i) {
+	return "material_texture_" + to_string(i);
+}
+
+/*
+ * Time of looking up the atlas regions of 10000 textured draws, whose
+ * materials are picked at random from 60 textures: by texture name on
+ * every draw, and by the region ID each material resolved when it was
+ * bound to the atlas. The regions are written to a meta file over the
+ * atlas image, with the first one repeated at the end to check that the
+ * last entry of a name is the one kept.
+ */
+int main(int argc, char** argv) {
+	string image = argc > 1 ? argv[1] : "../Assets/textureAtlas.png";
+	string meta = "AtlasRegions.meta";
+
+	try {
+		{
+			ofstream out(meta);
+			for (unsigned i = 0; i < regionCount; i++) {
+				out << regionName(i) << " = " << i % 8 * regionSize << " "
+					<< i / 8 * regionSize << " " << regionSize << " "
+					<< regionSize << "\n";
+			}
+			out << regionName(0) << " = 1024 1024 " << 2 * regionSize << " "
+				<< 2 * regionSize << "\n";
+		}
+		TextureAtlas atlas(image, meta);
+		remove(meta.c_str());
+		const PixelRect& kept = atlas.getRegions().getPixelRect(
+			atlas.findRegion(regionName(0)));
+		if (atlas.getRegions().getCount() != regionCount || kept.x != 1024
+			|| kept.width != 2 * regionSize) {
+			throw runtime_error("Repeated region name did not keep its last entry.");
+		}
+
+		mt19937 random(3);
+		uniform_int_distribution<unsigned> texture(0, regionCount - 1);
+		uniform_int_distribution<unsigned> draw(0, drawCount - 1);
+		vector<Material> materials(drawCount);
+		for (Material& material : materials) {
+			material.setTextureName(regionName(texture(random)));
+			material.bindAtlas(&atlas);
+		}
+		vector<const Material*> draws(drawCount);
+		for (const Material*& d : draws) {
+			d = &materials[draw(random)];
+		}
+
+		float sink = 0.f;
+		double byName = bestTime(50, [&] {
+			for (const Material* m : draws) {
+				if (!m->isTextured()) continue;
+				const TextureRect& rect = atlas.getRegion(m->getTextureName());
+				sink += rect.x + rect.w;
+			}
+		});
+		double byId = bestTime(50, [&] {
+			for (const Material* m : draws) {
+				if (!m->isTextured()) continue;
+				const TextureRect& rect = atlas.getRegion(m->getRegionId());
+				sink += rect.x + rect.w;
+			}
+		});
+		printf("%u textured draws, %u regions (checksum %g)\n", drawCount,
+			regionCount, sink);
+		printf("by name: %8.1f us, %6.2f ns/draw\n", byName * 1e6,
+			byName / drawCount * 1e9);
+		printf("by ID:   %8.1f us, %6.2f ns/draw\n", byId * 1e6,
+			byId / drawCount * 1e9);
+	} catch (const exception& e) {
+		remove(meta.c_str());
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+
+/*
+ * Shortest time in seconds of runs calls of f, so a run slowed down by
+ * the scheduler or cold caches does not count.
+ */
+template <typename F>
+double bestTime(unsigned runs, F f) {
+	double best = 0.0;
+	for (unsigned r = 0; r < runs; r++) {
+		std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+		f();
+		std::chrono::duration<double> elapsed =
+			std::chrono::steady_clock::now() - start;
+		best = r == 0 ? elapsed.count() : std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+#endif
@@ -0,0 +1,72 @@
+#include "Benchmark.h"
+#include <Engine/MeshCache.h>
+#include <Engine/MeshGeneration.h>
+#include <Engine/Primitives.h>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+using namespace std;
+using namespace Engine;
+
+/*
+ * Every allocation of the program goes through these, so the counts
+ * include the ones made inside the standard library and tinyobj.
+ */
+static size_t allocationCount = 0;
+static size_t allocatedBytes = 0;
+
+void* operator new(size_t size) {
+	allocationCount++;
+	allocatedBytes += size;
+	void* p = malloc(size ? size : 1);
+	if (!p) throw bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+template <typename F>
+static void measure(const char* name, F f) {
+	size_t count = allocationCount;
+	size_t bytes = allocatedBytes;
+	double seconds = bestTime(1, f);
+	printf("%-28s %8zu allocations %10zu bytes %8.2f ms\n", name,
+		allocationCount - count, allocatedBytes - bytes, seconds * 1e3);
+}
+
+/*
+ * Allocations and time of building meshes: the primitives, an .obj file
+ * parsed from text, and the same file read back from its binary cache,
+ * which is written by the first cached load.
+ */
+int main(int argc, char** argv) {
+	string path = argc > 1 ? argv[1] : "../Assets/terrain.obj";
+
+	remove(meshCachePath(path).c_str());
+	try {
+		measure("generateCube", [] { IndexedMesh m = generateCube(); });
+		measure("generateSphere(5)", [] { IndexedMesh m = generateSphere(5); });
+		measure("generateTorus(32, 16)",
+			[] { IndexedMesh m = generateTorus(32, 16); });
+		measure("loadMesh", [&] { IndexedMesh m = loadMesh(path); });
+		measure("loadMesh (cache write)", [&] {
+			IndexedMesh m = loadMesh(path, MeshLoadFlags::BinaryCache);
+		});
+		measure("loadMesh (cache read)", [&] {
+			IndexedMesh m = loadMesh(path, MeshLoadFlags::BinaryCache);
+		});
+	} catch (const exception& e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+#include "Benchmark.h"
+#include <Engine/Primitives.h>
+#include <cstdio>
+#include <functional>
+
+using namespace std;
+using namespace Engine;
+
+/*
+ * Count triangles with an index out of range or winding against the
+ * normals of their vertices, and triangles with no area, which only the
+ * poles of the capsule should have.
+ */
+static bool check(const char* name, const IndexedMesh& mesh) {
+	const vector<Vertex>& vertices = mesh.getVertices();
+	const vector<uint32_t>& indices = mesh.getIndices();
+	size_t outOfRange = 0;
+	size_t inward = 0;
+	size_t degenerate = 0;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		if (indices[i] >= vertices.size() || indices[i + 1] >= vertices.size()
+			|| indices[i + 2] >= vertices.size()) {
+			outOfRange++;
+			continue;
+		}
+		const Vertex& a = vertices[indices[i]];
+		const Vertex& b = vertices[indices[i + 1]];
+		const Vertex& c = vertices[indices[i + 2]];
+		glm::vec3 n = glm::cross(b.position - a.position,
+			c.position - a.position);
+		if (glm::length(n) < 1e-9f) {
+			degenerate++;
+		} else if (glm::dot(n, a.normal + b.normal + c.normal) <= 0.f) {
+			inward++;
+		}
+	}
+	printf("%-22s %6zu vertices %7zu indices, %zu out of range, %zu inward, "
+		"%zu degenerate\n", name, vertices.size(), indices.size(), outOfRange,
+		inward, degenerate);
+	return outOfRange == 0 && inward == 0 && indices.size() % 3 == 0;
+}
+
+/*
+ * Validate every primitive, then time building each one, allocation
+ * included, at the default size and at a size where writing vertices and
+ * indices outweighs allocating them.
+ */
+int main() {
+	struct Shape {
+		const char* name;
+		function<IndexedMesh()> generate;
+		unsigned runs;
+	};
+	const Shape shapes[] = {
+		{ "cube", [] { return generateCube(); }, 20000 },
+		{ "quad", [] { return generateQuad(); }, 20000 },
+		{ "grid(16, 16)", [] { return generateGrid(16, 16); }, 20000 },
+		{ "cylinder(32)", [] { return generateCylinder(32); }, 20000 },
+		{ "torus(32, 16)", [] { return generateTorus(32, 16); }, 20000 },
+		{ "capsule(32, 8)", [] { return generateCapsule(32, 8); }, 20000 },
+		{ "grid(512, 512)", [] { return generateGrid(512, 512); }, 50 },
+		{ "cylinder(4096)", [] { return generateCylinder(4096); }, 200 },
+		{ "torus(512, 256)", [] { return generateTorus(512, 256); }, 50 },
+		{ "capsule(512, 128)", [] { return generateCapsule(512, 128); }, 50 }
+	};
+
+	bool valid = true;
+	for (const Shape& shape : shapes) {
+		valid = check(shape.name, shape.generate()) && valid;
+	}
+	if (!valid) {
+		fprintf(stderr, "Invalid primitive.\n");
+		return 1;
+	}
+
+	for (const Shape& shape : shapes) {
+		size_t vertexCount = 0;
+		double seconds = bestTime(shape.runs, [&] {
+			IndexedMesh mesh = shape.generate();
+			vertexCount = mesh.getVertices().size();
+		});
+		printf("%-22s %10.2f us/mesh %6.2f ns/vertex\n", shape.name,
+			seconds * 1e6, seconds / vertexCount * 1e9);
+	}
+
+	return 0;
+}
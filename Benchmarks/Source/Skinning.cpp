@@ -0,0 +1,94 @@
+#include "Benchmark.h"
+#include <Engine/Parallel.h>
+#include <Engine/Skinning.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace Engine;
+
+static const size_t vertexCount = 65536;
+static const size_t jointCount = 64;
+
+/*
+ * Vertices per second per core of skinVertices for both methods, with the
+ * scalar and the AVX2 kernels: first one instance on the calling thread,
+ * then a batch of instances spread over the worker threads. Vertices are
+ * random, each with four random joints, and the joint transforms random
+ * rigid motions.
+ */
+int main() {
+	mt19937 random(1);
+	uniform_real_distribution<float> unit(-1.f, 1.f);
+	uniform_int_distribution<int> joint(0, jointCount - 1);
+
+	vector<Vertex> bindPose(vertexCount);
+	vector<SkinWeights> weights(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++) {
+		bindPose[i].position = glm::vec3(unit(random), unit(random),
+			unit(random));
+		bindPose[i].normal = glm::normalize(glm::vec3(unit(random),
+			unit(random), unit(random)));
+		bindPose[i].textureCoordinate = glm::vec2(unit(random), unit(random));
+		float sum = 0.f;
+		for (int k = 0; k < 4; k++) {
+			weights[i].joints[k] = (uint16_t)joint(random);
+			weights[i].weights[k] = unit(random) + 1.f;
+			sum += weights[i].weights[k];
+		}
+		for (int k = 0; k < 4; k++) {
+			weights[i].weights[k] /= sum;
+		}
+	}
+
+	vector<glm::mat4> jointMatrices(jointCount);
+	vector<glm::fdualquat> jointDualQuaternions(jointCount);
+	for (size_t j = 0; j < jointCount; j++) {
+		glm::quat rotation = glm::normalize(glm::quat(unit(random),
+			unit(random), unit(random), unit(random)));
+		glm::vec3 translation(unit(random), unit(random), unit(random));
+		jointMatrices[j] = glm::translate(glm::mat4(), translation)
+			* glm::mat4_cast(rotation);
+		jointDualQuaternions[j] = glm::fdualquat(rotation, translation);
+	}
+
+	size_t instanceCount = workerCount() * 4;
+	vector<vector<Vertex>> skinned(instanceCount,
+		vector<Vertex>(vertexCount));
+	vector<SkinningJob> jobs(instanceCount);
+	for (size_t i = 0; i < instanceCount; i++) {
+		jobs[i] = { bindPose.data(), weights.data(), vertexCount,
+			jointMatrices.data(), jointDualQuaternions.data(),
+			skinned[i].data() };
+	}
+
+	printf("%zu vertices, %zu joints, %u worker threads\n", vertexCount,
+		jointCount, workerCount());
+	const SkinningMethod methods[] = { SkinningMethod::LinearBlend,
+		SkinningMethod::DualQuaternion };
+	const char* methodNames[] = { "linear blend", "dual quaternion" };
+	for (int simd = 0; simd < 2; simd++) {
+		if (simd && !setSkinningSimd(true)) {
+			printf("AVX2 and FMA are not available\n");
+			break;
+		}
+		if (!simd) setSkinningSimd(false);
+		for (int m = 0; m < 2; m++) {
+			double single = bestTime(20, [&] {
+				skinVertices(jobs[0], methods[m]);
+			});
+			double batch = bestTime(5, [&] {
+				skinVertices(jobs.data(), jobs.size(), methods[m]);
+			});
+			printf("%-16s %-6s %7.1f Mverts/s per core (one instance), "
+				"%7.1f (batch)\n", methodNames[m], simd ? "AVX2" : "scalar",
+				vertexCount / single * 1e-6,
+				vertexCount * instanceCount / batch / workerCount() * 1e-6);
+		}
+	}
+	setSkinningSimd(true);
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+#ifndef ENGINE_ANIMATION_H
+#define ENGINE_ANIMATION_H
+
+#include "Node.h"
+#include <cstddef>
+#include <vector>
+
+namespace Engine {
+	enum class AnimationChannel {
+		Translation,
+		Rotation,
+		Scale
+	};
+
+	const size_t animationChannelCount = 3;
+
+	/*
+	 * Keyframe tracks, each animating one channel of one node. Tracks are
+	 * grouped by channel, and the key times and values of all tracks are
+	 * kept in two flat arrays, so sampling walks memory in order. Values
+	 * are vec4: xyz for translation and scale, (x, y, z, w) quaternions for
+	 * rotation.
+	 */
+	class AnimationClip {
+	public:
+		AnimationClip() : duration(0.f) {}
+
+		/*
+		 * Add a track and return its index within the channel. Times must
+		 * increase. Rotation keys are flipped into the hemisphere of the key
+		 * before, so sampling can interpolate without checking.
+		 */
+		uint32_t addTrack(AnimationChannel channel, const float* times,
+			const glm::vec4* values, size_t keyCount);
+
+		uint32_t addTranslationTrack(const std::vector<float>& times,
+			const std::vector<glm::vec3>& translations);
+		uint32_t addRotationTrack(const std::vector<float>& times,
+			const std::vector<glm::quat>& rotations);
+		uint32_t addScaleTrack(const std::vector<float>& times,
+			const std::vector<glm::vec3>& scales);
+
+		/*
+		 * Time of the last key of any track
+		 */
+		float getDuration() const {
+			return duration;
+		}
+
+		size_t getTrackCount(AnimationChannel channel) const {
+			return tracks[(size_t)channel].size();
+		}
+
+		/*
+		 * Range of a track in the key arrays
+		 */
+		struct Track {
+			uint32_t firstKey;
+			uint32_t keyCount;
+		};
+
+	private:
+		friend class AnimationPlayer;
+
+		std::vector<Track> tracks[animationChannelCount];
+		std::vector<float> times;
+		std::vector<glm::vec4> values;
+		float duration;
+	};
+
+	/*
+	 * Plays a clip onto nodes. Each track has a cursor at the key last
+	 * sampled, so playing forward only steps to the next key; seeking and
+	 * large steps fall back to a binary search. apply() writes the sampled
+	 * values into the translation, rotation and scale of the target nodes;
+	 * Node::update must run afterwards.
+	 */
+	class AnimationPlayer {
+	public:
+		AnimationPlayer(const AnimationClip* clip = nullptr) :
+			clip(nullptr), time(0.f), looping(true) {
+			setClip(clip);
+		}
+
+		/*
+		 * Use another clip. Targets and cursors are reset.
+		 */
+		void setClip(const AnimationClip* c);
+
+		/*
+		 * Node animated by a track, or nullptr to skip the track.
+		 */
+		void setTarget(AnimationChannel channel, uint32_t track, Node* node) {
+			targets[(size_t)channel][track] = node;
+		}
+
+		void setLooping(bool l) {
+			looping = l;
+		}
+
+		void setTime(float t);
+
+		/*
+		 * Move time forward, wrapping around when looping and stopping at
+		 * the end of the clip otherwise.
+		 */
+		void advance(float delta);
+
+		float getTime() const {
+			return time;
+		}
+
+		/*
+		 * Sample every track at the current time and write the results to
+		 * the targets.
+		 */
+		void apply();
+
+	private:
+		const AnimationClip* clip;
+		float time;
+		bool looping;
+		std::vector<Node*> targets[animationChannelCount];
+		std::vector<uint32_t> cursors[animationChannelCount];
+	};
+}
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef ENGINE_ATLASPACKER_H
+#define ENGINE_ATLASPACKER_H
+
+#include "Texture.h"
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Place rectangles of the given sizes without overlap in a bin of
+	 * width by height pixels, at least padding pixels apart. Uses MaxRects,
+	 * largest rectangles first, each where it leaves the shortest side
+	 * free. placed receives the rectangles in the order of sizes. Returns
+	 * false when they do not all fit.
+	 */
+	bool packRects(const std::vector<PixelRect>& sizes, uint32_t width,
+		uint32_t height, uint32_t padding, std::vector<PixelRect>& placed);
+
+	/*
+	 * Pack rectangles into the smallest power of two bin, no larger than
+	 * maxSize on a side, trying candidate bin sizes in parallel. Returns
+	 * false when no bin fits them.
+	 */
+	bool packAtlas(const std::vector<PixelRect>& sizes, uint32_t padding,
+		uint32_t maxSize, uint32_t& width, uint32_t& height,
+		std::vector<PixelRect>& placed);
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef ENGINE_BOUNDS_H
+#define ENGINE_BOUNDS_H
+
+#include "Vertex.h"
+#include <cstddef>
+
+namespace Engine {
+	struct BoundingSphere {
+		glm::vec3 center;
+		float radius;
+	};
+
+	/*
+	 * Sphere around the center of the bounding box that contains all the
+	 * given vertices.
+	 */
+	BoundingSphere computeBoundingSphere(const Vertex* vertices, size_t count);
+
+	/*
+	 * View frustum planes (Gribb and Hartmann) in the space that
+	 * modelViewProjection maps from, normalised so sphere radii can be
+	 * compared against plane distances.
+	 */
+	struct Frustum {
+		glm::vec4 planes[6];
+	};
+
+	Frustum computeFrustum(const glm::mat4& modelViewProjection);
+
+	/*
+	 * Whether the sphere is at least partly inside the frustum. Spheres
+	 * near a corner outside of it may also pass.
+	 */
+	inline bool intersectsFrustum(const Frustum& frustum,
+		const BoundingSphere& sphere) {
+		for (const glm::vec4& plane : frustum.planes) {
+			if (glm::dot(glm::vec3(plane), sphere.center) + plane.w
+				< -sphere.radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+#endif
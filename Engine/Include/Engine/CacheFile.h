@@ -0,0 +1,57 @@
+#ifndef ENGINE_CACHEFILE_H
+#define ENGINE_CACHEFILE_H
+
+#include "IndexedMesh.h"
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Bytes left to read in a file stream, or 0 when it has failed.
+	 */
+	uint64_t remainingBytes(std::istream& in);
+
+	/*
+	 * Read count elements, failing before anything is allocated when fewer
+	 * bytes are left in the file, as in a truncated or corrupt cache.
+	 */
+	template <typename T>
+	bool readArray(std::istream& in, std::vector<T>& v, uint64_t count) {
+		if (count > remainingBytes(in) / sizeof(T)) return false;
+		v.resize((size_t)count);
+		in.read((char*)v.data(), sizeof(T) * v.size());
+		return (bool)in;
+	}
+
+	template <typename T>
+	void writeArray(std::ostream& out, const std::vector<T>& v) {
+		out.write((const char*)v.data(), sizeof(T) * v.size());
+	}
+
+	/*
+	 * Size and modification time of the file a cache was built from,
+	 * stored in the cache to tell when it is out of date.
+	 */
+	bool sourceStamp(const std::string& path, uint64_t& size, int64_t& time);
+
+	/*
+	 * Whether every index of a mesh names one of its vertices, and its
+	 * submeshes, levels of detail and meshlets are ranges of its indices.
+	 */
+	bool validMeshRanges(const IndexedMesh& mesh);
+
+	/*
+	 * Caches are written under a name of their own and then renamed over
+	 * the old one, so a process mapping the old cache keeps its pages and
+	 * no reader sees a partly written file. replaceCacheFile removes the
+	 * temporary file when it can not be moved into place.
+	 */
+	std::string temporaryCachePath(const std::string& path);
+	bool replaceCacheFile(const std::string& temporaryPath,
+		const std::string& path);
+}
+
+#endif
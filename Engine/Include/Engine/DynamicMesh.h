@@ -0,0 +1,71 @@
+#ifndef ENGINE_DYNAMICMESH_H
+#define ENGINE_DYNAMICMESH_H
+
+#include "IndexedMesh.h"
+#include <utility>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Vertices first to first + count - 1
+	 */
+	struct VertexRange {
+		uint32_t first;
+		uint32_t count;
+	};
+
+	/*
+	 * Sort ranges by their first vertex and merge the ones that overlap or
+	 * are at most gap vertices apart.
+	 */
+	void mergeVertexRanges(std::vector<VertexRange>& ranges,
+		uint32_t gap = 0);
+
+	/*
+	 * Indexed mesh whose vertices change after it was first drawn. Writes
+	 * through editVertices or setVertex are recorded as changed ranges,
+	 * and renderers upload only those. The vertex count, indices and vertex
+	 * format (which must stay VertexFormat::Float) are fixed once drawn.
+	 * Renderers draw dynamic meshes whole, without culling, levels of
+	 * detail or meshlets, as their bounds move with the vertices.
+	 */
+	class DynamicMesh : public IndexedMesh {
+	public:
+		DynamicMesh(Topology pt = Topology::Triangles) :
+			IndexedMesh(pt) {}
+		explicit DynamicMesh(IndexedMesh&& mesh) :
+			IndexedMesh(std::move(mesh)) {}
+
+		/*
+		 * Vertices first to first + count - 1 for writing, marked changed.
+		 */
+		Vertex* editVertices(uint32_t first, uint32_t count) {
+			markChanged(first, count);
+			return getVertexData() + first;
+		}
+
+		void setVertex(uint32_t i, const Vertex& vertex) {
+			*editVertices(i, 1) = vertex;
+		}
+
+		/*
+		 * Record a change made through getVertices or getVertexData.
+		 */
+		void markChanged(uint32_t first, uint32_t count);
+
+		bool hasChanges() const {
+			return !changed.empty();
+		}
+
+		/*
+		 * Move the ranges changed since the last call, merged and sorted,
+		 * into ranges.
+		 */
+		void takeChangedRanges(std::vector<VertexRange>& ranges);
+
+	private:
+		std::vector<VertexRange> changed;
+	};
+}
+
+#endif
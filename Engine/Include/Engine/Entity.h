@@ -3,13 +3,17 @@
 
 #include "Node.h"
 #include "Geometry.h"
+#include "Skeleton.h"
+#include "Skinning.h"
 
 namespace Engine {
 	class Entity {
 	public:
-		Entity() : node(nullptr), geometry(nullptr) {}
+		Entity() : node(nullptr), geometry(nullptr), lod(0),
+			skeleton(nullptr), skinningMethod(SkinningMethod::LinearBlend) {}
 		Entity(Node* node, Geometry* geometry) :
-			node(node), geometry(geometry) {}
+			node(node), geometry(geometry), lod(0), skeleton(nullptr),
+			skinningMethod(SkinningMethod::LinearBlend) {}
 		~Entity() {}
 
 		Node* getNode() {
@@ -32,6 +36,13 @@ namespace Engine {
 			return scaleMatrix;
 		}
 
+		/*
+		 * Level of detail the renderer picked for this entity last frame.
+		 */
+		unsigned getLod() const {
+			return lod;
+		}
+
 		void setNode(Node* n) {
 			node = n;
 		}
@@ -47,11 +58,36 @@ namespace Engine {
 		void setScale(const glm::vec3& s) {
 			scaleMatrix = glm::scale(glm::mat4(), s);
 		}
+
+		void setLod(unsigned l) {
+			lod = l;
+		}
+
+		/*
+		 * Pose the SkinnedMesh of the geometry with a skeleton. Each skinned
+		 * entity gets its own copy of the vertices in the renderer.
+		 */
+		void setSkeleton(const Skeleton* s,
+			SkinningMethod method = SkinningMethod::LinearBlend) {
+			skeleton = s;
+			skinningMethod = method;
+		}
+
+		const Skeleton* getSkeleton() const {
+			return skeleton;
+		}
+
+		SkinningMethod getSkinningMethod() const {
+			return skinningMethod;
+		}
 		
 	private:
 		Node* node;
 		Geometry* geometry;
 		glm::mat4 scaleMatrix;
+		unsigned lod;
+		const Skeleton* skeleton;
+		SkinningMethod skinningMethod;
 	};
 }
 
@@ -7,9 +7,9 @@
 namespace Engine {
 	class Geometry {
 	public:
-		Geometry() : mesh(nullptr), material(nullptr) {}
-		Geometry(Mesh* mesh, Material* material) :
-			mesh(mesh), material(material) {}
+		Geometry() : mesh(nullptr), material(nullptr), submesh(-1) {}
+		Geometry(Mesh* mesh, Material* material, int submesh = -1) :
+			mesh(mesh), material(material), submesh(submesh) {}
 		~Geometry() {}
 		
 				Mesh* getMesh() {
@@ -28,6 +28,14 @@ namespace Engine {
 			return material;
 		}
 
+		/*
+		 * Index into the submesh table of an indexed mesh, or -1 to draw the
+		 * whole mesh.
+		 */
+		int getSubmesh() const {
+			return submesh;
+		}
+
 		void setMesh(Mesh* m) {
 			mesh = m;
 		}
@@ -35,10 +43,15 @@ namespace Engine {
 		void setMaterial(Material* m) {
 			material = m;
 		}
+
+		void setSubmesh(int s) {
+			submesh = s;
+		}
 		
 	private:
 		Mesh* mesh;
 		Material* material;
+		int submesh;
 	};
 }
 
@@ -2,8 +2,53 @@
 #define ENGINE_INDEXEDMESH_H
 
 #include "Mesh.h"
+#include "Bounds.h"
+#include <algorithm>
+#include <vector>
 
 namespace Engine {
+	/*
+	 * A range of indices drawn with a single material.
+	 */
+	struct Submesh {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		int32_t materialId;
+	};
+
+	/*
+	 * A range of indices that draws the whole mesh at reduced detail, and
+	 * the largest distance (in mesh units) it deviates from the full mesh.
+	 */
+	struct LevelOfDetail {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float error;
+	};
+
+	/*
+	 * A small cluster of triangles stored as a range of the index buffer,
+	 * with bounds for frustum culling and a normal cone for backface culling.
+	 * The cluster faces away from every viewer for which
+	 * dot(normalize(coneApex - viewer), coneAxis) >= coneCutoff.
+	 */
+	struct Meshlet {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		BoundingSphere bounds;
+		glm::vec3 coneApex;
+		glm::vec3 coneAxis;
+		float coneCutoff;
+	};
+
+	/*
+	 * Width of the indices uploaded to the GPU
+	 */
+	enum class IndexType {
+		UInt16,
+		UInt32
+	};
+
 	class IndexedMesh : public Mesh {
 	public:
 		IndexedMesh(Topology pt = Topology::Triangles) :
@@ -39,12 +84,87 @@ namespace Engine {
 			return indices.data();
 		}
 
+		/*
+		 * Indices are kept as 32 bit on the CPU. They are uploaded as 16 bit
+		 * whenever every vertex can be addressed that way.
+		 */
+		IndexType getIndexType() const {
+			return getVertices().size() <= 0x10000 ? IndexType::UInt16
+				: IndexType::UInt32;
+		}
+
+		size_t getIndexSize() const {
+			return getIndexType() == IndexType::UInt16 ? sizeof(uint16_t)
+				: sizeof(uint32_t);
+		}
+
+		size_t getIndexBufferSize() const {
+			return getIndexSize()*indices.size();
+		}
+
+		/*
+		 * Write getIndexBufferSize() bytes of indices in getIndexType().
+		 */
+		void writeIndexBuffer(void* out) const {
+			if (getIndexType() == IndexType::UInt32) {
+				std::copy(indices.begin(), indices.end(), (uint32_t*)out);
+				return;
+			}
+			uint16_t* shortIndices = (uint16_t*)out;
+			for (size_t i = 0; i < indices.size(); i++) {
+				shortIndices[i] = (uint16_t)indices[i];
+			}
+		}
+
+		void addSubmesh(const Submesh& submesh) {
+			submeshes.push_back(submesh);
+		}
+
+		std::vector<Submesh>& getSubmeshes() {
+			return submeshes;
+		}
+
+		const std::vector<Submesh>& getSubmeshes() const {
+			return submeshes;
+		}
+
+		void addLod(const LevelOfDetail& lod) {
+			lods.push_back(lod);
+		}
+
+		/*
+		 * Level 0 is the full mesh. Coarser levels are stored after it in the
+		 * same index buffer.
+		 */
+		std::vector<LevelOfDetail>& getLods() {
+			return lods;
+		}
+
+		const std::vector<LevelOfDetail>& getLods() const {
+			return lods;
+		}
+
+		void addMeshlet(const Meshlet& meshlet) {
+			meshlets.push_back(meshlet);
+		}
+
+		std::vector<Meshlet>& getMeshlets() {
+			return meshlets;
+		}
+
+		const std::vector<Meshlet>& getMeshlets() const {
+			return meshlets;
+		}
+
 		size_t getElementCount() const override {
-			return indices.size();
+			return lods.empty() ? indices.size() : lods[0].indexCount;
 		}
 
 	private:
 		std::vector<uint32_t> indices;
+		std::vector<Submesh> submeshes;
+		std::vector<LevelOfDetail> lods;
+		std::vector<Meshlet> meshlets;
 	};
 }
 
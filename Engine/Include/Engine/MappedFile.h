@@ -0,0 +1,48 @@
+#ifndef ENGINE_MAPPEDFILE_H
+#define ENGINE_MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Engine {
+	/*
+	 * A whole file mapped read-only into memory. Pages are read from disk
+	 * when first touched, and stay shared with the operating system's file
+	 * cache.
+	 */
+	class MappedFile {
+	public:
+		MappedFile() : data(nullptr), size(0) {}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other);
+		MappedFile& operator=(MappedFile&& other);
+		~MappedFile();
+
+		/*
+		 * Map the file, replacing the current mapping. Returns false when
+		 * the file can not be opened or is empty.
+		 */
+		bool open(const std::string& path);
+		void close();
+
+		bool isOpen() const {
+			return data != nullptr;
+		}
+
+		const uint8_t* getData() const {
+			return data;
+		}
+
+		size_t getSize() const {
+			return size;
+		}
+
+	private:
+		const uint8_t* data;
+		size_t size;
+	};
+}
+
+#endif
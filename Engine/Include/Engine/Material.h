@@ -2,12 +2,17 @@
 #define ENGINE_MATERIAL_H
 
 #include "Math.h"
+#include "TextureAtlas.h"
 #include <string>
 
 namespace Engine {
 	class Material {
 	public:
-		Material() : textureScale(glm::vec2(1.f, 1.f)) {}
+		Material() :
+			textureScale(glm::vec2(1.f, 1.f)),
+			textured(false),
+			atlas(nullptr),
+			regionId(RegionTable::none) {}
 
 		void setColor(float r, float g, float b, float a) {
 			color.r = r;
@@ -17,7 +22,7 @@ namespace Engine {
 		}
 
 		bool isTextured() const {
-			return !textureName.empty();
+			return textured;
 		}
 
 		void setColor(const glm::vec4& c) {
@@ -26,6 +31,17 @@ namespace Engine {
 
 		void setTextureName(const std::string& name) {
 			textureName = name;
+			textured = !name.empty();
+			resolveRegion();
+		}
+
+		/*
+		 * Look the texture up in an atlas once, so that draws can index its
+		 * regions with getRegionId. Throws if the atlas has no such region.
+		 */
+		void bindAtlas(const TextureAtlas* a) {
+			atlas = a;
+			resolveRegion();
 		}
 
 		void setTextureScale(float x, float y) {
@@ -48,10 +64,26 @@ namespace Engine {
 			return textureScale;
 		}
 
+		/*
+		 * Region of the texture in the bound atlas, or RegionTable::none when
+		 * the material is untextured or unbound.
+		 */
+		uint32_t getRegionId() const {
+			return regionId;
+		}
+
 	private:
+		void resolveRegion() {
+			regionId = atlas != nullptr && textured
+				? atlas->findRegion(textureName) : RegionTable::none;
+		}
+
 		glm::vec4 color;
 		std::string textureName;
 		glm::vec2 textureScale;
+		bool textured;
+		const TextureAtlas* atlas;
+		uint32_t regionId;
 	};
 }
 
@@ -2,6 +2,7 @@
 #define ENGINE_MESH_H
 
 #include "Vertex.h"
+#include "PackedVertex.h"
 #include <vector>
 
 namespace Engine {
@@ -17,9 +18,18 @@ namespace Engine {
 		};
 
 		Mesh(Topology pt = Topology::Triangles) :
-			topology(pt) {}
+			topology(pt), vertexFormat(VertexFormat::Float) {}
 		virtual ~Mesh() {}
 
+		/*
+		 * The virtual destructor suppresses the implicit moves, which would
+		 * otherwise fall back to copying the vertices.
+		 */
+		Mesh(const Mesh&) = default;
+		Mesh(Mesh&&) = default;
+		Mesh& operator=(const Mesh&) = default;
+		Mesh& operator=(Mesh&&) = default;
+
 		uint32_t addVertex(const Vertex& vertex) {
 			uint32_t i = (uint32_t)vertices.size();
 			vertices.push_back(vertex);
@@ -34,6 +44,18 @@ namespace Engine {
 			return topology;
 		}
 
+		/*
+		 * Layout the renderers upload the vertices in. Vertices are always
+		 * kept as Vertex on the CPU.
+		 */
+		void setVertexFormat(VertexFormat format) {
+			vertexFormat = format;
+		}
+
+		VertexFormat getVertexFormat() const {
+			return vertexFormat;
+		}
+
 		std::vector<Vertex>& getVertices() {
 			return vertices;
 		}
@@ -60,6 +82,7 @@ namespace Engine {
 
 	private:
 		Topology topology;
+		VertexFormat vertexFormat;
 		std::vector<Vertex> vertices;
 	};
 }
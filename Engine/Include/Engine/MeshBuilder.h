@@ -0,0 +1,121 @@
+#ifndef ENGINE_MESHBUILDER_H
+#define ENGINE_MESHBUILDER_H
+
+#include "IndexedMesh.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Assembles an IndexedMesh from whole arrays instead of single vertices
+	 * and faces. Sizes that are known up front are reserved exactly, so a
+	 * mesh is built with one allocation per buffer, and buffers that were
+	 * filled elsewhere are moved in without copying.
+	 */
+	class MeshBuilder {
+	public:
+		MeshBuilder(Mesh::Topology pt = Mesh::Topology::Triangles) :
+			mesh(pt) {}
+
+		void reserve(size_t vertexCount, size_t indexCount) {
+			mesh.getVertices().reserve(vertexCount);
+			mesh.getIndices().reserve(indexCount);
+		}
+
+		uint32_t getVertexCount() const {
+			return (uint32_t)mesh.getVertices().size();
+		}
+
+		uint32_t getIndexCount() const {
+			return (uint32_t)mesh.getIndices().size();
+		}
+
+		/*
+		 * Append count vertices and return the index of the first one.
+		 */
+		uint32_t appendVertices(const Vertex* vertices, size_t count) {
+			uint32_t first = getVertexCount();
+			std::vector<Vertex>& v = mesh.getVertices();
+			v.insert(v.end(), vertices, vertices + count);
+			return first;
+		}
+
+		/*
+		 * Grow the vertices by count and return the new ones to be written
+		 * in place. The pointer is valid until the vertices grow again.
+		 */
+		Vertex* extendVertices(size_t count) {
+			std::vector<Vertex>& v = mesh.getVertices();
+			size_t first = v.size();
+			v.resize(first + count);
+			return v.data() + first;
+		}
+
+		/*
+		 * Append count indices, each offset by baseVertex.
+		 */
+		void appendIndices(const uint32_t* indices, size_t count,
+			uint32_t baseVertex = 0) {
+			uint32_t* out = extendIndices(count);
+			if (baseVertex == 0) {
+				std::copy(indices, indices + count, out);
+				return;
+			}
+			for (size_t i = 0; i < count; i++) {
+				out[i] = indices[i] + baseVertex;
+			}
+		}
+
+		uint32_t* extendIndices(size_t count) {
+			std::vector<uint32_t>& i = mesh.getIndices();
+			size_t first = i.size();
+			i.resize(first + count);
+			return i.data() + first;
+		}
+
+		/*
+		 * Take over a filled buffer. The buffer is moved when the builder
+		 * has no vertices (indices) yet, and appended otherwise.
+		 */
+		void adoptVertices(std::vector<Vertex>&& vertices) {
+			std::vector<Vertex>& v = mesh.getVertices();
+			if (v.empty()) {
+				v = std::move(vertices);
+			} else {
+				appendVertices(vertices.data(), vertices.size());
+			}
+		}
+
+		void adoptIndices(std::vector<uint32_t>&& indices) {
+			std::vector<uint32_t>& i = mesh.getIndices();
+			if (i.empty()) {
+				i = std::move(indices);
+			} else {
+				appendIndices(indices.data(), indices.size());
+			}
+		}
+
+		void addSubmesh(const Submesh& submesh) {
+			mesh.addSubmesh(submesh);
+		}
+
+		IndexedMesh& getMesh() {
+			return mesh;
+		}
+
+		/*
+		 * Move the mesh out. The builder is empty afterwards.
+		 */
+		IndexedMesh build() {
+			IndexedMesh result = std::move(mesh);
+			mesh = IndexedMesh(result.getTopology());
+			return result;
+		}
+
+	private:
+		IndexedMesh mesh;
+	};
+}
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef ENGINE_MESHCACHE_H
+#define ENGINE_MESHCACHE_H
+
+#include "MeshGeneration.h"
+#include <string>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Binary mesh cache stored next to the source file. A cache is only used
+	 * when the size and modification time of the source, the load flags and
+	 * the number of levels of detail asked for match the ones it was written
+	 * with. Vertices and indices are either stored raw or, when written with
+	 * compress, with the mesh codec, which is smaller on disk but costs
+	 * encoding time when writing.
+	 */
+	std::string meshCachePath(const std::string& sourcePath);
+
+	bool readMeshCache(const std::string& sourcePath, MeshLoadFlags flags,
+		unsigned lodLevels, IndexedMesh& mesh,
+		std::vector<Material>& materials);
+
+	void writeMeshCache(const std::string& sourcePath, MeshLoadFlags flags,
+		unsigned lodLevels, const IndexedMesh& mesh,
+		const std::vector<Material>& materials, bool compress = false);
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef ENGINE_MESHCODEC_H
+#define ENGINE_MESHCODEC_H
+
+#include "Vertex.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Lossless compression of vertex and index arrays, built for decoding
+	 * at load time. Vertices are stored as the XOR with the vertex before
+	 * and indices as the zigzagged difference to the index before, which
+	 * leaves mostly zero high bytes in a mesh optimised for vertex fetch.
+	 * Each chunk of elements is then split into byte planes (byte k of
+	 * every element), and every plane is stored raw or in blocks of 16
+	 * bytes: a mask of the nonzero bytes followed by those bytes.
+	 */
+	void encodeVertices(const Vertex* vertices, size_t count,
+		std::vector<uint8_t>& encoded);
+	void encodeIndices(const uint32_t* indices, size_t count,
+		std::vector<uint8_t>& encoded);
+
+	/*
+	 * Decode count elements into the given array. Returns false when the
+	 * data is malformed or does not hold exactly count elements.
+	 */
+	bool decodeVertices(const uint8_t* data, size_t size, Vertex* vertices,
+		size_t count);
+	bool decodeIndices(const uint8_t* data, size_t size, uint32_t* indices,
+		size_t count);
+
+	/*
+	 * Most elements of elementSize bytes that size encoded bytes can hold,
+	 * to bound the arrays allocated before decoding.
+	 */
+	size_t maxDecodedCount(size_t size, size_t elementSize);
+}
+
+#endif
@@ -3,12 +3,71 @@
 
 #include "IndexedMesh.h"
 #include "Mesh.h"
+#include "Material.h"
+#include "SkinnedMesh.h"
 #include <string>
+#include <vector>
 
 namespace Engine {
-	Mesh generateCube();
+	/*
+	 * Options for loadMesh
+	 */
+	enum class MeshLoadFlags : int {
+		None = 0x0000,
+		OptimizeVertexCache = 0x0001, /* Run the vertex cache and fetch passes */
+		BinaryCache = 0x0002 /* Read and write a binary cache next to the file */
+	};
+
+	MeshLoadFlags operator|(MeshLoadFlags a, MeshLoadFlags b);
+	MeshLoadFlags operator&(MeshLoadFlags a, MeshLoadFlags b);
+
+	/*
+	 * Average cache miss ratio (misses per triangle) and average transform to
+	 * vertex ratio (misses per referenced vertex) for a FIFO post-transform
+	 * cache of the given size.
+	 */
+	struct VertexCacheStatistics {
+		float acmr;
+		float atvr;
+	};
+
 	IndexedMesh generateSphere(unsigned subdivisions);
-	IndexedMesh loadMesh(const std::string& filePath);
+
+	/*
+	 * Upright cylinder of height jointCount, skinned to jointCount joints
+	 * placed at heights 0, 1, ... along its axis.
+	 */
+	SkinnedMesh generateSkinnedCylinder(unsigned jointCount,
+		unsigned segments = 16, unsigned ringsPerJoint = 8);
+	IndexedMesh loadMesh(const std::string& filePath,
+		MeshLoadFlags flags = MeshLoadFlags::None, unsigned lodLevels = 0);
+
+	/*
+	 * Load all shapes of an .obj file into one mesh. Faces are grouped by
+	 * material, with one submesh per material. The materials from the .mtl
+	 * file are appended to materials, and submesh material ids index into
+	 * that list (-1 when a face has no material). Up to lodLevels levels of
+	 * detail are generated before the vertex cache pass, so they are
+	 * optimized and cached along with the full mesh.
+	 */
+	IndexedMesh loadMesh(const std::string& filePath,
+		std::vector<Material>& materials,
+		MeshLoadFlags flags = MeshLoadFlags::None, unsigned lodLevels = 0);
+
+	VertexCacheStatistics analyzeVertexCache(const IndexedMesh& mesh,
+		unsigned cacheSize = 16);
+
+	/*
+	 * Reorder the triangles of each submesh and level of detail for
+	 * post-transform vertex cache locality (Tipsify, Sander et al. 2007).
+	 */
+	void optimizeVertexCache(IndexedMesh& mesh, unsigned cacheSize = 16);
+
+	/*
+	 * Reorder the vertices by first use in the index buffer. Vertices that
+	 * are not referenced by any index are removed.
+	 */
+	void optimizeVertexFetch(IndexedMesh& mesh);
 }
 
 #endif
@@ -0,0 +1,51 @@
+#ifndef ENGINE_MESHNORMALS_H
+#define ENGINE_MESHNORMALS_H
+
+#include "IndexedMesh.h"
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Triangle corners (triangle * 3 + corner) of the full detail mesh,
+	 * grouped by vertex: the corners of vertex v are
+	 * corners[offsets[v]] to corners[offsets[v + 1] - 1]. With welded seams,
+	 * remap holds the vertex whose corners each vertex shares, otherwise it
+	 * is empty. Building it is the serial part of normal and tangent
+	 * generation, so meshes whose vertices move while their triangles stay
+	 * the same should keep it around.
+	 */
+	struct VertexAdjacency {
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> corners;
+		std::vector<uint32_t> remap;
+	};
+
+	/*
+	 * With weldSeams, vertices that share a position (texture seams) are
+	 * treated as one vertex.
+	 */
+	void buildVertexAdjacency(const IndexedMesh& mesh, bool weldSeams,
+		VertexAdjacency& adjacency);
+
+	/*
+	 * Replace the vertex normals with the area weighted average of the
+	 * normals of the triangles around each vertex. Vertices that no
+	 * triangle uses keep their normal.
+	 */
+	void generateNormals(IndexedMesh& mesh, const VertexAdjacency& adjacency);
+	void generateNormals(IndexedMesh& mesh, bool weldSeams = true);
+
+	/*
+	 * Per vertex tangents in xyz and the bitangent sign in w, such that
+	 * bitangent = w * cross(normal, tangent). Every triangle corner adds
+	 * the direction of increasing u, projected onto the vertex normal and
+	 * weighted by the corner angle, as in MikkTSpace. Expects normalised
+	 * vertex normals and an adjacency built without weldSeams.
+	 */
+	void generateTangents(const IndexedMesh& mesh,
+		const VertexAdjacency& adjacency, std::vector<glm::vec4>& tangents);
+	void generateTangents(const IndexedMesh& mesh,
+		std::vector<glm::vec4>& tangents);
+}
+
+#endif
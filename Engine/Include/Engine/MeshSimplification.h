@@ -0,0 +1,39 @@
+#ifndef ENGINE_MESHSIMPLIFICATION_H
+#define ENGINE_MESHSIMPLIFICATION_H
+
+#include "IndexedMesh.h"
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Reduce the triangle list in indices towards targetIndexCount by
+	 * collapsing edges into one of their end points, cheapest first, using
+	 * Garland-Heckbert quadric error plus a normal and texture coordinate
+	 * distance term, weighted by attributeWeight times the squared mesh
+	 * radius. Vertices on open borders and texture seams are never moved.
+	 * The vertices of the mesh are not changed. Returns the largest
+	 * geometric error introduced, in mesh units.
+	 */
+	float simplifyMesh(const IndexedMesh& mesh, std::vector<uint32_t>& indices,
+		size_t targetIndexCount, float attributeWeight = 0.001f);
+
+	/*
+	 * Append up to levels coarser levels of detail to the index buffer of the
+	 * mesh, each with about ratio times the triangles of the previous one.
+	 * Submeshes are simplified separately and stored in order within each
+	 * level. Stops early when a level can not be reduced further.
+	 */
+	void generateLods(IndexedMesh& mesh, unsigned levels, float ratio = 0.5f);
+
+	/*
+	 * Pick the coarsest level whose error, projected to the screen, is at
+	 * most threshold pixels. pixelsPerUnit is the size on screen of one mesh
+	 * unit at the mesh's distance. Moving to a coarser level than current
+	 * requires the error to be below hysteresis times the threshold, so an
+	 * object near a boundary does not switch every frame.
+	 */
+	unsigned selectLod(const std::vector<LevelOfDetail>& lods, unsigned current,
+		float pixelsPerUnit, float threshold, float hysteresis = 0.75f);
+}
+
+#endif
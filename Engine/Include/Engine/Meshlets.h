@@ -0,0 +1,29 @@
+#ifndef ENGINE_MESHLETS_H
+#define ENGINE_MESHLETS_H
+
+#include "IndexedMesh.h"
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Split the full detail triangles of the mesh into meshlets of at most
+	 * maxVertices unique vertices and maxTriangles triangles. Triangles are
+	 * grown into each meshlet through shared vertices, and the index buffer
+	 * is reordered so every meshlet is one contiguous range. Meshlets do not
+	 * cross submesh boundaries, and coarser levels of detail are left as is.
+	 */
+	void buildMeshlets(IndexedMesh& mesh, unsigned maxVertices = 64,
+		unsigned maxTriangles = 124);
+
+	/*
+	 * Append the index of every meshlet that is inside the view frustum of
+	 * modelViewProjection to visible. When cullBackfacing is set, meshlets
+	 * whose normal cone faces away from viewer (in model space) are dropped
+	 * as well. The cone test is only valid for uniformly scaled meshes.
+	 */
+	void cullMeshlets(const std::vector<Meshlet>& meshlets,
+		const glm::mat4& modelViewProjection, const glm::vec3& viewer,
+		bool cullBackfacing, std::vector<uint32_t>& visible);
+}
+
+#endif
@@ -7,7 +7,7 @@
 namespace Engine {
 	class Node {
 	public:
-		Node(Node* p = nullptr) : parent(nullptr) {
+		Node(Node* p = nullptr) : parent(nullptr), scale(1.f) {
 			if (p) p->addChild(this);
 		}
 
@@ -49,6 +49,14 @@ namespace Engine {
 			rotation = glm::angleAxis(angle, axis);
 		}
 
+		void setRotation(const glm::quat& r) {
+			rotation = r;
+		}
+
+		void setScale(const glm::vec3& s) {
+			scale = s;
+		}
+
 		Node* getParent() {
 			return parent;
 		}
@@ -65,6 +73,10 @@ namespace Engine {
 			return rotation;
 		}
 
+		const glm::vec3& getScale() const {
+			return scale;
+		}
+
 		const glm::vec3& getPosition() const {
 			return position;
 		}
@@ -86,6 +98,7 @@ namespace Engine {
 		 */
 		glm::vec3 translation;
 		glm::quat rotation;
+		glm::vec3 scale;
 
 		/*
 		 * Absolute world properties
@@ -0,0 +1,55 @@
+#ifndef ENGINE_PACKEDVERTEX_H
+#define ENGINE_PACKEDVERTEX_H
+
+#include "Vertex.h"
+#include <cstddef>
+
+namespace Engine {
+	/*
+	 * Layout of the vertex data uploaded to the GPU
+	 */
+	enum class VertexFormat {
+		Float, /* Vertex, 32 bytes */
+		Packed, /* PackedVertex, 16 bytes */
+		SplitPosition /* Positions in their own stream, 12 + 20 bytes */
+	};
+
+	/*
+	 * 16 byte vertex: position as unorm16 within the bounding box of the
+	 * mesh (the fourth component is padding), octahedral snorm16 normal and
+	 * half float texture coordinates.
+	 */
+	class PackedVertex {
+	public:
+		uint16_t position[4];
+		int16_t normal[2];
+		uint16_t textureCoordinate[2];
+
+		static const size_t Stride;
+		static const size_t PositionOffset;
+		static const size_t NormalOffset;
+		static const size_t TextureCoordinateOffset;
+	};
+
+	/*
+	 * Maps unorm positions back to model space: offset + scale * position.
+	 */
+	struct VertexQuantization {
+		glm::vec3 offset;
+		glm::vec3 scale;
+	};
+
+	VertexQuantization computeVertexQuantization(const Vertex* vertices,
+		size_t count);
+
+	void packVertices(const Vertex* vertices, size_t count,
+		const VertexQuantization& quantization, PackedVertex* packed);
+
+	void unpackVertices(const PackedVertex* packed, size_t count,
+		const VertexQuantization& quantization, Vertex* vertices);
+
+	uint16_t floatToHalf(float f);
+	float halfToFloat(uint16_t h);
+}
+
+#endif
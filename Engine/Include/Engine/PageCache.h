@@ -0,0 +1,75 @@
+#ifndef ENGINE_PAGECACHE_H
+#define ENGINE_PAGECACHE_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Slots of a physical page texture and the pages they hold, identified
+	 * by non-zero keys. A slot is reused from the least recently used page,
+	 * but never from a page used in the current frame or a pinned one.
+	 */
+	class PageCache {
+	public:
+		/* Slot returned for a page that is not cached, or can not be */
+		static const uint32_t none;
+
+		explicit PageCache(uint32_t slotCount);
+
+		/*
+		 * Start a frame. Pages touched or inserted from now on are in use
+		 * until the next one.
+		 */
+		void beginFrame() {
+			frame++;
+		}
+
+		/*
+		 * Slot holding a page, or none.
+		 */
+		uint32_t find(uint32_t page) const;
+
+		/*
+		 * Mark the page in a slot used this frame, so it is evicted last.
+		 */
+		void touch(uint32_t slot);
+
+		/*
+		 * Slot for a page not in the cache, used this frame. evicted
+		 * receives the page the slot held, or 0 when it was free. Returns
+		 * none when every slot is pinned or in use.
+		 */
+		uint32_t insert(uint32_t page, uint32_t& evicted);
+
+		/*
+		 * Keep the page in a slot for as long as the cache exists.
+		 */
+		void pin(uint32_t slot);
+
+		uint32_t getPage(uint32_t slot) const {
+			return pages[slot];
+		}
+
+		uint32_t getSlotCount() const {
+			return (uint32_t)pages.size();
+		}
+
+	private:
+		void unlink(uint32_t slot);
+		void append(uint32_t slot);
+
+		std::unordered_map<uint32_t, uint32_t> slots;
+		std::vector<uint32_t> pages;
+		std::vector<uint64_t> lastUsed;
+		/* Unpinned slots, least recently used first */
+		std::vector<uint32_t> previous;
+		std::vector<uint32_t> next;
+		uint32_t oldest;
+		uint32_t newest;
+		uint64_t frame;
+	};
+}
+
+#endif
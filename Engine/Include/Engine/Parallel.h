@@ -0,0 +1,48 @@
+#ifndef ENGINE_PARALLEL_H
+#define ENGINE_PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Number of threads parallelFor splits work across
+	 */
+	inline unsigned workerCount() {
+		unsigned count = std::thread::hardware_concurrency();
+		return count == 0 ? 1 : count;
+	}
+
+	/*
+	 * Call f(begin, end) on contiguous ranges that cover [0, count), one
+	 * range per worker, with no range smaller than minChunk. The calling
+	 * thread runs the first range and returns once every range is done.
+	 */
+	template <typename F>
+	void parallelFor(size_t count, size_t minChunk, F f) {
+		size_t chunks = std::min((size_t)workerCount(),
+			(count + minChunk - 1) / std::max(minChunk, (size_t)1));
+		if (chunks <= 1) {
+			if (count > 0) f((size_t)0, count);
+			return;
+		}
+
+		size_t chunkSize = (count + chunks - 1) / chunks;
+		std::vector<std::thread> threads;
+		threads.reserve(chunks - 1);
+		for (size_t c = 1; c < chunks; c++) {
+			size_t begin = c*chunkSize;
+			size_t end = std::min(count, begin + chunkSize);
+			if (begin >= end) break;
+			threads.emplace_back([=]() { f(begin, end); });
+		}
+		f((size_t)0, std::min(count, chunkSize));
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef ENGINE_PIXELCONVERSION_H
+#define ENGINE_PIXELCONVERSION_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Engine {
+	/*
+	 * Expand tightly packed pixels to RGBA. Grey is copied to red, green
+	 * and blue, and alpha is 255 where the source has none. Uses SSSE3
+	 * shuffles when the CPU has them. Source and destination must not
+	 * overlap.
+	 */
+	void convertRGBToRGBA(const uint8_t* rgb, uint8_t* rgba, size_t pixels);
+	void convertGreyToRGBA(const uint8_t* grey, uint8_t* rgba, size_t pixels);
+	void convertGreyAlphaToRGBA(const uint8_t* greyAlpha, uint8_t* rgba,
+		size_t pixels);
+}
+
+#endif
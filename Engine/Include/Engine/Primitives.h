@@ -0,0 +1,48 @@
+#ifndef ENGINE_PRIMITIVES_H
+#define ENGINE_PRIMITIVES_H
+
+#include "IndexedMesh.h"
+
+namespace Engine {
+	/*
+	 * Unit cube around the origin, four vertices per face so every face
+	 * has its own normal and texture coordinates. Vertices and indices are
+	 * tables generated at compile time.
+	 */
+	IndexedMesh generateCube();
+
+	/*
+	 * Unit square on the xy plane around the origin, facing +z. Also
+	 * generated at compile time.
+	 */
+	IndexedMesh generateQuad();
+
+	/*
+	 * Unit square on the xz plane around the origin, facing up, split into
+	 * columns by rows quads. Vertices are stored row by row along z.
+	 */
+	IndexedMesh generateGrid(unsigned columns, unsigned rows);
+
+	/*
+	 * Closed cylinder of radius 0.5 from y = -0.5 to y = 0.5, with
+	 * segments quads around its side.
+	 */
+	IndexedMesh generateCylinder(unsigned segments = 32);
+
+	/*
+	 * Torus around the y axis, reaching out to radius 0.5, with a tube of
+	 * tubeRadius. segments go around the y axis, tubeSegments around the
+	 * tube.
+	 */
+	IndexedMesh generateTorus(unsigned segments = 32,
+		unsigned tubeSegments = 16, float tubeRadius = 0.15f);
+
+	/*
+	 * Upright capsule of height 1 around the origin: a cylinder of the
+	 * given radius capped by hemispheres of rings rows each.
+	 */
+	IndexedMesh generateCapsule(unsigned segments = 32, unsigned rings = 8,
+		float radius = 0.25f);
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef ENGINE_REGIONTABLE_H
+#define ENGINE_REGIONTABLE_H
+
+#include "Texture.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Named regions of an atlas compiled into one block of memory that is
+	 * used in place: regions sorted by name, and a perfect hash from each
+	 * name to its index. The block can be written to a file and mapped
+	 * back without parsing. IDs are indices in name order.
+	 */
+	class RegionTable {
+	public:
+		/* ID returned for a name not in the table */
+		static const uint32_t none;
+
+		RegionTable();
+
+		/*
+		 * Compile regions, given in pixels and in texture coordinates, with
+		 * names that must be unique.
+		 */
+		RegionTable(const std::vector<std::string>& names,
+			const std::vector<PixelRect>& pixelRects,
+			const std::vector<TextureRect>& rects);
+		RegionTable(const RegionTable&) = delete;
+		RegionTable& operator=(const RegionTable&) = delete;
+		RegionTable(RegionTable&& other) = default;
+		RegionTable& operator=(RegionTable&& other) = default;
+
+		/*
+		 * Use a compiled table that outlives this one, such as part of a
+		 * mapped file, without copying it. Returns false, leaving the table
+		 * empty, when the data is not a valid table.
+		 */
+		bool assign(const uint8_t* tableData, size_t tableBytes);
+
+		/*
+		 * ID of a name, or none.
+		 */
+		uint32_t find(const char* name, size_t length) const;
+
+		uint32_t find(const std::string& name) const {
+			return find(name.data(), name.size());
+		}
+
+		uint32_t getCount() const {
+			return count;
+		}
+
+		std::string getName(uint32_t id) const;
+		const PixelRect& getPixelRect(uint32_t id) const;
+		const TextureRect& getRect(uint32_t id) const;
+
+		/*
+		 * The compiled table, as assign takes it.
+		 */
+		const uint8_t* getData() const {
+			return data;
+		}
+
+		size_t getSize() const {
+			return size;
+		}
+
+	private:
+		struct Record;
+
+		bool bind(const uint8_t* tableData, size_t tableBytes);
+
+		std::vector<uint8_t> storage;
+		const uint8_t* data;
+		size_t size;
+		uint32_t count;
+		uint32_t bucketCount;
+		const Record* records;
+		const uint32_t* displacements;
+		const uint32_t* slots;
+		const char* strings;
+	};
+}
+
+#endif
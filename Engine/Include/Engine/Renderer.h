@@ -5,18 +5,24 @@
 #include "Entity.h"
 #include "LightSource.h"
 #include "TextureAtlas.h"
+#include "VirtualTexture.h"
+#include "Bounds.h"
+#include "MeshSimplification.h"
+#include "Meshlets.h"
 #include <vector>
 
 namespace Engine {
 	class Renderer {
 	public:
-		Renderer() : camera(nullptr) {}
+		Renderer() : camera(nullptr), lodThreshold(1.f), textureAtlas(nullptr),
+			virtualTexture(nullptr) {}
 		virtual ~Renderer() {}
 
 		virtual void render() = 0;
 
 		void addEntity(Entity* e) {
 			entities.push_back(e);
+			bindMaterial(*e);
 		}
 
 		void addLightSource(LightSource* l) {
@@ -27,8 +33,42 @@ namespace Engine {
 			camera = c;
 		}
 
+		/*
+		 * Use an atlas for textured materials, resolving their regions for
+		 * the entities added so far, and for those added later as they are.
+		 */
 		virtual void setTextureAtlas(const TextureAtlas* atlas) {
 			textureAtlas = atlas;
+			for (Entity* e : entities) bindMaterial(*e);
+		}
+
+		/*
+		 * Sample textured materials from a virtual texture cut from the
+		 * atlas, paged in as it is seen, instead of from the atlas texture.
+		 * The atlas still gives their regions. Set before the atlas, so the
+		 * atlas texture is not uploaded.
+		 */
+		virtual void setVirtualTexture(VirtualTexture* texture) {
+			virtualTexture = texture;
+		}
+
+		/*
+		 * Whether textures of the format can be uploaded as they are.
+		 */
+		virtual bool supportsTextureFormat(Texture::Format format) const {
+			return !Texture::isCompressed(format);
+		}
+
+		/*
+		 * Largest on-screen error, in pixels, allowed when picking a level
+		 * of detail.
+		 */
+		void setLodThreshold(float pixels) {
+			lodThreshold = pixels;
+		}
+
+		float getLodThreshold() const {
+			return lodThreshold;
 		}
 
 		Camera* getCamera() {
@@ -43,11 +83,85 @@ namespace Engine {
 			return textureAtlas;
 		}
 
+		VirtualTexture* getVirtualTexture() const {
+			return virtualTexture;
+		}
+
 	protected:
 		Camera* camera;
+		float lodThreshold;
 		const TextureAtlas* textureAtlas;
+		VirtualTexture* virtualTexture;
 		std::vector<Entity*> entities;
 		std::vector<LightSource*> lightSources;
+		std::vector<uint32_t> visibleMeshlets;
+
+		void bindMaterial(Entity& e) {
+			Material* material = e.getGeometry() != nullptr
+				? e.getGeometry()->getMaterial() : nullptr;
+			if (material != nullptr && textureAtlas != nullptr) {
+				material->bindAtlas(textureAtlas);
+			}
+		}
+
+		/*
+		 * Pick and store the level of detail of an entity from the size on
+		 * screen of its mesh bounds.
+		 */
+		unsigned selectLod(Entity& e, const std::vector<LevelOfDetail>& lods,
+			const BoundingSphere& bounds, float viewportHeight) const {
+			if (lods.size() < 2) return 0;
+			const glm::mat4& scale = e.getScaleMatrix();
+			float maxScale = glm::max(glm::length(glm::vec3(scale[0])),
+				glm::max(glm::length(glm::vec3(scale[1])),
+					glm::length(glm::vec3(scale[2]))));
+			glm::vec4 center = camera->getViewMatrix()
+				* e.getNode()->getWorldMatrix() * scale
+				* glm::vec4(bounds.center, 1.f);
+			float distance = glm::length(glm::vec3(center))
+				- bounds.radius * maxScale;
+			distance = glm::max(distance, 1e-3f);
+			float pixelsPerUnit = maxScale * camera->getProjectionMatrix()[1][1]
+				* viewportHeight * 0.5f / distance;
+			unsigned lod = Engine::selectLod(lods, e.getLod(), pixelsPerUnit,
+				lodThreshold);
+			e.setLod(lod);
+			return lod;
+		}
+
+		/*
+		 * Whether any of the mesh bounds of an entity are in view.
+		 */
+		bool isVisible(const Entity& e, const BoundingSphere& bounds) const {
+			glm::mat4 modelViewProjection = camera->getProjectionMatrix()
+				* camera->getViewMatrix() * e.getNode()->getWorldMatrix()
+				* e.getScaleMatrix();
+			return intersectsFrustum(computeFrustum(modelViewProjection),
+				bounds);
+		}
+
+		/*
+		 * Replace visible with the meshlets of an entity that can be seen
+		 * from the camera. Backfacing meshlets are only dropped when the
+		 * entity is scaled uniformly.
+		 */
+		void cullMeshlets(const Entity& e, const std::vector<Meshlet>& meshlets,
+			std::vector<uint32_t>& visible) const {
+			visible.clear();
+			glm::mat4 worldMatrix = e.getNode()->getWorldMatrix()
+				* e.getScaleMatrix();
+			glm::mat4 modelView = camera->getViewMatrix() * worldMatrix;
+			glm::vec3 viewer = glm::vec3(glm::inverse(modelView)
+				* glm::vec4(0.f, 0.f, 0.f, 1.f));
+			float sx = glm::length(glm::vec3(worldMatrix[0]));
+			float sy = glm::length(glm::vec3(worldMatrix[1]));
+			float sz = glm::length(glm::vec3(worldMatrix[2]));
+			bool uniform = glm::abs(sx - sy) <= 1e-4f * sx
+				&& glm::abs(sx - sz) <= 1e-4f * sx;
+			Engine::cullMeshlets(meshlets,
+				camera->getProjectionMatrix() * modelView, viewer, uniform,
+				visible);
+		}
 	};
 }
 
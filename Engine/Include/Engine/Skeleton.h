@@ -0,0 +1,66 @@
+#ifndef ENGINE_SKELETON_H
+#define ENGINE_SKELETON_H
+
+#include "Node.h"
+#include <glm/gtx/dual_quaternion.hpp>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Joints of a skinned mesh. Each joint is a Node below root, and each
+	 * has the inverse of its bind pose transform relative to root. Skinned
+	 * vertices are in the space of root, so an entity drawing them should
+	 * use root as its node.
+	 */
+	class Skeleton {
+	public:
+		Skeleton(Node* root = nullptr) : root(root) {}
+
+		/*
+		 * Add a joint and return its index for SkinWeights.
+		 */
+		uint16_t addJoint(Node* joint, const glm::mat4& inverseBindMatrix) {
+			joints.push_back(joint);
+			inverseBindMatrices.push_back(inverseBindMatrix);
+			return (uint16_t)(joints.size() - 1);
+		}
+
+		/*
+		 * Take the current world transforms of the joints (after
+		 * Node::update) as the bind pose.
+		 */
+		void setBindPose();
+
+		/*
+		 * Joint transforms from bind pose to the current pose, in the space
+		 * of root. Node::update must have run for this frame.
+		 */
+		void computeJointMatrices(std::vector<glm::mat4>& matrices) const;
+
+		/*
+		 * The same transforms as unit dual quaternions. Scale is dropped,
+		 * as dual quaternions can only express rotation and translation.
+		 */
+		void computeJointDualQuaternions(
+			std::vector<glm::fdualquat>& dualQuaternions) const;
+
+		Node* getRoot() const {
+			return root;
+		}
+
+		size_t getJointCount() const {
+			return joints.size();
+		}
+
+		const std::vector<Node*>& getJoints() const {
+			return joints;
+		}
+
+	private:
+		Node* root;
+		std::vector<Node*> joints;
+		std::vector<glm::mat4> inverseBindMatrices;
+	};
+}
+
+#endif
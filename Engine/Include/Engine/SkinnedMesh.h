@@ -0,0 +1,45 @@
+#ifndef ENGINE_SKINNEDMESH_H
+#define ENGINE_SKINNEDMESH_H
+
+#include "IndexedMesh.h"
+#include <vector>
+
+namespace Engine {
+	/*
+	 * The joints that move a vertex and how much each of them does. Weights
+	 * sum to one; unused influences have weight zero.
+	 */
+	struct SkinWeights {
+		uint16_t joints[4];
+		float weights[4];
+	};
+
+	/*
+	 * Mesh in bind pose with one SkinWeights per vertex. The vertex format
+	 * must stay VertexFormat::Float, as renderers rewrite the skinned
+	 * vertices every frame.
+	 */
+	class SkinnedMesh : public IndexedMesh {
+	public:
+		SkinnedMesh(Topology pt = Topology::Triangles) :
+			IndexedMesh(pt) {}
+
+		uint32_t addVertex(const Vertex& vertex, const SkinWeights& weights) {
+			skinWeights.push_back(weights);
+			return Mesh::addVertex(vertex);
+		}
+
+		std::vector<SkinWeights>& getSkinWeights() {
+			return skinWeights;
+		}
+
+		const std::vector<SkinWeights>& getSkinWeights() const {
+			return skinWeights;
+		}
+
+	private:
+		std::vector<SkinWeights> skinWeights;
+	};
+}
+
+#endif
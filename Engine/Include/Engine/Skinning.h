@@ -0,0 +1,49 @@
+#ifndef ENGINE_SKINNING_H
+#define ENGINE_SKINNING_H
+
+#include "SkinnedMesh.h"
+#include <glm/gtx/dual_quaternion.hpp>
+#include <cstddef>
+
+namespace Engine {
+	enum class SkinningMethod {
+		LinearBlend, /* Blend joint matrices; cheap, collapses at twists */
+		DualQuaternion /* Blend rigid transforms; keeps volume, no scale */
+	};
+
+	/*
+	 * Vertices of one mesh instance to pose. jointMatrices is read by
+	 * LinearBlend and jointDualQuaternions by DualQuaternion; the other may
+	 * be null.
+	 */
+	struct SkinningJob {
+		const Vertex* bindPose;
+		const SkinWeights* weights;
+		size_t vertexCount;
+		const glm::mat4* jointMatrices;
+		const glm::fdualquat* jointDualQuaternions;
+		Vertex* skinned;
+	};
+
+	/*
+	 * Transform positions and normals of the job, copying texture
+	 * coordinates. Normals are not renormalised after linear blending.
+	 * Uses AVX2 and FMA when the CPU has them.
+	 */
+	void skinVertices(const SkinningJob& job, SkinningMethod method);
+
+	/*
+	 * Skin many instances, spread across worker threads.
+	 */
+	void skinVertices(const SkinningJob* jobs, size_t jobCount,
+		SkinningMethod method);
+
+	/*
+	 * Allow the AVX2 kernels, the default, or force the scalar ones, for
+	 * comparing the two. Returns whether the AVX2 kernels are now used.
+	 * Not to be called while vertices are being skinned.
+	 */
+	bool setSkinningSimd(bool enabled);
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef ENGINE_STATICBATCH_H
+#define ENGINE_STATICBATCH_H
+
+#include "Entity.h"
+#include "IndexedMesh.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Entities that never move, merged into meshes already in world space:
+	 * one mesh per material, vertex format and square cell on the xz plane,
+	 * so cells out of view can still be culled. The batch owns the merged
+	 * meshes and one entity per mesh, which are drawn in place of the
+	 * source entities.
+	 */
+	class StaticBatch {
+	public:
+		StaticBatch() {}
+		StaticBatch(const StaticBatch&) = delete;
+		StaticBatch& operator=(const StaticBatch&) = delete;
+
+		/*
+		 * Merge the entities, whose world matrices must be up to date.
+		 * Merged meshes get levels of detail and meshlets when any of their
+		 * sources had them. With a cachePath, the merged meshes are read
+		 * from it when it was written for the same entities and cell size,
+		 * and written to it otherwise. Skinned entities can not be merged.
+		 */
+		void build(const std::vector<Entity*>& sources, float cellSize,
+			const std::string& cachePath = "");
+
+		const std::vector<Entity*>& getEntities() const {
+			return entityPointers;
+		}
+
+	private:
+		Node node;
+		std::deque<IndexedMesh> meshes;
+		std::deque<Geometry> geometries;
+		std::deque<Entity> entities;
+		std::vector<Entity*> entityPointers;
+	};
+}
+
+#endif
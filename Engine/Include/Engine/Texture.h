@@ -1,47 +1,177 @@
 #ifndef ENGINE_TEXTURE_H
 #define ENGINE_TEXTURE_H
 
+#include "MappedFile.h"
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace Engine {
+	/*
+	 * Options for loading a texture from an image file
+	 */
+	enum class TextureLoadFlags : int {
+		None = 0x0000,
+		ForceRGBA = 0x0001, /* Expand grey images to RGBA as well */
+		Mipmaps = 0x0002, /* Generate the mip chain */
+		BinaryCache = 0x0004, /* Map decoded texels cached next to the file */
+		CompressFast = 0x0008, /* Encode to BC1, or BC3 if any alpha is below 255 */
+		CompressQuality = 0x0010 /* Encode to BC7 */
+	};
+
+	TextureLoadFlags operator|(TextureLoadFlags a, TextureLoadFlags b);
+	TextureLoadFlags operator&(TextureLoadFlags a, TextureLoadFlags b);
+
+	/*
+	 * Rectangle of whole pixels, from (x, y) on.
+	 */
+	struct PixelRect {
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	/*
+	 * Rectangle in texture coordinates, from 0 to 1 across the texture.
+	 */
+	struct TextureRect {
+		float x;
+		float y;
+		float w;
+		float h;
+	};
+
+	/*
+	 * One mip level, offset bytes from the start of the pixel data.
+	 */
+	struct TextureLevel {
+		uint32_t width;
+		uint32_t height;
+		uint32_t rowPitch;
+		uint64_t offset;
+	};
+
 	class Texture {
 	public:
 		enum class Format : int {
 			Grey = 1,
 			GreyAlpha = 2,
-			RGBA = 4
+			RGBA = 4,
+			BC1 = 0x100,
+			BC3 = 0x101,
+			BC7 = 0x102
 		};
-		
-		Texture(const std::string& file);
+
+		/*
+		 * Bytes per pixel, or per 4x4 block of a compressed format.
+		 */
+		static uint32_t formatSize(Format format);
+		static bool isCompressed(Format format);
+
+		/*
+		 * Rows of pixels, or of blocks, in a level of the given height.
+		 */
+		static uint32_t rowCount(Format format, uint32_t height);
+
+		/*
+		 * Decode an image file. RGB images become RGBA, and with ForceRGBA
+		 * so do grey images, for backends that only sample RGBA. Mipmaps
+		 * are generated with the given regions, as by generateMipmaps, and
+		 * the compression flags then encode every level, as by compress.
+		 */
+		Texture(const std::string& file,
+			TextureLoadFlags flags = TextureLoadFlags::None,
+			const std::vector<PixelRect>& regions = std::vector<PixelRect>());
 		Texture(Format format, uint32_t w, uint32_t h);
+		Texture(const Texture&) = delete;
+		Texture& operator=(const Texture&) = delete;
 		virtual ~Texture();
-		
+
 		Format getFormat() const {
 			return format;
 		}
-		
+
 		uint32_t getWidth() const {
-			return width;
+			return levels[0].width;
 		}
-		
+
 		uint32_t getHeight() const {
-			return height;
+			return levels[0].height;
+		}
+
+		/*
+		 * Bytes from the start of one row of pixels to the next.
+		 */
+		uint32_t getRowPitch() const {
+			return levels[0].rowPitch;
 		}
-		
+
 		uint8_t* getPixelData() {
 			return pixelData;
 		}
-		
+
 		const uint8_t* getPixelData() const {
 			return pixelData;
 		}
-		
+
+		uint32_t getLevelCount() const {
+			return (uint32_t)levels.size();
+		}
+
+		const TextureLevel& getLevel(uint32_t level) const {
+			return levels[level];
+		}
+
+		uint8_t* getLevelData(uint32_t level) {
+			return pixelData + levels[level].offset;
+		}
+
+		const uint8_t* getLevelData(uint32_t level) const {
+			return pixelData + levels[level].offset;
+		}
+
+		size_t getLevelSize(uint32_t level) const {
+			return (size_t)levels[level].rowPitch
+				* rowCount(format, levels[level].height);
+		}
+
+		/*
+		 * Replace the levels below the first with a chain down to 1x1, each
+		 * the 2x2 box filtered level above. Levels start levelAlignment
+		 * bytes apart. Pixels of a region are filtered from that region
+		 * alone, so regions of an atlas do not bleed into each other, and
+		 * their edges are first extruded up to gutterSize pixels into the
+		 * space no region covers.
+		 */
+		void generateMipmaps(
+			const std::vector<PixelRect>& regions = std::vector<PixelRect>());
+
+		/*
+		 * Encode every level of an RGBA texture into a block compressed
+		 * format, rows of blocks packed tight.
+		 */
+		void compress(Format compressed);
+
+		/*
+		 * Compress as the flags ask: BC7 for CompressQuality, otherwise BC1
+		 * for CompressFast, or BC3 when any alpha is below 255.
+		 */
+		void compress(TextureLoadFlags flags);
+
+		static const size_t levelAlignment;
+		static const uint32_t gutterSize;
+
 	private:
 		Format format;
-		uint32_t width, height;
+		std::vector<TextureLevel> levels;
 		uint8_t* pixelData;
 		void (*deleter)(void*);
+		MappedFile mapping;
+
+		friend bool readTextureCache(const std::string& sourcePath,
+			TextureLoadFlags flags, const std::vector<PixelRect>& regions,
+			Texture& texture);
 	};
 }
 
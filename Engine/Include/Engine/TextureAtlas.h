@@ -2,34 +2,82 @@
 #define TEXTUREATLAS_H
 
 #include "Texture.h"
-#include <unordered_map>
+#include "MappedFile.h"
+#include "RegionTable.h"
 #include <string>
+#include <vector>
 
 namespace Engine {
-	struct TextureRect {
-		float x;
-		float y;
-		float w;
-		float h;
+	/*
+	 * Image to pack into an atlas, and the name of its region.
+	 */
+	struct AtlasSource {
+		std::string name;
+		std::string file;
 	};
 
+	/*
+	 * Read the regions of a meta file: one "name = x y w h" line per
+	 * region, in pixels, with comments from '#' to the end of a line.
+	 */
+	void readAtlasMeta(const std::string& meta, std::vector<std::string>& names,
+		std::vector<PixelRect>& rects);
+
+	/*
+	 * Compile an image and its meta file into a bundle that loads without
+	 * parsing. The bundle refers to the image by name, so the image must
+	 * be in the same directory.
+	 */
+	void writeAtlasBundle(const std::string& image, const std::string& meta,
+		const std::string& bundle);
+
 	class TextureAtlas {
 	public:
-		TextureAtlas(const std::string& image, const std::string& meta);
+		TextureAtlas(const std::string& image, const std::string& meta,
+			TextureLoadFlags flags = TextureLoadFlags::None);
+		/*
+		 * Load a bundle written by writeAtlasBundle. The bundle is mapped
+		 * and its regions looked up in place.
+		 */
+		explicit TextureAtlas(const std::string& bundle,
+			TextureLoadFlags flags = TextureLoadFlags::None);
+		/*
+		 * Pack images into a new RGBA atlas with padding pixels between
+		 * them, in the smallest power of two size up to maxSize. Mipmaps
+		 * and compression follow the flags; BinaryCache is ignored, as the
+		 * atlas has no single source file.
+		 */
+		TextureAtlas(const std::vector<AtlasSource>& sources,
+			TextureLoadFlags flags = TextureLoadFlags::None,
+			uint32_t padding = Texture::gutterSize, uint32_t maxSize = 8192);
 		~TextureAtlas();
 
 		const Texture* getTexture() const {
 			return texture;
 		}
 
+		/*
+		 * ID of a named region, to be looked up once and then used to
+		 * index the regions on every draw.
+		 */
+		uint32_t findRegion(const std::string& name) const;
+
+		const TextureRect& getRegion(uint32_t id) const {
+			return regions.getRect(id);
+		}
+
 		const TextureRect& getRegion(const std::string& name) const {
-			auto found = regions.find(name);
-			return found->second;
+			return regions.getRect(findRegion(name));
+		}
+
+		const RegionTable& getRegions() const {
+			return regions;
 		}
-		
+
 	private:
 		Texture* texture;
-		std::unordered_map<std::string, TextureRect> regions;
+		MappedFile bundleFile;
+		RegionTable regions;
 	};
 }
 
@@ -0,0 +1,34 @@
+#ifndef ENGINE_TEXTURECACHE_H
+#define ENGINE_TEXTURECACHE_H
+
+#include "Texture.h"
+#include <string>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Decoded texels and their mip levels, cached next to the source image
+	 * so they can be mapped instead of decoded. A cache is only used when
+	 * the load flags, mipmap regions and the size of the source match the
+	 * ones it was written with, and the modification time or, failing that,
+	 * a hash of the source does. Each combination of load flags has its own
+	 * file, so loads that compress to different formats do not overwrite
+	 * each other's cache.
+	 */
+	std::string textureCachePath(const std::string& sourcePath,
+		TextureLoadFlags flags);
+
+	/*
+	 * Map the cache into texture, which then reads its texels from the
+	 * mapping. Returns false, leaving texture as it was, on a miss.
+	 */
+	bool readTextureCache(const std::string& sourcePath,
+		TextureLoadFlags flags, const std::vector<PixelRect>& regions,
+		Texture& texture);
+
+	void writeTextureCache(const std::string& sourcePath,
+		TextureLoadFlags flags, const std::vector<PixelRect>& regions,
+		const Texture& texture);
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef ENGINE_TEXTURECOMPRESSION_H
+#define ENGINE_TEXTURECOMPRESSION_H
+
+#include "Texture.h"
+
+namespace Engine {
+	/*
+	 * Encode RGBA pixels into 4x4 blocks of BC1, BC3 or BC7, blockRowPitch
+	 * bytes from one row of blocks to the next. BC1 and BC3 fit colour
+	 * endpoints along the principal axis of each block; BC7 uses mode 6,
+	 * one RGBA line with 16 levels, refined by least squares. Blocks past
+	 * the right and bottom edges repeat the edge pixels. Rows of blocks are
+	 * spread across worker threads.
+	 */
+	void compressTexels(const uint8_t* rgba, uint32_t width, uint32_t height,
+		uint32_t rowPitch, Texture::Format format, uint8_t* blocks,
+		uint32_t blockRowPitch);
+
+	/*
+	 * Whether every alpha value of the RGBA pixels is 255, so BC1 can hold
+	 * them.
+	 */
+	bool isOpaque(const uint8_t* rgba, uint32_t width, uint32_t height,
+		uint32_t rowPitch);
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef ENGINE_TEXTURESTREAMER_H
+#define ENGINE_TEXTURESTREAMER_H
+
+#include "Texture.h"
+
+namespace Engine {
+	/*
+	 * Rows of one level to upload: rows of pixels, or of 4x4 blocks for a
+	 * compressed format, from firstRow on.
+	 */
+	struct TextureUpload {
+		uint32_t level;
+		uint32_t firstRow;
+		uint32_t rowCount;
+	};
+
+	/*
+	 * Order in which the levels of a texture are uploaded: the smallest
+	 * level first, then each larger one, whole rows at a time, so that a
+	 * renderer can sample the levels that have arrived while the rest
+	 * stream in over later frames.
+	 */
+	class TextureStreamer {
+	public:
+		TextureStreamer(const Texture& texture);
+
+		/*
+		 * The next rows to upload, at most budget bytes of them, all from
+		 * one level. The first call hands out the smallest level whatever
+		 * the budget, so there is always a level to sample. Returns false
+		 * when every row has been handed out or the next row does not fit.
+		 */
+		bool next(size_t budget, TextureUpload& upload);
+
+		/*
+		 * Finest level whose rows have all been handed out. Every smaller
+		 * level has been handed out too.
+		 */
+		uint32_t getResidentLevel() const {
+			return residentLevel;
+		}
+
+		bool isComplete() const {
+			return residentLevel == 0;
+		}
+
+		size_t getSize(const TextureUpload& upload) const {
+			return (size_t)texture.getLevel(upload.level).rowPitch
+				* upload.rowCount;
+		}
+
+		const uint8_t* getData(const TextureUpload& upload) const {
+			return texture.getLevelData(upload.level)
+				+ (size_t)texture.getLevel(upload.level).rowPitch
+				* upload.firstRow;
+		}
+
+		/*
+		 * Pixels of the level covered by the rows of an upload.
+		 */
+		PixelRect getRect(const TextureUpload& upload) const;
+
+		const Texture& getTexture() const {
+			return texture;
+		}
+
+	private:
+		const Texture& texture;
+		uint32_t residentLevel;
+		uint32_t nextRow;
+	};
+}
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef ENGINE_VERTEXLAYOUT_H
+#define ENGINE_VERTEXLAYOUT_H
+
+#include "PackedVertex.h"
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Component type and count of a vertex attribute as seen by the GPU
+	 */
+	enum class AttributeFormat {
+		Float2,
+		Float3,
+		Unorm16x4,
+		Snorm16x2,
+		Half2
+	};
+
+	struct VertexAttributeDescription {
+		uint32_t location;
+		AttributeFormat format;
+		uint32_t offset;
+	};
+
+	/*
+	 * Attribute tags for VertexLayout. The location is the shader input the
+	 * attribute feeds; packed attributes feed the same inputs as their
+	 * float counterparts. Float attributes know how to copy themselves out
+	 * of a Vertex.
+	 */
+	namespace Attribute {
+		struct Position {
+			typedef glm::vec3 Type;
+			static constexpr uint32_t location() { return 0; }
+			static constexpr AttributeFormat format() {
+				return AttributeFormat::Float3;
+			}
+			static void copy(const Vertex& v, void* out) {
+				memcpy(out, &v.position, sizeof(Type));
+			}
+		};
+
+		struct Normal {
+			typedef glm::vec3 Type;
+			static constexpr uint32_t location() { return 1; }
+			static constexpr AttributeFormat format() {
+				return AttributeFormat::Float3;
+			}
+			static void copy(const Vertex& v, void* out) {
+				memcpy(out, &v.normal, sizeof(Type));
+			}
+		};
+
+		struct TextureCoordinate {
+			typedef glm::vec2 Type;
+			static constexpr uint32_t location() { return 2; }
+			static constexpr AttributeFormat format() {
+				return AttributeFormat::Float2;
+			}
+			static void copy(const Vertex& v, void* out) {
+				memcpy(out, &v.textureCoordinate, sizeof(Type));
+			}
+		};
+
+		struct PackedPosition {
+			typedef uint16_t Type[4];
+			static constexpr uint32_t location() { return 0; }
+			static constexpr AttributeFormat format() {
+				return AttributeFormat::Unorm16x4;
+			}
+		};
+
+		struct PackedNormal {
+			typedef int16_t Type[2];
+			static constexpr uint32_t location() { return 1; }
+			static constexpr AttributeFormat format() {
+				return AttributeFormat::Snorm16x2;
+			}
+		};
+
+		struct PackedTextureCoordinate {
+			typedef uint16_t Type[2];
+			static constexpr uint32_t location() { return 2; }
+			static constexpr AttributeFormat format() {
+				return AttributeFormat::Half2;
+			}
+		};
+	}
+
+	template <typename... Attributes>
+	struct AttributeSize;
+
+	template <>
+	struct AttributeSize<> {
+		static constexpr uint32_t value() { return 0; }
+	};
+
+	template <typename A, typename... Rest>
+	struct AttributeSize<A, Rest...> {
+		static constexpr uint32_t value() {
+			return (uint32_t)sizeof(typename A::Type)
+				+ AttributeSize<Rest...>::value();
+		}
+	};
+
+	/*
+	 * Offset of attribute A in a list of attributes
+	 */
+	template <typename A, typename... Attributes>
+	struct AttributeOffset;
+
+	template <typename A, typename... Rest>
+	struct AttributeOffset<A, A, Rest...> {
+		static constexpr uint32_t value() { return 0; }
+	};
+
+	template <typename A, typename B, typename... Rest>
+	struct AttributeOffset<A, B, Rest...> {
+		static constexpr uint32_t value() {
+			return (uint32_t)sizeof(typename B::Type)
+				+ AttributeOffset<A, Rest...>::value();
+		}
+	};
+
+	/*
+	 * Interleaved vertex stream holding the given attributes in order.
+	 */
+	template <typename... Attributes>
+	struct VertexLayout {
+		static constexpr uint32_t attributeCount() {
+			return sizeof...(Attributes);
+		}
+
+		static constexpr uint32_t stride() {
+			return AttributeSize<Attributes...>::value();
+		}
+
+		template <typename A>
+		static constexpr uint32_t offset() {
+			return AttributeOffset<A, Attributes...>::value();
+		}
+
+		static constexpr VertexAttributeDescription
+			attributes[sizeof...(Attributes)] = {
+			{ Attributes::location(), Attributes::format(),
+				AttributeOffset<Attributes, Attributes...>::value() }...
+		};
+
+		/*
+		 * Copy the attributes of count vertices into out, stride() bytes
+		 * per vertex. Only available for float attributes.
+		 */
+		static void write(const Vertex* vertices, size_t count, uint8_t* out) {
+			for (size_t i = 0; i < count; i++, out += stride()) {
+				int expand[] = { (Attributes::copy(vertices[i],
+					out + offset<Attributes>()), 0)... };
+				(void)expand;
+			}
+		}
+	};
+
+	template <typename... Attributes>
+	constexpr VertexAttributeDescription
+		VertexLayout<Attributes...>::attributes[sizeof...(Attributes)];
+
+	/*
+	 * A set of vertex streams, one buffer binding per layout.
+	 */
+	template <typename... Layouts>
+	struct VertexStreams {
+		static constexpr uint32_t streamCount() {
+			return sizeof...(Layouts);
+		}
+
+		static constexpr uint32_t strides[sizeof...(Layouts)] = {
+			Layouts::stride()...
+		};
+
+		static constexpr uint32_t attributeCounts[sizeof...(Layouts)] = {
+			Layouts::attributeCount()...
+		};
+
+		static constexpr const VertexAttributeDescription*
+			attributes[sizeof...(Layouts)] = {
+			Layouts::attributes...
+		};
+	};
+
+	template <typename... Layouts>
+	constexpr uint32_t VertexStreams<Layouts...>::strides[sizeof...(Layouts)];
+
+	template <typename... Layouts>
+	constexpr uint32_t
+		VertexStreams<Layouts...>::attributeCounts[sizeof...(Layouts)];
+
+	template <typename... Layouts>
+	constexpr const VertexAttributeDescription*
+		VertexStreams<Layouts...>::attributes[sizeof...(Layouts)];
+
+	typedef VertexLayout<Attribute::Position, Attribute::Normal,
+		Attribute::TextureCoordinate> InterleavedLayout;
+	typedef VertexLayout<Attribute::PackedPosition, Attribute::PackedNormal,
+		Attribute::PackedTextureCoordinate> PackedLayout;
+
+	typedef VertexStreams<InterleavedLayout> InterleavedStreams;
+	typedef VertexStreams<PackedLayout> PackedStreams;
+	typedef VertexStreams<VertexLayout<Attribute::Position>,
+		VertexLayout<Attribute::Normal, Attribute::TextureCoordinate>>
+		SplitPositionStreams;
+
+	static_assert(InterleavedLayout::stride() == sizeof(Vertex),
+		"InterleavedLayout must match Vertex");
+	static_assert(InterleavedLayout::offset<Attribute::Normal>()
+		== offsetof(Vertex, normal), "InterleavedLayout must match Vertex");
+	static_assert(InterleavedLayout::offset<Attribute::TextureCoordinate>()
+		== offsetof(Vertex, textureCoordinate),
+		"InterleavedLayout must match Vertex");
+	static_assert(PackedLayout::stride() == sizeof(PackedVertex),
+		"PackedLayout must match PackedVertex");
+
+	/*
+	 * Most streams any vertex format uses
+	 */
+	const uint32_t maxVertexStreams = 2;
+
+	/*
+	 * Streams of a vertex format, for the backends to build their vertex
+	 * input state from.
+	 */
+	struct VertexInputDescription {
+		uint32_t streamCount;
+		const uint32_t* strides;
+		const uint32_t* attributeCounts;
+		const VertexAttributeDescription* const* attributes;
+	};
+
+	template <typename Streams>
+	VertexInputDescription describeVertexInput() {
+		VertexInputDescription description = { Streams::streamCount(),
+			Streams::strides, Streams::attributeCounts, Streams::attributes };
+		return description;
+	}
+
+	VertexInputDescription getVertexInputDescription(VertexFormat format);
+
+	/*
+	 * Vertex data in the given format, one byte buffer per stream. The
+	 * quantization is only used by VertexFormat::Packed.
+	 */
+	std::vector<std::vector<uint8_t>> writeVertexStreams(const Vertex* vertices,
+		size_t count, VertexFormat format,
+		const VertexQuantization& quantization);
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef ENGINE_VIRTUALTEXTURE_H
+#define ENGINE_VIRTUALTEXTURE_H
+
+#include "PageCache.h"
+#include "VirtualTextureFile.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Page placed in a slot of the physical texture, with its stored
+	 * pixels to upload there.
+	 */
+	struct PageUpload {
+		uint32_t page;
+		uint32_t slot;
+		const uint8_t* data;
+	};
+
+	/*
+	 * A texture paged in from disk as it is seen, for textures larger than
+	 * fit in memory. Shaders write the page each pixel wants into a
+	 * feedback buffer, look up the finest resident page covering it in an
+	 * indirection texture, and sample that page from a physical texture of
+	 * slotsPerSide by slotsPerSide padded pages.
+	 *
+	 * Each frame the renderer passes the feedback of an earlier frame to
+	 * requestPages, which queues the missing pages for worker threads to
+	 * read from the page file. update then places the pages that have been
+	 * read, within a budget of bytes, evicting the least recently used.
+	 * The renderer uploads them, and the changed rectangles of the
+	 * indirection, before drawing.
+	 */
+	class VirtualTexture {
+	public:
+		/*
+		 * Open a page file written by writeVirtualTexture. The pages of the
+		 * last level are read at once and kept, so every pixel always has
+		 * a page to sample.
+		 */
+		VirtualTexture(const std::string& path, uint32_t slotsPerSide = 16,
+			unsigned threadCount = 2);
+		VirtualTexture(const VirtualTexture&) = delete;
+		VirtualTexture& operator=(const VirtualTexture&) = delete;
+		~VirtualTexture();
+
+		const VirtualTextureFile& getFile() const {
+			return file;
+		}
+
+		uint32_t getSlotsPerSide() const {
+			return slotsPerSide;
+		}
+
+		/*
+		 * Pixels across the physical texture.
+		 */
+		uint32_t getPhysicalSize() const {
+			return slotsPerSide * file.getPaddedSize();
+		}
+
+		/*
+		 * One RGBA8 texel per page of a level: the slot (x, y) of the
+		 * finest resident page covering it, that page's level, and 255.
+		 */
+		const uint32_t* getIndirection(uint32_t level) const {
+			return indirection[level].data();
+		}
+
+		/*
+		 * Texels of a level of the indirection changed since clearChanges
+		 * was last called. Returns false when none have.
+		 */
+		bool getChangedRect(uint32_t level, PixelRect& rect) const;
+		void clearChanges();
+
+		/*
+		 * Queue the pages packed in feedback, 0 where no page was wanted,
+		 * for the workers to read, replacing the pages queued before. Pages
+		 * of coarser levels come first, as they cover more, then the pages
+		 * most pixels want. Pages wanted that are resident, and the pages
+		 * above them, are marked used so they are evicted last.
+		 */
+		void requestPages(const uint32_t* feedback, size_t count);
+
+		/*
+		 * Place pages read by the workers, at least one and up to budget
+		 * bytes of them, into slots. The first call hands out the pages of
+		 * the last level instead. uploads are valid until the next call.
+		 */
+		void update(size_t budget, std::vector<PageUpload>& uploads);
+
+	private:
+		struct LoadedPage {
+			uint32_t page;
+			std::vector<uint8_t> pixels;
+		};
+
+		void readPages();
+		void refreshIndirection(const VirtualPage& page);
+
+		VirtualTextureFile file;
+		uint32_t slotsPerSide;
+		PageCache cache;
+		std::vector<std::vector<uint32_t>> indirection;
+		std::vector<PixelRect> changed;
+		std::vector<uint32_t> requests;
+		std::vector<LoadedPage> uploaded;
+		bool started;
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping;
+		/* Pages queued, being read or read, and not yet placed */
+		std::unordered_set<uint32_t> inFlight;
+		std::deque<uint32_t> queue;
+		std::vector<LoadedPage> loaded;
+		std::vector<std::vector<uint8_t>> freeBuffers;
+		std::vector<std::thread> threads;
+	};
+}
+
+#endif
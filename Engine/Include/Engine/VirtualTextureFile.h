@@ -0,0 +1,136 @@
+#ifndef ENGINE_VIRTUALTEXTUREFILE_H
+#define ENGINE_VIRTUALTEXTUREFILE_H
+
+#include "Texture.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Engine {
+	/*
+	 * Square of pageSize pixels of one level of a virtual texture, at
+	 * (x, y) counted in pages.
+	 */
+	struct VirtualPage {
+		uint32_t level;
+		uint32_t x;
+		uint32_t y;
+	};
+
+	/*
+	 * A page in 32 bits, as shaders write it into feedback: the level plus
+	 * one in the top 4 bits, then 14 bits each of y and x. 0 is no page.
+	 */
+	inline uint32_t packPage(const VirtualPage& page) {
+		return ((page.level + 1) << 28) | (page.y << 14) | page.x;
+	}
+
+	inline VirtualPage unpackPage(uint32_t key) {
+		return { (key >> 28) - 1, key & 0x3fff, (key >> 14) & 0x3fff };
+	}
+
+	/*
+	 * Cut an RGBA texture and its mip levels into pages, each stored with
+	 * border pixels from its neighbours, or repeated at the edges of the
+	 * texture, so a page filters on its own as it would in place. The size
+	 * of the texture and of pages must be powers of two, and the texture
+	 * must have every level down to the one that fits in a page across its
+	 * shorter side, the last level of the page file. Pages are block
+	 * compressed when pageFormat is a compressed format. The file is
+	 * stamped with the size and modification time of sourcePath, the image
+	 * the texture was loaded from.
+	 */
+	void writeVirtualTexture(const std::string& path,
+		const std::string& sourcePath, const Texture& texture,
+		Texture::Format pageFormat = Texture::Format::RGBA,
+		uint32_t pageSize = 128, uint32_t border = 4);
+
+	/*
+	 * Whether path holds a valid page file of pageFormat written from
+	 * sourcePath as it is now, so it need not be written again.
+	 */
+	bool isVirtualTextureCurrent(const std::string& path,
+		const std::string& sourcePath, Texture::Format pageFormat);
+
+	/*
+	 * Page file written by writeVirtualTexture, mapped so pages are read
+	 * from disk only when they are first copied out.
+	 */
+	class VirtualTextureFile {
+	public:
+		explicit VirtualTextureFile(const std::string& path);
+
+		Texture::Format getFormat() const {
+			return format;
+		}
+
+		uint32_t getWidth() const {
+			return width;
+		}
+
+		uint32_t getHeight() const {
+			return height;
+		}
+
+		uint32_t getPageSize() const {
+			return pageSize;
+		}
+
+		uint32_t getBorder() const {
+			return border;
+		}
+
+		/*
+		 * Pixels across a stored page, border included.
+		 */
+		uint32_t getPaddedSize() const {
+			return pageSize + 2 * border;
+		}
+
+		uint32_t getLevelCount() const {
+			return (uint32_t)levels.size();
+		}
+
+		uint32_t getPagesX(uint32_t level) const {
+			return levels[level].pagesX;
+		}
+
+		uint32_t getPagesY(uint32_t level) const {
+			return levels[level].pagesY;
+		}
+
+		/*
+		 * Bytes of a stored page: rows of pixels, or of 4x4 blocks, packed
+		 * tight.
+		 */
+		size_t getPageBytes() const {
+			return pageBytes;
+		}
+
+		const uint8_t* getPage(const VirtualPage& page) const {
+			const Level& level = levels[page.level];
+			return pages + pageBytes * (level.firstPage
+				+ (size_t)page.y * level.pagesX + page.x);
+		}
+
+	private:
+		struct Level {
+			uint32_t pagesX;
+			uint32_t pagesY;
+			uint32_t firstPage;
+		};
+
+		MappedFile mapping;
+		Texture::Format format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t pageSize;
+		uint32_t border;
+		size_t pageBytes;
+		std::vector<Level> levels;
+		const uint8_t* pages;
+	};
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include <Engine/Animation.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using glm::vec3;
+using glm::vec4;
+using Engine::AnimationChannel;
+using Engine::AnimationClip;
+using Engine::Node;
+
+/*
+ * Find the key k with times[k] <= t < times[k + 1], starting from the
+ * cursor k. Times before the first key and after the last clamp to the
+ * first and last pair. Playing forward moves at most one key per frame,
+ * so only bigger jumps search.
+ */
+static uint32_t seekKey(const float* times, uint32_t keyCount, uint32_t k,
+	float t) {
+	uint32_t last = keyCount - 2;
+	if (t < times[k]) {
+		k = (uint32_t)(upper_bound(times, times + k, t) - times);
+		return k > 0 ? k - 1 : 0;
+	}
+	if (k < last && times[k + 1] <= t) {
+		k++;
+		if (k < last && times[k + 1] <= t) {
+			k = (uint32_t)(upper_bound(times + k + 1, times + last + 1, t)
+				- times) - 1;
+		}
+	}
+	return k;
+}
+
+static void writeChannel(Node* node, AnimationChannel channel, const vec4& v) {
+	switch (channel) {
+	case AnimationChannel::Translation:
+		node->setTranslation(vec3(v));
+		break;
+	case AnimationChannel::Rotation:
+		node->setRotation(glm::normalize(glm::quat(v.w, v.x, v.y, v.z)));
+		break;
+	case AnimationChannel::Scale:
+		node->setScale(vec3(v));
+		break;
+	}
+}
+
+/*
+ * Sample the tracks of one channel. Rotations are interpolated linearly
+ * and renormalised, which is close to slerp for the small angles between
+ * neighbouring keys.
+ */
+template <AnimationChannel channel>
+static void sampleChannel(const vector<AnimationClip::Track>& tracks,
+	const float* times, const vec4* values, Node* const* targets,
+	uint32_t* cursors, float t) {
+	for (size_t i = 0; i < tracks.size(); i++) {
+		if (targets[i] == nullptr) continue;
+		const AnimationClip::Track& track = tracks[i];
+		const float* trackTimes = times + track.firstKey;
+		const vec4* trackValues = values + track.firstKey;
+		if (track.keyCount == 1) {
+			writeChannel(targets[i], channel, trackValues[0]);
+			continue;
+		}
+
+		uint32_t k = seekKey(trackTimes, track.keyCount, cursors[i], t);
+		cursors[i] = k;
+		float f = (t - trackTimes[k]) / (trackTimes[k + 1] - trackTimes[k]);
+		f = glm::clamp(f, 0.f, 1.f);
+		writeChannel(targets[i], channel,
+			trackValues[k] + (trackValues[k + 1] - trackValues[k]) * f);
+	}
+}
+
+namespace Engine {
+	uint32_t AnimationClip::addTrack(AnimationChannel channel,
+		const float* keyTimes, const glm::vec4* keyValues, size_t keyCount) {
+		if (keyCount == 0) {
+			throw runtime_error("Animation track without keys.");
+		}
+		for (size_t k = 1; k < keyCount; k++) {
+			if (!(keyTimes[k] > keyTimes[k - 1])) {
+				throw runtime_error("Animation key times must increase.");
+			}
+		}
+
+		Track track;
+		track.firstKey = (uint32_t)times.size();
+		track.keyCount = (uint32_t)keyCount;
+		times.insert(times.end(), keyTimes, keyTimes + keyCount);
+		values.insert(values.end(), keyValues, keyValues + keyCount);
+		if (channel == AnimationChannel::Rotation) {
+			vec4* rotations = values.data() + track.firstKey;
+			for (size_t k = 1; k < keyCount; k++) {
+				if (glm::dot(rotations[k - 1], rotations[k]) < 0.f) {
+					rotations[k] = -rotations[k];
+				}
+			}
+		}
+		duration = max(duration, keyTimes[keyCount - 1]);
+
+		vector<Track>& channelTracks = tracks[(size_t)channel];
+		channelTracks.push_back(track);
+		return (uint32_t)(channelTracks.size() - 1);
+	}
+
+	uint32_t AnimationClip::addTranslationTrack(const vector<float>& times,
+		const vector<glm::vec3>& translations) {
+		vector<vec4> v(translations.size());
+		for (size_t i = 0; i < v.size(); i++) {
+			v[i] = vec4(translations[i], 0.f);
+		}
+		return addTrack(AnimationChannel::Translation, times.data(), v.data(),
+			min(times.size(), v.size()));
+	}
+
+	uint32_t AnimationClip::addRotationTrack(const vector<float>& times,
+		const vector<glm::quat>& rotations) {
+		vector<vec4> v(rotations.size());
+		for (size_t i = 0; i < v.size(); i++) {
+			const glm::quat& q = rotations[i];
+			v[i] = vec4(q.x, q.y, q.z, q.w);
+		}
+		return addTrack(AnimationChannel::Rotation, times.data(), v.data(),
+			min(times.size(), v.size()));
+	}
+
+	uint32_t AnimationClip::addScaleTrack(const vector<float>& times,
+		const vector<glm::vec3>& scales) {
+		vector<vec4> v(scales.size());
+		for (size_t i = 0; i < v.size(); i++) {
+			v[i] = vec4(scales[i], 0.f);
+		}
+		return addTrack(AnimationChannel::Scale, times.data(), v.data(),
+			min(times.size(), v.size()));
+	}
+
+	void AnimationPlayer::setClip(const AnimationClip* c) {
+		clip = c;
+		time = 0.f;
+		for (size_t i = 0; i < animationChannelCount; i++) {
+			size_t count = clip ? clip->tracks[i].size() : 0;
+			targets[i].assign(count, nullptr);
+			cursors[i].assign(count, 0);
+		}
+	}
+
+	void AnimationPlayer::setTime(float t) {
+		float duration = clip ? clip->getDuration() : 0.f;
+		if (looping && duration > 0.f) {
+			t = fmodf(t, duration);
+			time = t < 0.f ? t + duration : t;
+		} else {
+			time = glm::clamp(t, 0.f, duration);
+		}
+	}
+
+	void AnimationPlayer::advance(float delta) {
+		float duration = clip ? clip->getDuration() : 0.f;
+		float t = time + delta;
+		if (looping && duration > 0.f && t >= duration) {
+			/*
+			 * Starting the cursors over is cheaper than searching back.
+			 */
+			for (vector<uint32_t>& c : cursors) {
+				fill(c.begin(), c.end(), 0);
+			}
+		}
+		setTime(t);
+	}
+
+	void AnimationPlayer::apply() {
+		if (clip == nullptr) return;
+		const float* times = clip->times.data();
+		const glm::vec4* values = clip->values.data();
+		sampleChannel<AnimationChannel::Translation>(
+			clip->tracks[(size_t)AnimationChannel::Translation], times, values,
+			targets[(size_t)AnimationChannel::Translation].data(),
+			cursors[(size_t)AnimationChannel::Translation].data(), time);
+		sampleChannel<AnimationChannel::Rotation>(
+			clip->tracks[(size_t)AnimationChannel::Rotation], times, values,
+			targets[(size_t)AnimationChannel::Rotation].data(),
+			cursors[(size_t)AnimationChannel::Rotation].data(), time);
+		sampleChannel<AnimationChannel::Scale>(
+			clip->tracks[(size_t)AnimationChannel::Scale], times, values,
+			targets[(size_t)AnimationChannel::Scale].data(),
+			cursors[(size_t)AnimationChannel::Scale].data(), time);
+	}
+}
@@ -0,0 +1,189 @@
+#include <Engine/AtlasPacker.h>
+#include <Engine/Parallel.h>
+#include <algorithm>
+#include <numeric>
+
+using namespace std;
+using Engine::PixelRect;
+
+static bool contains(const PixelRect& outer, const PixelRect& inner) {
+	return inner.x >= outer.x && inner.y >= outer.y
+		&& inner.x + inner.width <= outer.x + outer.width
+		&& inner.y + inner.height <= outer.y + outer.height;
+}
+
+/*
+ * Replace the free rectangles that overlap used with the parts of them
+ * left over on each side, then drop those inside another.
+ */
+static void splitFreeRects(vector<PixelRect>& freeRects, const PixelRect& used) {
+	vector<PixelRect> pieces;
+	for (size_t i = 0; i < freeRects.size();) {
+		PixelRect f = freeRects[i];
+		if (used.x >= f.x + f.width || used.x + used.width <= f.x
+			|| used.y >= f.y + f.height || used.y + used.height <= f.y) {
+			i++;
+			continue;
+		}
+		if (used.x > f.x) {
+			pieces.push_back({ f.x, f.y, used.x - f.x, f.height });
+		}
+		if (used.x + used.width < f.x + f.width) {
+			pieces.push_back({ used.x + used.width, f.y,
+				f.x + f.width - used.x - used.width, f.height });
+		}
+		if (used.y > f.y) {
+			pieces.push_back({ f.x, f.y, f.width, used.y - f.y });
+		}
+		if (used.y + used.height < f.y + f.height) {
+			pieces.push_back({ f.x, used.y + used.height, f.width,
+				f.y + f.height - used.y - used.height });
+		}
+		freeRects[i] = freeRects.back();
+		freeRects.pop_back();
+	}
+
+	/*
+	 * Free rectangles left from before were already pruned, so only the
+	 * new pieces need checking, against each other and the rest.
+	 */
+	vector<PixelRect> kept;
+	for (size_t i = 0; i < pieces.size(); i++) {
+		bool inside = false;
+		for (const PixelRect& f : freeRects) {
+			if (contains(f, pieces[i])) {
+				inside = true;
+				break;
+			}
+		}
+		for (size_t j = 0; j < pieces.size() && !inside; j++) {
+			/* Of two equal pieces, the first is kept. */
+			inside = j != i && contains(pieces[j], pieces[i])
+				&& (j < i || !contains(pieces[i], pieces[j]));
+		}
+		if (!inside) kept.push_back(pieces[i]);
+	}
+	freeRects.erase(remove_if(freeRects.begin(), freeRects.end(),
+		[&](const PixelRect& f) {
+		for (const PixelRect& k : kept) {
+			if (contains(k, f)) return true;
+		}
+		return false;
+	}), freeRects.end());
+	freeRects.insert(freeRects.end(), kept.begin(), kept.end());
+}
+
+static uint32_t nextPowerOfTwo(uint64_t v) {
+	uint64_t p = 1;
+	while (p < v) p <<= 1;
+	return (uint32_t)min<uint64_t>(p, 1u << 31);
+}
+
+namespace Engine {
+	bool packRects(const vector<PixelRect>& sizes, uint32_t width,
+		uint32_t height, uint32_t padding, vector<PixelRect>& placed) {
+		/* Each rectangle owns padding pixels to its right and below. */
+		vector<PixelRect> freeRects(1, { 0, 0, width + padding,
+			height + padding });
+		placed.assign(sizes.size(), { 0, 0, 0, 0 });
+
+		vector<size_t> order(sizes.size());
+		iota(order.begin(), order.end(), (size_t)0);
+		stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+			uint32_t sideA = max(sizes[a].width, sizes[a].height);
+			uint32_t sideB = max(sizes[b].width, sizes[b].height);
+			if (sideA != sideB) return sideA > sideB;
+			return (uint64_t)sizes[a].width * sizes[a].height
+				> (uint64_t)sizes[b].width * sizes[b].height;
+		});
+
+		for (size_t i : order) {
+			uint64_t w = (uint64_t)sizes[i].width + padding;
+			uint64_t h = (uint64_t)sizes[i].height + padding;
+			const PixelRect* best = nullptr;
+			uint64_t bestShort = UINT64_MAX, bestLong = UINT64_MAX;
+			for (const PixelRect& f : freeRects) {
+				if (f.width < w || f.height < h) continue;
+				uint64_t leftX = f.width - w, leftY = f.height - h;
+				uint64_t shortSide = min(leftX, leftY);
+				uint64_t longSide = max(leftX, leftY);
+				if (shortSide < bestShort
+					|| (shortSide == bestShort && longSide < bestLong)) {
+					best = &f;
+					bestShort = shortSide;
+					bestLong = longSide;
+				}
+			}
+			if (best == nullptr) return false;
+
+			PixelRect used = { best->x, best->y, (uint32_t)w, (uint32_t)h };
+			placed[i] = { used.x, used.y, sizes[i].width, sizes[i].height };
+			splitFreeRects(freeRects, used);
+		}
+		return true;
+	}
+
+	bool packAtlas(const vector<PixelRect>& sizes, uint32_t padding,
+		uint32_t maxSize, uint32_t& width, uint32_t& height,
+		vector<PixelRect>& placed) {
+		uint64_t area = 0;
+		uint32_t widest = 1, tallest = 1;
+		for (const PixelRect& r : sizes) {
+			area += (uint64_t)(r.width + padding) * (r.height + padding);
+			widest = max(widest, r.width);
+			tallest = max(tallest, r.height);
+		}
+
+		/*
+		 * Every power of two bin that could hold the area, smallest area
+		 * first and squarer bins before longer ones of the same area.
+		 */
+		struct Candidate {
+			uint32_t width;
+			uint32_t height;
+			bool fits;
+			vector<PixelRect> placed;
+		};
+		vector<Candidate> candidates;
+		for (uint32_t w = nextPowerOfTwo(widest); w <= maxSize && w != 0; w *= 2) {
+			for (uint32_t h = nextPowerOfTwo(tallest); h <= maxSize && h != 0;
+				h *= 2) {
+				if ((uint64_t)w * h >= area) {
+					candidates.push_back({ w, h, false, {} });
+				}
+			}
+		}
+		sort(candidates.begin(), candidates.end(),
+			[](const Candidate& a, const Candidate& b) {
+			uint64_t areaA = (uint64_t)a.width * a.height;
+			uint64_t areaB = (uint64_t)b.width * b.height;
+			if (areaA != areaB) return areaA < areaB;
+			return max(a.width, a.height) < max(b.width, b.height);
+		});
+
+		/*
+		 * One candidate per worker at a time, so bins larger than the
+		 * first that fits are rarely tried.
+		 */
+		size_t batch = workerCount();
+		for (size_t first = 0; first < candidates.size(); first += batch) {
+			size_t count = min(batch, candidates.size() - first);
+			parallelFor(count, 1, [&](size_t begin, size_t end) {
+				for (size_t i = first + begin; i < first + end; i++) {
+					Candidate& c = candidates[i];
+					c.fits = packRects(sizes, c.width, c.height, padding,
+						c.placed);
+				}
+			});
+			for (size_t i = first; i < first + count; i++) {
+				Candidate& c = candidates[i];
+				if (!c.fits) continue;
+				width = c.width;
+				height = c.height;
+				placed = std::move(c.placed);
+				return true;
+			}
+		}
+		return false;
+	}
+}
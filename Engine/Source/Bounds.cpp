@@ -0,0 +1,45 @@
+#include <Engine/Bounds.h>
+
+using glm::vec3;
+using glm::vec4;
+
+namespace Engine {
+	BoundingSphere computeBoundingSphere(const Vertex* vertices, size_t count) {
+		BoundingSphere sphere = { vec3(), 0.f };
+		if (count == 0) return sphere;
+
+		vec3 low = vertices[0].position;
+		vec3 high = vertices[0].position;
+		for (size_t i = 1; i < count; i++) {
+			low = glm::min(low, vertices[i].position);
+			high = glm::max(high, vertices[i].position);
+		}
+		sphere.center = (low + high) * 0.5f;
+
+		float radius2 = 0.f;
+		for (size_t i = 0; i < count; i++) {
+			vec3 d = vertices[i].position - sphere.center;
+			radius2 = glm::max(radius2, glm::dot(d, d));
+		}
+		sphere.radius = sqrtf(radius2);
+		return sphere;
+	}
+
+	Frustum computeFrustum(const glm::mat4& modelViewProjection) {
+		const glm::mat4& m = modelViewProjection;
+		vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+		vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+		vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+		vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+		Frustum frustum = { {
+			row3 + row0, row3 - row0,
+			row3 + row1, row3 - row1,
+			row3 + row2, row3 - row2
+		} };
+		for (vec4& plane : frustum.planes) {
+			float length = glm::length(vec3(plane));
+			if (length > 0.f) plane /= length;
+		}
+		return frustum;
+	}
+}
@@ -0,0 +1,69 @@
+#include <Engine/CacheFile.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <random>
+
+using namespace std;
+
+/*
+ * Whether first + count stays within size, without overflowing.
+ */
+static bool inRange(uint64_t first, uint64_t count, uint64_t size) {
+	return first <= size && count <= size - first;
+}
+
+namespace Engine {
+	uint64_t remainingBytes(istream& in) {
+		streampos at = in.tellg();
+		in.seekg(0, ios::end);
+		streampos end = in.tellg();
+		in.seekg(at);
+		if (!in || at < 0 || end < at) return 0;
+		return (uint64_t)(end - at);
+	}
+
+	bool sourceStamp(const string& path, uint64_t& size, int64_t& time) {
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0) return false;
+		size = (uint64_t)info.st_size;
+		time = (int64_t)info.st_mtime;
+		return true;
+	}
+
+	bool validMeshRanges(const IndexedMesh& mesh) {
+		size_t vertexCount = mesh.getVertices().size();
+		const vector<uint32_t>& indices = mesh.getIndices();
+		for (uint32_t i : indices) {
+			if (i >= vertexCount) return false;
+		}
+		for (const Submesh& s : mesh.getSubmeshes()) {
+			if (!inRange(s.firstIndex, s.indexCount, indices.size())) {
+				return false;
+			}
+		}
+		for (const LevelOfDetail& l : mesh.getLods()) {
+			if (!inRange(l.firstIndex, l.indexCount, indices.size())) {
+				return false;
+			}
+		}
+		for (const Meshlet& m : mesh.getMeshlets()) {
+			if (!inRange(m.firstIndex, m.indexCount, indices.size())) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	string temporaryCachePath(const string& path) {
+		return path + "." + to_string(random_device()()) + ".tmp";
+	}
+
+	bool replaceCacheFile(const string& temporaryPath, const string& path) {
+		if (rename(temporaryPath.c_str(), path.c_str()) == 0) return true;
+		/* Windows does not rename over an existing file. */
+		remove(path.c_str());
+		if (rename(temporaryPath.c_str(), path.c_str()) == 0) return true;
+		remove(temporaryPath.c_str());
+		return false;
+	}
+}
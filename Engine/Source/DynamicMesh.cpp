@@ -0,0 +1,62 @@
+#include <Engine/DynamicMesh.h>
+#include <algorithm>
+
+using namespace std;
+
+/*
+ * Scattered edits are merged once this many ranges are pending. When
+ * that is not enough, ranges with small gaps between them are joined, the
+ * allowed gap doubling until at most half as many are left.
+ */
+static const size_t maxChangedRanges = 256;
+static const uint32_t firstJoinedGap = 16;
+
+namespace Engine {
+	void mergeVertexRanges(vector<VertexRange>& ranges, uint32_t gap) {
+		if (ranges.size() < 2) return;
+		sort(ranges.begin(), ranges.end(),
+			[](const VertexRange& a, const VertexRange& b) {
+				return a.first < b.first;
+			});
+		size_t merged = 0;
+		for (size_t i = 1; i < ranges.size(); i++) {
+			VertexRange& last = ranges[merged];
+			const VertexRange& r = ranges[i];
+			if (r.first - last.first <= (uint64_t)last.count + gap) {
+				last.count = max(last.first + last.count, r.first + r.count)
+					- last.first;
+			} else {
+				ranges[++merged] = r;
+			}
+		}
+		ranges.resize(merged + 1);
+	}
+
+	void DynamicMesh::markChanged(uint32_t first, uint32_t count) {
+		if (count == 0) return;
+		if (!changed.empty()) {
+			/*
+			 * Edits usually walk forward, so most extend the last range.
+			 */
+			VertexRange& last = changed.back();
+			if (first >= last.first && first <= last.first + last.count) {
+				last.count = max(last.first + last.count, first + count)
+					- last.first;
+				return;
+			}
+		}
+		changed.push_back({ first, count });
+		if (changed.size() < maxChangedRanges) return;
+		mergeVertexRanges(changed);
+		for (uint32_t gap = firstJoinedGap;
+			changed.size() >= maxChangedRanges / 2; gap *= 2) {
+			mergeVertexRanges(changed, gap);
+		}
+	}
+
+	void DynamicMesh::takeChangedRanges(vector<VertexRange>& ranges) {
+		mergeVertexRanges(changed);
+		ranges.swap(changed);
+		changed.clear();
+	}
+}
@@ -0,0 +1,92 @@
+#include <Engine/MappedFile.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const uint8_t* mapFile(const string& path, size_t& size) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return nullptr;
+	LARGE_INTEGER fileSize;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0,
+			nullptr);
+	}
+	CloseHandle(file);
+	if (mapping == nullptr) return nullptr;
+	/* The view keeps the mapping alive after its handle is closed. */
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (view == nullptr) return nullptr;
+	size = (size_t)fileSize.QuadPart;
+	return (const uint8_t*)view;
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0) return nullptr;
+	struct stat info;
+	void* view = MAP_FAILED;
+	if (fstat(file, &info) == 0 && info.st_size > 0) {
+		view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE,
+			file, 0);
+	}
+	::close(file);
+	if (view == MAP_FAILED) return nullptr;
+	size = (size_t)info.st_size;
+	return (const uint8_t*)view;
+#endif
+}
+
+namespace Engine {
+	MappedFile::MappedFile(MappedFile&& other) :
+	data(other.data),
+	size(other.size)
+	{
+		other.data = nullptr;
+		other.size = 0;
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) {
+		if (this != &other) {
+			close();
+			data = other.data;
+			size = other.size;
+			other.data = nullptr;
+			other.size = 0;
+		}
+		return *this;
+	}
+
+	MappedFile::~MappedFile() {
+		close();
+	}
+
+	bool MappedFile::open(const string& path) {
+		close();
+		size_t mappedSize = 0;
+		data = mapFile(path, mappedSize);
+		size = data ? mappedSize : 0;
+		return data != nullptr;
+	}
+
+	void MappedFile::close() {
+		if (data == nullptr) return;
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+#else
+		munmap((void*)data, size);
+#endif
+		data = nullptr;
+		size = 0;
+	}
+}
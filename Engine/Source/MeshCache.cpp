@@ -0,0 +1,188 @@
+#include <Engine/MeshCache.h>
+#include <Engine/CacheFile.h>
+#include <Engine/MeshCodec.h>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+using Engine::readArray;
+using Engine::writeArray;
+
+static const char cacheMagic[4] = { 'E', 'M', 'S', 'H' };
+static const uint32_t cacheVersion = 3;
+
+enum CacheEncoding : uint32_t {
+	EncodingRaw,
+	EncodingCodec
+};
+
+struct MeshCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t flags;
+	uint32_t vertexSize;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t submeshCount;
+	uint32_t materialCount;
+	uint32_t encoding;
+	uint32_t lodLevels;
+	uint32_t lodCount;
+	uint32_t padding;
+};
+
+struct MeshCacheMaterial {
+	glm::vec4 color;
+	glm::vec2 textureScale;
+	uint32_t textureNameLength;
+	uint32_t padding;
+};
+
+/* Compressed arrays are stored as their encoded size and the encoding. */
+static bool readEncoded(istream& in, vector<uint8_t>& encoded) {
+	uint32_t size;
+	in.read((char*)&size, sizeof(size));
+	return in && readArray(in, encoded, size);
+}
+
+static void writeEncoded(ostream& out, const vector<uint8_t>& encoded) {
+	uint32_t size = (uint32_t)encoded.size();
+	out.write((const char*)&size, sizeof(size));
+	writeArray(out, encoded);
+}
+
+namespace Engine {
+	string meshCachePath(const string& sourcePath) {
+		return sourcePath + ".meshcache";
+	}
+
+	bool readMeshCache(const string& sourcePath, MeshLoadFlags flags,
+		unsigned lodLevels, IndexedMesh& mesh, vector<Material>& materials) {
+		uint64_t size;
+		int64_t time;
+		if (!sourceStamp(sourcePath, size, time)) return false;
+
+		ifstream in(meshCachePath(sourcePath), ios::binary);
+		if (!in.is_open()) return false;
+
+		MeshCacheHeader header;
+		in.read((char*)&header, sizeof(header));
+		if (!in || memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0
+			|| header.version != cacheVersion
+			|| header.flags != (uint32_t)flags
+			|| header.lodLevels != lodLevels
+			|| header.vertexSize != sizeof(Vertex)
+			|| header.sourceSize != size || header.sourceTime != time) {
+			return false;
+		}
+
+		IndexedMesh cached;
+		vector<Vertex>& vertices = cached.getVertices();
+		vector<uint32_t>& indices = cached.getIndices();
+		if (header.encoding == EncodingCodec) {
+			vector<uint8_t> encoded;
+			if (!readEncoded(in, encoded) || header.vertexCount
+				> maxDecodedCount(encoded.size(), sizeof(Vertex))) {
+				return false;
+			}
+			vertices.resize(header.vertexCount);
+			if (!decodeVertices(encoded.data(), encoded.size(),
+				vertices.data(), vertices.size())) {
+				return false;
+			}
+			if (!readEncoded(in, encoded) || header.indexCount
+				> maxDecodedCount(encoded.size(), sizeof(uint32_t))) {
+				return false;
+			}
+			indices.resize(header.indexCount);
+			if (!decodeIndices(encoded.data(), encoded.size(), indices.data(),
+				indices.size())) {
+				return false;
+			}
+		} else if (header.encoding != EncodingRaw
+			|| !readArray(in, vertices, header.vertexCount)
+			|| !readArray(in, indices, header.indexCount)) {
+			return false;
+		}
+		if (!readArray(in, cached.getSubmeshes(), header.submeshCount)
+			|| !readArray(in, cached.getLods(), header.lodCount)
+			|| !validMeshRanges(cached)
+			|| header.materialCount
+				> remainingBytes(in) / sizeof(MeshCacheMaterial)) {
+			return false;
+		}
+
+		vector<Material> cachedMaterials;
+		cachedMaterials.reserve(header.materialCount);
+		for (uint32_t i = 0; i < header.materialCount; i++) {
+			MeshCacheMaterial record;
+			in.read((char*)&record, sizeof(record));
+			if (!in || record.textureNameLength > remainingBytes(in)) {
+				return false;
+			}
+			string name(record.textureNameLength, '\0');
+			if (!name.empty()) in.read(&name[0], name.size());
+			if (!in) return false;
+			Material material;
+			material.setColor(record.color);
+			material.setTextureScale(record.textureScale);
+			material.setTextureName(name);
+			cachedMaterials.push_back(std::move(material));
+		}
+
+		mesh = std::move(cached);
+		materials = std::move(cachedMaterials);
+		return true;
+	}
+
+	void writeMeshCache(const string& sourcePath, MeshLoadFlags flags,
+		unsigned lodLevels, const IndexedMesh& mesh,
+		const vector<Material>& materials, bool compress) {
+		MeshCacheHeader header = {};
+		memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+		header.version = cacheVersion;
+		header.flags = (uint32_t)flags;
+		header.lodLevels = lodLevels;
+		header.vertexSize = sizeof(Vertex);
+		if (!sourceStamp(sourcePath, header.sourceSize, header.sourceTime)) {
+			return;
+		}
+		header.vertexCount = (uint32_t)mesh.getVertices().size();
+		header.indexCount = (uint32_t)mesh.getIndices().size();
+		header.submeshCount = (uint32_t)mesh.getSubmeshes().size();
+		header.materialCount = (uint32_t)materials.size();
+		header.lodCount = (uint32_t)mesh.getLods().size();
+		header.encoding = compress ? EncodingCodec : EncodingRaw;
+
+		ofstream out(meshCachePath(sourcePath), ios::binary | ios::trunc);
+		if (!out.is_open()) return;
+
+		out.write((const char*)&header, sizeof(header));
+		if (compress) {
+			vector<uint8_t> encoded;
+			encodeVertices(mesh.getVertices().data(), mesh.getVertices().size(),
+				encoded);
+			writeEncoded(out, encoded);
+			encodeIndices(mesh.getIndices().data(), mesh.getIndices().size(),
+				encoded);
+			writeEncoded(out, encoded);
+		} else {
+			writeArray(out, mesh.getVertices());
+			writeArray(out, mesh.getIndices());
+		}
+		writeArray(out, mesh.getSubmeshes());
+		writeArray(out, mesh.getLods());
+		for (const Material& material : materials) {
+			MeshCacheMaterial record = {};
+			record.color = material.getColor();
+			record.textureScale = material.getTextureScale();
+			record.textureNameLength =
+				(uint32_t)material.getTextureName().size();
+			out.write((const char*)&record, sizeof(record));
+			out.write(material.getTextureName().data(),
+				material.getTextureName().size());
+		}
+	}
+}
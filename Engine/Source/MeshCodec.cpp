@@ -0,0 +1,393 @@
+#include <Engine/MeshCodec.h>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ENGINE_MESHCODEC_SSSE3
+#endif
+
+using namespace std;
+using Engine::Vertex;
+
+/*
+ * Stream layout: a version byte, then for every chunk of up to chunkSize
+ * elements (padded to a multiple of 16 with zeros) one byte plane after
+ * another, each a mode byte followed by the plane.
+ */
+static const uint8_t codecVersion = 1;
+static const size_t chunkSize = 256;
+static const size_t vertexWords = sizeof(Vertex)/4;
+
+enum PlaneMode : uint8_t {
+	PlaneRaw,
+	PlaneMasked
+};
+
+static_assert(sizeof(Vertex) == 32, "the vertex decoder expects 8 words");
+
+static size_t paddedCount(size_t count) {
+	return (count + 15) & ~(size_t)15;
+}
+
+static void encodePlanes(const uint8_t* elements, size_t count,
+	size_t elementSize, vector<uint8_t>& encoded) {
+	encoded.clear();
+	encoded.push_back(codecVersion);
+	uint8_t plane[chunkSize];
+	for (size_t begin = 0; begin < count; begin += chunkSize) {
+		size_t n = min(chunkSize, count - begin);
+		size_t padded = paddedCount(n);
+		for (size_t k = 0; k < elementSize; k++) {
+			size_t nonzero = 0;
+			for (size_t j = 0; j < padded; j++) {
+				plane[j] = j < n ? elements[(begin + j)*elementSize + k] : 0;
+				if (plane[j]) nonzero++;
+			}
+
+			if (padded/16*2 + nonzero >= padded) {
+				encoded.push_back(PlaneRaw);
+				encoded.insert(encoded.end(), plane, plane + padded);
+				continue;
+			}
+			encoded.push_back(PlaneMasked);
+			for (size_t j = 0; j < padded; j += 16) {
+				uint16_t mask = 0;
+				for (size_t b = 0; b < 16; b++) {
+					if (plane[j + b]) mask |= (uint16_t)(1 << b);
+				}
+				encoded.push_back((uint8_t)mask);
+				encoded.push_back((uint8_t)(mask >> 8));
+				for (size_t b = 0; b < 16; b++) {
+					if (plane[j + b]) encoded.push_back(plane[j + b]);
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Expands one block of a masked plane. The vector version looks up the
+ * shuffle that spreads the packed bytes of each half of the mask.
+ */
+static void expandBlock(uint16_t mask, const uint8_t* data, uint8_t* out) {
+	for (int b = 0; b < 16; b++) {
+		out[b] = (mask >> b) & 1 ? *data++ : 0;
+	}
+}
+
+#ifdef ENGINE_MESHCODEC_SSSE3
+struct ExpandTable {
+	uint64_t shuffles[256];
+	uint8_t counts[256];
+};
+
+static ExpandTable buildExpandTable() {
+	ExpandTable table;
+	for (int mask = 0; mask < 256; mask++) {
+		uint64_t shuffle = 0;
+		uint8_t count = 0;
+		for (int b = 0; b < 8; b++) {
+			uint64_t index = (mask >> b) & 1 ? count++ : 0x80;
+			shuffle |= index << (b*8);
+		}
+		table.shuffles[mask] = shuffle;
+		table.counts[mask] = count;
+	}
+	return table;
+}
+
+static const ExpandTable& expandTable() {
+	static const ExpandTable table = buildExpandTable();
+	return table;
+}
+
+__attribute__((target("ssse3")))
+static void expandBlockSSSE3(const ExpandTable& table, uint16_t mask,
+	const uint8_t* data, uint8_t* out) {
+	uint8_t low = (uint8_t)mask, high = (uint8_t)(mask >> 8);
+	/* Entries of 0x80 stay above 0x80 and keep zeroing their byte. */
+	uint64_t highShuffle = table.shuffles[high]
+		+ table.counts[low]*0x0101010101010101ull;
+	__m128i shuffle = _mm_set_epi64x((long long)highShuffle,
+		(long long)table.shuffles[low]);
+	__m128i bytes = _mm_loadu_si128((const __m128i*)data);
+	_mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(bytes, shuffle));
+}
+
+static bool haveSSSE3() {
+	static const bool have = __builtin_cpu_supports("ssse3");
+	return have;
+}
+#endif
+
+/*
+ * Decodes the planes of one chunk into planes[k*chunkSize + j]. Returns
+ * false when the data ends early.
+ */
+template <bool Vector>
+static bool decodePlanes(const uint8_t*& data, const uint8_t* end,
+	size_t padded, size_t elementSize, uint8_t* planes) {
+#ifdef ENGINE_MESHCODEC_SSSE3
+	const ExpandTable& table = expandTable();
+#endif
+	for (size_t k = 0; k < elementSize; k++) {
+		uint8_t* plane = planes + k*chunkSize;
+		if (data == end) return false;
+		uint8_t mode = *data++;
+		if (mode == PlaneRaw) {
+			if ((size_t)(end - data) < padded) return false;
+			memcpy(plane, data, padded);
+			data += padded;
+			continue;
+		}
+		if (mode != PlaneMasked) return false;
+
+		for (size_t j = 0; j < padded; j += 16) {
+			if (end - data < 2) return false;
+			uint16_t mask = (uint16_t)(data[0] | data[1] << 8);
+			data += 2;
+#ifdef ENGINE_MESHCODEC_SSSE3
+			size_t count = (size_t)table.counts[mask & 0xff]
+				+ table.counts[mask >> 8];
+#else
+			size_t count = (size_t)__builtin_popcount(mask);
+#endif
+			if ((size_t)(end - data) < count) return false;
+#ifdef ENGINE_MESHCODEC_SSSE3
+			/* The vector load reads 16 bytes, so the last few use the loop. */
+			if (Vector && end - data >= 16) {
+				expandBlockSSSE3(table, mask, data, plane + j);
+			} else {
+				expandBlock(mask, data, plane + j);
+			}
+#else
+			expandBlock(mask, data, plane + j);
+#endif
+			data += count;
+		}
+	}
+	return true;
+}
+
+static uint32_t planeWord(const uint8_t* planes, size_t word, size_t j) {
+	const uint8_t* p = planes + word*4*chunkSize + j;
+	return (uint32_t)p[0] | (uint32_t)p[chunkSize] << 8
+		| (uint32_t)p[2*chunkSize] << 16 | (uint32_t)p[3*chunkSize] << 24;
+}
+
+static void unfilterVertices(const uint8_t* planes, size_t n,
+	uint32_t* previous, Vertex* out) {
+	for (size_t j = 0; j < n; j++) {
+		for (size_t w = 0; w < vertexWords; w++) {
+			previous[w] ^= planeWord(planes, w, j);
+		}
+		memcpy((void*)&out[j], previous, sizeof(Vertex));
+	}
+}
+
+static void unfilterIndices(const uint8_t* planes, size_t n,
+	uint32_t& previous, uint32_t* out) {
+	for (size_t j = 0; j < n; j++) {
+		uint32_t z = planeWord(planes, 0, j);
+		previous += (z >> 1) ^ (0u - (z & 1));
+		out[j] = previous;
+	}
+}
+
+#ifdef ENGINE_MESHCODEC_SSSE3
+/*
+ * Interleaves four byte planes of 16 elements into 16 words, four
+ * elements to a register.
+ */
+__attribute__((target("ssse3")))
+static inline void planesToWords(const uint8_t* p, __m128i words[4]) {
+	__m128i b0 = _mm_loadu_si128((const __m128i*)p);
+	__m128i b1 = _mm_loadu_si128((const __m128i*)(p + chunkSize));
+	__m128i b2 = _mm_loadu_si128((const __m128i*)(p + 2*chunkSize));
+	__m128i b3 = _mm_loadu_si128((const __m128i*)(p + 3*chunkSize));
+	__m128i t0 = _mm_unpacklo_epi8(b0, b1);
+	__m128i t1 = _mm_unpackhi_epi8(b0, b1);
+	__m128i t2 = _mm_unpacklo_epi8(b2, b3);
+	__m128i t3 = _mm_unpackhi_epi8(b2, b3);
+	words[0] = _mm_unpacklo_epi16(t0, t2);
+	words[1] = _mm_unpackhi_epi16(t0, t2);
+	words[2] = _mm_unpacklo_epi16(t1, t3);
+	words[3] = _mm_unpackhi_epi16(t1, t3);
+}
+
+__attribute__((target("ssse3")))
+static inline void transpose4(__m128i& a, __m128i& b, __m128i& c,
+	__m128i& d) {
+	__m128i ab0 = _mm_unpacklo_epi32(a, b);
+	__m128i ab1 = _mm_unpackhi_epi32(a, b);
+	__m128i cd0 = _mm_unpacklo_epi32(c, d);
+	__m128i cd1 = _mm_unpackhi_epi32(c, d);
+	a = _mm_unpacklo_epi64(ab0, cd0);
+	b = _mm_unpackhi_epi64(ab0, cd0);
+	c = _mm_unpacklo_epi64(ab1, cd1);
+	d = _mm_unpackhi_epi64(ab1, cd1);
+}
+
+__attribute__((target("ssse3")))
+static void unfilterVerticesSSSE3(const uint8_t* planes, size_t n,
+	uint32_t* previous, Vertex* out) {
+	__m128i low = _mm_loadu_si128((const __m128i*)previous);
+	__m128i high = _mm_loadu_si128((const __m128i*)(previous + 4));
+	for (size_t j = 0; j < n; j += 16) {
+		__m128i words[vertexWords][4];
+		for (size_t w = 0; w < vertexWords; w++) {
+			planesToWords(planes + w*4*chunkSize + j, words[w]);
+		}
+		size_t end = min((size_t)16, n - j);
+		for (size_t q = 0; q < 4; q++) {
+			__m128i rows[8] = {
+				words[0][q], words[1][q], words[2][q], words[3][q],
+				words[4][q], words[5][q], words[6][q], words[7][q]
+			};
+			transpose4(rows[0], rows[1], rows[2], rows[3]);
+			transpose4(rows[4], rows[5], rows[6], rows[7]);
+			for (size_t e = 0; e < 4; e++) {
+				low = _mm_xor_si128(low, rows[e]);
+				high = _mm_xor_si128(high, rows[4 + e]);
+				size_t i = q*4 + e;
+				if (i >= end) continue;
+				__m128i* v = (__m128i*)&out[j + i];
+				_mm_storeu_si128(v, low);
+				_mm_storeu_si128(v + 1, high);
+			}
+		}
+	}
+	/* Padding is zero, so the state after it is the last vertex. */
+	_mm_storeu_si128((__m128i*)previous, low);
+	_mm_storeu_si128((__m128i*)(previous + 4), high);
+}
+
+__attribute__((target("ssse3")))
+static void unfilterIndicesSSSE3(const uint8_t* planes, size_t n,
+	uint32_t& previous, uint32_t* out) {
+	const __m128i one = _mm_set1_epi32(1);
+	__m128i last = _mm_set1_epi32((int)previous);
+	for (size_t j = 0; j < n; j += 16) {
+		__m128i words[4];
+		planesToWords(planes + j, words);
+		for (size_t q = 0; q < 4; q++) {
+			__m128i z = words[q];
+			__m128i sign = _mm_sub_epi32(_mm_setzero_si128(),
+				_mm_and_si128(z, one));
+			__m128i d = _mm_xor_si128(_mm_srli_epi32(z, 1), sign);
+			d = _mm_add_epi32(d, _mm_slli_si128(d, 4));
+			d = _mm_add_epi32(d, _mm_slli_si128(d, 8));
+			d = _mm_add_epi32(d, last);
+			last = _mm_shuffle_epi32(d, 0xff);
+
+			size_t i = j + q*4;
+			if (i + 4 <= n) {
+				_mm_storeu_si128((__m128i*)(out + i), d);
+			} else if (i < n) {
+				uint32_t lanes[4];
+				_mm_storeu_si128((__m128i*)lanes, d);
+				memcpy(out + i, lanes, (n - i)*sizeof(uint32_t));
+			}
+		}
+	}
+	previous = (uint32_t)_mm_cvtsi128_si32(last);
+}
+#endif
+
+template <typename T, typename Unfilter>
+static bool decodeElements(const uint8_t* data, size_t size, T* out,
+	size_t count, size_t elementSize, Unfilter unfilter) {
+	const uint8_t* end = data + size;
+	if (size == 0 || *data++ != codecVersion) return false;
+
+#ifdef ENGINE_MESHCODEC_SSSE3
+	bool simd = haveSSSE3();
+#else
+	bool simd = false;
+#endif
+	/* Room for whole 16 byte loads past the last element of a plane. */
+	vector<uint8_t> planes(elementSize*chunkSize + 16);
+	for (size_t begin = 0; begin < count; begin += chunkSize) {
+		size_t n = min(chunkSize, count - begin);
+		size_t padded = paddedCount(n);
+		bool decoded = simd
+			? decodePlanes<true>(data, end, padded, elementSize, planes.data())
+			: decodePlanes<false>(data, end, padded, elementSize,
+				planes.data());
+		if (!decoded) return false;
+		unfilter(planes.data(), n, simd, out + begin);
+	}
+	return data == end;
+}
+
+namespace Engine {
+	void encodeVertices(const Vertex* vertices, size_t count,
+		vector<uint8_t>& encoded) {
+		vector<uint32_t> filtered(count*vertexWords);
+		uint32_t previous[vertexWords] = {};
+		for (size_t i = 0; i < count; i++) {
+			uint32_t words[vertexWords];
+			memcpy(words, &vertices[i], sizeof(Vertex));
+			for (size_t w = 0; w < vertexWords; w++) {
+				filtered[i*vertexWords + w] = words[w] ^ previous[w];
+				previous[w] = words[w];
+			}
+		}
+		encodePlanes((const uint8_t*)filtered.data(), count, sizeof(Vertex),
+			encoded);
+	}
+
+	void encodeIndices(const uint32_t* indices, size_t count,
+		vector<uint8_t>& encoded) {
+		vector<uint32_t> filtered(count);
+		uint32_t previous = 0;
+		for (size_t i = 0; i < count; i++) {
+			int32_t delta = (int32_t)(indices[i] - previous);
+			filtered[i] = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+			previous = indices[i];
+		}
+		encodePlanes((const uint8_t*)filtered.data(), count, sizeof(uint32_t),
+			encoded);
+	}
+
+	bool decodeVertices(const uint8_t* data, size_t size, Vertex* vertices,
+		size_t count) {
+		uint32_t previous[vertexWords] = {};
+		return decodeElements(data, size, vertices, count, sizeof(Vertex),
+			[&previous](const uint8_t* planes, size_t n, bool simd,
+				Vertex* out) {
+#ifdef ENGINE_MESHCODEC_SSSE3
+				if (simd) {
+					unfilterVerticesSSSE3(planes, n, previous, out);
+					return;
+				}
+#endif
+				unfilterVertices(planes, n, previous, out);
+			});
+	}
+
+	/*
+	 * Every 16 bytes of a plane take at least a 2 byte mask, so each byte
+	 * of an element takes at least an eighth of a byte.
+	 */
+	size_t maxDecodedCount(size_t size, size_t elementSize) {
+		return size / elementSize * 8 + 8;
+	}
+
+	bool decodeIndices(const uint8_t* data, size_t size, uint32_t* indices,
+		size_t count) {
+		uint32_t previous = 0;
+		return decodeElements(data, size, indices, count, sizeof(uint32_t),
+			[&previous](const uint8_t* planes, size_t n, bool simd,
+				uint32_t* out) {
+#ifdef ENGINE_MESHCODEC_SSSE3
+				if (simd) {
+					unfilterIndicesSSSE3(planes, n, previous, out);
+					return;
+				}
+#endif
+				unfilterIndices(planes, n, previous, out);
+			});
+	}
+}
@@ -1,9 +1,15 @@
 #include <Engine/MeshGeneration.h>
+#include <Engine/MeshBuilder.h>
+#include <Engine/MeshCache.h>
+#include <Engine/MeshNormals.h>
+#include <Engine/MeshSimplification.h>
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 #include <iostream>
 #include <stdexcept>
 #include <map>
+#include <algorithm>
+#include <limits>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -14,74 +20,79 @@ using glm::vec3;
 using glm::vec2;
 
 namespace Engine {
-	Mesh generateCube() {
-		Mesh m;
-		m.addVertex({ vec3(-0.5f, -0.5f, 0.5f), vec3(0.f, 0.f, 1.f), vec2(0.f, 0.f) });
-		m.addVertex({ vec3(0.5f, -0.5f, 0.5f), vec3(0.f, 0.f, 1.f), vec2(1.f, 0.f) });
-		m.addVertex({ vec3(0.5f, 0.5f, 0.5f), vec3(0.f, 0.f, 1.f), vec2(1.f, 1.f) });
-		m.addVertex({ vec3(0.5f, 0.5f, 0.5f), vec3(0.f, 0.f, 1.f), vec2(1.f, 1.f) });
-		m.addVertex({ vec3(-0.5f, 0.5f, 0.5f), vec3(0.f, 0.f, 1.f), vec2(0.f, 1.f) });
-		m.addVertex({ vec3(-0.5f, -0.5f, 0.5f), vec3(0.f, 0.f, 1.f), vec2(0.f, 0.f) });
-		m.addVertex({ vec3(-0.5f, 0.5f, 0.5f), vec3(0.f, 1.f, 0.f), vec2(0.f, 0.f) });
-		m.addVertex({ vec3(0.5f, 0.5f, 0.5f), vec3(0.f, 1.f, 0.f), vec2(1.f, 0.f) });
-		m.addVertex({ vec3(0.5f, 0.5f, -0.5f), vec3(0.f, 1.f, 0.f), vec2(1.f, 1.f) });
-		m.addVertex({ vec3(0.5f, 0.5f, -0.5f), vec3(0.f, 1.f, 0.f), vec2(1.f, 1.f) });
-		m.addVertex({ vec3(-0.5f, 0.5f, -0.5f), vec3(0.f, 1.f, 0.f), vec2(0.f, 1.f) });
-		m.addVertex({ vec3(-0.5f, 0.5f, 0.5f), vec3(0.f, 1.f, 0.f), vec2(0.f, 0.f) });
-		m.addVertex({ vec3(-0.5f, 0.5f, -0.5f), vec3(0.f, 0.f, -1.f), vec2(0.f, 0.f) });
-		m.addVertex({ vec3(0.5f, 0.5f, -0.5f), vec3(0.f, 0.f, -1.f), vec2(1.f, 0.f) });
-		m.addVertex({ vec3(0.5f, -0.5f, -0.5f), vec3(0.f, 0.f, -1.f), vec2(1.f, 1.f) });
-		m.addVertex({ vec3(0.5f, -0.5f, -0.5f), vec3(0.f, 0.f, -1.f), vec2(1.f, 1.f) });
-		m.addVertex({ vec3(-0.5f, -0.5f, -0.5f), vec3(0.f, 0.f, -1.f), vec2(0.f, 1.f) });
-		m.addVertex({ vec3(-0.5f, 0.5f, -0.5f), vec3(0.f, 0.f, -1.f), vec2(0.f, 0.f) });
-		m.addVertex({ vec3(-0.5f, -0.5f, -0.5f), vec3(-1.f, 0.f, 0.f), vec2(0.f, 0.f) });
-		m.addVertex({ vec3(-0.5f, -0.5f, 0.5f), vec3(-1.f, 0.f, 0.f), vec2(1.f, 0.f) });
-		m.addVertex({ vec3(-0.5f, 0.5f, 0.5f), vec3(-1.f, 0.f, 0.f), vec2(1.f, 1.f) });
-		m.addVertex({ vec3(-0.5f, 0.5f, 0.5f), vec3(-1.f, 0.f, 0.f), vec2(1.f, 1.f) });
-		m.addVertex({ vec3(-0.5f, 0.5f, -0.5f), vec3(-1.f, 0.f, 0.f), vec2(0.f, 1.f) });
-		m.addVertex({ vec3(-0.5f, -0.5f, -0.5f), vec3(-1.f, 0.f, 0.f), vec2(0.f, 0.f) });
-		m.addVertex({ vec3(-0.5f, -0.5f, 0.5f), vec3(0.f, -1.f, 0.f), vec2(0.f, 0.f) });
-		m.addVertex({ vec3(0.5f, -0.5f, -0.5f), vec3(0.f, -1.f, 0.f), vec2(1.f, 0.f) });
-		m.addVertex({ vec3(0.5f, -0.5f, 0.5f), vec3(0.f, -1.f, 0.f), vec2(1.f, 1.f) });
-		m.addVertex({ vec3(-0.5f, -0.5f, -0.5f), vec3(0.f, -1.f, 0.f), vec2(1.f, 1.f) });
-		m.addVertex({ vec3(0.5f, -0.5f, -0.5f), vec3(0.f, -1.f, 0.f), vec2(0.f, 1.f) });
-		m.addVertex({ vec3(-0.5f, -0.5f, 0.5f), vec3(0.f, -1.f, 0.f), vec2(0.f, 0.f) });
-		m.addVertex({ vec3(0.5f, -0.5f, 0.5f), vec3(1.f, 0.f, 0.f), vec2(0.f, 0.f) });
-		m.addVertex({ vec3(0.5f, -0.5f, -0.5f), vec3(1.f, 0.f, 0.f), vec2(1.f, 0.f) });
-		m.addVertex({ vec3(0.5f, 0.5f, -0.5f), vec3(1.f, 0.f, 0.f), vec2(1.f, 1.f) });
-		m.addVertex({ vec3(0.5f, 0.5f, -0.5f), vec3(1.f, 0.f, 0.f), vec2(1.f, 1.f) });
-		m.addVertex({ vec3(0.5f, 0.5f, 0.5f), vec3(1.f, 0.f, 0.f), vec2(0.f, 1.f) });
-		m.addVertex({ vec3(0.5f, -0.5f, 0.5f), vec3(1.f, 0.f, 0.f), vec2(0.f, 0.f) });
-		return m;
-	}
-
-	static glm::vec2 sphereUv(glm::vec3& p) {
+	MeshLoadFlags operator|(MeshLoadFlags a, MeshLoadFlags b) {
+		return static_cast<MeshLoadFlags>(static_cast<int>(a) | static_cast<int>(b));
+	}
+
+	MeshLoadFlags operator&(MeshLoadFlags a, MeshLoadFlags b) {
+		return static_cast<MeshLoadFlags>(static_cast<int>(a) & static_cast<int>(b));
+	}
+
+	static glm::vec2 sphereUv(const glm::vec3& p) {
 		float twoPi = (float)(2 * M_PI);
 		glm::vec2 uv;
-		uv.x = 0.5f - ((float)atan2(p.z, p.x) / twoPi);
-		uv.y = 0.5f - 2.0f * ((float)asin(p.y) / twoPi);
+		uv.x = 0.5f - (atan2f(p.z, p.x) / twoPi);
+		uv.y = 0.5f - 2.0f * (asinf(p.y) / twoPi);
 		return uv;
 	}
 
 
-	static uint32_t subVertex(IndexedMesh& m, uint32_t a, uint32_t b) {
-		auto& vertices = m.getVertices();
-		vec3 pos = glm::normalize(glm::mix(vertices[a].position, vertices[b].position, 0.5f));
-		return m.addVertex({ pos, pos, sphereUv(pos) });;
+	/*
+	 * Every vertex of an icosphere has at most six neighbours, so the
+	 * midpoints of a subdivision level are cached in a fixed number of slots
+	 * per vertex, keyed by the lower index of the edge.
+	 */
+	static const uint32_t maxEdgesPerVertex = 6;
+
+	struct MidpointCache {
+		vector<uint8_t> count;
+		vector<uint32_t> other;
+		vector<uint32_t> midpoint;
+
+		void reset(size_t vertexCount) {
+			count.assign(vertexCount, 0);
+			other.resize(vertexCount * maxEdgesPerVertex);
+			midpoint.resize(vertexCount * maxEdgesPerVertex);
+		}
+	};
+
+	static uint32_t subVertex(vector<Vertex>& vertices, MidpointCache& cache,
+		uint32_t a, uint32_t b) {
+		uint32_t key = a < b ? a : b;
+		uint32_t value = a < b ? b : a;
+		uint32_t* other = &cache.other[key * maxEdgesPerVertex];
+		uint8_t& count = cache.count[key];
+		for (uint32_t i = 0; i < count; i++) {
+			if (other[i] == value) {
+				return cache.midpoint[key * maxEdgesPerVertex + i];
+			}
+		}
+
+		vec3 pos = glm::normalize(glm::mix(vertices[a].position,
+			vertices[b].position, 0.5f));
+		uint32_t index = (uint32_t)vertices.size();
+		vertices.push_back({ pos, pos, sphereUv(pos) });
+		other[count] = value;
+		cache.midpoint[key * maxEdgesPerVertex + count] = index;
+		count++;
+		return index;
 	}
 
-	static void subdivide(IndexedMesh& m, uint32_t a, uint32_t b, uint32_t c, unsigned level) {
-		if (level > 0) {
-			uint32_t ab = subVertex(m, a, b);
-			uint32_t ac = subVertex(m, a, c);
-			uint32_t bc = subVertex(m, b, c);
-			level--;
-			subdivide(m, a, ab, ac, level);
-			subdivide(m, ab, b, bc, level);
-			subdivide(m, bc, c, ac, level);
-			subdivide(m, ab, bc, ac, level);
-		} else {
-			m.addFace(a, b, c);
+	static void subdivide(vector<Vertex>& vertices, MidpointCache& cache,
+		const uint32_t* faces, size_t faceCount, uint32_t* out) {
+		cache.reset(vertices.size());
+		for (size_t f = 0; f < faceCount; f++) {
+			uint32_t a = faces[f*3 + 0];
+			uint32_t b = faces[f*3 + 1];
+			uint32_t c = faces[f*3 + 2];
+			uint32_t ab = subVertex(vertices, cache, a, b);
+			uint32_t ac = subVertex(vertices, cache, a, c);
+			uint32_t bc = subVertex(vertices, cache, b, c);
+			uint32_t* o = out + f*12;
+			o[0] = a;  o[1] = ab;  o[2] = ac;
+			o[3] = ab; o[4] = b;   o[5] = bc;
+			o[6] = bc; o[7] = c;   o[8] = ac;
+			o[9] = ab; o[10] = bc; o[11] = ac;
 		}
 	}
 
@@ -127,8 +138,6 @@ namespace Engine {
 	}
 
 	IndexedMesh generateSphere(unsigned subdivisions) {
-		IndexedMesh m;
-
 		float t = (1.f + sqrtf(5.f)) / 2.f;
 
 		vec3
@@ -160,86 +169,402 @@ namespace Engine {
 		v10 = glm::normalize(v10);
 		v11 = glm::normalize(v11);
 
-		m.addVertex({ v0, v0, sphereUv(v0) });
-		m.addVertex({ v1, v1, sphereUv(v1) });
-		m.addVertex({ v2, v2, sphereUv(v2) });
-		m.addVertex({ v3, v3, sphereUv(v3) });
-		m.addVertex({ v4, v4, sphereUv(v4) });
-		m.addVertex({ v5, v5, sphereUv(v5) });
-		m.addVertex({ v6, v6, sphereUv(v6) });
-		m.addVertex({ v7, v7, sphereUv(v7) });
-		m.addVertex({ v8, v8, sphereUv(v8) });
-		m.addVertex({ v9, v9, sphereUv(v9) });
-		m.addVertex({ v10, v10, sphereUv(v10) });
-		m.addVertex({ v11, v11, sphereUv(v11) });
-
-		subdivide(m, 0, 11, 5, subdivisions);
-		subdivide(m, 0, 5, 1, subdivisions);
-		subdivide(m, 0, 1, 7, subdivisions);
-		subdivide(m, 0, 7, 10, subdivisions);
-		subdivide(m, 0, 10, 11, subdivisions);
-
-		subdivide(m, 1, 5, 9, subdivisions);
-		subdivide(m, 5, 11, 4, subdivisions);
-		subdivide(m, 11, 10, 2, subdivisions);
-		subdivide(m, 10, 7, 6, subdivisions);
-		subdivide(m, 7, 1, 8, subdivisions);
-
-		subdivide(m, 3, 9, 4, subdivisions);
-		subdivide(m, 3, 4, 2, subdivisions);
-		subdivide(m, 3, 2, 6, subdivisions);
-		subdivide(m, 3, 6, 8, subdivisions);
-		subdivide(m, 3, 8, 9, subdivisions);
-
-		subdivide(m, 4, 9, 5, subdivisions);
-		subdivide(m, 2, 4, 11, subdivisions);
-		subdivide(m, 6, 2, 10, subdivisions);
-		subdivide(m, 8, 6, 7, subdivisions);
-		subdivide(m, 9, 8, 1, subdivisions);
-
-		//repairTextureWrapSeam(m.getVertices(), m.getIndices()); //currently doesn't matter because texture atlas
-
-		return m;
-	}
-
-	IndexedMesh loadMesh(const string& filePath) {
+		/*
+		 * Each level splits every face in four and every edge in two, so a
+		 * sphere with n subdivisions has 20*4^n faces, 30*4^n edges and
+		 * 10*4^n + 2 vertices.
+		 */
+		size_t faceCount = 20 * ((size_t)1 << (2 * subdivisions));
+		MeshBuilder builder;
+		builder.reserve(faceCount / 2 + 2, faceCount * 3);
+		uint32_t* indices = builder.extendIndices(faceCount * 3);
+		vector<Vertex>& vertices = builder.getMesh().getVertices();
+
+		vec3 base[] = { v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11 };
+		for (const vec3& v : base) {
+			vertices.push_back({ v, v, sphereUv(v) });
+		}
+
+		static const uint32_t icosahedron[] = {
+			0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+			1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+			3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+			4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1
+		};
+
+		/*
+		 * Subdivide level by level, alternating between the index buffer
+		 * and a scratch buffer so the last level lands in the index buffer.
+		 */
+		vector<uint32_t> scratch(subdivisions > 1 ? faceCount * 3 / 4 : 0);
+		uint32_t* buffers[] = { indices, scratch.data() };
+		const uint32_t* faces = icosahedron;
+		size_t levelFaces = 20;
+		if (subdivisions == 0) {
+			copy(icosahedron, icosahedron + 60, indices);
+		}
+		MidpointCache cache;
+		for (unsigned level = 0; level < subdivisions; level++) {
+			uint32_t* out = buffers[(subdivisions - 1 - level) % 2];
+			subdivide(vertices, cache, faces, levelFaces, out);
+			faces = out;
+			levelFaces *= 4;
+		}
+
+		//repairTextureWrapSeam(builder.getMesh().getVertices(), builder.getMesh().getIndices()); //currently doesn't matter because texture atlas
+
+		return builder.build();
+	}
+
+	SkinnedMesh generateSkinnedCylinder(unsigned jointCount,
+		unsigned segments, unsigned ringsPerJoint) {
+		const float radius = 0.25f;
+		unsigned rings = jointCount * ringsPerJoint + 1;
+		SkinnedMesh mesh;
+		mesh.getVertices().reserve(rings * (segments + 1));
+		mesh.getSkinWeights().reserve(rings * (segments + 1));
+		mesh.getIndices().reserve((rings - 1) * segments * 6);
+
+		/*
+		 * Joint k sits at height k and moves the rings between it and the
+		 * next joint, fading linearly into the next. The seam column is
+		 * duplicated for the texture coordinates.
+		 */
+		for (unsigned r = 0; r < rings; r++) {
+			float y = r / (float)ringsPerJoint;
+			uint16_t joint = (uint16_t)min(r / ringsPerJoint, jointCount - 1);
+			float f = y - joint;
+			SkinWeights weights = { { joint, 0, 0, 0 },
+				{ 1.f, 0.f, 0.f, 0.f } };
+			if (joint + 1u < jointCount) {
+				weights.joints[1] = (uint16_t)(joint + 1);
+				weights.weights[0] = 1.f - f;
+				weights.weights[1] = f;
+			}
+			for (unsigned s = 0; s <= segments; s++) {
+				float a = 2.f * glm::pi<float>() * s / segments;
+				vec3 normal(cosf(a), 0.f, sinf(a));
+				Vertex v = { vec3(radius * normal.x, y, radius * normal.z),
+					normal, vec2(s / (float)segments, y / jointCount) };
+				mesh.addVertex(v, weights);
+			}
+		}
+
+		uint32_t stride = segments + 1;
+		for (unsigned r = 0; r + 1 < rings; r++) {
+			for (unsigned s = 0; s < segments; s++) {
+				uint32_t a = r * stride + s;
+				uint32_t b = a + stride;
+				mesh.addIndex(a);
+				mesh.addIndex(b);
+				mesh.addIndex(a + 1);
+				mesh.addIndex(a + 1);
+				mesh.addIndex(b);
+				mesh.addIndex(b + 1);
+			}
+		}
+		return mesh;
+	}
+
+	static string textureNameFromPath(const string& path) {
+		size_t begin = path.find_last_of("/\\");
+		begin = begin == string::npos ? 0 : begin + 1;
+		size_t end = path.find_last_of('.');
+		if (end == string::npos || end < begin) end = path.size();
+		return path.substr(begin, end - begin);
+	}
+
+	static void loadObj(const string& filePath, IndexedMesh& mesh,
+		vector<Material>& materials) {
 		vector<tinyobj::shape_t> shapes;
-		vector<tinyobj::material_t> materials;
+		vector<tinyobj::material_t> objMaterials;
 		string err;
-		tinyobj::LoadObj(shapes, materials, err, filePath.c_str(), nullptr,
-			tinyobj::load_flags_t::triangulation
-				| tinyobj::load_flags_t::calculate_normals);
+		size_t slash = filePath.find_last_of("/\\");
+		string basePath = slash == string::npos ? "" : filePath.substr(0, slash + 1);
+		tinyobj::LoadObj(shapes, objMaterials, err, filePath.c_str(),
+			basePath.c_str(),
+			tinyobj::load_flags_t::triangulation);
 
 		if (!err.empty()) {
 			cerr << err;
 		}
 
-		IndexedMesh mesh;
+		for (const tinyobj::material_t& m : objMaterials) {
+			Material material;
+			material.setColor(m.diffuse[0], m.diffuse[1], m.diffuse[2],
+				m.dissolve);
+			if (!m.diffuse_texname.empty()) {
+				material.setTextureName(textureNameFromPath(m.diffuse_texname));
+			}
+			materials.push_back(material);
+		}
 
+
+		/*
+		 * Count the faces of each material first, so the faces can be
+		 * scattered straight into contiguous per-material ranges.
+		 * Slot 0 holds faces without a material.
+		 */
+		size_t slotCount = objMaterials.size() + 1;
+		vector<uint32_t> slotFirst(slotCount + 1, 0);
+		size_t vertexCount = 0;
+		for (const tinyobj::shape_t& shape : shapes) {
+			vertexCount += shape.mesh.positions.size() / 3;
+			size_t faceCount = shape.mesh.indices.size() / 3;
+			for (size_t f = 0; f < faceCount; f++) {
+				int id = f < shape.mesh.material_ids.size() ?
+					shape.mesh.material_ids[f] : -1;
+				if (id < 0 || id >= (int)objMaterials.size()) id = -1;
+				slotFirst[id + 2] += 3;
+			}
+		}
+		for (size_t i = 1; i <= slotCount; i++) {
+			slotFirst[i] += slotFirst[i - 1];
+		}
+
+		MeshBuilder builder;
+		Vertex* vertices = builder.extendVertices(vertexCount);
+		uint32_t* indices = builder.extendIndices(slotFirst[slotCount]);
+		vector<uint32_t> cursor(slotFirst.begin(), slotFirst.end() - 1);
+
+		uint32_t offset = 0;
+		bool missingNormals = false;
 		for (const tinyobj::shape_t& shape : shapes) {
-			for (int i = 0; i < shape.mesh.positions.size() / 3; i++) {
-				Vertex v;
-				int pos = i*3;
-				v.position.x = shape.mesh.positions[pos];
-				v.normal.x = shape.mesh.normals[pos++];
-				v.position.y = shape.mesh.positions[pos];
-				v.normal.y = shape.mesh.normals[pos++];
-				v.position.z = shape.mesh.positions[pos];
-				v.normal.z = shape.mesh.normals[pos++];
-
-				if (!shape.mesh.texcoords.empty()) {
-					pos = i*2;
-					v.textureCoordinate.x = shape.mesh.texcoords[pos++];
-					v.textureCoordinate.y = shape.mesh.texcoords[pos];
+			size_t shapeVertexCount = shape.mesh.positions.size() / 3;
+			const float* positions = shape.mesh.positions.data();
+			const float* normals = shape.mesh.normals.empty() ? nullptr
+				: shape.mesh.normals.data();
+			missingNormals = missingNormals || !normals;
+			const float* texcoords = shape.mesh.texcoords.empty() ? nullptr
+				: shape.mesh.texcoords.data();
+			Vertex* v = vertices + offset;
+			for (size_t i = 0; i < shapeVertexCount; i++) {
+				v[i].position = vec3(positions[i*3], positions[i*3 + 1],
+					positions[i*3 + 2]);
+				v[i].normal = normals ? vec3(normals[i*3], normals[i*3 + 1],
+					normals[i*3 + 2]) : vec3();
+				v[i].textureCoordinate = texcoords ?
+					vec2(texcoords[i*2], texcoords[i*2 + 1]) : vec2();
+			}
+
+			size_t faceCount = shape.mesh.indices.size() / 3;
+			for (size_t f = 0; f < faceCount; f++) {
+				int id = f < shape.mesh.material_ids.size() ?
+					shape.mesh.material_ids[f] : -1;
+				if (id < 0 || id >= (int)objMaterials.size()) id = -1;
+				uint32_t& c = cursor[id + 1];
+				for (size_t j = 0; j < 3; j++) {
+					indices[c++] = shape.mesh.indices[f*3 + j] + offset;
 				}
-				mesh.addVertex(v);
 			}
-			uint32_t offset = (uint32_t)mesh.getElementCount();
-			for (uint32_t i : shape.mesh.indices) {
-				mesh.addIndex(i + offset);
+			offset += (uint32_t)shapeVertexCount;
+		}
+
+		for (size_t slot = 0; slot < slotCount; slot++) {
+			uint32_t count = slotFirst[slot + 1] - slotFirst[slot];
+			if (count == 0) continue;
+			int32_t id = slot == 0 ? -1 : (int32_t)(slot - 1);
+			builder.addSubmesh({ slotFirst[slot], count, id });
+		}
+		mesh = builder.build();
+
+		/*
+		 * Normals are generated for the whole mesh when any shape has
+		 * none, so shapes that do have them are smoothed as well.
+		 */
+		if (missingNormals) {
+			generateNormals(mesh);
+		}
+	}
+
+	IndexedMesh loadMesh(const string& filePath, MeshLoadFlags flags,
+		unsigned lodLevels) {
+		vector<Material> materials;
+		return loadMesh(filePath, materials, flags, lodLevels);
+	}
+
+	IndexedMesh loadMesh(const string& filePath, vector<Material>& materials,
+		MeshLoadFlags flags, unsigned lodLevels) {
+		IndexedMesh mesh;
+		vector<Material> meshMaterials;
+		bool useCache = (flags & MeshLoadFlags::BinaryCache)
+			!= MeshLoadFlags::None;
+
+		if (!useCache || !readMeshCache(filePath, flags, lodLevels, mesh,
+			meshMaterials)) {
+			loadObj(filePath, mesh, meshMaterials);
+			if (lodLevels > 0) {
+				generateLods(mesh, lodLevels);
+			}
+			if ((flags & MeshLoadFlags::OptimizeVertexCache)
+				!= MeshLoadFlags::None) {
+				optimizeVertexCache(mesh);
+				optimizeVertexFetch(mesh);
+			}
+			if (useCache) {
+				writeMeshCache(filePath, flags, lodLevels, mesh, meshMaterials);
 			}
 		}
 
+		int32_t materialOffset = (int32_t)materials.size();
+		for (Submesh& submesh : mesh.getSubmeshes()) {
+			if (submesh.materialId >= 0) submesh.materialId += materialOffset;
+		}
+		materials.insert(materials.end(),
+			make_move_iterator(meshMaterials.begin()),
+			make_move_iterator(meshMaterials.end()));
+
 		return mesh;
 	}
+
+	VertexCacheStatistics analyzeVertexCache(const IndexedMesh& mesh,
+		unsigned cacheSize) {
+		const vector<uint32_t>& indices = mesh.getIndices();
+		VertexCacheStatistics stats = { 0.f, 0.f };
+		if (indices.empty() || cacheSize == 0) return stats;
+
+		/*
+		 * FIFO cache simulation. A vertex is in the cache if it was
+		 * transformed less than cacheSize misses ago.
+		 */
+		vector<uint32_t> transformedAt(mesh.getVertices().size(), 0);
+		vector<bool> referenced(mesh.getVertices().size(), false);
+		uint32_t misses = 0;
+		uint32_t unique = 0;
+		for (uint32_t index : indices) {
+			if (!referenced[index]) {
+				referenced[index] = true;
+				unique++;
+			}
+			if (transformedAt[index] == 0
+				|| misses + 1 - transformedAt[index] > cacheSize) {
+				misses++;
+				transformedAt[index] = misses;
+			}
+		}
+
+		stats.acmr = misses / (float)(indices.size() / 3);
+		stats.atvr = misses / (float)unique;
+		return stats;
+	}
+
+	static void tipsify(uint32_t* indices, size_t indexCount,
+		size_t vertexCount, unsigned cacheSize) {
+		size_t triangleCount = indexCount / 3;
+
+		/*
+		 * Vertex to triangle adjacency, stored as offsets into one array.
+		 */
+		vector<uint32_t> liveCount(vertexCount, 0);
+		for (size_t i = 0; i < indexCount; i++) {
+			liveCount[indices[i]]++;
+		}
+		vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++) {
+			adjacencyOffset[v + 1] = adjacencyOffset[v] + liveCount[v];
+		}
+		vector<uint32_t> adjacency(indexCount);
+		vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for (size_t i = 0; i < indexCount; i++) {
+			adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+		}
+
+		vector<uint32_t> cacheTime(vertexCount, 0);
+		vector<bool> emitted(triangleCount, false);
+		vector<uint32_t> deadEnd;
+		vector<uint32_t> candidates;
+		vector<uint32_t> output;
+		output.reserve(indexCount);
+
+		uint32_t time = cacheSize + 1;
+		size_t cursor = 0;
+		int64_t fanning = indexCount > 0 ? indices[0] : -1;
+
+		while (fanning >= 0) {
+			candidates.clear();
+			uint32_t f = (uint32_t)fanning;
+			for (uint32_t a = adjacencyOffset[f]; a < adjacencyOffset[f + 1]; a++) {
+				uint32_t t = adjacency[a];
+				if (emitted[t]) continue;
+				for (uint32_t j = 0; j < 3; j++) {
+					uint32_t v = indices[t*3 + j];
+					output.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					liveCount[v]--;
+					if (time - cacheTime[v] > cacheSize) {
+						cacheTime[v] = time++;
+					}
+				}
+				emitted[t] = true;
+			}
+
+			/*
+			 * Pick the live candidate that will still be in the cache after
+			 * its remaining triangles are emitted, preferring the oldest one.
+			 * Otherwise fall back to a recently used dead-end vertex.
+			 */
+			fanning = -1;
+			int64_t best = -1;
+			for (uint32_t v : candidates) {
+				if (liveCount[v] == 0) continue;
+				int64_t priority = 0;
+				if (time - cacheTime[v] + 2*liveCount[v] <= cacheSize) {
+					priority = time - cacheTime[v];
+				}
+				if (priority > best) {
+					best = priority;
+					fanning = v;
+				}
+			}
+			while (fanning < 0 && !deadEnd.empty()) {
+				uint32_t v = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveCount[v] > 0) fanning = v;
+			}
+			while (fanning < 0 && cursor < indexCount) {
+				uint32_t v = indices[cursor++];
+				if (liveCount[v] > 0) fanning = v;
+			}
+		}
+
+		copy(output.begin(), output.end(), indices);
+	}
+
+	void optimizeVertexCache(IndexedMesh& mesh, unsigned cacheSize) {
+		vector<uint32_t>& indices = mesh.getIndices();
+		size_t vertexCount = mesh.getVertices().size();
+		if (mesh.getSubmeshes().empty()) {
+			size_t count = mesh.getElementCount();
+			tipsify(indices.data(), count - count % 3, vertexCount, cacheSize);
+		}
+		for (const Submesh& submesh : mesh.getSubmeshes()) {
+			tipsify(indices.data() + submesh.firstIndex,
+				submesh.indexCount - submesh.indexCount % 3, vertexCount,
+				cacheSize);
+		}
+		for (size_t i = 1; i < mesh.getLods().size(); i++) {
+			const LevelOfDetail& lod = mesh.getLods()[i];
+			tipsify(indices.data() + lod.firstIndex,
+				lod.indexCount - lod.indexCount % 3, vertexCount, cacheSize);
+		}
+	}
+
+	void optimizeVertexFetch(IndexedMesh& mesh) {
+		vector<Vertex>& vertices = mesh.getVertices();
+		vector<uint32_t>& indices = mesh.getIndices();
+		const uint32_t unused = numeric_limits<uint32_t>::max();
+
+		vector<uint32_t> remap(vertices.size(), unused);
+		vector<Vertex> reordered;
+		reordered.reserve(vertices.size());
+		for (uint32_t& index : indices) {
+			if (remap[index] == unused) {
+				remap[index] = (uint32_t)reordered.size();
+				reordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(reordered);
+	}
 }
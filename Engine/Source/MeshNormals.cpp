@@ -0,0 +1,321 @@
+#include <Engine/MeshNormals.h>
+#include <Engine/Parallel.h>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define ENGINE_NORMALS_SSE
+#endif
+
+using namespace std;
+using glm::vec2;
+using glm::vec3;
+using glm::vec4;
+using Engine::Vertex;
+
+static const size_t minTrianglesPerChunk = 8192;
+static const size_t minVerticesPerChunk = 8192;
+
+struct PositionHash {
+	size_t operator()(const vec3& p) const {
+		uint32_t bits[3];
+		memcpy(bits, &p, sizeof(bits));
+		return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u
+			^ bits[2] * 83492791u);
+	}
+};
+
+/*
+ * Index of the first vertex with the same position, for every vertex
+ */
+static vector<uint32_t> weldPositions(const vector<Vertex>& vertices) {
+	vector<uint32_t> remap(vertices.size());
+	unordered_map<vec3, uint32_t, PositionHash> positions;
+	positions.reserve(vertices.size());
+	for (uint32_t i = 0; i < vertices.size(); i++) {
+		remap[i] = positions.insert(
+			make_pair(vertices[i].position, i)).first->second;
+	}
+	return remap;
+}
+
+/*
+ * Cross products of the edges of triangles [begin, end), whose length is
+ * twice the triangle area
+ */
+static void computeFaceNormals(const Vertex* vertices,
+	const uint32_t* indices, size_t begin, size_t end, vec4* normals) {
+	size_t t = begin;
+#ifdef ENGINE_NORMALS_SSE
+	/*
+	 * Four triangles at a time. Each position is loaded with the normal.x
+	 * that follows it and transposed, so the fourth row is unused.
+	 */
+	for (; t + 4 <= end; t += 4) {
+		const uint32_t* i = indices + t*3;
+		__m128 a[4], b[4], c[4];
+		for (int k = 0; k < 4; k++) {
+			a[k] = _mm_loadu_ps(&vertices[i[k*3]].position.x);
+			b[k] = _mm_loadu_ps(&vertices[i[k*3 + 1]].position.x);
+			c[k] = _mm_loadu_ps(&vertices[i[k*3 + 2]].position.x);
+		}
+		_MM_TRANSPOSE4_PS(a[0], a[1], a[2], a[3]);
+		_MM_TRANSPOSE4_PS(b[0], b[1], b[2], b[3]);
+		_MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+		__m128 e1x = _mm_sub_ps(b[0], a[0]);
+		__m128 e1y = _mm_sub_ps(b[1], a[1]);
+		__m128 e1z = _mm_sub_ps(b[2], a[2]);
+		__m128 e2x = _mm_sub_ps(c[0], a[0]);
+		__m128 e2y = _mm_sub_ps(c[1], a[1]);
+		__m128 e2z = _mm_sub_ps(c[2], a[2]);
+		__m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+		__m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+		__m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+		__m128 nw = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+		_mm_storeu_ps(&normals[t].x, nx);
+		_mm_storeu_ps(&normals[t + 1].x, ny);
+		_mm_storeu_ps(&normals[t + 2].x, nz);
+		_mm_storeu_ps(&normals[t + 3].x, nw);
+	}
+#endif
+	for (; t < end; t++) {
+		const uint32_t* i = indices + t*3;
+		const vec3& p0 = vertices[i[0]].position;
+		normals[t] = vec4(glm::cross(vertices[i[1]].position - p0,
+			vertices[i[2]].position - p0), 0.f);
+	}
+}
+
+/*
+ * Normalise four vectors in place. The fourth component of each is set to
+ * one when the vector was normalised, and to zero when it has no length.
+ */
+static void normalizeVectors(vec4* v) {
+#ifdef ENGINE_NORMALS_SSE
+	__m128 x = _mm_loadu_ps(&v[0].x);
+	__m128 y = _mm_loadu_ps(&v[1].x);
+	__m128 z = _mm_loadu_ps(&v[2].x);
+	__m128 w = _mm_loadu_ps(&v[3].x);
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	__m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x),
+		_mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+	__m128 valid = _mm_cmpgt_ps(length2, _mm_setzero_ps());
+	__m128 inverse = _mm_and_ps(valid,
+		_mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(length2)));
+	x = _mm_mul_ps(x, inverse);
+	y = _mm_mul_ps(y, inverse);
+	z = _mm_mul_ps(z, inverse);
+	w = _mm_and_ps(valid, _mm_set1_ps(1.f));
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	_mm_storeu_ps(&v[0].x, x);
+	_mm_storeu_ps(&v[1].x, y);
+	_mm_storeu_ps(&v[2].x, z);
+	_mm_storeu_ps(&v[3].x, w);
+#else
+	for (int i = 0; i < 4; i++) {
+		float length = glm::length(vec3(v[i]));
+		v[i] = length > 0.f ? vec4(vec3(v[i]) / length, 1.f) : vec4();
+	}
+#endif
+}
+
+/*
+ * Sum the face normals around vertices [begin, end) and write them
+ * normalised, four vertices at a time
+ */
+static void gatherNormals(const Engine::VertexAdjacency& adjacency,
+	const vec4* faceNormals, Vertex* vertices, size_t begin, size_t end) {
+	const uint32_t* offsets = adjacency.offsets.data();
+	const uint32_t* corners = adjacency.corners.data();
+	const uint32_t* remap = adjacency.remap.empty() ? nullptr
+		: adjacency.remap.data();
+	for (size_t v = begin; v < end; v += 4) {
+		size_t count = min((size_t)4, end - v);
+		vec4 sums[4];
+		for (size_t k = 0; k < count; k++) {
+			size_t key = remap ? remap[v + k] : v + k;
+			for (uint32_t c = offsets[key]; c < offsets[key + 1]; c++) {
+				sums[k] += faceNormals[corners[c] / 3];
+			}
+		}
+		normalizeVectors(sums);
+		for (size_t k = 0; k < count; k++) {
+			if (sums[k].w == 0.f) continue;
+			vertices[v + k].normal = vec3(sums[k]);
+		}
+	}
+}
+
+/*
+ * Direction of increasing u and v on a triangle, both normalised and
+ * flipped when the texture is mirrored (MikkTSpace vOs and vOt).
+ */
+struct TriangleTangent {
+	vec3 s;
+	vec3 t;
+};
+
+static TriangleTangent computeTriangleTangent(const Vertex& v0,
+	const Vertex& v1, const Vertex& v2) {
+	vec3 e1 = v1.position - v0.position;
+	vec3 e2 = v2.position - v0.position;
+	vec2 d1 = v1.textureCoordinate - v0.textureCoordinate;
+	vec2 d2 = v2.textureCoordinate - v0.textureCoordinate;
+	float area = d1.x*d2.y - d1.y*d2.x;
+	TriangleTangent result = { vec3(), vec3() };
+	if (area == 0.f) return result;
+
+	float sign = area > 0.f ? 1.f : -1.f;
+	vec3 s = d2.y*e1 - d1.y*e2;
+	vec3 t = d1.x*e2 - d2.x*e1;
+	float sLength = glm::length(s);
+	float tLength = glm::length(t);
+	if (sLength > 0.f) result.s = s * (sign / sLength);
+	if (tLength > 0.f) result.t = t * (sign / tLength);
+	return result;
+}
+
+static vec3 projectOnPlane(const vec3& v, const vec3& normal) {
+	return v - normal * glm::dot(normal, v);
+}
+
+static vec3 safeNormalize(const vec3& v) {
+	float length = glm::length(v);
+	return length > 0.f ? v / length : vec3();
+}
+
+/*
+ * Any unit vector perpendicular to normal
+ */
+static vec3 perpendicular(const vec3& normal) {
+	vec3 axis = fabsf(normal.x) < 0.9f ? vec3(1.f, 0.f, 0.f)
+		: vec3(0.f, 1.f, 0.f);
+	return safeNormalize(glm::cross(axis, normal));
+}
+
+namespace Engine {
+	void buildVertexAdjacency(const IndexedMesh& mesh, bool weldSeams,
+		VertexAdjacency& adjacency) {
+		const vector<Vertex>& vertices = mesh.getVertices();
+		const uint32_t* indices = mesh.getIndexData();
+		size_t indexCount = mesh.getElementCount() / 3 * 3;
+		size_t vertexCount = vertices.size();
+
+		adjacency.remap.clear();
+		if (weldSeams) adjacency.remap = weldPositions(vertices);
+		const uint32_t* remap = weldSeams ? adjacency.remap.data() : nullptr;
+
+		/*
+		 * Counting sort of the corners by vertex, so that later every
+		 * vertex is gathered by one thread and no two threads write to the
+		 * same vertex.
+		 */
+		vector<uint32_t>& offsets = adjacency.offsets;
+		offsets.assign(vertexCount + 1, 0);
+		for (size_t i = 0; i < indexCount; i++) {
+			uint32_t v = remap ? remap[indices[i]] : indices[i];
+			offsets[v + 1]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++) {
+			offsets[v + 1] += offsets[v];
+		}
+		adjacency.corners.resize(indexCount);
+		vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indexCount; i++) {
+			uint32_t v = remap ? remap[indices[i]] : indices[i];
+			adjacency.corners[cursor[v]++] = (uint32_t)i;
+		}
+	}
+
+	void generateNormals(IndexedMesh& mesh, const VertexAdjacency& adjacency) {
+		Vertex* vertices = mesh.getVertexData();
+		const uint32_t* indices = mesh.getIndexData();
+		size_t triangleCount = mesh.getElementCount() / 3;
+		size_t vertexCount = mesh.getVertices().size();
+
+		vector<vec4> faceNormals(triangleCount);
+		parallelFor(triangleCount, minTrianglesPerChunk,
+			[&](size_t begin, size_t end) {
+			computeFaceNormals(vertices, indices, begin, end,
+				faceNormals.data());
+		});
+
+		/*
+		 * Chunks are whole groups of four vertices. Every vertex sums its
+		 * own triangles in a fixed order, so the result does not depend on
+		 * the number of threads.
+		 */
+		size_t groupCount = (vertexCount + 3) / 4;
+		parallelFor(groupCount, minVerticesPerChunk / 4,
+			[&](size_t begin, size_t end) {
+			gatherNormals(adjacency, faceNormals.data(), vertices, begin*4,
+				min(end*4, vertexCount));
+		});
+	}
+
+	void generateNormals(IndexedMesh& mesh, bool weldSeams) {
+		VertexAdjacency adjacency;
+		buildVertexAdjacency(mesh, weldSeams, adjacency);
+		generateNormals(mesh, adjacency);
+	}
+
+	void generateTangents(const IndexedMesh& mesh,
+		const VertexAdjacency& adjacency, vector<vec4>& tangents) {
+		const vector<Vertex>& vertices = mesh.getVertices();
+		const uint32_t* indices = mesh.getIndexData();
+		const uint32_t* offsets = adjacency.offsets.data();
+		const uint32_t* corners = adjacency.corners.data();
+		size_t triangleCount = mesh.getElementCount() / 3;
+		size_t vertexCount = vertices.size();
+
+		vector<TriangleTangent> triangles(triangleCount);
+		parallelFor(triangleCount, minTrianglesPerChunk,
+			[&](size_t begin, size_t end) {
+			for (size_t t = begin; t < end; t++) {
+				const uint32_t* i = indices + t*3;
+				triangles[t] = computeTriangleTangent(vertices[i[0]],
+					vertices[i[1]], vertices[i[2]]);
+			}
+		});
+
+		tangents.resize(vertexCount);
+		parallelFor(vertexCount, minVerticesPerChunk,
+			[&](size_t begin, size_t end) {
+			for (size_t v = begin; v < end; v++) {
+				const vec3& normal = vertices[v].normal;
+				const vec3& p = vertices[v].position;
+				vec3 tangent, bitangent;
+				for (uint32_t c = offsets[v]; c < offsets[v + 1]; c++) {
+					uint32_t t = corners[c] / 3;
+					uint32_t k = corners[c] % 3;
+					const uint32_t* i = indices + t*3;
+					vec3 e1 = safeNormalize(projectOnPlane(
+						vertices[i[(k + 1) % 3]].position - p, normal));
+					vec3 e2 = safeNormalize(projectOnPlane(
+						vertices[i[(k + 2) % 3]].position - p, normal));
+					float angle = acosf(max(-1.f, min(1.f,
+						glm::dot(e1, e2))));
+					tangent += angle * safeNormalize(
+						projectOnPlane(triangles[t].s, normal));
+					bitangent += angle * safeNormalize(
+						projectOnPlane(triangles[t].t, normal));
+				}
+
+				tangent = safeNormalize(tangent);
+				if (tangent == vec3()) tangent = perpendicular(normal);
+				float sign = glm::dot(glm::cross(normal, tangent), bitangent)
+					< 0.f ? -1.f : 1.f;
+				tangents[v] = vec4(tangent, sign);
+			}
+		});
+	}
+
+	void generateTangents(const IndexedMesh& mesh, vector<vec4>& tangents) {
+		VertexAdjacency adjacency;
+		buildVertexAdjacency(mesh, false, adjacency);
+		generateTangents(mesh, adjacency, tangents);
+	}
+}
@@ -0,0 +1,316 @@
+#include <Engine/MeshSimplification.h>
+#include <Engine/Bounds.h>
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+using glm::vec3;
+using glm::dvec3;
+
+/*
+ * Symmetric 4x4 matrix of a sum of squared plane distances.
+ */
+struct Quadric {
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+	void addPlane(const dvec3& n, double d) {
+		a2 += n.x*n.x; ab += n.x*n.y; ac += n.x*n.z; ad += n.x*d;
+		b2 += n.y*n.y; bc += n.y*n.z; bd += n.y*d;
+		c2 += n.z*n.z; cd += n.z*d;
+		d2 += d*d;
+	}
+
+	void add(const Quadric& q) {
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+	}
+
+	double error(const vec3& p) const {
+		double x = p.x, y = p.y, z = p.z;
+		double e = a2*x*x + 2*ab*x*y + 2*ac*x*z + 2*ad*x
+			+ b2*y*y + 2*bc*y*z + 2*bd*y
+			+ c2*z*z + 2*cd*z
+			+ d2;
+		return e > 0.0 ? e : 0.0;
+	}
+};
+
+struct Collapse {
+	float cost;
+	float error;
+	uint32_t from;
+	uint32_t to;
+
+	bool operator<(const Collapse& c) const {
+		return cost < c.cost;
+	}
+};
+
+static uint64_t edgeKey(uint32_t a, uint32_t b) {
+	return ((uint64_t)a << 32) | b;
+}
+
+struct PositionHash {
+	size_t operator()(const vec3& p) const {
+		uint32_t bits[3];
+		memcpy(bits, &p, sizeof(bits));
+		return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u
+			^ bits[2] * 83492791u);
+	}
+};
+
+/*
+ * Vertices that may not move: ends of edges that only one triangle uses,
+ * and vertices that share their position with another vertex (texture or
+ * normal seams).
+ */
+static vector<bool> findLockedVertices(const vector<Engine::Vertex>& vertices,
+	const vector<uint32_t>& indices) {
+	vector<bool> locked(vertices.size(), false);
+
+	unordered_map<vec3, uint32_t, PositionHash> positions;
+	positions.reserve(vertices.size());
+	for (uint32_t i = 0; i < vertices.size(); i++) {
+		auto result = positions.insert(make_pair(vertices[i].position, i));
+		if (!result.second) {
+			locked[i] = true;
+			locked[result.first->second] = true;
+		}
+	}
+
+	unordered_set<uint64_t> edges;
+	edges.reserve(indices.size());
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		for (size_t j = 0; j < 3; j++) {
+			edges.insert(edgeKey(indices[i + j], indices[i + (j + 1) % 3]));
+		}
+	}
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		for (size_t j = 0; j < 3; j++) {
+			uint32_t a = indices[i + j];
+			uint32_t b = indices[i + (j + 1) % 3];
+			if (edges.find(edgeKey(b, a)) == edges.end()) {
+				locked[a] = true;
+				locked[b] = true;
+			}
+		}
+	}
+
+	return locked;
+}
+
+/*
+ * Whether moving vertex from onto the position of vertex to keeps every
+ * other triangle around from facing the same way.
+ */
+static bool preservesOrientation(const vector<Engine::Vertex>& vertices,
+	const vector<uint32_t>& indices, const vector<uint32_t>& adjacency,
+	uint32_t begin, uint32_t end, uint32_t from, uint32_t to) {
+	const vec3& target = vertices[to].position;
+	for (uint32_t a = begin; a < end; a++) {
+		const uint32_t* t = &indices[adjacency[a] * 3];
+		if (t[0] == to || t[1] == to || t[2] == to) continue;
+		uint32_t k = t[0] == from ? 0 : t[1] == from ? 1 : 2;
+		const vec3& p1 = vertices[t[(k + 1) % 3]].position;
+		const vec3& p2 = vertices[t[(k + 2) % 3]].position;
+		vec3 before = glm::cross(p1 - vertices[from].position,
+			p2 - vertices[from].position);
+		vec3 after = glm::cross(p1 - target, p2 - target);
+		if (glm::dot(before, after) <= 0.f) return false;
+	}
+	return true;
+}
+
+namespace Engine {
+	float simplifyMesh(const IndexedMesh& mesh, vector<uint32_t>& indices,
+		size_t targetIndexCount, float attributeWeight) {
+		const vector<Vertex>& vertices = mesh.getVertices();
+		size_t vertexCount = vertices.size();
+		indices.resize(indices.size() - indices.size() % 3);
+
+		vector<bool> locked = findLockedVertices(vertices, indices);
+
+		vector<Quadric> quadrics(vertexCount, Quadric());
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			dvec3 p0(vertices[indices[i]].position);
+			dvec3 p1(vertices[indices[i + 1]].position);
+			dvec3 p2(vertices[indices[i + 2]].position);
+			dvec3 n = glm::cross(p1 - p0, p2 - p0);
+			double length = glm::length(n);
+			if (length == 0.0) continue;
+			n /= length;
+			for (size_t j = 0; j < 3; j++) {
+				quadrics[indices[i + j]].addPlane(n, -glm::dot(n, p0));
+			}
+		}
+
+		BoundingSphere bounds = computeBoundingSphere(vertices.data(),
+			vertexCount);
+		float attributeScale = attributeWeight * bounds.radius * bounds.radius;
+		vector<vec3> normals(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++) {
+			float length = glm::length(vertices[i].normal);
+			normals[i] = length > 0.f ? vertices[i].normal / length : vec3();
+		}
+
+		vector<uint32_t> remap(vertexCount);
+		vector<bool> touched(vertexCount);
+		vector<uint32_t> adjacencyOffset(vertexCount + 1);
+		vector<uint32_t> adjacency;
+		vector<Collapse> collapses;
+		float maxError = 0.f;
+
+		while (indices.size() > targetIndexCount) {
+			/*
+			 * Vertex to triangle adjacency of the current triangles.
+			 */
+			fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+			for (uint32_t index : indices) {
+				adjacencyOffset[index + 1]++;
+			}
+			for (size_t v = 0; v < vertexCount; v++) {
+				adjacencyOffset[v + 1] += adjacencyOffset[v];
+			}
+			adjacency.resize(indices.size());
+			vector<uint32_t> cursor(adjacencyOffset.begin(),
+				adjacencyOffset.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++) {
+				adjacency[cursor[indices[i]]++] = (uint32_t)(i / 3);
+			}
+
+			collapses.clear();
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				for (size_t j = 0; j < 3; j++) {
+					uint32_t a = indices[i + j];
+					uint32_t b = indices[i + (j + 1) % 3];
+					for (int k = 0; k < 2; k++) {
+						if (!locked[a]) {
+							Quadric q = quadrics[a];
+							q.add(quadrics[b]);
+							vec3 dn = normals[a] - normals[b];
+							glm::vec2 dt = vertices[a].textureCoordinate
+								- vertices[b].textureCoordinate;
+							float error = (float)q.error(vertices[b].position);
+							float cost = error + attributeScale
+								* (glm::dot(dn, dn) + glm::dot(dt, dt));
+							collapses.push_back({ cost, error, a, b });
+						}
+						swap(a, b);
+					}
+				}
+			}
+			if (collapses.empty()) break;
+			sort(collapses.begin(), collapses.end());
+
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				remap[v] = v;
+			}
+			fill(touched.begin(), touched.end(), false);
+
+			/*
+			 * Every edge is listed from both of its triangles and most
+			 * collapses remove two triangles, so about removeTarget entries
+			 * reach the target. Only a little more expensive collapses than
+			 * that are done in one pass; the rest are reconsidered with
+			 * updated quadrics in the next pass.
+			 */
+			size_t removeTarget = (indices.size() - targetIndexCount) / 3;
+			size_t goal = min(removeTarget, collapses.size() - 1);
+			float costLimit = collapses[goal].cost * 1.5f;
+			size_t removed = 0;
+			for (const Collapse& c : collapses) {
+				if (removed >= removeTarget) break;
+				if (c.cost > costLimit && removed > 0) break;
+				if (touched[c.from] || touched[c.to]) continue;
+				uint32_t begin = adjacencyOffset[c.from];
+				uint32_t end = adjacencyOffset[c.from + 1];
+				if (!preservesOrientation(vertices, indices, adjacency,
+					begin, end, c.from, c.to)) {
+					continue;
+				}
+
+				/*
+				 * Triangles around the collapsed vertex change shape, so
+				 * none of their vertices can move again in this pass.
+				 */
+				for (uint32_t a = begin; a < end; a++) {
+					const uint32_t* t = &indices[adjacency[a] * 3];
+					touched[t[0]] = touched[t[1]] = touched[t[2]] = true;
+					if (t[0] == c.to || t[1] == c.to || t[2] == c.to) {
+						removed++;
+					}
+				}
+				remap[c.from] = c.to;
+				quadrics[c.to].add(quadrics[c.from]);
+				maxError = max(maxError, c.error);
+			}
+			if (removed == 0) break;
+
+			size_t write = 0;
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				uint32_t a = remap[indices[i]];
+				uint32_t b = remap[indices[i + 1]];
+				uint32_t c = remap[indices[i + 2]];
+				if (a == b || b == c || a == c) continue;
+				indices[write++] = a;
+				indices[write++] = b;
+				indices[write++] = c;
+			}
+			indices.resize(write);
+		}
+
+		return sqrtf(maxError);
+	}
+
+	void generateLods(IndexedMesh& mesh, unsigned levels, float ratio) {
+		vector<uint32_t>& indices = mesh.getIndices();
+		vector<LevelOfDetail>& lods = mesh.getLods();
+		uint32_t baseCount = (uint32_t)mesh.getElementCount();
+		indices.resize(baseCount);
+		lods.clear();
+		lods.push_back({ 0, baseCount, 0.f });
+
+		/*
+		 * Every submesh is simplified on its own, so collapses never move
+		 * the border between two materials, and a level stores the
+		 * submeshes one after the other.
+		 */
+		vector<Submesh> ranges = mesh.getSubmeshes();
+		if (ranges.empty()) ranges.push_back({ 0, baseCount, -1 });
+		vector<vector<uint32_t>> bases;
+		vector<size_t> targets;
+		for (const Submesh& range : ranges) {
+			bases.emplace_back(indices.begin() + range.firstIndex,
+				indices.begin() + range.firstIndex + range.indexCount);
+			targets.push_back(range.indexCount);
+		}
+
+		float error = 0.f;
+		for (unsigned level = 0; level < levels; level++) {
+			vector<uint32_t> lod;
+			for (size_t r = 0; r < ranges.size(); r++) {
+				targets[r] = (size_t)(targets[r] * ratio) / 3 * 3;
+				vector<uint32_t> part = bases[r];
+				error = max(error, simplifyMesh(mesh, part, targets[r]));
+				lod.insert(lod.end(), part.begin(), part.end());
+			}
+			if (lod.empty() || lod.size() >= lods.back().indexCount) break;
+			lods.push_back({ (uint32_t)indices.size(), (uint32_t)lod.size(),
+				error });
+			indices.insert(indices.end(), lod.begin(), lod.end());
+		}
+	}
+
+	unsigned selectLod(const vector<LevelOfDetail>& lods, unsigned current,
+		float pixelsPerUnit, float threshold, float hysteresis) {
+		for (size_t i = lods.size(); i-- > 1;) {
+			float limit = i > current ? threshold * hysteresis : threshold;
+			if (lods[i].error * pixelsPerUnit <= limit) return (unsigned)i;
+		}
+		return 0;
+	}
+}
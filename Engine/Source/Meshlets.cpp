@@ -0,0 +1,266 @@
+#include <Engine/Meshlets.h>
+#include <algorithm>
+
+using namespace std;
+using glm::vec3;
+
+/*
+ * Bounding sphere and normal cone of the triangles in
+ * indices[begin, end).
+ */
+static Engine::Meshlet finishMeshlet(const vector<Engine::Vertex>& vertices,
+	const vector<uint32_t>& indices, uint32_t begin, uint32_t end) {
+	Engine::Meshlet meshlet;
+	meshlet.firstIndex = begin;
+	meshlet.indexCount = end - begin;
+
+	vec3 low = vertices[indices[begin]].position;
+	vec3 high = low;
+	for (uint32_t i = begin; i < end; i++) {
+		low = glm::min(low, vertices[indices[i]].position);
+		high = glm::max(high, vertices[indices[i]].position);
+	}
+	vec3 center = (low + high) * 0.5f;
+	float radius2 = 0.f;
+	for (uint32_t i = begin; i < end; i++) {
+		vec3 d = vertices[indices[i]].position - center;
+		radius2 = max(radius2, glm::dot(d, d));
+	}
+	meshlet.bounds.center = center;
+	meshlet.bounds.radius = sqrtf(radius2);
+
+	/*
+	 * The cone axis is the average triangle normal and the cutoff follows
+	 * from the normal that deviates most from it. Apex is chosen so the
+	 * cone contains every triangle plane.
+	 */
+	vector<vec3> normals;
+	normals.reserve((end - begin) / 3);
+	vec3 axis;
+	for (uint32_t i = begin; i < end; i += 3) {
+		const vec3& p0 = vertices[indices[i]].position;
+		const vec3& p1 = vertices[indices[i + 1]].position;
+		const vec3& p2 = vertices[indices[i + 2]].position;
+		vec3 n = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(n);
+		if (length == 0.f) continue;
+		normals.push_back(n / length);
+		axis += normals.back();
+	}
+
+	meshlet.coneApex = center;
+	meshlet.coneAxis = vec3(0.f, 0.f, 1.f);
+	meshlet.coneCutoff = 2.f;
+	float axisLength = glm::length(axis);
+	if (normals.empty() || axisLength == 0.f) return meshlet;
+	axis /= axisLength;
+
+	float minDot = 1.f;
+	for (const vec3& n : normals) {
+		minDot = min(minDot, glm::dot(n, axis));
+	}
+	/*
+	 * Normals more than 90 degrees apart: some triangle is visible from
+	 * every direction.
+	 */
+	if (minDot <= 0.1f) return meshlet;
+
+	float maxT = 0.f;
+	size_t n = 0;
+	for (uint32_t i = begin; i < end; i += 3) {
+		const vec3& p0 = vertices[indices[i]].position;
+		const vec3& p1 = vertices[indices[i + 1]].position;
+		const vec3& p2 = vertices[indices[i + 2]].position;
+		vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		if (glm::length(normal) == 0.f) continue;
+		const vec3& tn = normals[n++];
+		/*
+		 * Distance along the axis behind center at which the plane of
+		 * this triangle crosses the axis.
+		 */
+		float denominator = glm::dot(axis, tn);
+		float t = glm::dot(center - p0, tn) / denominator;
+		maxT = max(maxT, t);
+	}
+
+	meshlet.coneApex = center - axis * maxT;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = sqrtf(1.f - minDot * minDot);
+	return meshlet;
+}
+
+/*
+ * Greedily grow meshlets over the triangles in indices[begin, end),
+ * appending the reordered triangles to out.
+ */
+static void clusterRange(const vector<Engine::Vertex>& vertices,
+	const vector<uint32_t>& indices, uint32_t begin, uint32_t end,
+	unsigned maxVertices, unsigned maxTriangles, vector<uint32_t>& out,
+	vector<Engine::Meshlet>& meshlets) {
+	uint32_t triangleCount = (end - begin) / 3;
+	if (triangleCount == 0) return;
+
+	/*
+	 * Vertex to triangle adjacency, vertex ids stay global.
+	 */
+	size_t vertexCount = vertices.size();
+	vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+	for (uint32_t i = begin; i < begin + triangleCount * 3; i++) {
+		adjacencyOffset[indices[i] + 1]++;
+	}
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffset[v + 1] += adjacencyOffset[v];
+	}
+	vector<uint32_t> adjacency(triangleCount * 3);
+	vector<uint32_t> cursor(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (uint32_t i = 0; i < triangleCount * 3; i++) {
+		adjacency[cursor[indices[begin + i]]++] = i / 3;
+	}
+
+	vector<bool> emitted(triangleCount, false);
+	vector<uint32_t> vertexMeshlet(vertexCount, ~0u);
+	vector<uint32_t> candidates;
+	uint32_t meshletId = 0;
+	uint32_t meshletVertices = 0;
+	uint32_t meshletTriangles = 0;
+	uint32_t meshletBegin = (uint32_t)out.size();
+	uint32_t scan = 0;
+
+	for (uint32_t emittedCount = 0; emittedCount < triangleCount;) {
+		/*
+		 * Pick the candidate that adds the fewest new vertices, or the next
+		 * triangle in order when the meshlet has no neighbours left.
+		 */
+		int best = -1;
+		unsigned bestNew = 4;
+		size_t write = 0;
+		for (size_t c = 0; c < candidates.size(); c++) {
+			uint32_t t = candidates[c];
+			if (emitted[t]) continue;
+			candidates[write++] = t;
+			const uint32_t* tri = &indices[begin + t * 3];
+			unsigned newVertices = 0;
+			for (int k = 0; k < 3; k++) {
+				if (vertexMeshlet[tri[k]] != meshletId) newVertices++;
+			}
+			if (newVertices < bestNew) {
+				bestNew = newVertices;
+				best = (int)t;
+			}
+		}
+		candidates.resize(write);
+
+		uint32_t triangle;
+		if (best >= 0 && meshletVertices + bestNew <= maxVertices) {
+			triangle = (uint32_t)best;
+		} else {
+			if (meshletTriangles > 0) {
+				meshlets.push_back(finishMeshlet(vertices, out, meshletBegin,
+					(uint32_t)out.size()));
+				meshletId++;
+				meshletVertices = 0;
+				meshletTriangles = 0;
+				meshletBegin = (uint32_t)out.size();
+				candidates.clear();
+			}
+			if (best >= 0) {
+				triangle = (uint32_t)best;
+			} else {
+				while (emitted[scan]) scan++;
+				triangle = scan;
+			}
+		}
+
+		const uint32_t* tri = &indices[begin + triangle * 3];
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = tri[k];
+			out.push_back(v);
+			if (vertexMeshlet[v] != meshletId) {
+				vertexMeshlet[v] = meshletId;
+				meshletVertices++;
+			}
+			for (uint32_t a = adjacencyOffset[v]; a < adjacencyOffset[v + 1];
+				a++) {
+				if (!emitted[adjacency[a]]) candidates.push_back(adjacency[a]);
+			}
+		}
+		emitted[triangle] = true;
+		emittedCount++;
+
+		if (++meshletTriangles >= maxTriangles) {
+			meshlets.push_back(finishMeshlet(vertices, out, meshletBegin,
+				(uint32_t)out.size()));
+			meshletId++;
+			meshletVertices = 0;
+			meshletTriangles = 0;
+			meshletBegin = (uint32_t)out.size();
+			candidates.clear();
+		}
+	}
+	if (meshletTriangles > 0) {
+		meshlets.push_back(finishMeshlet(vertices, out, meshletBegin,
+			(uint32_t)out.size()));
+	}
+}
+
+/*
+ * Indices from where out ends up to end, which no submesh clusters, copied
+ * through unchanged.
+ */
+static void copyUncovered(const vector<uint32_t>& indices, uint32_t end,
+	vector<uint32_t>& out) {
+	if (out.size() < end) {
+		out.insert(out.end(), indices.begin() + out.size(),
+			indices.begin() + end);
+	}
+}
+
+namespace Engine {
+	void buildMeshlets(IndexedMesh& mesh, unsigned maxVertices,
+		unsigned maxTriangles) {
+		maxVertices = max(maxVertices, 3u);
+		maxTriangles = max(maxTriangles, 1u);
+		vector<uint32_t>& indices = mesh.getIndices();
+		vector<Meshlet>& meshlets = mesh.getMeshlets();
+		meshlets.clear();
+
+		uint32_t baseCount = (uint32_t)mesh.getElementCount();
+		vector<uint32_t> out;
+		out.reserve(baseCount);
+		if (mesh.getSubmeshes().empty()) {
+			clusterRange(mesh.getVertices(), indices, 0, baseCount,
+				maxVertices, maxTriangles, out, meshlets);
+		} else {
+			for (const Submesh& submesh : mesh.getSubmeshes()) {
+				uint32_t end = submesh.firstIndex + submesh.indexCount;
+				copyUncovered(indices, submesh.firstIndex, out);
+				clusterRange(mesh.getVertices(), indices, submesh.firstIndex,
+					end, maxVertices, maxTriangles, out, meshlets);
+				copyUncovered(indices, end, out);
+			}
+		}
+		copyUncovered(indices, baseCount, out);
+		out.resize(baseCount);
+		copy(out.begin(), out.end(), indices.begin());
+	}
+
+	void cullMeshlets(const vector<Meshlet>& meshlets,
+		const glm::mat4& modelViewProjection, const vec3& viewer,
+		bool cullBackfacing, vector<uint32_t>& visible) {
+		Frustum frustum = computeFrustum(modelViewProjection);
+		for (uint32_t i = 0; i < meshlets.size(); i++) {
+			const Meshlet& meshlet = meshlets[i];
+			if (!intersectsFrustum(frustum, meshlet.bounds)) continue;
+
+			if (cullBackfacing && meshlet.coneCutoff <= 1.f) {
+				vec3 view = meshlet.coneApex - viewer;
+				float length = glm::length(view);
+				if (length > 0.f && glm::dot(view, meshlet.coneAxis)
+					>= meshlet.coneCutoff * length) {
+					continue;
+				}
+			}
+			visible.push_back(i);
+		}
+	}
+}
@@ -2,24 +2,21 @@
 #include <algorithm>
 
 using std::remove_if;
-using Engine::quatTransform;
 
 namespace Engine {
 	void Node::update() {
 		glm::mat4 localMatrix =
-			glm::translate(glm::mat4(), translation) * glm::mat4_cast(rotation);
+			glm::translate(glm::mat4(), translation) * glm::mat4_cast(rotation)
+			* glm::scale(glm::mat4(), scale);
 
 		if (parent) {
-			position = parent->getPosition()
-				+ quatTransform(parent->getOrientation(),
-					glm::normalize(translation)) * glm::length(translation);
 			orientation = parent->getOrientation() * rotation;
 			worldMatrix = parent->getWorldMatrix() * localMatrix;
 		} else {
-			position = translation;
 			orientation = rotation;
 			worldMatrix = localMatrix;
 		}
+		position = glm::vec3(worldMatrix[3]);
 
 		for (Node* child : children) {
 			child->update();
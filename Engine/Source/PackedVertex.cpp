@@ -0,0 +1,226 @@
+#include <Engine/PackedVertex.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ENGINE_PACK_SSE2
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ENGINE_PACK_F16C
+#endif
+
+using namespace std;
+using glm::vec2;
+using glm::vec3;
+
+namespace Engine {
+	const size_t PackedVertex::Stride = sizeof(PackedVertex);
+	const size_t PackedVertex::PositionOffset = 0;
+	const size_t PackedVertex::NormalOffset = 4 * sizeof(uint16_t);
+	const size_t PackedVertex::TextureCoordinateOffset = 6 * sizeof(uint16_t);
+}
+
+static int16_t toSnorm16(float v) {
+	v = max(-1.f, min(1.f, v));
+	return (int16_t)lrintf(v * 32767.f);
+}
+
+static float signNotZero(float v) {
+	return v >= 0.f ? 1.f : -1.f;
+}
+
+/*
+ * Project the normal onto the octahedron |x| + |y| + |z| = 1 and fold the
+ * lower half over the upper one (Cigolle et al. 2014).
+ */
+static void encodeOctahedral(const vec3& n, int16_t* out) {
+	float sum = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (sum == 0.f) {
+		out[0] = out[1] = 0;
+		return;
+	}
+	vec2 p(n.x / sum, n.y / sum);
+	if (n.z < 0.f) {
+		p = vec2((1.f - fabsf(p.y)) * signNotZero(p.x),
+			(1.f - fabsf(p.x)) * signNotZero(p.y));
+	}
+	out[0] = toSnorm16(p.x);
+	out[1] = toSnorm16(p.y);
+}
+
+static vec3 decodeOctahedral(const int16_t* in) {
+	vec3 n(max(in[0] / 32767.f, -1.f), max(in[1] / 32767.f, -1.f), 0.f);
+	n.z = 1.f - fabsf(n.x) - fabsf(n.y);
+	float t = max(-n.z, 0.f);
+	n.x += n.x >= 0.f ? -t : t;
+	n.y += n.y >= 0.f ? -t : t;
+	return glm::normalize(n);
+}
+
+static void packPositions(const Engine::Vertex* vertices, size_t count,
+	const vec3& offset, const vec3& inverseScale, Engine::PackedVertex* packed) {
+#ifdef ENGINE_PACK_SSE2
+	/*
+	 * The fourth lane reads normal.x and is multiplied by zero. Values are
+	 * biased into signed range so the saturating pack keeps all 16 bits.
+	 */
+	const __m128 o = _mm_setr_ps(offset.x, offset.y, offset.z, 0.f);
+	const __m128 s = _mm_setr_ps(inverseScale.x, inverseScale.y,
+		inverseScale.z, 0.f);
+	const __m128 low = _mm_setzero_ps();
+	const __m128 high = _mm_set1_ps(65535.f);
+	const __m128i bias = _mm_set1_epi32(32768);
+	const __m128i flip = _mm_set1_epi16((short)0x8000);
+	for (size_t i = 0; i < count; i++) {
+		__m128 p = _mm_loadu_ps(&vertices[i].position.x);
+		p = _mm_mul_ps(_mm_sub_ps(p, o), s);
+		p = _mm_min_ps(_mm_max_ps(p, low), high);
+		__m128i q = _mm_sub_epi32(_mm_cvtps_epi32(p), bias);
+		q = _mm_xor_si128(_mm_packs_epi32(q, q), flip);
+		_mm_storel_epi64((__m128i*)packed[i].position, q);
+	}
+#else
+	for (size_t i = 0; i < count; i++) {
+		vec3 p = (vertices[i].position - offset) * inverseScale;
+		for (int k = 0; k < 3; k++) {
+			packed[i].position[k] =
+				(uint16_t)lrintf(max(0.f, min(65535.f, p[k])));
+		}
+		packed[i].position[3] = 0;
+	}
+#endif
+}
+
+static void packTextureCoordinates(const Engine::Vertex* vertices,
+	size_t count, Engine::PackedVertex* packed) {
+	for (size_t i = 0; i < count; i++) {
+		packed[i].textureCoordinate[0] =
+			Engine::floatToHalf(vertices[i].textureCoordinate.x);
+		packed[i].textureCoordinate[1] =
+			Engine::floatToHalf(vertices[i].textureCoordinate.y);
+	}
+}
+
+#ifdef ENGINE_PACK_F16C
+__attribute__((target("f16c")))
+static void packTextureCoordinatesF16C(const Engine::Vertex* vertices,
+	size_t count, Engine::PackedVertex* packed) {
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		__m128d uv = _mm_load_sd((const double*)&vertices[i].textureCoordinate);
+		uv = _mm_loadh_pd(uv, (const double*)&vertices[i + 1].textureCoordinate);
+		__m128i h = _mm_cvtps_ph(_mm_castpd_ps(uv), 0);
+		uint32_t pair[2] = {
+			(uint32_t)_mm_cvtsi128_si32(h),
+			(uint32_t)_mm_cvtsi128_si32(_mm_srli_epi64(h, 32))
+		};
+		memcpy(packed[i].textureCoordinate, &pair[0], sizeof(uint32_t));
+		memcpy(packed[i + 1].textureCoordinate, &pair[1], sizeof(uint32_t));
+	}
+	packTextureCoordinates(vertices + i, count - i, packed + i);
+}
+#endif
+
+namespace Engine {
+	VertexQuantization computeVertexQuantization(const Vertex* vertices,
+		size_t count) {
+		VertexQuantization quantization = { vec3(), vec3(1.f) };
+		if (count == 0) return quantization;
+		vec3 low = vertices[0].position;
+		vec3 high = vertices[0].position;
+		for (size_t i = 1; i < count; i++) {
+			low = glm::min(low, vertices[i].position);
+			high = glm::max(high, vertices[i].position);
+		}
+		quantization.offset = low;
+		quantization.scale = high - low;
+		return quantization;
+	}
+
+	void packVertices(const Vertex* vertices, size_t count,
+		const VertexQuantization& quantization, PackedVertex* packed) {
+		vec3 inverseScale;
+		for (int k = 0; k < 3; k++) {
+			float s = quantization.scale[k];
+			inverseScale[k] = s > 0.f ? 65535.f / s : 0.f;
+		}
+		packPositions(vertices, count, quantization.offset, inverseScale,
+			packed);
+
+		for (size_t i = 0; i < count; i++) {
+			encodeOctahedral(vertices[i].normal, packed[i].normal);
+		}
+
+#ifdef ENGINE_PACK_F16C
+		if (__builtin_cpu_supports("f16c")) {
+			packTextureCoordinatesF16C(vertices, count, packed);
+			return;
+		}
+#endif
+		packTextureCoordinates(vertices, count, packed);
+	}
+
+	void unpackVertices(const PackedVertex* packed, size_t count,
+		const VertexQuantization& quantization, Vertex* vertices) {
+		for (size_t i = 0; i < count; i++) {
+			const PackedVertex& p = packed[i];
+			vec3 unorm(p.position[0], p.position[1], p.position[2]);
+			vertices[i].position = quantization.offset
+				+ quantization.scale * (unorm / 65535.f);
+			vertices[i].normal = decodeOctahedral(p.normal);
+			vertices[i].textureCoordinate = vec2(
+				halfToFloat(p.textureCoordinate[0]),
+				halfToFloat(p.textureCoordinate[1]));
+		}
+	}
+
+	uint16_t floatToHalf(float f) {
+		uint32_t x;
+		memcpy(&x, &f, sizeof(x));
+		uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+		uint32_t bits = x & 0x7fffffff;
+
+		if (bits >= 0x7f800000) {
+			return sign | 0x7c00 | (bits > 0x7f800000 ? 0x200 : 0);
+		}
+		if (bits >= 0x477ff000) return sign | 0x7c00;
+
+		uint32_t h, rest, halfway;
+		if (bits < 0x38800000) {
+			if (bits < 0x33000000) return sign;
+			uint32_t mantissa = (bits & 0x7fffff) | 0x800000;
+			uint32_t shift = 126 - (bits >> 23);
+			h = mantissa >> shift;
+			rest = mantissa & ((1u << shift) - 1);
+			halfway = 1u << (shift - 1);
+		} else {
+			h = (bits - 0x38000000) >> 13;
+			rest = bits & 0x1fff;
+			halfway = 0x1000;
+		}
+		if (rest > halfway || (rest == halfway && (h & 1))) h++;
+		return sign | (uint16_t)h;
+	}
+
+	float halfToFloat(uint16_t h) {
+		uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+		uint32_t exponent = (h >> 10) & 0x1f;
+		uint32_t mantissa = h & 0x3ff;
+		uint32_t x;
+		if (exponent == 0) {
+			float f = mantissa * (1.f / 16777216.f);
+			return sign ? -f : f;
+		} else if (exponent == 31) {
+			x = sign | 0x7f800000 | (mantissa << 13);
+		} else {
+			x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		}
+		float f;
+		memcpy(&f, &x, sizeof(f));
+		return f;
+	}
+}
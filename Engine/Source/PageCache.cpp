@@ -0,0 +1,79 @@
+#include <Engine/PageCache.h>
+
+using namespace std;
+
+namespace Engine {
+	const uint32_t PageCache::none = UINT32_MAX;
+
+	PageCache::PageCache(uint32_t slotCount) :
+	pages(slotCount, 0),
+	lastUsed(slotCount, 0),
+	previous(slotCount, none),
+	next(slotCount, none),
+	oldest(none),
+	newest(none),
+	frame(1)
+	{
+		for (uint32_t slot = 0; slot < slotCount; slot++) {
+			append(slot);
+		}
+	}
+
+	uint32_t PageCache::find(uint32_t page) const {
+		auto found = slots.find(page);
+		return found == slots.end() ? none : found->second;
+	}
+
+	void PageCache::touch(uint32_t slot) {
+		lastUsed[slot] = frame;
+		if (slot == newest || (previous[slot] == none && slot != oldest)) {
+			/* Already the newest, or pinned */
+			return;
+		}
+		unlink(slot);
+		append(slot);
+	}
+
+	uint32_t PageCache::insert(uint32_t page, uint32_t& evicted) {
+		uint32_t slot = oldest;
+		if (slot == none || lastUsed[slot] == frame) return none;
+
+		evicted = pages[slot];
+		if (evicted != 0) slots.erase(evicted);
+		pages[slot] = page;
+		slots[page] = slot;
+		touch(slot);
+		return slot;
+	}
+
+	void PageCache::pin(uint32_t slot) {
+		if (previous[slot] == none && slot != oldest) return;
+		unlink(slot);
+	}
+
+	void PageCache::unlink(uint32_t slot) {
+		if (previous[slot] != none) {
+			next[previous[slot]] = next[slot];
+		} else {
+			oldest = next[slot];
+		}
+		if (next[slot] != none) {
+			previous[next[slot]] = previous[slot];
+		} else {
+			newest = previous[slot];
+		}
+		previous[slot] = none;
+		next[slot] = none;
+	}
+
+	void PageCache::append(uint32_t slot) {
+		previous[slot] = newest;
+		next[slot] = none;
+		if (newest != none) {
+			next[newest] = slot;
+		} else {
+			oldest = slot;
+		}
+		newest = slot;
+	}
+}
@@ -0,0 +1,143 @@
+#include <Engine/PixelConversion.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ENGINE_PIXELCONVERSION_SSSE3
+#endif
+
+static void rgbToRGBA(const uint8_t* rgb, uint8_t* rgba, size_t pixels) {
+	for (size_t i = 0; i < pixels; i++) {
+		rgba[i*4] = rgb[i*3];
+		rgba[i*4 + 1] = rgb[i*3 + 1];
+		rgba[i*4 + 2] = rgb[i*3 + 2];
+		rgba[i*4 + 3] = 255;
+	}
+}
+
+static void greyToRGBA(const uint8_t* grey, uint8_t* rgba, size_t pixels) {
+	for (size_t i = 0; i < pixels; i++) {
+		rgba[i*4] = rgba[i*4 + 1] = rgba[i*4 + 2] = grey[i];
+		rgba[i*4 + 3] = 255;
+	}
+}
+
+static void greyAlphaToRGBA(const uint8_t* greyAlpha, uint8_t* rgba,
+	size_t pixels) {
+	for (size_t i = 0; i < pixels; i++) {
+		rgba[i*4] = rgba[i*4 + 1] = rgba[i*4 + 2] = greyAlpha[i*2];
+		rgba[i*4 + 3] = greyAlpha[i*2 + 1];
+	}
+}
+
+#ifdef ENGINE_PIXELCONVERSION_SSSE3
+/*
+ * 16 pixels per iteration. The RGB kernel loads the 48 source bytes as
+ * four overlapping vectors so that it never reads past them; the last
+ * vector starts at byte 32 and its shuffle skips the first 4 bytes.
+ */
+__attribute__((target("ssse3")))
+static void rgbToRGBASSSE3(const uint8_t* rgb, uint8_t* rgba,
+	size_t pixels) {
+	const __m128i spread = _mm_setr_epi8(
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i spreadLast = _mm_setr_epi8(
+		4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15, -1);
+	const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+	size_t i = 0;
+	for (; i + 16 <= pixels; i += 16) {
+		const uint8_t* s = rgb + i*3;
+		__m128i* d = (__m128i*)(rgba + i*4);
+		__m128i p0 = _mm_loadu_si128((const __m128i*)s);
+		__m128i p1 = _mm_loadu_si128((const __m128i*)(s + 12));
+		__m128i p2 = _mm_loadu_si128((const __m128i*)(s + 24));
+		__m128i p3 = _mm_loadu_si128((const __m128i*)(s + 32));
+		_mm_storeu_si128(d, _mm_or_si128(_mm_shuffle_epi8(p0, spread), alpha));
+		_mm_storeu_si128(d + 1,
+			_mm_or_si128(_mm_shuffle_epi8(p1, spread), alpha));
+		_mm_storeu_si128(d + 2,
+			_mm_or_si128(_mm_shuffle_epi8(p2, spread), alpha));
+		_mm_storeu_si128(d + 3,
+			_mm_or_si128(_mm_shuffle_epi8(p3, spreadLast), alpha));
+	}
+	rgbToRGBA(rgb + i*3, rgba + i*4, pixels - i);
+}
+
+__attribute__((target("ssse3")))
+static void greyToRGBASSSE3(const uint8_t* grey, uint8_t* rgba,
+	size_t pixels) {
+	const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+	size_t i = 0;
+	for (; i + 16 <= pixels; i += 16) {
+		__m128i* d = (__m128i*)(rgba + i*4);
+		__m128i g = _mm_loadu_si128((const __m128i*)(grey + i));
+		__m128i gg0 = _mm_unpacklo_epi8(g, g);
+		__m128i gg1 = _mm_unpackhi_epi8(g, g);
+		_mm_storeu_si128(d, _mm_or_si128(_mm_unpacklo_epi16(gg0, gg0), alpha));
+		_mm_storeu_si128(d + 1,
+			_mm_or_si128(_mm_unpackhi_epi16(gg0, gg0), alpha));
+		_mm_storeu_si128(d + 2,
+			_mm_or_si128(_mm_unpacklo_epi16(gg1, gg1), alpha));
+		_mm_storeu_si128(d + 3,
+			_mm_or_si128(_mm_unpackhi_epi16(gg1, gg1), alpha));
+	}
+	greyToRGBA(grey + i, rgba + i*4, pixels - i);
+}
+
+__attribute__((target("ssse3")))
+static void greyAlphaToRGBASSSE3(const uint8_t* greyAlpha, uint8_t* rgba,
+	size_t pixels) {
+	const __m128i spread = _mm_setr_epi8(
+		0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7);
+	const __m128i spreadHigh = _mm_setr_epi8(
+		8, 8, 8, 9, 10, 10, 10, 11, 12, 12, 12, 13, 14, 14, 14, 15);
+	size_t i = 0;
+	for (; i + 16 <= pixels; i += 16) {
+		__m128i* d = (__m128i*)(rgba + i*4);
+		__m128i p0 = _mm_loadu_si128((const __m128i*)(greyAlpha + i*2));
+		__m128i p1 = _mm_loadu_si128((const __m128i*)(greyAlpha + i*2 + 16));
+		_mm_storeu_si128(d, _mm_shuffle_epi8(p0, spread));
+		_mm_storeu_si128(d + 1, _mm_shuffle_epi8(p0, spreadHigh));
+		_mm_storeu_si128(d + 2, _mm_shuffle_epi8(p1, spread));
+		_mm_storeu_si128(d + 3, _mm_shuffle_epi8(p1, spreadHigh));
+	}
+	greyAlphaToRGBA(greyAlpha + i*2, rgba + i*4, pixels - i);
+}
+
+static bool haveSSSE3() {
+	static const bool have = __builtin_cpu_supports("ssse3");
+	return have;
+}
+#endif
+
+namespace Engine {
+	void convertRGBToRGBA(const uint8_t* rgb, uint8_t* rgba, size_t pixels) {
+#ifdef ENGINE_PIXELCONVERSION_SSSE3
+		if (haveSSSE3()) {
+			rgbToRGBASSSE3(rgb, rgba, pixels);
+			return;
+		}
+#endif
+		rgbToRGBA(rgb, rgba, pixels);
+	}
+
+	void convertGreyToRGBA(const uint8_t* grey, uint8_t* rgba, size_t pixels) {
+#ifdef ENGINE_PIXELCONVERSION_SSSE3
+		if (haveSSSE3()) {
+			greyToRGBASSSE3(grey, rgba, pixels);
+			return;
+		}
+#endif
+		greyToRGBA(grey, rgba, pixels);
+	}
+
+	void convertGreyAlphaToRGBA(const uint8_t* greyAlpha, uint8_t* rgba,
+		size_t pixels) {
+#ifdef ENGINE_PIXELCONVERSION_SSSE3
+		if (haveSSSE3()) {
+			greyAlphaToRGBASSSE3(greyAlpha, rgba, pixels);
+			return;
+		}
+#endif
+		greyAlphaToRGBA(greyAlpha, rgba, pixels);
+	}
+}
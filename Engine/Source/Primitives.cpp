@@ -0,0 +1,375 @@
+#include <Engine/Primitives.h>
+#include <cmath>
+#include <iterator>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ENGINE_PRIMITIVES_SSE2
+#endif
+
+using namespace std;
+using glm::vec2;
+using glm::vec3;
+using Engine::IndexedMesh;
+using Engine::Vertex;
+
+template <size_t... I>
+struct IndexSequence {};
+
+template <size_t N, size_t... I>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, I...> {};
+
+template <size_t... I>
+struct MakeIndexSequence<0, I...> {
+	typedef IndexSequence<I...> type;
+};
+
+template <typename T, size_t N>
+struct ConstantArray {
+	T values[N];
+};
+
+/*
+ * Array of element(0), element(1), ... evaluated by the compiler
+ */
+template <typename T, T (*element)(size_t), size_t... I>
+static constexpr ConstantArray<T, sizeof...(I)> generateArray(
+	IndexSequence<I...>) {
+	return {{ element(I)... }};
+}
+
+/*
+ * Outward normal of each cube face, then the axes along which the texture
+ * coordinates u and v grow. u x v is the normal, so corners visited in
+ * quadCorners order wind counterclockwise seen from outside.
+ */
+static constexpr float cubeFaces[6][3][3] = {
+	{ { 0.f, 0.f, 1.f }, { 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } },
+	{ { 0.f, 1.f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 0.f, -1.f } },
+	{ { 0.f, 0.f, -1.f }, { -1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } },
+	{ { -1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 1.f, 0.f } },
+	{ { 0.f, -1.f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f } },
+	{ { 1.f, 0.f, 0.f }, { 0.f, 0.f, -1.f }, { 0.f, 1.f, 0.f } }
+};
+
+static constexpr float quadCorners[4][2] = {
+	{ 0.f, 0.f }, { 1.f, 0.f }, { 1.f, 1.f }, { 0.f, 1.f }
+};
+
+static constexpr uint32_t quadCornerIndices[6] = { 0, 1, 2, 2, 3, 0 };
+
+static constexpr float cubeCoordinate(size_t face, size_t corner,
+	size_t axis) {
+	return 0.5f * cubeFaces[face][0][axis]
+		+ (quadCorners[corner][0] - 0.5f) * cubeFaces[face][1][axis]
+		+ (quadCorners[corner][1] - 0.5f) * cubeFaces[face][2][axis];
+}
+
+static constexpr Vertex cubeVertex(size_t i) {
+	return { vec3(cubeCoordinate(i / 4, i % 4, 0),
+			cubeCoordinate(i / 4, i % 4, 1), cubeCoordinate(i / 4, i % 4, 2)),
+		vec3(cubeFaces[i / 4][0][0], cubeFaces[i / 4][0][1],
+			cubeFaces[i / 4][0][2]),
+		vec2(quadCorners[i % 4][0], quadCorners[i % 4][1]) };
+}
+
+static constexpr uint32_t cubeIndex(size_t i) {
+	return (uint32_t)(i / 6 * 4) + quadCornerIndices[i % 6];
+}
+
+static constexpr Vertex quadVertex(size_t i) {
+	return { vec3(quadCorners[i][0] - 0.5f, quadCorners[i][1] - 0.5f, 0.f),
+		vec3(0.f, 0.f, 1.f), vec2(quadCorners[i][0], quadCorners[i][1]) };
+}
+
+static constexpr uint32_t quadIndex(size_t i) {
+	return quadCornerIndices[i];
+}
+
+static constexpr ConstantArray<Vertex, 24> cubeVertices =
+	generateArray<Vertex, cubeVertex>(MakeIndexSequence<24>::type());
+static constexpr ConstantArray<uint32_t, 36> cubeIndices =
+	generateArray<uint32_t, cubeIndex>(MakeIndexSequence<36>::type());
+static constexpr ConstantArray<Vertex, 4> quadVertices =
+	generateArray<Vertex, quadVertex>(MakeIndexSequence<4>::type());
+static constexpr ConstantArray<uint32_t, 6> quadIndices =
+	generateArray<uint32_t, quadIndex>(MakeIndexSequence<6>::type());
+
+static_assert(cubeVertices.values[6].position.y == 0.5f
+	&& cubeVertices.values[23].normal.x == 1.f
+	&& cubeIndices.values[35] == 20, "Cube tables not generated.");
+
+template <size_t V, size_t I>
+static IndexedMesh meshFromTables(const ConstantArray<Vertex, V>& vertices,
+	const ConstantArray<uint32_t, I>& indices) {
+	IndexedMesh mesh;
+	mesh.getVertices().assign(begin(vertices.values), end(vertices.values));
+	mesh.getIndices().assign(begin(indices.values), end(indices.values));
+	return mesh;
+}
+
+/*
+ * Parametric shapes are sized exactly up front and written in place.
+ */
+static IndexedMesh allocateMesh(size_t vertexCount, size_t indexCount) {
+	IndexedMesh mesh;
+	mesh.getVertices().resize(vertexCount);
+	mesh.getIndices().resize(indexCount);
+	return mesh;
+}
+
+/*
+ * Cosines and sines of segments + 1 angles around a circle. The last
+ * angle repeats the first exactly, so seams close.
+ */
+static void circleTable(unsigned segments, vector<float>& cosines,
+	vector<float>& sines) {
+	cosines.resize(segments + 1);
+	sines.resize(segments + 1);
+	float step = 2.f * glm::pi<float>() / segments;
+	for (unsigned s = 0; s < segments; s++) {
+		cosines[s] = cosf(s * step);
+		sines[s] = sinf(s * step);
+	}
+	cosines[segments] = cosines[0];
+	sines[segments] = sines[0];
+}
+
+#ifdef ENGINE_PRIMITIVES_SSE2
+/*
+ * Four vertices from one register per component: two 4x4 transposes turn
+ * them into the eight floats of each vertex.
+ */
+static inline void storeVertices(Vertex* v, __m128 px, __m128 py, __m128 pz,
+	__m128 nx, __m128 ny, __m128 nz, __m128 u, __m128 tv) {
+	_MM_TRANSPOSE4_PS(px, py, pz, nx);
+	_MM_TRANSPOSE4_PS(ny, nz, u, tv);
+	float* out = &v[0].position.x;
+	_mm_storeu_ps(out, px);
+	_mm_storeu_ps(out + 4, ny);
+	_mm_storeu_ps(out + 8, py);
+	_mm_storeu_ps(out + 12, nz);
+	_mm_storeu_ps(out + 16, pz);
+	_mm_storeu_ps(out + 20, u);
+	_mm_storeu_ps(out + 24, nx);
+	_mm_storeu_ps(out + 28, tv);
+}
+
+/*
+ * (first, first + 1, first + 2, first + 3) times step
+ */
+static inline __m128 steps(size_t first, float step) {
+	__m128i i = _mm_add_epi32(_mm_set1_epi32((int)first),
+		_mm_setr_epi32(0, 1, 2, 3));
+	return _mm_mul_ps(_mm_cvtepi32_ps(i), _mm_set1_ps(step));
+}
+#endif
+
+/*
+ * One row of a surface around the y axis: a circle of radius at height y,
+ * with normals made of a radial and a vertical part.
+ */
+static Vertex* writeRing(Vertex* v, const vector<float>& cosines,
+	const vector<float>& sines, float radius, float y, float normalRadial,
+	float normalY, float textureV) {
+	size_t count = cosines.size();
+	float textureStep = 1.f / (count - 1);
+	size_t s = 0;
+#ifdef ENGINE_PRIMITIVES_SSE2
+	__m128 r = _mm_set1_ps(radius);
+	__m128 nr = _mm_set1_ps(normalRadial);
+	for (; s + 4 <= count; s += 4) {
+		__m128 c = _mm_loadu_ps(&cosines[s]);
+		__m128 sn = _mm_loadu_ps(&sines[s]);
+		storeVertices(v + s, _mm_mul_ps(r, c), _mm_set1_ps(y),
+			_mm_mul_ps(r, sn), _mm_mul_ps(nr, c), _mm_set1_ps(normalY),
+			_mm_mul_ps(nr, sn), steps(s, textureStep),
+			_mm_set1_ps(textureV));
+	}
+#endif
+	for (; s < count; s++) {
+		v[s].position = vec3(radius * cosines[s], y, radius * sines[s]);
+		v[s].normal = vec3(normalRadial * cosines[s], normalY,
+			normalRadial * sines[s]);
+		v[s].textureCoordinate = vec2(s * textureStep, textureV);
+	}
+	return v + count;
+}
+
+/*
+ * Two triangles for each quad of a grid of vertices stored row by row,
+ * stride apart, starting at first. Rows must advance so that row
+ * direction x column direction points out of the surface.
+ */
+static uint32_t* writeGridIndices(uint32_t* out, uint32_t first,
+	unsigned columns, unsigned rows, uint32_t stride) {
+#ifdef ENGINE_PRIMITIVES_SSE2
+	/*
+	 * Two quads are twelve indices, three registers of offsets from the
+	 * first corner of the first quad.
+	 */
+	__m128i o0 = _mm_setr_epi32(0, stride, 1, 1);
+	__m128i o1 = _mm_setr_epi32(stride, stride + 1, 1, stride + 1);
+	__m128i o2 = _mm_setr_epi32(2, 2, stride + 1, stride + 2);
+#endif
+	for (unsigned r = 0; r < rows; r++) {
+		unsigned c = 0;
+#ifdef ENGINE_PRIMITIVES_SSE2
+		__m128i a = _mm_set1_epi32((int)(first + r * stride));
+		for (; c + 2 <= columns; c += 2) {
+			_mm_storeu_si128((__m128i*)out, _mm_add_epi32(a, o0));
+			_mm_storeu_si128((__m128i*)(out + 4), _mm_add_epi32(a, o1));
+			_mm_storeu_si128((__m128i*)(out + 8), _mm_add_epi32(a, o2));
+			a = _mm_add_epi32(a, _mm_set1_epi32(2));
+			out += 12;
+		}
+#endif
+		for (; c < columns; c++) {
+			uint32_t a = first + r * stride + c;
+			uint32_t b = a + stride;
+			out[0] = a;
+			out[1] = b;
+			out[2] = a + 1;
+			out[3] = a + 1;
+			out[4] = b;
+			out[5] = b + 1;
+			out += 6;
+		}
+	}
+	return out;
+}
+
+/*
+ * Flat disk closing a cylinder: a center vertex, then a ring. Triangles
+ * wind counterclockwise seen from the side the normal points to.
+ */
+static Vertex* writeCap(Vertex* v, uint32_t*& out, uint32_t first,
+	const vector<float>& cosines, const vector<float>& sines, float y,
+	float normalY) {
+	unsigned segments = (unsigned)cosines.size() - 1;
+	v[0].position = vec3(0.f, y, 0.f);
+	v[0].normal = vec3(0.f, normalY, 0.f);
+	v[0].textureCoordinate = vec2(0.5f);
+	for (unsigned s = 0; s <= segments; s++) {
+		v[s + 1].position = vec3(0.5f * cosines[s], y, 0.5f * sines[s]);
+		v[s + 1].normal = vec3(0.f, normalY, 0.f);
+		v[s + 1].textureCoordinate = vec2(0.5f + 0.5f * cosines[s],
+			0.5f + 0.5f * sines[s]);
+	}
+	for (unsigned s = 0; s < segments; s++) {
+		uint32_t a = first + 1 + s;
+		out[0] = first;
+		out[1] = normalY > 0.f ? a + 1 : a;
+		out[2] = normalY > 0.f ? a : a + 1;
+		out += 3;
+	}
+	return v + segments + 2;
+}
+
+namespace Engine {
+	IndexedMesh generateCube() {
+		return meshFromTables(cubeVertices, cubeIndices);
+	}
+
+	IndexedMesh generateQuad() {
+		return meshFromTables(quadVertices, quadIndices);
+	}
+
+	IndexedMesh generateGrid(unsigned columns, unsigned rows) {
+		uint32_t stride = columns + 1;
+		IndexedMesh mesh = allocateMesh((rows + 1) * stride,
+			rows * columns * 6);
+		Vertex* v = mesh.getVertexData();
+		float columnStep = 1.f / columns;
+		float rowStep = 1.f / rows;
+		for (unsigned r = 0; r <= rows; r++) {
+			unsigned c = 0;
+#ifdef ENGINE_PRIMITIVES_SSE2
+			__m128 zero = _mm_setzero_ps();
+			__m128 tv = _mm_set1_ps(r * rowStep);
+			for (; c + 4 <= columns + 1; c += 4, v += 4) {
+				__m128 u = steps(c, columnStep);
+				storeVertices(v, _mm_sub_ps(u, _mm_set1_ps(0.5f)), zero,
+					_mm_sub_ps(tv, _mm_set1_ps(0.5f)), zero,
+					_mm_set1_ps(1.f), zero, u, tv);
+			}
+#endif
+			for (; c <= columns; c++, v++) {
+				vec2 uv(c * columnStep, r * rowStep);
+				v->position = vec3(uv.x - 0.5f, 0.f, uv.y - 0.5f);
+				v->normal = vec3(0.f, 1.f, 0.f);
+				v->textureCoordinate = uv;
+			}
+		}
+		writeGridIndices(mesh.getIndexData(), 0, columns, rows, stride);
+		return mesh;
+	}
+
+	IndexedMesh generateCylinder(unsigned segments) {
+		uint32_t stride = segments + 1;
+		IndexedMesh mesh = allocateMesh(4 * stride + 2, 12 * segments);
+		vector<float> cosines, sines;
+		circleTable(segments, cosines, sines);
+
+		Vertex* v = mesh.getVertexData();
+		uint32_t* out = mesh.getIndexData();
+		v = writeRing(v, cosines, sines, 0.5f, -0.5f, 1.f, 0.f, 0.f);
+		v = writeRing(v, cosines, sines, 0.5f, 0.5f, 1.f, 0.f, 1.f);
+		out = writeGridIndices(out, 0, segments, 1, stride);
+		v = writeCap(v, out, 2 * stride, cosines, sines, -0.5f, -1.f);
+		writeCap(v, out, 3 * stride + 1, cosines, sines, 0.5f, 1.f);
+		return mesh;
+	}
+
+	IndexedMesh generateTorus(unsigned segments, unsigned tubeSegments,
+		float tubeRadius) {
+		uint32_t stride = segments + 1;
+		IndexedMesh mesh = allocateMesh((tubeSegments + 1) * stride,
+			tubeSegments * segments * 6);
+		vector<float> cosines, sines, tubeCosines, tubeSines;
+		circleTable(segments, cosines, sines);
+		circleTable(tubeSegments, tubeCosines, tubeSines);
+
+		/*
+		 * Rows go around the tube, starting on the outside of the torus
+		 */
+		float ringRadius = 0.5f - tubeRadius;
+		Vertex* v = mesh.getVertexData();
+		for (unsigned t = 0; t <= tubeSegments; t++) {
+			v = writeRing(v, cosines, sines,
+				ringRadius + tubeRadius * tubeCosines[t],
+				tubeRadius * tubeSines[t], tubeCosines[t], tubeSines[t],
+				t / (float)tubeSegments);
+		}
+		writeGridIndices(mesh.getIndexData(), 0, segments, tubeSegments,
+			stride);
+		return mesh;
+	}
+
+	IndexedMesh generateCapsule(unsigned segments, unsigned rings,
+		float radius) {
+		uint32_t stride = segments + 1;
+		unsigned rows = 2 * rings + 2;
+		IndexedMesh mesh = allocateMesh(rows * stride,
+			(rows - 1) * segments * 6);
+		vector<float> cosines, sines;
+		circleTable(segments, cosines, sines);
+
+		/*
+		 * Rows go up from the bottom pole; the two equator rows bound the
+		 * cylinder between the hemispheres.
+		 */
+		float halfCylinder = 0.5f - radius;
+		Vertex* v = mesh.getVertexData();
+		for (unsigned r = 0; r < rows; r++) {
+			bool top = r > rings;
+			float a = glm::half_pi<float>() * ((top ? r - rings - 1.f : r)
+				/ rings - (top ? 0.f : 1.f));
+			float y = (top ? halfCylinder : -halfCylinder) + radius * sinf(a);
+			v = writeRing(v, cosines, sines, radius * cosf(a), y, cosf(a),
+				sinf(a), y + 0.5f);
+		}
+		writeGridIndices(mesh.getIndexData(), 0, segments, rows - 1, stride);
+		return mesh;
+	}
+}
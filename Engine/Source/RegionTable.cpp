@@ -0,0 +1,240 @@
+#include <Engine/RegionTable.h>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std;
+
+static const char tableMagic[4] = { 'E', 'R', 'G', 'N' };
+static const uint32_t tableVersion = 1;
+/* Average names per bucket of the hash and displace table */
+static const uint32_t bucketLoad = 4;
+static const uint32_t maxDisplacement = 1u << 24;
+
+struct RegionTableHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t count;
+	uint32_t bucketCount;
+	uint32_t stringsSize;
+	uint32_t padding;
+};
+
+static uint64_t hashName(const char* name, size_t length) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < length; i++) {
+		hash = (hash ^ (uint8_t)name[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+/*
+ * Mix a name hash with a seed and map it onto [0, modulo).
+ */
+static uint32_t hashSlot(uint64_t hash, uint32_t seed, uint32_t modulo) {
+	uint64_t x = hash + seed * 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	x ^= x >> 31;
+	return (uint32_t)(((x >> 32) * modulo) >> 32);
+}
+
+static size_t tableSize(uint32_t count, uint32_t bucketCount,
+	uint32_t stringsSize, size_t recordSize) {
+	return sizeof(RegionTableHeader) + count * recordSize
+		+ ((size_t)bucketCount + count) * sizeof(uint32_t) + stringsSize;
+}
+
+namespace Engine {
+	struct RegionTable::Record {
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		PixelRect pixelRect;
+		TextureRect rect;
+	};
+
+	const uint32_t RegionTable::none = UINT32_MAX;
+
+	RegionTable::RegionTable() :
+	data(nullptr),
+	size(0),
+	count(0),
+	bucketCount(0),
+	records(nullptr),
+	displacements(nullptr),
+	slots(nullptr),
+	strings(nullptr)
+	{
+	}
+
+	RegionTable::RegionTable(const vector<string>& names,
+		const vector<PixelRect>& pixelRects, const vector<TextureRect>& rects) :
+	RegionTable()
+	{
+		uint32_t n = (uint32_t)names.size();
+		vector<uint32_t> order(n);
+		iota(order.begin(), order.end(), 0u);
+		sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return names[a] < names[b];
+		});
+
+		RegionTableHeader header = {};
+		memcpy(header.magic, tableMagic, sizeof(tableMagic));
+		header.version = tableVersion;
+		header.count = n;
+		header.bucketCount = max(1u, n / bucketLoad);
+		vector<Record> sorted(n);
+		vector<uint64_t> hashes(n);
+		for (uint32_t i = 0; i < n; i++) {
+			const string& name = names[order[i]];
+			sorted[i] = { header.stringsSize, (uint32_t)name.size(),
+				pixelRects[order[i]], rects[order[i]] };
+			header.stringsSize += (uint32_t)name.size();
+			hashes[i] = hashName(name.data(), name.size());
+		}
+
+		/*
+		 * Hash and displace: names are split into buckets, and each bucket,
+		 * largest first, gets the first displacement that sends all its
+		 * names to slots still free.
+		 */
+		vector<vector<uint32_t>> buckets(header.bucketCount);
+		for (uint32_t i = 0; i < n; i++) {
+			buckets[hashSlot(hashes[i], 0, header.bucketCount)].push_back(i);
+		}
+		vector<uint32_t> bucketOrder(header.bucketCount);
+		iota(bucketOrder.begin(), bucketOrder.end(), 0u);
+		stable_sort(bucketOrder.begin(), bucketOrder.end(),
+			[&](uint32_t a, uint32_t b) {
+			return buckets[a].size() > buckets[b].size();
+		});
+
+		vector<uint32_t> bucketDisplacements(header.bucketCount, 0);
+		vector<uint32_t> slotIds(n, none);
+		vector<uint32_t> bucketSlots;
+		for (uint32_t b : bucketOrder) {
+			const vector<uint32_t>& bucket = buckets[b];
+			if (bucket.empty()) break;
+			for (uint32_t d = 1;; d++) {
+				if (d == maxDisplacement) {
+					throw runtime_error("Could not hash atlas region names.");
+				}
+				bucketSlots.clear();
+				for (uint32_t i : bucket) {
+					uint32_t slot = hashSlot(hashes[i], d, n);
+					if (slotIds[slot] != none || std::find(bucketSlots.begin(),
+						bucketSlots.end(), slot) != bucketSlots.end()) {
+						break;
+					}
+					bucketSlots.push_back(slot);
+				}
+				if (bucketSlots.size() < bucket.size()) continue;
+
+				bucketDisplacements[b] = d;
+				for (size_t i = 0; i < bucket.size(); i++) {
+					slotIds[bucketSlots[i]] = bucket[i];
+				}
+				break;
+			}
+		}
+
+		storage.resize(tableSize(n, header.bucketCount, header.stringsSize,
+			sizeof(Record)));
+		uint8_t* out = storage.data();
+		memcpy(out, &header, sizeof(header));
+		out += sizeof(header);
+		memcpy(out, sorted.data(), n * sizeof(Record));
+		out += n * sizeof(Record);
+		memcpy(out, bucketDisplacements.data(),
+			header.bucketCount * sizeof(uint32_t));
+		out += header.bucketCount * sizeof(uint32_t);
+		memcpy(out, slotIds.data(), n * sizeof(uint32_t));
+		out += n * sizeof(uint32_t);
+		for (uint32_t i : order) {
+			memcpy(out, names[i].data(), names[i].size());
+			out += names[i].size();
+		}
+
+		if (!bind(storage.data(), storage.size())) {
+			throw runtime_error("Invalid atlas region table.");
+		}
+	}
+
+	bool RegionTable::assign(const uint8_t* tableData, size_t tableBytes) {
+		storage.clear();
+		storage.shrink_to_fit();
+		return bind(tableData, tableBytes);
+	}
+
+	bool RegionTable::bind(const uint8_t* tableData, size_t tableBytes) {
+		data = nullptr;
+		size = 0;
+		count = 0;
+		bucketCount = 0;
+		RegionTableHeader header;
+		if (tableBytes < sizeof(header) || (uintptr_t)tableData % 4 != 0) {
+			return false;
+		}
+		memcpy(&header, tableData, sizeof(header));
+		if (memcmp(header.magic, tableMagic, sizeof(tableMagic)) != 0
+			|| header.version != tableVersion
+			|| header.bucketCount == 0
+			|| header.count > tableBytes / sizeof(Record)
+			|| header.bucketCount > tableBytes / sizeof(uint32_t)
+			|| tableSize(header.count, header.bucketCount, header.stringsSize,
+				sizeof(Record)) != tableBytes) {
+			return false;
+		}
+
+		const uint8_t* p = tableData + sizeof(header);
+		const Record* tableRecords = (const Record*)p;
+		p += header.count * sizeof(Record);
+		const uint32_t* tableDisplacements = (const uint32_t*)p;
+		p += header.bucketCount * sizeof(uint32_t);
+		const uint32_t* tableSlots = (const uint32_t*)p;
+		p += header.count * sizeof(uint32_t);
+		for (uint32_t i = 0; i < header.count; i++) {
+			const Record& r = tableRecords[i];
+			if (tableSlots[i] >= header.count || r.nameOffset > header.stringsSize
+				|| r.nameLength > header.stringsSize - r.nameOffset) {
+				return false;
+			}
+		}
+
+		data = tableData;
+		size = tableBytes;
+		count = header.count;
+		bucketCount = header.bucketCount;
+		records = tableRecords;
+		displacements = tableDisplacements;
+		slots = tableSlots;
+		strings = (const char*)p;
+		return true;
+	}
+
+	uint32_t RegionTable::find(const char* name, size_t length) const {
+		if (count == 0) return none;
+		uint64_t hash = hashName(name, length);
+		uint32_t d = displacements[hashSlot(hash, 0, bucketCount)];
+		uint32_t id = slots[hashSlot(hash, d, count)];
+		const Record& r = records[id];
+		if (r.nameLength != length
+			|| memcmp(strings + r.nameOffset, name, length) != 0) {
+			return none;
+		}
+		return id;
+	}
+
+	string RegionTable::getName(uint32_t id) const {
+		return string(strings + records[id].nameOffset, records[id].nameLength);
+	}
+
+	const PixelRect& RegionTable::getPixelRect(uint32_t id) const {
+		return records[id].pixelRect;
+	}
+
+	const TextureRect& RegionTable::getRect(uint32_t id) const {
+		return records[id].rect;
+	}
+}
@@ -0,0 +1,41 @@
+#include <Engine/Skeleton.h>
+
+using namespace std;
+
+static glm::mat4 rootInverse(const Engine::Node* root) {
+	return root ? glm::inverse(root->getWorldMatrix()) : glm::mat4();
+}
+
+namespace Engine {
+	void Skeleton::setBindPose() {
+		glm::mat4 toRoot = rootInverse(root);
+		for (size_t i = 0; i < joints.size(); i++) {
+			inverseBindMatrices[i] =
+				glm::inverse(toRoot * joints[i]->getWorldMatrix());
+		}
+	}
+
+	void Skeleton::computeJointMatrices(vector<glm::mat4>& matrices) const {
+		glm::mat4 toRoot = rootInverse(root);
+		matrices.resize(joints.size());
+		for (size_t i = 0; i < joints.size(); i++) {
+			matrices[i] = toRoot * joints[i]->getWorldMatrix()
+				* inverseBindMatrices[i];
+		}
+	}
+
+	void Skeleton::computeJointDualQuaternions(
+		vector<glm::fdualquat>& dualQuaternions) const {
+		glm::mat4 toRoot = rootInverse(root);
+		dualQuaternions.resize(joints.size());
+		for (size_t i = 0; i < joints.size(); i++) {
+			glm::mat4 m = toRoot * joints[i]->getWorldMatrix()
+				* inverseBindMatrices[i];
+			glm::mat3 rotation(glm::normalize(glm::vec3(m[0])),
+				glm::normalize(glm::vec3(m[1])),
+				glm::normalize(glm::vec3(m[2])));
+			dualQuaternions[i] = glm::fdualquat(glm::quat_cast(rotation),
+				glm::vec3(m[3]));
+		}
+	}
+}
@@ -0,0 +1,225 @@
+#include <Engine/Skinning.h>
+#include <Engine/Parallel.h>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ENGINE_SKINNING_AVX2
+#endif
+
+using namespace std;
+using glm::vec3;
+using glm::vec4;
+using Engine::SkinningJob;
+using Engine::SkinWeights;
+
+static bool simdEnabled = true;
+
+static void skinLinearBlend(const SkinningJob& job) {
+	for (size_t i = 0; i < job.vertexCount; i++) {
+		const SkinWeights& s = job.weights[i];
+		glm::mat4 m = job.jointMatrices[s.joints[0]] * s.weights[0];
+		for (int k = 1; k < 4; k++) {
+			m += job.jointMatrices[s.joints[k]] * s.weights[k];
+		}
+		const Engine::Vertex& v = job.bindPose[i];
+		Engine::Vertex& out = job.skinned[i];
+		out.position = vec3(m * vec4(v.position, 1.f));
+		out.normal = glm::mat3(m) * v.normal;
+		out.textureCoordinate = v.textureCoordinate;
+	}
+}
+
+static void skinDualQuaternion(const SkinningJob& job) {
+	for (size_t i = 0; i < job.vertexCount; i++) {
+		const SkinWeights& s = job.weights[i];
+		const glm::fdualquat& first = job.jointDualQuaternions[s.joints[0]];
+		glm::fdualquat b = first * s.weights[0];
+		for (int k = 1; k < 4; k++) {
+			const glm::fdualquat& q = job.jointDualQuaternions[s.joints[k]];
+			float w = glm::dot(first.real, q.real) < 0.f ? -s.weights[k]
+				: s.weights[k];
+			b = b + q * w;
+		}
+		float inverse = 1.f / glm::length(b.real);
+		vec3 r = vec3(b.real.x, b.real.y, b.real.z) * inverse;
+		vec3 d = vec3(b.dual.x, b.dual.y, b.dual.z) * inverse;
+		float rw = b.real.w * inverse;
+		float dw = b.dual.w * inverse;
+
+		const Engine::Vertex& v = job.bindPose[i];
+		Engine::Vertex& out = job.skinned[i];
+		vec3 t = 2.f * (rw * d - dw * r + glm::cross(r, d));
+		out.position = v.position + 2.f * glm::cross(r,
+			glm::cross(r, v.position) + rw * v.position) + t;
+		out.normal = v.normal + 2.f * glm::cross(r,
+			glm::cross(r, v.normal) + rw * v.normal);
+		out.textureCoordinate = v.textureCoordinate;
+	}
+}
+
+#ifdef ENGINE_SKINNING_AVX2
+/*
+ * A Vertex is eight floats, so each vertex is one register: position and
+ * normal.x in the low half, normal.yz and the texture coordinate in the
+ * high half. Both kernels work on [position, 0 | normal, 0] and write the
+ * result back in the vertex layout.
+ */
+__attribute__((target("avx2,fma")))
+static inline __m256 positionAndNormal(__m256 v) {
+	__m256 pn = _mm256_permutevar8x32_ps(v,
+		_mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0));
+	return _mm256_blend_ps(pn, _mm256_setzero_ps(), 0x88);
+}
+
+__attribute__((target("avx2,fma")))
+static inline void storeVertex(Engine::Vertex* out, __m256 pn, __m256 v) {
+	__m256 packed = _mm256_permutevar8x32_ps(pn,
+		_mm256_setr_epi32(0, 1, 2, 4, 5, 6, 6, 7));
+	_mm256_storeu_ps(&out->position.x, _mm256_blend_ps(packed, v, 0xc0));
+}
+
+/*
+ * Cross product of the xyz parts of each half
+ */
+__attribute__((target("avx2,fma")))
+static inline __m256 cross(__m256 a, __m256 b) {
+	const int yzx = _MM_SHUFFLE(3, 0, 2, 1);
+	__m256 c = _mm256_fmsub_ps(a, _mm256_permute_ps(b, yzx),
+		_mm256_mul_ps(_mm256_permute_ps(a, yzx), b));
+	return _mm256_permute_ps(c, yzx);
+}
+
+__attribute__((target("avx2,fma")))
+static void skinLinearBlendAVX2(const SkinningJob& job) {
+	const float* joints = &job.jointMatrices[0][0].x;
+	const __m256i xIndex = _mm256_setr_epi32(0, 0, 0, 0, 3, 3, 3, 3);
+	const __m256i yIndex = _mm256_setr_epi32(1, 1, 1, 1, 4, 4, 4, 4);
+	const __m256i zIndex = _mm256_setr_epi32(2, 2, 2, 2, 5, 5, 5, 5);
+	for (size_t i = 0; i < job.vertexCount; i++) {
+		const SkinWeights& s = job.weights[i];
+
+		/*
+		 * Blend the columns of the joint matrices: c0 and c1 in m01, c2
+		 * and c3 in m23.
+		 */
+		__m256 m01 = _mm256_setzero_ps();
+		__m256 m23 = _mm256_setzero_ps();
+		for (int k = 0; k < 4; k++) {
+			const float* m = joints + s.joints[k] * 16;
+			__m256 w = _mm256_set1_ps(s.weights[k]);
+			m01 = _mm256_fmadd_ps(w, _mm256_loadu_ps(m), m01);
+			m23 = _mm256_fmadd_ps(w, _mm256_loadu_ps(m + 8), m23);
+		}
+
+		/*
+		 * [position, 1 | normal, 0] = c0 * x + c1 * y + c2 * z + [c3 | 0]
+		 */
+		__m256 v = _mm256_loadu_ps(&job.bindPose[i].position.x);
+		__m256 pn = _mm256_permute2f128_ps(m23, m23, 0x81);
+		pn = _mm256_fmadd_ps(_mm256_permute2f128_ps(m23, m23, 0x00),
+			_mm256_permutevar8x32_ps(v, zIndex), pn);
+		pn = _mm256_fmadd_ps(_mm256_permute2f128_ps(m01, m01, 0x11),
+			_mm256_permutevar8x32_ps(v, yIndex), pn);
+		pn = _mm256_fmadd_ps(_mm256_permute2f128_ps(m01, m01, 0x00),
+			_mm256_permutevar8x32_ps(v, xIndex), pn);
+		storeVertex(job.skinned + i, pn, v);
+	}
+}
+
+__attribute__((target("avx2,fma")))
+static void skinDualQuaternionAVX2(const SkinningJob& job) {
+	const float* joints = &job.jointDualQuaternions[0].real.x;
+	const __m256 two = _mm256_set1_ps(2.f);
+	const __m128 signMask = _mm_set1_ps(-0.f);
+	for (size_t i = 0; i < job.vertexCount; i++) {
+		const SkinWeights& s = job.weights[i];
+
+		/*
+		 * Blend [real | dual] with the weights of joints whose rotation
+		 * points away from the first joint's negated, so the blend takes
+		 * the short way. The sign is applied without a branch, as it
+		 * flips unpredictably between neighbouring vertices.
+		 */
+		const float* first = joints + s.joints[0] * 8;
+		__m128 firstReal = _mm_loadu_ps(first);
+		__m256 b = _mm256_mul_ps(_mm256_set1_ps(s.weights[0]),
+			_mm256_loadu_ps(first));
+		for (int k = 1; k < 4; k++) {
+			const float* q = joints + s.joints[k] * 8;
+			__m128 sign = _mm_and_ps(signMask,
+				_mm_dp_ps(firstReal, _mm_loadu_ps(q), 0xff));
+			__m128 w = _mm_xor_ps(_mm_set1_ps(s.weights[k]), sign);
+			b = _mm256_fmadd_ps(_mm256_set_m128(w, w), _mm256_loadu_ps(q), b);
+		}
+		__m128 real = _mm256_castps256_ps128(b);
+		float length2 = _mm_cvtss_f32(_mm_dp_ps(real, real, 0xf1));
+		b = _mm256_mul_ps(b, _mm256_set1_ps(1.f / sqrtf(length2)));
+
+		__m256 r = _mm256_permute2f128_ps(b, b, 0x00);
+		__m256 d = _mm256_permute2f128_ps(b, b, 0x11);
+		__m256 rw = _mm256_permute_ps(r, 0xff);
+		__m256 dw = _mm256_permute_ps(d, 0xff);
+
+		/*
+		 * Translation 2 * (rw * d - dw * r + r x d), for the position only
+		 */
+		__m256 t = _mm256_fmsub_ps(rw, d, _mm256_mul_ps(dw, r));
+		t = _mm256_mul_ps(two, _mm256_add_ps(t, cross(r, d)));
+		t = _mm256_permute2f128_ps(t, t, 0x80);
+
+		/*
+		 * Rotation v + 2 * r x (r x v + rw * v) of position and normal
+		 */
+		__m256 v = _mm256_loadu_ps(&job.bindPose[i].position.x);
+		__m256 pn = positionAndNormal(v);
+		__m256 c = _mm256_fmadd_ps(rw, pn, cross(r, pn));
+		pn = _mm256_add_ps(_mm256_fmadd_ps(two, cross(r, c), pn), t);
+		storeVertex(job.skinned + i, pn, v);
+	}
+}
+
+static bool haveAVX2() {
+	static const bool have = __builtin_cpu_supports("avx2")
+		&& __builtin_cpu_supports("fma");
+	return have;
+}
+#endif
+
+namespace Engine {
+	void skinVertices(const SkinningJob& job, SkinningMethod method) {
+#ifdef ENGINE_SKINNING_AVX2
+		if (simdEnabled && haveAVX2()) {
+			if (method == SkinningMethod::LinearBlend) {
+				skinLinearBlendAVX2(job);
+			} else {
+				skinDualQuaternionAVX2(job);
+			}
+			return;
+		}
+#endif
+		if (method == SkinningMethod::LinearBlend) {
+			skinLinearBlend(job);
+		} else {
+			skinDualQuaternion(job);
+		}
+	}
+
+	void skinVertices(const SkinningJob* jobs, size_t jobCount,
+		SkinningMethod method) {
+		parallelFor(jobCount, 1, [&](size_t begin, size_t end) {
+			for (size_t j = begin; j < end; j++) {
+				skinVertices(jobs[j], method);
+			}
+		});
+	}
+
+	bool setSkinningSimd(bool enabled) {
+		simdEnabled = enabled;
+#ifdef ENGINE_SKINNING_AVX2
+		return enabled && haveAVX2();
+#else
+		return false;
+#endif
+	}
+}
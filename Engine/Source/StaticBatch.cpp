@@ -0,0 +1,345 @@
+#include <Engine/StaticBatch.h>
+#include <Engine/CacheFile.h>
+#include <Engine/MeshSimplification.h>
+#include <Engine/Meshlets.h>
+#include <Engine/Parallel.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+using namespace std;
+using glm::vec3;
+using glm::vec4;
+using Engine::IndexedMesh;
+using Engine::Mesh;
+using Engine::Vertex;
+using Engine::VertexFormat;
+using Engine::parallelFor;
+using Engine::readArray;
+using Engine::writeArray;
+
+static const char cacheMagic[4] = { 'E', 'S', 'T', 'B' };
+static const uint32_t cacheVersion = 1;
+
+struct StaticBatchCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t vertexSize;
+	uint32_t meshCount;
+	uint64_t key;
+};
+
+struct StaticBatchCacheMesh {
+	uint32_t material;
+	uint32_t vertexFormat;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t lodCount;
+	uint32_t meshletCount;
+};
+
+/*
+ * Triangles of one source entity: a range of its index buffer, or of its
+ * vertices when the mesh is not indexed.
+ */
+struct BatchSource {
+	const Mesh* mesh;
+	const uint32_t* indices;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t material;
+	unsigned lodLevels;
+	bool meshlets;
+	glm::mat4 transform;
+
+	uint32_t index(uint32_t i) const {
+		return indices ? indices[firstIndex + i] : firstIndex + i;
+	}
+};
+
+/*
+ * FNV-1a over 64 bit words, with a shift so high bits reach the low ones.
+ * Only used to notice that the scene of a cache changed.
+ */
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+	const uint8_t* bytes = (const uint8_t*)data;
+	const uint64_t prime = 0x100000001b3ull;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 29;
+	}
+	for (; i < size; i++) {
+		hash = (hash ^ bytes[i]) * prime;
+	}
+	return hash;
+}
+
+template <typename T>
+static uint64_t hashValue(uint64_t hash, const T& value) {
+	return hashBytes(hash, &value, sizeof(T));
+}
+
+static uint64_t hashSource(uint64_t hash, const BatchSource& s) {
+	hash = hashValue(hash, s.material);
+	hash = hashValue(hash, s.transform);
+	hash = hashValue(hash, (uint32_t)s.mesh->getVertexFormat());
+	hash = hashValue(hash, s.indexCount);
+	hash = hashValue(hash, s.lodLevels);
+	hash = hashValue(hash, s.meshlets);
+	hash = hashBytes(hash, s.mesh->getVertexData(),
+		s.mesh->getVertexDataSize());
+	if (s.indices) {
+		hash = hashBytes(hash, s.indices + s.firstIndex,
+			s.indexCount * sizeof(uint32_t));
+	}
+	return hash;
+}
+
+/*
+ * Transform every source into world space, split its triangles into
+ * cells by centroid and append each cell to the mesh of its material,
+ * vertex format and cell. Cells are centered on the origin, so small
+ * objects near it are not split in four.
+ */
+static void mergeSources(const vector<BatchSource>& sources, float cellSize,
+	deque<IndexedMesh>& meshes, vector<uint32_t>& meshMaterials) {
+	map<tuple<uint32_t, uint32_t, int32_t, int32_t>, size_t> cells;
+	vector<unsigned> lodLevels;
+	vector<char> meshlets;
+	vector<Vertex> world;
+	vector<pair<uint64_t, uint32_t>> triangles;
+	vector<uint32_t> remap, stamp;
+	for (const BatchSource& s : sources) {
+		const vector<Vertex>& vertices = s.mesh->getVertices();
+		glm::mat3 normalMatrix =
+			glm::transpose(glm::inverse(glm::mat3(s.transform)));
+		world.resize(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++) {
+			const Vertex& v = vertices[i];
+			vec3 normal = normalMatrix * v.normal;
+			float length = glm::length(normal);
+			world[i].position = vec3(s.transform * vec4(v.position, 1.f));
+			world[i].normal = length > 0.f ? normal / length : normal;
+			world[i].textureCoordinate = v.textureCoordinate;
+		}
+
+		uint32_t triangleCount = s.indexCount / 3;
+		triangles.resize(triangleCount);
+		for (uint32_t t = 0; t < triangleCount; t++) {
+			vec3 centroid = (world[s.index(3*t)].position
+				+ world[s.index(3*t + 1)].position
+				+ world[s.index(3*t + 2)].position) / 3.f;
+			int32_t x = (int32_t)floorf(centroid.x / cellSize + 0.5f);
+			int32_t z = (int32_t)floorf(centroid.z / cellSize + 0.5f);
+			triangles[t] = make_pair(((uint64_t)(uint32_t)x << 32)
+				| (uint32_t)z, t);
+		}
+		sort(triangles.begin(), triangles.end());
+
+		/*
+		 * Vertices are copied once per cell they are used in; stamp marks
+		 * the cells (by first triangle) a vertex has been copied to.
+		 */
+		remap.resize(vertices.size());
+		stamp.assign(vertices.size(), ~0u);
+		uint32_t format = (uint32_t)s.mesh->getVertexFormat();
+		for (uint32_t begin = 0; begin < triangleCount;) {
+			uint64_t cell = triangles[begin].first;
+			auto inserted = cells.insert(make_pair(make_tuple(s.material,
+				format, (int32_t)(cell >> 32), (int32_t)(uint32_t)cell),
+				meshes.size()));
+			if (inserted.second) {
+				meshes.emplace_back();
+				meshes.back().setVertexFormat(s.mesh->getVertexFormat());
+				meshMaterials.push_back(s.material);
+				lodLevels.push_back(0);
+				meshlets.push_back(false);
+			}
+			size_t m = inserted.first->second;
+			IndexedMesh& mesh = meshes[m];
+			lodLevels[m] = max(lodLevels[m], s.lodLevels);
+			meshlets[m] = meshlets[m] || s.meshlets;
+
+			uint32_t end = begin;
+			for (; end < triangleCount && triangles[end].first == cell; end++) {
+				uint32_t t = triangles[end].second;
+				for (uint32_t k = 0; k < 3; k++) {
+					uint32_t v = s.index(3*t + k);
+					if (stamp[v] != begin) {
+						stamp[v] = begin;
+						remap[v] = mesh.addVertex(world[v]);
+					}
+					mesh.addIndex(remap[v]);
+				}
+			}
+			begin = end;
+		}
+	}
+
+	parallelFor(meshes.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t m = begin; m < end; m++) {
+			if (lodLevels[m] > 0) generateLods(meshes[m], lodLevels[m]);
+			if (meshlets[m]) buildMeshlets(meshes[m]);
+		}
+	});
+}
+
+static bool readBatchCache(const string& path, uint64_t key,
+	size_t materialCount, deque<IndexedMesh>& meshes,
+	vector<uint32_t>& meshMaterials) {
+	ifstream in(path, ios::binary);
+	if (!in.is_open()) return false;
+
+	StaticBatchCacheHeader header;
+	in.read((char*)&header, sizeof(header));
+	if (!in || memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0
+		|| header.version != cacheVersion
+		|| header.vertexSize != sizeof(Vertex) || header.key != key) {
+		return false;
+	}
+
+	deque<IndexedMesh> cached;
+	vector<uint32_t> cachedMaterials;
+	for (uint32_t i = 0; i < header.meshCount; i++) {
+		StaticBatchCacheMesh record;
+		in.read((char*)&record, sizeof(record));
+		if (!in || record.material >= materialCount
+			|| record.vertexFormat > (uint32_t)VertexFormat::SplitPosition) {
+			return false;
+		}
+		cached.emplace_back();
+		IndexedMesh& mesh = cached.back();
+		mesh.setVertexFormat((VertexFormat)record.vertexFormat);
+		if (!readArray(in, mesh.getVertices(), record.vertexCount)
+			|| !readArray(in, mesh.getIndices(), record.indexCount)
+			|| !readArray(in, mesh.getLods(), record.lodCount)
+			|| !readArray(in, mesh.getMeshlets(), record.meshletCount)
+			|| !Engine::validMeshRanges(mesh)) {
+			return false;
+		}
+		cachedMaterials.push_back(record.material);
+	}
+
+	meshes = std::move(cached);
+	meshMaterials = std::move(cachedMaterials);
+	return true;
+}
+
+static void writeBatchCache(const string& path, uint64_t key,
+	const deque<IndexedMesh>& meshes, const vector<uint32_t>& meshMaterials) {
+	string tempPath = Engine::temporaryCachePath(path);
+	ofstream out(tempPath, ios::binary | ios::trunc);
+	if (!out.is_open()) return;
+
+	StaticBatchCacheHeader header = {};
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.vertexSize = sizeof(Vertex);
+	header.meshCount = (uint32_t)meshes.size();
+	header.key = key;
+	out.write((const char*)&header, sizeof(header));
+	for (size_t i = 0; i < meshes.size(); i++) {
+		const IndexedMesh& mesh = meshes[i];
+		StaticBatchCacheMesh record = {};
+		record.material = meshMaterials[i];
+		record.vertexFormat = (uint32_t)mesh.getVertexFormat();
+		record.vertexCount = (uint32_t)mesh.getVertices().size();
+		record.indexCount = (uint32_t)mesh.getIndices().size();
+		record.lodCount = (uint32_t)mesh.getLods().size();
+		record.meshletCount = (uint32_t)mesh.getMeshlets().size();
+		out.write((const char*)&record, sizeof(record));
+		writeArray(out, mesh.getVertices());
+		writeArray(out, mesh.getIndices());
+		writeArray(out, mesh.getLods());
+		writeArray(out, mesh.getMeshlets());
+	}
+	out.close();
+	if (!out) {
+		remove(tempPath.c_str());
+		return;
+	}
+	Engine::replaceCacheFile(tempPath, path);
+}
+
+namespace Engine {
+	void StaticBatch::build(const vector<Entity*>& sources, float cellSize,
+		const string& cachePath) {
+		if (!(cellSize > 0.f)) {
+			throw runtime_error("Static batch cells must have a size.");
+		}
+		meshes.clear();
+		geometries.clear();
+		entities.clear();
+		entityPointers.clear();
+
+		vector<Material*> materials;
+		vector<BatchSource> batchSources;
+		batchSources.reserve(sources.size());
+		uint64_t key = hashValue(0xcbf29ce484222325ull, cellSize);
+		for (Entity* e : sources) {
+			if (e->getSkeleton()) {
+				throw runtime_error("Skinned entities can not be batched.");
+			}
+			Geometry* geometry = e->getGeometry();
+			const Mesh* mesh = geometry->getMesh();
+			if (mesh->getTopology() != Mesh::Topology::Triangles) {
+				throw runtime_error("Only triangle lists can be batched.");
+			}
+
+			BatchSource s;
+			s.mesh = mesh;
+			s.indices = nullptr;
+			s.firstIndex = 0;
+			s.indexCount = (uint32_t)mesh->getElementCount();
+			s.lodLevels = 0;
+			s.meshlets = false;
+			s.transform = e->getNode()->getWorldMatrix() * e->getScaleMatrix();
+			const IndexedMesh* indexed = dynamic_cast<const IndexedMesh*>(mesh);
+			if (indexed) {
+				s.indices = indexed->getIndexData();
+				int submesh = geometry->getSubmesh();
+				if (submesh >= 0 && submesh < (int)indexed->getSubmeshes().size()) {
+					s.firstIndex = indexed->getSubmeshes()[submesh].firstIndex;
+					s.indexCount = indexed->getSubmeshes()[submesh].indexCount;
+				} else {
+					size_t lodCount = indexed->getLods().size();
+					s.lodLevels = lodCount > 1 ? (unsigned)(lodCount - 1) : 0;
+					s.meshlets = !indexed->getMeshlets().empty();
+				}
+			}
+
+			auto found = find(materials.begin(), materials.end(),
+				geometry->getMaterial());
+			s.material = (uint32_t)(found - materials.begin());
+			if (found == materials.end()) {
+				materials.push_back(geometry->getMaterial());
+			}
+			key = hashSource(key, s);
+			batchSources.push_back(s);
+		}
+
+		vector<uint32_t> meshMaterials;
+		if (cachePath.empty() || !readBatchCache(cachePath, key,
+			materials.size(), meshes, meshMaterials)) {
+			mergeSources(batchSources, cellSize, meshes, meshMaterials);
+			if (!cachePath.empty()) {
+				writeBatchCache(cachePath, key, meshes, meshMaterials);
+			}
+		}
+
+		node.update();
+		for (size_t i = 0; i < meshes.size(); i++) {
+			geometries.emplace_back(&meshes[i], materials[meshMaterials[i]]);
+			entities.emplace_back(&node, &geometries.back());
+			entityPointers.push_back(&entities.back());
+		}
+	}
+}
@@ -1,47 +1,344 @@
 #include <Engine/Texture.h>
+#include <Engine/TextureCache.h>
+#include <Engine/TextureCompression.h>
+#include <Engine/PixelConversion.h>
+#include <Engine/Parallel.h>
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define ENGINE_TEXTURE_SSE2
+#endif
+
 using namespace std;
+using Engine::PixelRect;
+using Engine::TextureLevel;
+using Engine::parallelFor;
+
+/*
+ * Rounded average of the 2x2 block of src under the dst pixel (x, y),
+ * reading only pixels inside bounds, which repeat at its edges.
+ */
+static void filterPixel(uint8_t* data, const TextureLevel& src,
+	const TextureLevel& dst, size_t bpp, uint32_t x, uint32_t y,
+	const PixelRect& bounds) {
+	uint32_t lastX = bounds.x + bounds.width - 1;
+	uint32_t lastY = bounds.y + bounds.height - 1;
+	size_t x0 = min(max(x * 2, bounds.x), lastX) * bpp;
+	size_t x1 = min(max(x * 2 + 1, bounds.x), lastX) * bpp;
+	const uint8_t* row0 = data + src.offset
+		+ (size_t)min(max(y * 2, bounds.y), lastY) * src.rowPitch;
+	const uint8_t* row1 = data + src.offset
+		+ (size_t)min(max(y * 2 + 1, bounds.y), lastY) * src.rowPitch;
+	uint8_t* out = data + dst.offset + (size_t)y * dst.rowPitch + x * bpp;
+	for (size_t c = 0; c < bpp; c++) {
+		out[c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c]
+			+ row1[x1 + c] + 2) / 4);
+	}
+}
+
+#ifdef ENGINE_TEXTURE_SSE2
+/*
+ * Two RGBA pixels from four on each of two rows, as 16 bit channels.
+ */
+static inline __m128i average2x2(__m128i top, __m128i bottom) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero),
+		_mm_unpacklo_epi8(bottom, zero));
+	__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero),
+		_mm_unpackhi_epi8(bottom, zero));
+	low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+	high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+	__m128i sum = _mm_unpacklo_epi64(low, high);
+	return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+#endif
+
+static void filterRows(uint8_t* data, const TextureLevel& src,
+	const TextureLevel& dst, size_t bpp, uint32_t begin, uint32_t end) {
+	const PixelRect whole = { 0, 0, src.width, src.height };
+	for (uint32_t y = begin; y < end; y++) {
+		uint32_t x = 0;
+#ifdef ENGINE_TEXTURE_SSE2
+		/* Whole 2x2 blocks of RGBA, four output pixels at a time. */
+		if (bpp == 4 && y * 2 + 1 < src.height) {
+			const uint8_t* row0 = data + src.offset
+				+ (size_t)y * 2 * src.rowPitch;
+			const uint8_t* row1 = row0 + src.rowPitch;
+			uint8_t* out = data + dst.offset + (size_t)y * dst.rowPitch;
+			for (; x + 4 <= dst.width && x * 2 + 8 <= src.width; x += 4) {
+				const __m128i* a = (const __m128i*)(row0 + x * 8);
+				const __m128i* b = (const __m128i*)(row1 + x * 8);
+				__m128i first = average2x2(_mm_loadu_si128(a),
+					_mm_loadu_si128(b));
+				__m128i second = average2x2(_mm_loadu_si128(a + 1),
+					_mm_loadu_si128(b + 1));
+				_mm_storeu_si128((__m128i*)(out + x * 4),
+					_mm_packus_epi16(first, second));
+			}
+		}
+#endif
+		for (; x < dst.width; x++) {
+			filterPixel(data, src, dst, bpp, x, y, whole);
+		}
+	}
+}
+
+/*
+ * Copy the edge pixels of every region outward, one ring of pixels at a
+ * time, into pixels no region covers. Nearer rings, then earlier regions,
+ * claim a pixel first.
+ */
+static void extrudeRegions(uint8_t* data, const TextureLevel& level,
+	size_t bpp, const vector<PixelRect>& regions, uint32_t gutter) {
+	vector<uint8_t> covered((size_t)level.width * level.height, 0);
+	for (const PixelRect& r : regions) {
+		for (uint32_t y = r.y; y < r.y + r.height; y++) {
+			memset(&covered[(size_t)y * level.width + r.x], 1, r.width);
+		}
+	}
+
+	auto extrude = [&](const PixelRect& r, int64_t x, int64_t y) {
+		if (x < 0 || y < 0 || x >= level.width || y >= level.height) return;
+		uint8_t& claimed = covered[(size_t)y * level.width + (size_t)x];
+		if (claimed) return;
+		claimed = 1;
+		int64_t fromX = min(max(x, (int64_t)r.x),
+			(int64_t)(r.x + r.width - 1));
+		int64_t fromY = min(max(y, (int64_t)r.y),
+			(int64_t)(r.y + r.height - 1));
+		memcpy(data + (size_t)y * level.rowPitch + (size_t)x * bpp,
+			data + (size_t)fromY * level.rowPitch + (size_t)fromX * bpp, bpp);
+	};
+	for (int64_t g = 1; g <= gutter; g++) {
+		for (const PixelRect& r : regions) {
+			int64_t left = (int64_t)r.x - g;
+			int64_t right = (int64_t)r.x + r.width - 1 + g;
+			int64_t top = (int64_t)r.y - g;
+			int64_t bottom = (int64_t)r.y + r.height - 1 + g;
+			for (int64_t x = left; x <= right; x++) {
+				extrude(r, x, top);
+				extrude(r, x, bottom);
+			}
+			for (int64_t y = top + 1; y < bottom; y++) {
+				extrude(r, left, y);
+				extrude(r, right, y);
+			}
+		}
+	}
+}
 
 namespace Engine {
-	Texture::Texture(const std::string& file) :
+	const size_t Texture::levelAlignment = 256;
+
+	TextureLoadFlags operator|(TextureLoadFlags a, TextureLoadFlags b) {
+		return static_cast<TextureLoadFlags>(static_cast<int>(a) | static_cast<int>(b));
+	}
+
+	TextureLoadFlags operator&(TextureLoadFlags a, TextureLoadFlags b) {
+		return static_cast<TextureLoadFlags>(static_cast<int>(a) & static_cast<int>(b));
+	}
+
+	static void pixelDeleter(void* data) {
+		delete[] (uint8_t*)data;
+	}
+
+	Texture::Texture(const std::string& file, TextureLoadFlags flags,
+		const vector<PixelRect>& regions) :
+	pixelData(nullptr),
 	deleter(stbi_image_free)
 	{
+		bool useCache = (flags & TextureLoadFlags::BinaryCache)
+			!= TextureLoadFlags::None;
+		if (useCache && readTextureCache(file, flags, regions, *this)) return;
+
+		TextureLoadFlags compression = flags
+			& (TextureLoadFlags::CompressFast | TextureLoadFlags::CompressQuality);
+		bool forceRGBA = (flags & TextureLoadFlags::ForceRGBA)
+			!= TextureLoadFlags::None || compression != TextureLoadFlags::None;
 		int w, h, n;
 		pixelData = stbi_load(file.c_str(), &w, &h, &n, 0);
-		if (pixelData != nullptr && n == 3) {
-			stbi_image_free(pixelData);
-			pixelData = stbi_load(file.c_str(), &w, &h, &n, STBI_rgb_alpha);
-			n = 4;
-		}
 		if (pixelData == nullptr) {
 			throw runtime_error("Failed to load image \"" + file + "\".");
 		}
-		width = w;
-		height = h;
+		if (n == 3 || (forceRGBA && n != 4)) {
+			size_t pixels = (size_t)w * h;
+			uint8_t* rgba = new uint8_t[pixels * 4];
+			switch (n) {
+			case 1: convertGreyToRGBA(pixelData, rgba, pixels); break;
+			case 2: convertGreyAlphaToRGBA(pixelData, rgba, pixels); break;
+			case 3: convertRGBToRGBA(pixelData, rgba, pixels); break;
+			}
+			stbi_image_free(pixelData);
+			pixelData = rgba;
+			deleter = pixelDeleter;
+			n = 4;
+		}
 		format = static_cast<Format>(n);
+		levels.push_back({ (uint32_t)w, (uint32_t)h, (uint32_t)(w * n), 0 });
+
+		if ((flags & TextureLoadFlags::Mipmaps) != TextureLoadFlags::None) {
+			generateMipmaps(regions);
+		}
+		compress(flags);
+		if (useCache) {
+			writeTextureCache(file, flags, regions, *this);
+		}
 	}
-	
-	static void pixelDeleter(void* data) {
-		delete[] (uint8_t*)data;
-	}
-	
+
 	Texture::Texture(Format format, uint32_t w, uint32_t h) :
 	format(format),
-	width(w),
-	height(h),
 	deleter(pixelDeleter)
 	{
-		uint32_t size = w * h * static_cast<int>(format);
+		uint32_t rowPitch = w * static_cast<int>(format);
+		uint32_t size = rowPitch * h;
 		if (size == 0) {
 			throw runtime_error("Can't allocate 0 memory for image.");
 		}
+		levels.push_back({ w, h, rowPitch, 0 });
 		pixelData = new uint8_t[size];
 	}
-	
+
 	Texture::~Texture() {
 		deleter(pixelData);
 	}
+
+	const uint32_t Texture::gutterSize = 8;
+
+	uint32_t Texture::formatSize(Format format) {
+		switch (format) {
+		case Format::BC1: return 8;
+		case Format::BC3: return 16;
+		case Format::BC7: return 16;
+		default: return static_cast<uint32_t>(format);
+		}
+	}
+
+	bool Texture::isCompressed(Format format) {
+		return format == Format::BC1 || format == Format::BC3
+			|| format == Format::BC7;
+	}
+
+	uint32_t Texture::rowCount(Format format, uint32_t height) {
+		return isCompressed(format) ? (height + 3) / 4 : height;
+	}
+
+	void Texture::generateMipmaps(const vector<PixelRect>& regions) {
+		if (isCompressed(format)) {
+			throw runtime_error("Can't filter mipmaps of a compressed texture.");
+		}
+		size_t bpp = formatSize(format);
+		vector<TextureLevel> chain(1, levels[0]);
+		while (chain.back().width > 1 || chain.back().height > 1) {
+			const TextureLevel& above = chain.back();
+			TextureLevel level;
+			level.width = max(above.width / 2, 1u);
+			level.height = max(above.height / 2, 1u);
+			level.rowPitch = (uint32_t)(level.width * bpp);
+			uint64_t end = above.offset + (uint64_t)above.rowPitch * above.height;
+			level.offset = (end + levelAlignment - 1) / levelAlignment
+				* levelAlignment;
+			chain.push_back(level);
+		}
+
+		const TextureLevel& last = chain.back();
+		uint8_t* data = new uint8_t[last.offset
+			+ (size_t)last.rowPitch * last.height];
+		memcpy(data, pixelData, (size_t)levels[0].rowPitch * levels[0].height);
+
+		vector<PixelRect> rects;
+		for (const PixelRect& r : regions) {
+			if (r.x >= chain[0].width || r.y >= chain[0].height) continue;
+			PixelRect clipped = r;
+			clipped.width = min(r.width, chain[0].width - r.x);
+			clipped.height = min(r.height, chain[0].height - r.y);
+			if (clipped.width > 0 && clipped.height > 0) {
+				rects.push_back(clipped);
+			}
+		}
+		extrudeRegions(data, chain[0], bpp, rects, gutterSize);
+
+		for (size_t l = 1; l < chain.size(); l++) {
+			const TextureLevel& src = chain[l - 1];
+			const TextureLevel& dst = chain[l];
+			parallelFor(dst.height, 32, [&](size_t begin, size_t end) {
+				filterRows(data, src, dst, bpp, (uint32_t)begin, (uint32_t)end);
+			});
+
+			/*
+			 * Only the outer rows and columns of a region can reach past
+			 * it, so those are filtered again from the region alone, the
+			 * earliest region last so that it wins where two meet.
+			 */
+			for (size_t i = rects.size(); i-- > 0;) {
+				PixelRect& r = rects[i];
+				uint32_t x0 = r.x / 2;
+				uint32_t x1 = min((r.x + r.width + 1) / 2, dst.width);
+				uint32_t y0 = r.y / 2;
+				uint32_t y1 = min((r.y + r.height + 1) / 2, dst.height);
+				for (uint32_t x = x0; x < x1; x++) {
+					filterPixel(data, src, dst, bpp, x, y0, r);
+					filterPixel(data, src, dst, bpp, x, y1 - 1, r);
+				}
+				for (uint32_t y = y0 + 1; y + 1 < y1; y++) {
+					filterPixel(data, src, dst, bpp, x0, y, r);
+					filterPixel(data, src, dst, bpp, x1 - 1, y, r);
+				}
+				r = { x0, y0, x1 - x0, y1 - y0 };
+			}
+		}
+
+		deleter(pixelData);
+		mapping.close();
+		pixelData = data;
+		deleter = pixelDeleter;
+		levels = chain;
+	}
+
+	void Texture::compress(TextureLoadFlags flags) {
+		if ((flags & TextureLoadFlags::CompressQuality)
+			!= TextureLoadFlags::None) {
+			compress(Format::BC7);
+		} else if ((flags & TextureLoadFlags::CompressFast)
+			!= TextureLoadFlags::None) {
+			compress(isOpaque(pixelData, getWidth(), getHeight(), getRowPitch())
+				? Format::BC1 : Format::BC3);
+		}
+	}
+
+	void Texture::compress(Format compressed) {
+		if (format != Format::RGBA || !isCompressed(compressed)) {
+			throw runtime_error("Only RGBA textures can be block compressed.");
+		}
+		vector<TextureLevel> chain;
+		uint64_t end = 0;
+		for (const TextureLevel& above : levels) {
+			TextureLevel level = above;
+			level.rowPitch = (level.width + 3) / 4 * formatSize(compressed);
+			level.offset = (end + levelAlignment - 1) / levelAlignment
+				* levelAlignment;
+			end = level.offset
+				+ (uint64_t)level.rowPitch * rowCount(compressed, level.height);
+			chain.push_back(level);
+		}
+
+		uint8_t* data = new uint8_t[end];
+		for (size_t l = 0; l < chain.size(); l++) {
+			const TextureLevel& level = chain[l];
+			compressTexels(getLevelData((uint32_t)l), level.width, level.height,
+				levels[l].rowPitch, compressed, data + level.offset,
+				level.rowPitch);
+		}
+
+		deleter(pixelData);
+		mapping.close();
+		pixelData = data;
+		deleter = pixelDeleter;
+		levels = chain;
+		format = compressed;
+	}
 }
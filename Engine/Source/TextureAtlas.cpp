@@ -1,11 +1,32 @@
 #include <Engine/TextureAtlas.h>
+#include <Engine/AtlasPacker.h>
+#include <stb_image.h>
+#include <cstring>
 #include <fstream>
-#include <iostream>
+#include <memory>
 #include <stdexcept>
-#include <regex>
-#include <sstream>
+#include <unordered_set>
+#include <vector>
 
 using namespace std;
+using Engine::PixelRect;
+using Engine::RegionTable;
+using Engine::TextureRect;
+
+static const char bundleMagic[4] = { 'E', 'A', 'T', 'L' };
+static const uint32_t bundleVersion = 1;
+static const uint64_t tableAlignment = 8;
+
+struct AtlasBundleHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t imageWidth;
+	uint32_t imageHeight;
+	uint32_t imageOffset;
+	uint32_t imageLength;
+	uint64_t tableOffset;
+	uint64_t tableSize;
+};
 
 enum class TokenType {
 	End,
@@ -17,40 +38,11 @@ enum class TokenType {
 
 struct Token {
 	TokenType type;
-	string name;
+	const char* name;
+	size_t length;
 	uint32_t number;
 };
 
-Token parseToken(istream& in) {
-	static regex name("[_]*[a-zA-Z][a-zA-Z_0-9]*");
-	static regex number("0|([1-9][0-9]*)");
-
-	Token token = { TokenType::End, "", 0 };
-	int c;
-	while ((c = in.get()) != EOF && (c == ' ' || c == '\t'));
-	if (c == '\n') {
-		token.type = TokenType::NewLine;
-	} else if (c == '#') {
-		while ((c = in.get()) != EOF && c != '\n');
-		if (c != EOF) token.type = TokenType::NewLine;
-	} else if (c == '=') {
-		token.type = TokenType::Equals;
-	} else if (c != EOF) {
-		in.unget();
-		in >> token.name;
-		if (regex_match(token.name, name)) {
-			token.type = TokenType::Name;
-		} else if (regex_match(token.name, number)) {
-			token.type = TokenType::Number;
-			token.number = (uint32_t)stoi(token.name);
-		} else {
-			throw runtime_error("Syntax error.");
-		}
-	}
-
-	return token;
-}
-
 namespace std {
 	string to_string(TokenType t) {
 		switch (t)
@@ -74,46 +66,299 @@ namespace std {
 	}
 }
 
-Token expectToken(istream& in, TokenType type) {
-	Token t = parseToken(in);
-	if (t.type != type) {
-		throw runtime_error("Expected " + to_string(type) + ", got "
-			+ to_string(t.type) + ".");
+static bool isLetter(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+/*
+ * Splits the text of a meta file into tokens in one pass over its bytes,
+ * without copying them.
+ */
+struct MetaLexer {
+	const char* next;
+	const char* end;
+	uint32_t line;
+	/* Line the last token started on, for errors */
+	uint32_t tokenLine;
+
+	runtime_error error(const string& message) const {
+		return runtime_error(message + " (line " + to_string(tokenLine) + ")");
+	}
+
+	bool atDelimiter() const {
+		return next == end || *next == ' ' || *next == '\t' || *next == '\r'
+			|| *next == '\n' || *next == '=' || *next == '#';
+	}
+
+	Token parse() {
+		Token token = { TokenType::End, nullptr, 0, 0 };
+		while (next != end && (*next == ' ' || *next == '\t' || *next == '\r')) {
+			next++;
+		}
+		tokenLine = line;
+		if (next == end) return token;
+
+		const char* start = next;
+		if (*next == '#') {
+			while (next != end && *next != '\n') next++;
+			if (next == end) return token;
+		}
+		if (*next == '\n') {
+			next++;
+			line++;
+			token.type = TokenType::NewLine;
+		} else if (*next == '=') {
+			next++;
+			token.type = TokenType::Equals;
+		} else if (isDigit(*next)) {
+			uint64_t number = 0;
+			while (next != end && isDigit(*next) && number <= UINT32_MAX) {
+				number = number * 10 + (uint32_t)(*next++ - '0');
+			}
+			/* No leading zeros, as in "0|[1-9][0-9]*" */
+			if (number > UINT32_MAX || (*start == '0' && next - start > 1)
+				|| !atDelimiter()) {
+				throw error("Syntax error.");
+			}
+			token.type = TokenType::Number;
+			token.number = (uint32_t)number;
+		} else {
+			/* "[_]*[a-zA-Z][a-zA-Z_0-9]*" */
+			while (next != end && *next == '_') next++;
+			if (next == end || !isLetter(*next)) throw error("Syntax error.");
+			while (next != end && (isLetter(*next) || isDigit(*next)
+				|| *next == '_')) {
+				next++;
+			}
+			if (!atDelimiter()) throw error("Syntax error.");
+			token.type = TokenType::Name;
+			token.name = start;
+			token.length = next - start;
+		}
+		return token;
+	}
+
+	Token expect(TokenType type) {
+		Token t = parse();
+		if (t.type != type) {
+			throw error("Expected " + to_string(type) + ", got "
+				+ to_string(t.type) + ".");
+		}
+		return t;
+	}
+};
+
+static string directoryOf(const string& path) {
+	size_t slash = path.find_last_of("/\\");
+	return slash == string::npos ? string() : path.substr(0, slash + 1);
+}
+
+/*
+ * Regions of a texture of the given size, the last of any repeated name
+ * kept.
+ */
+static RegionTable compileRegions(const vector<string>& names,
+	const vector<PixelRect>& rects, uint32_t width, uint32_t height) {
+	/*
+	 * Walking backwards, the first time a name is seen is its last entry.
+	 * The table sorts regions by name, so their order here does not matter.
+	 */
+	unordered_set<string> seen;
+	vector<string> tableNames;
+	vector<PixelRect> pixelRects;
+	vector<TextureRect> textureRects;
+	for (size_t i = names.size(); i-- > 0;) {
+		if (!seen.insert(names[i]).second) continue;
+		tableNames.push_back(names[i]);
+		pixelRects.push_back(rects[i]);
+		textureRects.push_back({
+			rects[i].x / (float)width,
+			rects[i].y / (float)height,
+			rects[i].width / (float)width,
+			rects[i].height / (float)height
+		});
 	}
-	return t;
+	return RegionTable(tableNames, pixelRects, textureRects);
 }
 
 namespace Engine {
-	TextureAtlas::TextureAtlas(const string& image, const string& meta) {
-		texture = new Texture(image);
+	void readAtlasMeta(const string& meta, vector<string>& names,
+		vector<PixelRect>& rects) {
+		MappedFile file;
+		if (!file.open(meta)) {
+			/* An empty file maps to nothing, but has no regions either. */
+			if (!ifstream(meta).is_open()) {
+				throw runtime_error("Failed to open atlas meta " + meta + ".");
+			}
+			return;
+		}
 
-		ifstream metaFile(meta);
+		MetaLexer lexer = { (const char*)file.getData(),
+			(const char*)file.getData() + file.getSize(), 1, 1 };
 		Token token;
-		while ((token = parseToken(metaFile)).type != TokenType::End) {
-			while (token.type == TokenType::NewLine) {
-				token = parseToken(metaFile);
+		while ((token = lexer.parse()).type != TokenType::End) {
+			if (token.type == TokenType::NewLine) continue;
+			if (token.type != TokenType::Name) throw lexer.error("Syntax error.");
+
+			string name(token.name, token.length);
+			lexer.expect(TokenType::Equals);
+			uint32_t nums[4];
+			for (int i = 0; i < 4; i++) {
+				nums[i] = lexer.expect(TokenType::Number).number;
 			}
-			if (token.type == TokenType::Name) {
-				string name = token.name;
-				expectToken(metaFile, TokenType::Equals);
-				uint32_t nums[4];
-				for (int i = 0; i < 4; i++) {
-					token = expectToken(metaFile, TokenType::Number);
-					nums[i] = token.number;
-				}
-				expectToken(metaFile, TokenType::NewLine);
-
-				regions[name] = {
-					nums[0] / (float)texture->getWidth(),
-					nums[1] / (float)texture->getHeight(),
-					nums[2] / (float)texture->getWidth(),
-					nums[3] / (float)texture->getHeight()
-				};
-			} else if (!(token.type == TokenType::NewLine ||
-				token.type == TokenType::End)) {
-				throw runtime_error("Syntax error.");
+			token = lexer.parse();
+			if (token.type != TokenType::NewLine && token.type != TokenType::End) {
+				throw lexer.error("Expected " + to_string(TokenType::NewLine)
+					+ ", got " + to_string(token.type) + ".");
 			}
+
+			names.push_back(std::move(name));
+			rects.push_back({ nums[0], nums[1], nums[2], nums[3] });
+			if (token.type == TokenType::End) break;
+		}
+	}
+
+	void writeAtlasBundle(const string& image, const string& meta,
+		const string& bundle) {
+		string directory = directoryOf(bundle);
+		if (directoryOf(image) != directory) {
+			throw runtime_error("Atlas image " + image
+				+ " is not in the directory of " + bundle + ".");
+		}
+		string reference = image.substr(directory.size());
+
+		int width, height, channels;
+		if (!stbi_info(image.c_str(), &width, &height, &channels)) {
+			throw runtime_error("Failed to read atlas image " + image + ".");
+		}
+		vector<string> names;
+		vector<PixelRect> rects;
+		readAtlasMeta(meta, names, rects);
+		RegionTable table = compileRegions(names, rects, (uint32_t)width,
+			(uint32_t)height);
+
+		AtlasBundleHeader header = {};
+		memcpy(header.magic, bundleMagic, sizeof(bundleMagic));
+		header.version = bundleVersion;
+		header.imageWidth = (uint32_t)width;
+		header.imageHeight = (uint32_t)height;
+		header.imageOffset = sizeof(header);
+		header.imageLength = (uint32_t)reference.size();
+		header.tableOffset = (sizeof(header) + reference.size()
+			+ tableAlignment - 1) / tableAlignment * tableAlignment;
+		header.tableSize = table.getSize();
+
+		ofstream out(bundle, ios::binary | ios::trunc);
+		out.write((const char*)&header, sizeof(header));
+		out.write(reference.data(), reference.size());
+		char padding[tableAlignment] = {};
+		out.write(padding, header.tableOffset - sizeof(header) - reference.size());
+		out.write((const char*)table.getData(), table.getSize());
+		if (!out) throw runtime_error("Failed to write atlas bundle " + bundle + ".");
+	}
+
+	TextureAtlas::TextureAtlas(const string& image, const string& meta,
+		TextureLoadFlags flags) {
+		vector<string> names;
+		vector<PixelRect> rects;
+		readAtlasMeta(meta, names, rects);
+
+		/* Regions are known first so mipmaps can keep them apart. */
+		texture = new Texture(image, flags, rects);
+		regions = compileRegions(names, rects, texture->getWidth(),
+			texture->getHeight());
+	}
+
+	TextureAtlas::TextureAtlas(const string& bundle, TextureLoadFlags flags) {
+		if (!bundleFile.open(bundle)) {
+			throw runtime_error("Failed to open atlas bundle " + bundle + ".");
+		}
+		const uint8_t* data = bundleFile.getData();
+		size_t size = bundleFile.getSize();
+
+		AtlasBundleHeader header;
+		if (size < sizeof(header)) {
+			throw runtime_error("Invalid atlas bundle " + bundle + ".");
+		}
+		memcpy(&header, data, sizeof(header));
+		if (memcmp(header.magic, bundleMagic, sizeof(bundleMagic)) != 0
+			|| header.version != bundleVersion
+			|| header.imageOffset > size
+			|| header.imageLength > size - header.imageOffset
+			|| header.tableOffset % tableAlignment != 0
+			|| header.tableOffset > size
+			|| header.tableSize > size - header.tableOffset
+			|| !regions.assign(data + header.tableOffset,
+				(size_t)header.tableSize)) {
+			throw runtime_error("Invalid atlas bundle " + bundle + ".");
+		}
+
+		vector<PixelRect> rects(regions.getCount());
+		for (uint32_t id = 0; id < regions.getCount(); id++) {
+			rects[id] = regions.getPixelRect(id);
+		}
+		string image = directoryOf(bundle) + string((const char*)data
+			+ header.imageOffset, header.imageLength);
+		texture = new Texture(image, flags, rects);
+		if (texture->getWidth() != header.imageWidth
+			|| texture->getHeight() != header.imageHeight) {
+			delete texture;
+			throw runtime_error("Atlas image " + image
+				+ " has changed size since " + bundle + " was written.");
+		}
+	}
+
+	TextureAtlas::TextureAtlas(const vector<AtlasSource>& sources,
+		TextureLoadFlags flags, uint32_t padding, uint32_t maxSize) {
+		vector<unique_ptr<Texture>> images;
+		vector<string> names;
+		vector<PixelRect> sizes;
+		for (const AtlasSource& source : sources) {
+			images.emplace_back(new Texture(source.file,
+				TextureLoadFlags::ForceRGBA));
+			names.push_back(source.name);
+			sizes.push_back({ 0, 0, images.back()->getWidth(),
+				images.back()->getHeight() });
+		}
+
+		uint32_t width, height;
+		vector<PixelRect> rects;
+		if (!packAtlas(sizes, padding, maxSize, width, height, rects)) {
+			throw runtime_error("Images do not fit in a "
+				+ to_string(maxSize) + "x" + to_string(maxSize) + " atlas.");
+		}
+
+		texture = new Texture(Texture::Format::RGBA, width, height);
+		uint8_t* pixels = texture->getPixelData();
+		uint32_t rowPitch = texture->getRowPitch();
+		memset(pixels, 0, (size_t)rowPitch * height);
+		for (size_t i = 0; i < images.size(); i++) {
+			const Texture& image = *images[i];
+			const PixelRect& r = rects[i];
+			for (uint32_t y = 0; y < r.height; y++) {
+				memcpy(pixels + (size_t)(r.y + y) * rowPitch + r.x * 4,
+					image.getPixelData() + (size_t)y * image.getRowPitch(),
+					(size_t)r.width * 4);
+			}
+		}
+
+		if ((flags & TextureLoadFlags::Mipmaps) != TextureLoadFlags::None) {
+			texture->generateMipmaps(rects);
+		}
+		texture->compress(flags);
+		regions = compileRegions(names, rects, width, height);
+	}
+
+	uint32_t TextureAtlas::findRegion(const string& name) const {
+		uint32_t id = regions.find(name);
+		if (id == RegionTable::none) {
+			throw runtime_error("No region \"" + name + "\" in texture atlas.");
 		}
+		return id;
 	}
 
 	TextureAtlas::~TextureAtlas() {
@@ -0,0 +1,225 @@
+#include <Engine/TextureCache.h>
+#include <Engine/CacheFile.h>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace std;
+using Engine::Texture;
+using Engine::TextureLevel;
+
+static const char cacheMagic[4] = { 'E', 'T', 'E', 'X' };
+static const uint32_t cacheVersion = 3;
+/* Texel data starts on a page, so mapped levels keep their alignment. */
+static const uint64_t dataAlignment = 4096;
+static const uint32_t maxLevels = 32;
+
+struct TextureCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t flags;
+	uint32_t format;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint64_t sourceHash;
+	uint64_t regionHash;
+	uint32_t levelCount;
+	uint32_t padding;
+	uint64_t dataOffset;
+	uint64_t dataSize;
+};
+
+struct TextureCacheLevel {
+	uint32_t width;
+	uint32_t height;
+	uint32_t rowPitch;
+	uint32_t padding;
+	uint64_t offset;
+};
+
+/*
+ * FNV-1a over 64 bit words, with a shift so high bits reach the low ones.
+ */
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+	const uint8_t* bytes = (const uint8_t*)data;
+	const uint64_t prime = 0x100000001b3ull;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 29;
+	}
+	for (; i < size; i++) {
+		hash = (hash ^ bytes[i]) * prime;
+	}
+	return hash;
+}
+
+static bool hashFile(const string& path, uint64_t& hash) {
+	ifstream in(path, ios::binary);
+	if (!in.is_open()) return false;
+	hash = 0xcbf29ce484222325ull;
+	/* A multiple of 8, so words do not depend on where reads end. */
+	vector<char> buffer(1 << 16);
+	while (in) {
+		in.read(buffer.data(), buffer.size());
+		hash = hashBytes(hash, buffer.data(), (size_t)in.gcount());
+	}
+	return in.eof();
+}
+
+static uint64_t hashRegions(const vector<Engine::PixelRect>& regions) {
+	return hashBytes(0xcbf29ce484222325ull, regions.data(),
+		regions.size() * sizeof(Engine::PixelRect));
+}
+
+static bool validFormat(Texture::Format format) {
+	switch (format) {
+	case Texture::Format::Grey:
+	case Texture::Format::GreyAlpha:
+	case Texture::Format::RGBA:
+	case Texture::Format::BC1:
+	case Texture::Format::BC3:
+	case Texture::Format::BC7:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static uint64_t alignUp(uint64_t offset, uint64_t alignment) {
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+namespace Engine {
+	string textureCachePath(const string& sourcePath,
+		TextureLoadFlags flags) {
+		char key[16];
+		snprintf(key, sizeof(key), ".%02x", (unsigned)flags
+			& ~(unsigned)TextureLoadFlags::BinaryCache);
+		return sourcePath + key + ".texcache";
+	}
+
+	bool readTextureCache(const string& sourcePath, TextureLoadFlags flags,
+		const vector<PixelRect>& regions, Texture& texture) {
+		uint64_t size;
+		int64_t time;
+		if (!sourceStamp(sourcePath, size, time)) return false;
+
+		string cachePath = textureCachePath(sourcePath, flags);
+		MappedFile mapping;
+		if (!mapping.open(cachePath)) return false;
+		const uint8_t* data = mapping.getData();
+		size_t fileSize = mapping.getSize();
+
+		TextureCacheHeader header;
+		if (fileSize < sizeof(header)) return false;
+		memcpy(&header, data, sizeof(header));
+		Texture::Format format = static_cast<Texture::Format>(header.format);
+		if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0
+			|| header.version != cacheVersion
+			|| header.flags != (uint32_t)flags
+			|| !validFormat(format)
+			|| header.sourceSize != size
+			|| header.regionHash != hashRegions(regions)
+			|| header.levelCount == 0 || header.levelCount > maxLevels
+			|| header.dataOffset % dataAlignment != 0
+			|| header.dataOffset > fileSize
+			|| header.dataSize > fileSize - header.dataOffset) {
+			return false;
+		}
+
+		size_t tableEnd = sizeof(header)
+			+ header.levelCount * sizeof(TextureCacheLevel);
+		if (tableEnd > header.dataOffset) return false;
+		vector<TextureLevel> levels(header.levelCount);
+		for (uint32_t i = 0; i < header.levelCount; i++) {
+			TextureCacheLevel record;
+			memcpy(&record, data + sizeof(header)
+				+ i * sizeof(TextureCacheLevel), sizeof(record));
+			uint64_t levelSize = (uint64_t)record.rowPitch
+				* Texture::rowCount(format, record.height);
+			uint64_t columns = Texture::isCompressed(format)
+				? (record.width + 3) / 4 : record.width;
+			if (record.width == 0 || record.height == 0
+				|| record.rowPitch < columns * Texture::formatSize(format)
+				|| record.offset > header.dataSize
+				|| levelSize > header.dataSize - record.offset
+				|| (i == 0 && record.offset != 0)) {
+				return false;
+			}
+			levels[i] = { record.width, record.height, record.rowPitch,
+				record.offset };
+		}
+
+		/*
+		 * A different modification time alone, as after a checkout, is
+		 * settled by hashing the source, and the cache is then stamped
+		 * with the new time so the next load skips the hash.
+		 */
+		if (header.sourceTime != time) {
+			uint64_t hash;
+			if (!hashFile(sourcePath, hash) || hash != header.sourceHash) {
+				return false;
+			}
+			fstream stamp(cachePath, ios::binary | ios::in | ios::out);
+			stamp.seekp(offsetof(TextureCacheHeader, sourceTime));
+			stamp.write((const char*)&time, sizeof(time));
+		}
+
+		if (texture.pixelData != nullptr) texture.deleter(texture.pixelData);
+		texture.format = format;
+		texture.levels = std::move(levels);
+		texture.pixelData = const_cast<uint8_t*>(data + header.dataOffset);
+		texture.deleter = [](void*) {};
+		texture.mapping = std::move(mapping);
+		return true;
+	}
+
+	void writeTextureCache(const string& sourcePath, TextureLoadFlags flags,
+		const vector<PixelRect>& regions, const Texture& texture) {
+		TextureCacheHeader header = {};
+		memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+		header.version = cacheVersion;
+		header.flags = (uint32_t)flags;
+		header.format = (uint32_t)texture.getFormat();
+		if (!sourceStamp(sourcePath, header.sourceSize, header.sourceTime)
+			|| !hashFile(sourcePath, header.sourceHash)) {
+			return;
+		}
+		header.regionHash = hashRegions(regions);
+		header.levelCount = texture.getLevelCount();
+		header.dataOffset = alignUp(sizeof(header)
+			+ header.levelCount * sizeof(TextureCacheLevel), dataAlignment);
+		uint32_t last = header.levelCount - 1;
+		header.dataSize = texture.getLevel(last).offset
+			+ texture.getLevelSize(last);
+
+		string cachePath = textureCachePath(sourcePath, flags);
+		string tempPath = temporaryCachePath(cachePath);
+		ofstream out(tempPath, ios::binary | ios::trunc);
+		if (!out.is_open()) return;
+
+		out.write((const char*)&header, sizeof(header));
+		for (uint32_t i = 0; i < header.levelCount; i++) {
+			const TextureLevel& level = texture.getLevel(i);
+			TextureCacheLevel record = {};
+			record.width = level.width;
+			record.height = level.height;
+			record.rowPitch = level.rowPitch;
+			record.offset = level.offset;
+			out.write((const char*)&record, sizeof(record));
+		}
+		vector<char> padding(header.dataOffset - (uint64_t)out.tellp());
+		out.write(padding.data(), padding.size());
+		out.write((const char*)texture.getPixelData(), header.dataSize);
+		out.close();
+		if (!out) {
+			remove(tempPath.c_str());
+			return;
+		}
+		replaceCacheFile(tempPath, cachePath);
+	}
+}
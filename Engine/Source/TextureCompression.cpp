@@ -0,0 +1,509 @@
+#include <Engine/TextureCompression.h>
+#include <Engine/Parallel.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define ENGINE_TEXTURECOMPRESSION_SSE2
+#endif
+
+using namespace std;
+using Engine::Texture;
+using Engine::parallelFor;
+
+/*
+ * The 16 pixels of a block, one array per channel so four pixels fit a
+ * vector.
+ */
+struct Block {
+	alignas(16) float channels[4][16];
+};
+
+/* Weights of the second endpoint, out of 64, for 4 bit BC7 indices. */
+static const int bc7Weights[16] = {
+	0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64
+};
+
+/* The same weights as fractions, for fitting endpoints. */
+static const float bc7WeightFractions[16] = {
+	0 / 64.f, 4 / 64.f, 9 / 64.f, 13 / 64.f, 17 / 64.f, 21 / 64.f, 26 / 64.f,
+	30 / 64.f, 34 / 64.f, 38 / 64.f, 43 / 64.f, 47 / 64.f, 51 / 64.f,
+	55 / 64.f, 60 / 64.f, 64 / 64.f
+};
+
+static void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height,
+	uint32_t rowPitch, uint32_t bx, uint32_t by, Block& block) {
+#ifdef ENGINE_TEXTURECOMPRESSION_SSE2
+	/* Whole blocks split a row of four pixels into channels at once. */
+	if (bx * 4 + 4 <= width && by * 4 + 4 <= height) {
+		const __m128i mask = _mm_set1_epi32(0xff);
+		for (uint32_t py = 0; py < 4; py++) {
+			__m128i pixels = _mm_loadu_si128((const __m128i*)(rgba
+				+ (size_t)(by * 4 + py) * rowPitch + bx * 16));
+			for (int c = 0; c < 4; c++) {
+				__m128i channel = _mm_and_si128(
+					_mm_srli_epi32(pixels, c * 8), mask);
+				_mm_store_ps(&block.channels[c][py * 4],
+					_mm_cvtepi32_ps(channel));
+			}
+		}
+		return;
+	}
+#endif
+	for (uint32_t py = 0; py < 4; py++) {
+		uint32_t y = min(by * 4 + py, height - 1);
+		for (uint32_t px = 0; px < 4; px++) {
+			uint32_t x = min(bx * 4 + px, width - 1);
+			const uint8_t* p = rgba + (size_t)y * rowPitch + x * 4;
+			for (int c = 0; c < 4; c++) {
+				block.channels[c][py * 4 + px] = p[c];
+			}
+		}
+	}
+}
+
+/*
+ * Mean of the block and the direction it varies most along, by power
+ * iteration on the covariance of its first channelCount channels.
+ */
+static void principalAxis(const Block& block, int channelCount,
+	float mean[4], float axis[4]) {
+	float low[4] = {}, high[4] = {};
+	float covariance[4][4] = {};
+	for (int c = 0; c < 4; c++) {
+		mean[c] = 0.f;
+		axis[c] = 0.f;
+	}
+#ifdef ENGINE_TEXTURECOMPRESSION_SSE2
+	__m128 centered[4][4];
+	for (int c = 0; c < channelCount; c++) {
+		__m128 sum = _mm_setzero_ps();
+		__m128 lowest = _mm_load_ps(&block.channels[c][0]);
+		__m128 highest = lowest;
+		for (int i = 0; i < 16; i += 4) {
+			__m128 v = _mm_load_ps(&block.channels[c][i]);
+			sum = _mm_add_ps(sum, v);
+			lowest = _mm_min_ps(lowest, v);
+			highest = _mm_max_ps(highest, v);
+		}
+		alignas(16) float lanes[3][4];
+		_mm_store_ps(lanes[0], sum);
+		_mm_store_ps(lanes[1], lowest);
+		_mm_store_ps(lanes[2], highest);
+		mean[c] = (lanes[0][0] + lanes[0][1] + lanes[0][2] + lanes[0][3]) / 16.f;
+		low[c] = min(min(lanes[1][0], lanes[1][1]), min(lanes[1][2], lanes[1][3]));
+		high[c] = max(max(lanes[2][0], lanes[2][1]), max(lanes[2][2], lanes[2][3]));
+		for (int i = 0; i < 4; i++) {
+			centered[c][i] = _mm_sub_ps(_mm_load_ps(&block.channels[c][i * 4]),
+				_mm_set1_ps(mean[c]));
+		}
+	}
+	for (int c = 0; c < channelCount; c++) {
+		for (int d = c; d < channelCount; d++) {
+			__m128 sum = _mm_setzero_ps();
+			for (int i = 0; i < 4; i++) {
+				sum = _mm_add_ps(sum, _mm_mul_ps(centered[c][i], centered[d][i]));
+			}
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, sum);
+			covariance[c][d] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+		}
+	}
+#else
+	for (int c = 0; c < channelCount; c++) {
+		low[c] = high[c] = block.channels[c][0];
+		for (int i = 0; i < 16; i++) {
+			float v = block.channels[c][i];
+			mean[c] += v;
+			low[c] = min(low[c], v);
+			high[c] = max(high[c], v);
+		}
+		mean[c] /= 16.f;
+	}
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < channelCount; c++) {
+			float dc = block.channels[c][i] - mean[c];
+			for (int d = c; d < channelCount; d++) {
+				covariance[c][d] += dc * (block.channels[d][i] - mean[d]);
+			}
+		}
+	}
+#endif
+	for (int c = 0; c < channelCount; c++) {
+		for (int d = 0; d < c; d++) covariance[c][d] = covariance[d][c];
+	}
+
+	for (int c = 0; c < channelCount; c++) axis[c] = high[c] - low[c];
+	for (int iteration = 0; iteration < 8; iteration++) {
+		float next[4] = {};
+		float length = 0.f;
+		for (int c = 0; c < channelCount; c++) {
+			for (int d = 0; d < channelCount; d++) {
+				next[c] += covariance[c][d] * axis[d];
+			}
+			length = max(length, fabsf(next[c]));
+		}
+		if (length == 0.f) break;
+		for (int c = 0; c < channelCount; c++) axis[c] = next[c] / length;
+	}
+	float length = 0.f;
+	for (int c = 0; c < channelCount; c++) length += axis[c] * axis[c];
+	if (length == 0.f) {
+		for (int c = 0; c < channelCount; c++) axis[c] = 1.f;
+		length = (float)channelCount;
+	}
+	length = sqrtf(length);
+	for (int c = 0; c < channelCount; c++) axis[c] /= length;
+}
+
+/*
+ * Endpoints that best fit the pixels, in the least squares sense, given
+ * the weight of e1 (out of 1) each pixel's index stands for. Returns false
+ * when the indices do not pin both endpoints down.
+ */
+static bool fitEndpoints(const Block& block, int channelCount,
+	const int indices[16], const float* weights, float e0[4], float e1[4]) {
+	float aa = 0.f, ab = 0.f, bb = 0.f;
+	float ap[4] = {}, bp[4] = {};
+	for (int i = 0; i < 16; i++) {
+		float b = weights[indices[i]];
+		float a = 1.f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int c = 0; c < channelCount; c++) {
+			ap[c] += a * block.channels[c][i];
+			bp[c] += b * block.channels[c][i];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f) return false;
+	for (int c = 0; c < channelCount; c++) {
+		e0[c] = min(max((bb * ap[c] - ab * bp[c]) / determinant, 0.f), 255.f);
+		e1[c] = min(max((aa * bp[c] - ab * ap[c]) / determinant, 0.f), 255.f);
+	}
+	return true;
+}
+
+static uint16_t packRGB565(const float c[4]) {
+	int r = (int)lrintf(c[0] * 31.f / 255.f);
+	int g = (int)lrintf(c[1] * 63.f / 255.f);
+	int b = (int)lrintf(c[2] * 31.f / 255.f);
+	return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+static void unpackRGB565(uint16_t packed, int c[3]) {
+	int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+	c[0] = r << 3 | r >> 2;
+	c[1] = g << 2 | g >> 4;
+	c[2] = b << 3 | b >> 2;
+}
+
+/*
+ * Nearest palette entry of every pixel, and the squared error of the block
+ * against them.
+ */
+static float selectIndices(const Block& block, int channelCount,
+	const float palette[16][4], int levels, int indices[16]) {
+#ifdef ENGINE_TEXTURECOMPRESSION_SSE2
+	__m128 total = _mm_setzero_ps();
+	for (int i = 0; i < 16; i += 4) {
+		__m128 best = _mm_set1_ps(1e30f);
+		__m128i bestIndex = _mm_setzero_si128();
+		for (int k = 0; k < levels; k++) {
+			__m128 error = _mm_setzero_ps();
+			for (int c = 0; c < channelCount; c++) {
+				__m128 d = _mm_sub_ps(_mm_load_ps(&block.channels[c][i]),
+					_mm_set1_ps(palette[k][c]));
+				error = _mm_add_ps(error, _mm_mul_ps(d, d));
+			}
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(error, best));
+			best = _mm_min_ps(error, best);
+			bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex),
+				_mm_and_si128(closer, _mm_set1_epi32(k)));
+		}
+		total = _mm_add_ps(total, best);
+		_mm_storeu_si128((__m128i*)&indices[i], bestIndex);
+	}
+	alignas(16) float sums[4];
+	_mm_store_ps(sums, total);
+	return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+	float total = 0.f;
+	for (int i = 0; i < 16; i++) {
+		float best = 1e30f;
+		for (int k = 0; k < levels; k++) {
+			float error = 0.f;
+			for (int c = 0; c < channelCount; c++) {
+				float d = block.channels[c][i] - palette[k][c];
+				error += d * d;
+			}
+			if (error < best) {
+				best = error;
+				indices[i] = k;
+			}
+		}
+		total += best;
+	}
+	return total;
+#endif
+}
+
+/*
+ * Colour block of BC1 and BC3 in four colour mode. Indices run from c0
+ * to c1 along the line; the block stores them as 0, 2, 3, 1.
+ */
+static void encodeColorBlock(const Block& block, uint8_t* out) {
+	static const float weights[4] = { 0.f, 1.f / 3.f, 2.f / 3.f, 1.f };
+	static const uint8_t order[4] = { 0, 2, 3, 1 };
+
+	float mean[4], axis[4];
+	principalAxis(block, 3, mean, axis);
+	float tMin = 0.f, tMax = 0.f;
+	for (int i = 0; i < 16; i++) {
+		float t = 0.f;
+		for (int c = 0; c < 3; c++) {
+			t += (block.channels[c][i] - mean[c]) * axis[c];
+		}
+		tMin = min(tMin, t);
+		tMax = max(tMax, t);
+	}
+	/* Inset the ends, as pixels rarely sit on them. */
+	float inset = (tMax - tMin) / 16.f;
+	float e0[4] = {}, e1[4] = {};
+	for (int c = 0; c < 3; c++) {
+		e0[c] = min(max(mean[c] + axis[c] * (tMax - inset), 0.f), 255.f);
+		e1[c] = min(max(mean[c] + axis[c] * (tMin + inset), 0.f), 255.f);
+	}
+
+	uint16_t best0 = 0, best1 = 0;
+	int bestIndices[16] = {};
+	float bestError = -1.f;
+	for (int iteration = 0; iteration < 2; iteration++) {
+		uint16_t c0 = packRGB565(e0), c1 = packRGB565(e1);
+		int ends[2][3];
+		unpackRGB565(c0, ends[0]);
+		unpackRGB565(c1, ends[1]);
+		float palette[16][4] = {};
+		for (int c = 0; c < 3; c++) {
+			palette[0][c] = (float)ends[0][c];
+			palette[1][c] = (float)((2 * ends[0][c] + ends[1][c]) / 3);
+			palette[2][c] = (float)((ends[0][c] + 2 * ends[1][c]) / 3);
+			palette[3][c] = (float)ends[1][c];
+		}
+		int indices[16];
+		float error = selectIndices(block, 3, palette, 4, indices);
+		if (bestError < 0.f || error < bestError) {
+			bestError = error;
+			best0 = c0;
+			best1 = c1;
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+		if (!fitEndpoints(block, 3, indices, weights, e0, e1)) break;
+	}
+
+	/* c0 > c1 selects four colours; equal endpoints only need index 0. */
+	if (best0 < best1) {
+		swap(best0, best1);
+		for (int i = 0; i < 16; i++) bestIndices[i] = 3 - bestIndices[i];
+	} else if (best0 == best1) {
+		memset(bestIndices, 0, sizeof(bestIndices));
+	}
+	uint32_t bits = 0;
+	for (int i = 0; i < 16; i++) {
+		bits |= (uint32_t)order[bestIndices[i]] << (i * 2);
+	}
+	out[0] = (uint8_t)best0;
+	out[1] = (uint8_t)(best0 >> 8);
+	out[2] = (uint8_t)best1;
+	out[3] = (uint8_t)(best1 >> 8);
+	for (int i = 0; i < 4; i++) out[4 + i] = (uint8_t)(bits >> (i * 8));
+}
+
+/*
+ * Alpha block of BC3 in eight value mode, a0 the largest alpha and a1 the
+ * smallest. Indices run from a1 up to a0; the block stores them as
+ * 1, 7, 6, ..., 2, 0.
+ */
+static void encodeAlphaBlock(const Block& block, uint8_t* out) {
+	int low = 255, high = 0;
+	for (int i = 0; i < 16; i++) {
+		int a = (int)block.channels[3][i];
+		low = min(low, a);
+		high = max(high, a);
+	}
+	out[0] = (uint8_t)high;
+	out[1] = (uint8_t)low;
+	uint64_t bits = 0;
+	if (high > low) {
+		for (int i = 0; i < 16; i++) {
+			int a = (int)block.channels[3][i];
+			int t = ((a - low) * 14 + (high - low)) / (2 * (high - low));
+			uint64_t index = t == 7 ? 0 : t == 0 ? 1 : 8 - t;
+			bits |= index << (i * 3);
+		}
+	}
+	for (int i = 0; i < 6; i++) out[2 + i] = (uint8_t)(bits >> (i * 8));
+}
+
+/*
+ * BC7 endpoints are 7 bits per channel plus one bit shared by all four
+ * channels, picked to round the endpoint best.
+ */
+static void quantizeBC7(const float e[4], int q[4], int& pbit) {
+	float bestError = -1.f;
+	for (int p = 0; p < 2; p++) {
+		int candidate[4];
+		float error = 0.f;
+		for (int c = 0; c < 4; c++) {
+			candidate[c] = min(max((int)lrintf((e[c] - p) / 2.f), 0), 127);
+			float d = (float)(candidate[c] * 2 + p) - e[c];
+			error += d * d;
+		}
+		if (bestError < 0.f || error < bestError) {
+			bestError = error;
+			pbit = p;
+			memcpy(q, candidate, sizeof(candidate));
+		}
+	}
+}
+
+/*
+ * Fills a 128 bit block from its lowest bit up.
+ */
+struct BitWriter {
+	uint64_t words[2];
+	unsigned position;
+
+	void write(uint64_t value, unsigned bits) {
+		unsigned word = position / 64, shift = position % 64;
+		words[word] |= value << shift;
+		if (shift + bits > 64) words[1] |= value >> (64 - shift);
+		position += bits;
+	}
+
+	void store(uint8_t* out) const {
+		for (int i = 0; i < 16; i++) {
+			out[i] = (uint8_t)(words[i / 8] >> (i % 8 * 8));
+		}
+	}
+};
+
+static void encodeBC7Block(const Block& block, uint8_t* out) {
+	float mean[4], axis[4];
+	principalAxis(block, 4, mean, axis);
+	float tMin = 0.f, tMax = 0.f;
+	for (int i = 0; i < 16; i++) {
+		float t = 0.f;
+		for (int c = 0; c < 4; c++) {
+			t += (block.channels[c][i] - mean[c]) * axis[c];
+		}
+		tMin = min(tMin, t);
+		tMax = max(tMax, t);
+	}
+	float e0[4], e1[4];
+	for (int c = 0; c < 4; c++) {
+		e0[c] = min(max(mean[c] + axis[c] * tMin, 0.f), 255.f);
+		e1[c] = min(max(mean[c] + axis[c] * tMax, 0.f), 255.f);
+	}
+
+	int best0[4] = {}, best1[4] = {}, bestP0 = 0, bestP1 = 0;
+	int bestIndices[16] = {};
+	float bestError = -1.f;
+	for (int iteration = 0; iteration < 3; iteration++) {
+		int q0[4], q1[4], p0, p1;
+		quantizeBC7(e0, q0, p0);
+		quantizeBC7(e1, q1, p1);
+		float palette[16][4];
+		for (int c = 0; c < 4; c++) {
+			int v0 = q0[c] * 2 + p0, v1 = q1[c] * 2 + p1;
+			for (int k = 0; k < 16; k++) {
+				palette[k][c] = (float)(((64 - bc7Weights[k]) * v0
+					+ bc7Weights[k] * v1 + 32) >> 6);
+			}
+		}
+		int indices[16];
+		float error = selectIndices(block, 4, palette, 16, indices);
+		if (bestError < 0.f || error < bestError) {
+			bestError = error;
+			memcpy(best0, q0, sizeof(q0));
+			memcpy(best1, q1, sizeof(q1));
+			bestP0 = p0;
+			bestP1 = p1;
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+		if (bestError == 0.f
+			|| !fitEndpoints(block, 4, indices, bc7WeightFractions, e0, e1)) {
+			break;
+		}
+	}
+
+	/* The first index drops its top bit, so it must be below 8. */
+	if (bestIndices[0] >= 8) {
+		swap(best0, best1);
+		swap(bestP0, bestP1);
+		for (int i = 0; i < 16; i++) bestIndices[i] = 15 - bestIndices[i];
+	}
+
+	BitWriter writer = { { 0, 0 }, 0 };
+	writer.write(1 << 6, 7);
+	for (int c = 0; c < 4; c++) {
+		writer.write((uint32_t)best0[c], 7);
+		writer.write((uint32_t)best1[c], 7);
+	}
+	writer.write((uint32_t)bestP0, 1);
+	writer.write((uint32_t)bestP1, 1);
+	writer.write((uint32_t)bestIndices[0], 3);
+	for (int i = 1; i < 16; i++) writer.write((uint32_t)bestIndices[i], 4);
+	writer.store(out);
+}
+
+namespace Engine {
+	void compressTexels(const uint8_t* rgba, uint32_t width, uint32_t height,
+		uint32_t rowPitch, Texture::Format format, uint8_t* blocks,
+		uint32_t blockRowPitch) {
+		if (!Texture::isCompressed(format)) {
+			throw runtime_error("Texels can only be compressed to BC formats.");
+		}
+		uint32_t blocksWide = (width + 3) / 4;
+		uint32_t blocksHigh = (height + 3) / 4;
+		size_t blockSize = Texture::formatSize(format);
+		parallelFor(blocksHigh, 4, [&](size_t begin, size_t end) {
+			Block block;
+			for (size_t by = begin; by < end; by++) {
+				uint8_t* out = blocks + by * blockRowPitch;
+				for (uint32_t bx = 0; bx < blocksWide; bx++) {
+					loadBlock(rgba, width, height, rowPitch, bx, (uint32_t)by,
+						block);
+					uint8_t* blockOut = out + bx * blockSize;
+					switch (format) {
+					case Texture::Format::BC1:
+						encodeColorBlock(block, blockOut);
+						break;
+					case Texture::Format::BC3:
+						encodeAlphaBlock(block, blockOut);
+						encodeColorBlock(block, blockOut + 8);
+						break;
+					default:
+						encodeBC7Block(block, blockOut);
+						break;
+					}
+				}
+			}
+		});
+	}
+
+	bool isOpaque(const uint8_t* rgba, uint32_t width, uint32_t height,
+		uint32_t rowPitch) {
+		for (uint32_t y = 0; y < height; y++) {
+			const uint8_t* row = rgba + (size_t)y * rowPitch;
+			for (uint32_t x = 0; x < width; x++) {
+				if (row[x * 4 + 3] != 255) return false;
+			}
+		}
+		return true;
+	}
+}
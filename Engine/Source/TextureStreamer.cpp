@@ -0,0 +1,42 @@
+#include <Engine/TextureStreamer.h>
+#include <algorithm>
+
+using namespace std;
+
+namespace Engine {
+	TextureStreamer::TextureStreamer(const Texture& texture) :
+	texture(texture),
+	residentLevel(texture.getLevelCount()),
+	nextRow(0)
+	{
+	}
+
+	bool TextureStreamer::next(size_t budget, TextureUpload& upload) {
+		if (isComplete()) return false;
+		uint32_t level = residentLevel - 1;
+		uint32_t rows = Texture::rowCount(texture.getFormat(),
+			texture.getLevel(level).height);
+		size_t rowPitch = texture.getLevel(level).rowPitch;
+		uint32_t count = rows - nextRow;
+		if (residentLevel < texture.getLevelCount()) {
+			count = (uint32_t)min<size_t>(count, budget / rowPitch);
+			if (count == 0) return false;
+		}
+
+		upload = { level, nextRow, count };
+		nextRow += count;
+		if (nextRow == rows) {
+			residentLevel = level;
+			nextRow = 0;
+		}
+		return true;
+	}
+
+	PixelRect TextureStreamer::getRect(const TextureUpload& upload) const {
+		const TextureLevel& level = texture.getLevel(upload.level);
+		uint32_t rowHeight = Texture::isCompressed(texture.getFormat()) ? 4 : 1;
+		uint32_t y = upload.firstRow * rowHeight;
+		return { 0, y, level.width,
+			min(upload.rowCount * rowHeight, level.height - y) };
+	}
+}
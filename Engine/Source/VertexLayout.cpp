@@ -0,0 +1,48 @@
+#include <Engine/VertexLayout.h>
+
+using namespace std;
+
+template <typename Layout>
+static vector<uint8_t> writeStream(const Engine::Vertex* vertices,
+	size_t count) {
+	vector<uint8_t> stream(Layout::stride() * count);
+	Layout::write(vertices, count, stream.data());
+	return stream;
+}
+
+namespace Engine {
+	VertexInputDescription getVertexInputDescription(VertexFormat format) {
+		switch (format) {
+		case VertexFormat::Packed:
+			return describeVertexInput<PackedStreams>();
+		case VertexFormat::SplitPosition:
+			return describeVertexInput<SplitPositionStreams>();
+		default:
+			return describeVertexInput<InterleavedStreams>();
+		}
+	}
+
+	vector<vector<uint8_t>> writeVertexStreams(const Vertex* vertices,
+		size_t count, VertexFormat format,
+		const VertexQuantization& quantization) {
+		vector<vector<uint8_t>> streams;
+		switch (format) {
+		case VertexFormat::Packed:
+			streams.emplace_back(sizeof(PackedVertex) * count);
+			packVertices(vertices, count, quantization,
+				(PackedVertex*)streams[0].data());
+			break;
+		case VertexFormat::SplitPosition:
+			streams.push_back(writeStream<VertexLayout<Attribute::Position>>(
+				vertices, count));
+			streams.push_back(writeStream<VertexLayout<Attribute::Normal,
+				Attribute::TextureCoordinate>>(vertices, count));
+			break;
+		default:
+			streams.emplace_back((const uint8_t*)vertices,
+				(const uint8_t*)(vertices + count));
+			break;
+		}
+		return streams;
+	}
+}
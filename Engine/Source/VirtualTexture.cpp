@@ -0,0 +1,269 @@
+#include <Engine/VirtualTexture.h>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+/* Slot coordinates must fit in 8 bits of an indirection texel. */
+static const uint32_t maxSlotsPerSide = 256;
+
+static void growRect(Engine::PixelRect& rect, uint32_t x, uint32_t y,
+	uint32_t w, uint32_t h) {
+	if (rect.width == 0) {
+		rect = { x, y, w, h };
+		return;
+	}
+	uint32_t right = max(rect.x + rect.width, x + w);
+	uint32_t bottom = max(rect.y + rect.height, y + h);
+	rect.x = min(rect.x, x);
+	rect.y = min(rect.y, y);
+	rect.width = right - rect.x;
+	rect.height = bottom - rect.y;
+}
+
+namespace Engine {
+	VirtualTexture::VirtualTexture(const string& path, uint32_t slotsPerSide,
+		unsigned threadCount) :
+	file(path),
+	slotsPerSide(slotsPerSide),
+	cache(slotsPerSide * slotsPerSide),
+	started(false),
+	stopping(false)
+	{
+		uint32_t top = file.getLevelCount() - 1;
+		uint32_t topPages = file.getPagesX(top) * file.getPagesY(top);
+		if (slotsPerSide == 0 || slotsPerSide > maxSlotsPerSide
+			|| topPages >= cache.getSlotCount()) {
+			throw runtime_error("Virtual texture needs more than "
+				+ to_string(topPages) + " slots, and at most "
+				+ to_string(maxSlotsPerSide) + " across.");
+		}
+
+		for (uint32_t level = 0; level <= top; level++) {
+			indirection.emplace_back(
+				(size_t)file.getPagesX(level) * file.getPagesY(level), 0);
+			changed.push_back({ 0, 0, 0, 0 });
+		}
+
+		for (uint32_t y = 0; y < file.getPagesY(top); y++) {
+			for (uint32_t x = 0; x < file.getPagesX(top); x++) {
+				VirtualPage page = { top, x, y };
+				uint32_t evicted;
+				uint32_t slot = cache.insert(packPage(page), evicted);
+				cache.pin(slot);
+				const uint8_t* stored = file.getPage(page);
+				uploaded.push_back({ packPage(page),
+					vector<uint8_t>(stored, stored + file.getPageBytes()) });
+				refreshIndirection(page);
+			}
+		}
+
+		for (unsigned i = 0; i < max(threadCount, 1u); i++) {
+			threads.emplace_back(&VirtualTexture::readPages, this);
+		}
+	}
+
+	VirtualTexture::~VirtualTexture() {
+		{
+			lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (thread& t : threads) {
+			t.join();
+		}
+	}
+
+	bool VirtualTexture::getChangedRect(uint32_t level, PixelRect& rect) const {
+		rect = changed[level];
+		return rect.width != 0;
+	}
+
+	void VirtualTexture::clearChanges() {
+		for (PixelRect& rect : changed) {
+			rect = { 0, 0, 0, 0 };
+		}
+	}
+
+	void VirtualTexture::requestPages(const uint32_t* feedback, size_t count) {
+		cache.beginFrame();
+
+		/* Neighbouring pixels mostly want the same page. */
+		uint32_t levelCount = file.getLevelCount();
+		requests.clear();
+		uint32_t previous = 0;
+		for (size_t i = 0; i < count; i++) {
+			uint32_t key = feedback[i];
+			if (key == 0 || key == previous) continue;
+			previous = key;
+			VirtualPage page = unpackPage(key);
+			if (page.level >= levelCount || page.x >= file.getPagesX(page.level)
+				|| page.y >= file.getPagesY(page.level)) {
+				continue;
+			}
+			requests.push_back(key);
+		}
+
+		/* Pixels wanting each page, then each page above them too */
+		sort(requests.begin(), requests.end());
+		vector<pair<uint32_t, uint32_t>> ranked;
+		for (size_t i = 0; i < requests.size();) {
+			size_t j = i;
+			while (j < requests.size() && requests[j] == requests[i]) j++;
+			ranked.push_back({ (uint32_t)(j - i), requests[i] });
+			i = j;
+		}
+		size_t wanted = ranked.size();
+		for (size_t i = 0; i < wanted; i++) {
+			VirtualPage page = unpackPage(ranked[i].second);
+			for (uint32_t level = page.level + 1; level < levelCount; level++) {
+				uint32_t shift = level - page.level;
+				ranked.push_back({ ranked[i].first, packPage({ level,
+					page.x >> shift, page.y >> shift }) });
+			}
+		}
+		sort(ranked.begin(), ranked.end(),
+			[](const pair<uint32_t, uint32_t>& a,
+				const pair<uint32_t, uint32_t>& b) {
+			return a.second < b.second;
+		});
+		size_t merged = 0;
+		for (size_t i = 0; i < ranked.size(); i++) {
+			if (merged > 0 && ranked[merged - 1].second == ranked[i].second) {
+				ranked[merged - 1].first += ranked[i].first;
+			} else {
+				ranked[merged++] = ranked[i];
+			}
+		}
+		ranked.resize(merged);
+		sort(ranked.begin(), ranked.end(),
+			[](const pair<uint32_t, uint32_t>& a,
+				const pair<uint32_t, uint32_t>& b) {
+			uint32_t levelA = a.second >> 28, levelB = b.second >> 28;
+			if (levelA != levelB) return levelA > levelB;
+			return a.first > b.first;
+		});
+
+		requests.clear();
+		for (const pair<uint32_t, uint32_t>& r : ranked) {
+			uint32_t slot = cache.find(r.second);
+			if (slot != PageCache::none) {
+				cache.touch(slot);
+			} else {
+				requests.push_back(r.second);
+			}
+		}
+
+		/* Pages queued for earlier frames may no longer be seen. */
+		size_t maxQueued = max(cache.getSlotCount() / 4, 1u);
+		{
+			lock_guard<std::mutex> lock(mutex);
+			for (uint32_t page : queue) {
+				inFlight.erase(page);
+			}
+			queue.clear();
+			for (uint32_t page : requests) {
+				if (queue.size() == maxQueued) break;
+				if (inFlight.insert(page).second) queue.push_back(page);
+			}
+		}
+		wake.notify_all();
+	}
+
+	void VirtualTexture::update(size_t budget, vector<PageUpload>& uploads) {
+		uploads.clear();
+		if (!started) {
+			started = true;
+			for (const LoadedPage& p : uploaded) {
+				uploads.push_back({ p.page, cache.find(p.page), p.pixels.data() });
+			}
+			return;
+		}
+
+		vector<LoadedPage> ready;
+		{
+			lock_guard<std::mutex> lock(mutex);
+			for (LoadedPage& p : uploaded) {
+				freeBuffers.push_back(std::move(p.pixels));
+			}
+			ready.swap(loaded);
+		}
+		uploaded.clear();
+
+		size_t placed = 0, spent = 0;
+		for (; placed < ready.size(); placed++) {
+			if (placed > 0 && spent + file.getPageBytes() > budget) break;
+			uint32_t evicted = 0;
+			uint32_t slot = cache.insert(ready[placed].page, evicted);
+			if (slot == PageCache::none) break;
+			if (evicted != 0) refreshIndirection(unpackPage(evicted));
+			refreshIndirection(unpackPage(ready[placed].page));
+			uploads.push_back({ ready[placed].page, slot,
+				ready[placed].pixels.data() });
+			uploaded.push_back(std::move(ready[placed]));
+			spent += file.getPageBytes();
+		}
+
+		lock_guard<std::mutex> lock(mutex);
+		for (const LoadedPage& p : uploaded) {
+			inFlight.erase(p.page);
+		}
+		loaded.insert(loaded.begin(),
+			make_move_iterator(ready.begin() + placed),
+			make_move_iterator(ready.end()));
+	}
+
+	void VirtualTexture::readPages() {
+		unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+			if (stopping) return;
+			uint32_t page = queue.front();
+			queue.pop_front();
+			vector<uint8_t> pixels;
+			if (!freeBuffers.empty()) {
+				pixels = std::move(freeBuffers.back());
+				freeBuffers.pop_back();
+			}
+			lock.unlock();
+
+			/* Copying out of the mapping is what reads the page from disk. */
+			const uint8_t* stored = file.getPage(unpackPage(page));
+			pixels.assign(stored, stored + file.getPageBytes());
+
+			lock.lock();
+			loaded.push_back({ page, std::move(pixels) });
+		}
+	}
+
+	/*
+	 * Point the indirection texels under a page, at its level and every
+	 * finer one, at the finest resident page above each. Texels of pages
+	 * not resident take the texel of the page above them.
+	 */
+	void VirtualTexture::refreshIndirection(const VirtualPage& page) {
+		uint32_t top = file.getLevelCount() - 1;
+		for (uint32_t i = 0; i <= page.level; i++) {
+			uint32_t level = page.level - i;
+			uint32_t x0 = page.x << i, y0 = page.y << i, size = 1u << i;
+			uint32_t pagesX = file.getPagesX(level);
+			for (uint32_t y = y0; y < y0 + size; y++) {
+				for (uint32_t x = x0; x < x0 + size; x++) {
+					uint32_t slot = cache.find(packPage({ level, x, y }));
+					uint32_t entry = 0;
+					if (slot != PageCache::none) {
+						entry = (slot % slotsPerSide)
+							| (slot / slotsPerSide) << 8 | level << 16
+							| 0xff000000u;
+					} else if (level < top) {
+						entry = indirection[level + 1][(size_t)(y >> 1)
+							* file.getPagesX(level + 1) + (x >> 1)];
+					}
+					indirection[level][(size_t)y * pagesX + x] = entry;
+				}
+			}
+			growRect(changed[level], x0, y0, size, size);
+		}
+	}
+}
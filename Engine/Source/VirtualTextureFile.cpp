@@ -0,0 +1,230 @@
+#include <Engine/VirtualTextureFile.h>
+#include <Engine/TextureCompression.h>
+#include <Engine/CacheFile.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+using Engine::Texture;
+
+static const char fileMagic[4] = { 'E', 'V', 'T', 'X' };
+static const uint32_t fileVersion = 2;
+/* Pages start on a disk page, so reading one touches no more than needed. */
+static const uint64_t dataAlignment = 4096;
+/* Levels and page coordinates must fit in the packed form of a page. */
+static const uint32_t maxLevels = 15;
+static const uint32_t maxPages = 1 << 14;
+
+struct VirtualTextureHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pageSize;
+	uint32_t border;
+	uint32_t levelCount;
+	uint64_t pageBytes;
+	uint64_t dataOffset;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+};
+
+struct VirtualTextureLevel {
+	uint32_t pagesX;
+	uint32_t pagesY;
+	uint32_t firstPage;
+	uint32_t padding;
+};
+
+static bool isPowerOfTwo(uint32_t v) {
+	return v != 0 && (v & (v - 1)) == 0;
+}
+
+static size_t storedPageBytes(Texture::Format format, uint32_t paddedSize) {
+	return (size_t)Texture::rowCount(format, paddedSize)
+		* Texture::rowCount(format, paddedSize) * Texture::formatSize(format);
+}
+
+/*
+ * Read and check the header and level table of a page file, and that the
+ * pages they describe fit in it.
+ */
+static bool readHeader(const uint8_t* data, size_t size,
+	VirtualTextureHeader& header, vector<VirtualTextureLevel>& levels) {
+	if (size < sizeof(header)) return false;
+	memcpy(&header, data, sizeof(header));
+	Texture::Format format = static_cast<Texture::Format>(header.format);
+	if (memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0
+		|| header.version != fileVersion
+		|| (format != Texture::Format::RGBA
+			&& format != Texture::Format::BC1
+			&& format != Texture::Format::BC3
+			&& format != Texture::Format::BC7)
+		|| !isPowerOfTwo(header.pageSize)
+		|| header.levelCount == 0 || header.levelCount > maxLevels
+		|| header.pageBytes != storedPageBytes(format,
+			header.pageSize + 2 * header.border)
+		|| header.dataOffset < sizeof(header)
+			+ header.levelCount * sizeof(VirtualTextureLevel)
+		|| header.dataOffset > size) {
+		return false;
+	}
+
+	levels.resize(header.levelCount);
+	memcpy(levels.data(), data + sizeof(header),
+		levels.size() * sizeof(VirtualTextureLevel));
+	uint64_t pageCount = 0;
+	for (uint32_t i = 0; i < header.levelCount; i++) {
+		const VirtualTextureLevel& level = levels[i];
+		if (level.firstPage != pageCount
+			|| level.pagesX != max(1u, (header.width >> i) / header.pageSize)
+			|| level.pagesY != max(1u, (header.height >> i) / header.pageSize)
+			|| level.pagesX > maxPages || level.pagesY > maxPages) {
+			return false;
+		}
+		pageCount += (uint64_t)level.pagesX * level.pagesY;
+	}
+	return pageCount * header.pageBytes <= size - header.dataOffset;
+}
+
+/*
+ * Copy a page and its border out of an RGBA level, clamping to the edges.
+ */
+static void copyPage(const Texture& texture, uint32_t level, uint32_t x0,
+	uint32_t y0, uint32_t border, uint32_t paddedSize, uint8_t* out) {
+	const Engine::TextureLevel& l = texture.getLevel(level);
+	const uint8_t* pixels = texture.getLevelData(level);
+	for (uint32_t y = 0; y < paddedSize; y++) {
+		int64_t sy = min<int64_t>(max<int64_t>((int64_t)y0 + y - border, 0),
+			l.height - 1);
+		const uint8_t* row = pixels + (size_t)sy * l.rowPitch;
+		for (uint32_t x = 0; x < paddedSize; x++) {
+			int64_t sx = min<int64_t>(max<int64_t>((int64_t)x0 + x - border,
+				0), l.width - 1);
+			memcpy(out + ((size_t)y * paddedSize + x) * 4, row + sx * 4, 4);
+		}
+	}
+}
+
+namespace Engine {
+	void writeVirtualTexture(const string& path, const string& sourcePath,
+		const Texture& texture, Texture::Format pageFormat, uint32_t pageSize,
+		uint32_t border) {
+		uint32_t width = texture.getWidth(), height = texture.getHeight();
+		uint32_t paddedSize = pageSize + 2 * border;
+		if (texture.getFormat() != Texture::Format::RGBA
+			|| !isPowerOfTwo(width) || !isPowerOfTwo(height)
+			|| !isPowerOfTwo(pageSize) || width < pageSize
+			|| height < pageSize || width / pageSize > maxPages
+			|| height / pageSize > maxPages
+			|| (Texture::isCompressed(pageFormat) && paddedSize % 4 != 0)) {
+			throw runtime_error("Texture can not be cut into virtual pages.");
+		}
+
+		vector<VirtualTextureLevel> levels;
+		uint32_t pageCount = 0;
+		for (uint32_t level = 0; (min(width, height) >> level) >= pageSize;
+			level++) {
+			uint32_t pagesX = (width >> level) / pageSize;
+			uint32_t pagesY = (height >> level) / pageSize;
+			levels.push_back({ pagesX, pagesY, pageCount, 0 });
+			pageCount += pagesX * pagesY;
+		}
+		if (levels.size() > maxLevels
+			|| texture.getLevelCount() < levels.size()) {
+			throw runtime_error("Texture needs "
+				+ to_string(levels.size()) + " levels to be paged.");
+		}
+
+		VirtualTextureHeader header = {};
+		memcpy(header.magic, fileMagic, sizeof(fileMagic));
+		header.version = fileVersion;
+		header.format = (uint32_t)pageFormat;
+		header.width = width;
+		header.height = height;
+		header.pageSize = pageSize;
+		header.border = border;
+		header.levelCount = (uint32_t)levels.size();
+		if (!sourceStamp(sourcePath, header.sourceSize, header.sourceTime)) {
+			throw runtime_error("Failed to open " + sourcePath + ".");
+		}
+		header.pageBytes = storedPageBytes(pageFormat, paddedSize);
+		header.dataOffset = (sizeof(header)
+			+ levels.size() * sizeof(VirtualTextureLevel) + dataAlignment - 1)
+			/ dataAlignment * dataAlignment;
+
+		string tempPath = temporaryCachePath(path);
+		ofstream out(tempPath, ios::binary | ios::trunc);
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)levels.data(),
+			levels.size() * sizeof(VirtualTextureLevel));
+		vector<char> padding(header.dataOffset - (uint64_t)out.tellp(), 0);
+		out.write(padding.data(), padding.size());
+
+		vector<uint8_t> rgba((size_t)paddedSize * paddedSize * 4);
+		vector<uint8_t> page(header.pageBytes);
+		for (uint32_t level = 0; level < levels.size(); level++) {
+			for (uint32_t y = 0; y < levels[level].pagesY; y++) {
+				for (uint32_t x = 0; x < levels[level].pagesX; x++) {
+					copyPage(texture, level, x * pageSize, y * pageSize, border,
+						paddedSize, rgba.data());
+					if (Texture::isCompressed(pageFormat)) {
+						compressTexels(rgba.data(), paddedSize, paddedSize,
+							paddedSize * 4, pageFormat, page.data(),
+							paddedSize / 4 * Texture::formatSize(pageFormat));
+						out.write((const char*)page.data(), page.size());
+					} else {
+						out.write((const char*)rgba.data(), rgba.size());
+					}
+				}
+			}
+		}
+		out.close();
+		if (!out) remove(tempPath.c_str());
+		if (!out || !replaceCacheFile(tempPath, path)) {
+			throw runtime_error("Failed to write " + path + ".");
+		}
+	}
+
+	bool isVirtualTextureCurrent(const string& path, const string& sourcePath,
+		Texture::Format pageFormat) {
+		uint64_t size;
+		int64_t time;
+		MappedFile mapping;
+		VirtualTextureHeader header;
+		vector<VirtualTextureLevel> levels;
+		return sourceStamp(sourcePath, size, time) && mapping.open(path)
+			&& readHeader(mapping.getData(), mapping.getSize(), header, levels)
+			&& header.format == (uint32_t)pageFormat
+			&& header.sourceSize == size && header.sourceTime == time;
+	}
+
+	VirtualTextureFile::VirtualTextureFile(const string& path) {
+		if (!mapping.open(path)) {
+			throw runtime_error("Failed to open virtual texture " + path + ".");
+		}
+		const uint8_t* data = mapping.getData();
+		size_t size = mapping.getSize();
+
+		VirtualTextureHeader header;
+		vector<VirtualTextureLevel> fileLevels;
+		if (!readHeader(data, size, header, fileLevels)) {
+			throw runtime_error("Invalid virtual texture " + path + ".");
+		}
+
+		format = static_cast<Texture::Format>(header.format);
+		for (const VirtualTextureLevel& level : fileLevels) {
+			levels.push_back({ level.pagesX, level.pagesY, level.firstPage });
+		}
+
+		width = header.width;
+		height = header.height;
+		pageSize = header.pageSize;
+		border = header.border;
+		pageBytes = (size_t)header.pageBytes;
+		pages = data + header.dataOffset;
+	}
+}
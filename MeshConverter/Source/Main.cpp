@@ -0,0 +1,75 @@
+#include <Engine/MeshCache.h>
+#include <Engine/MeshGeneration.h>
+#include <Engine/TextureAtlas.h>
+#include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+using namespace Engine;
+
+/*
+ * Writes compressed mesh caches for the given .obj files, so the encoding
+ * is done once offline and loadMesh only decodes. The caches are written
+ * for the flags the sandboxes load with, unless --no-optimize is given,
+ * and with the levels of detail given by --lods.
+ * Atlas .meta files are compiled into .atlas bundles of the .png image
+ * next to them.
+ */
+int main(int argc, char** argv) {
+	MeshLoadFlags flags = MeshLoadFlags::OptimizeVertexCache;
+	unsigned lodLevels = 0;
+	vector<const char*> paths;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--no-optimize") == 0) {
+			flags = MeshLoadFlags::None;
+		} else if (strcmp(argv[i], "--lods") == 0 && i + 1 < argc) {
+			lodLevels = (unsigned)atoi(argv[++i]);
+		} else {
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.empty()) {
+		cerr << "usage: " << argv[0]
+			<< " [--no-optimize] [--lods levels] file.obj|file.meta..." << endl;
+		return 1;
+	}
+
+	try {
+		for (const char* path : paths) {
+			string file = path;
+			size_t extension = file.rfind(".meta");
+			if (extension != string::npos && extension + 5 == file.size()) {
+				string base = file.substr(0, extension);
+				writeAtlasBundle(base + ".png", file, base + ".atlas");
+				TextureAtlas atlas(base + ".atlas");
+				cout << base << ".atlas: " << atlas.getRegions().getCount()
+					<< " regions" << endl;
+				continue;
+			}
+
+			vector<Material> materials;
+			IndexedMesh mesh = loadMesh(path, materials, flags, lodLevels);
+			writeMeshCache(path, flags | MeshLoadFlags::BinaryCache, lodLevels,
+				mesh, materials, true);
+
+			vector<Material> cachedMaterials;
+			IndexedMesh cached;
+			if (!readMeshCache(path, flags | MeshLoadFlags::BinaryCache,
+				lodLevels, cached, cachedMaterials)) {
+				throw runtime_error(string("Could not write cache for ") + path);
+			}
+			cout << meshCachePath(path) << ": "
+				<< mesh.getVertices().size() << " vertices, "
+				<< mesh.getIndices().size() << " indices, "
+				<< mesh.getLods().size() << " levels of detail" << endl;
+		}
+	} catch (const exception& e) {
+		cerr << e.what() << endl;
+		return 1;
+	}
+
+	return 0;
+}
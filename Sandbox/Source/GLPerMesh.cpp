@@ -1,17 +1,53 @@
 #include "GLPerMesh.h"
 #include <Engine/IndexedMesh.h>
+#include <Engine/VertexLayout.h>
+#include <cstring>
 #include <stdexcept>
 
 using namespace std;
 using namespace Engine;
 
-static GLuint createVertexBuffer(const Mesh& mesh) {
+static vector<GLuint> createVertexBuffers(const Mesh& mesh,
+	const VertexQuantization& quantization) {
+	vector<vector<uint8_t>> streams = writeVertexStreams(mesh.getVertexData(),
+		mesh.getVertices().size(), mesh.getVertexFormat(), quantization);
+	vector<GLuint> bufs(streams.size());
+	glGenBuffers((GLsizei)bufs.size(), bufs.data());
+	for (size_t i = 0; i < streams.size(); i++) {
+		glBindBuffer(GL_ARRAY_BUFFER, bufs[i]);
+		glBufferData(
+		GL_ARRAY_BUFFER, streams[i].size(), streams[i].data(),
+		GL_STATIC_DRAW);
+	}
+	return bufs;
+}
+
+/*
+ * One buffer holding copies of the vertices, mapped for as long as it
+ * exists. Coherent mapping makes writes visible to draws issued after
+ * them without flushing.
+ */
+static GLuint createDynamicVertexBuffer(const Mesh& mesh, uint32_t copies,
+	Vertex*& mapped) {
+	if (mesh.getVertexFormat() != VertexFormat::Float) {
+		throw runtime_error("Dynamic meshes must use float vertices.");
+	}
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT
+		| GL_MAP_COHERENT_BIT;
+	GLsizeiptr size = (GLsizeiptr)mesh.getVertexDataSize();
 	GLuint buf;
 	glGenBuffers(1, &buf);
 	glBindBuffer(GL_ARRAY_BUFFER, buf);
-	glBufferData(
-	GL_ARRAY_BUFFER, mesh.getVertexDataSize(), mesh.getVertexData(),
-	GL_STATIC_DRAW);
+	glBufferStorage(GL_ARRAY_BUFFER, size * copies, nullptr, flags);
+	mapped = (Vertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size * copies,
+		flags);
+	if (mapped == nullptr) {
+		throw runtime_error("Failed to map dynamic vertex buffer.");
+	}
+	for (uint32_t c = 0; c < copies; c++) {
+		memcpy(mapped + c * mesh.getVertices().size(), mesh.getVertexData(),
+			size);
+	}
 	return buf;
 }
 
@@ -19,52 +55,77 @@ static GLuint createIndexBuffer(const IndexedMesh& mesh) {
 	GLuint buf;
 	glGenBuffers(1, &buf);
 	glBindBuffer(GL_ARRAY_BUFFER, buf);
+	vector<uint8_t> data(mesh.getIndexBufferSize());
+	mesh.writeIndexBuffer(data.data());
 	glBufferData(
-	GL_ARRAY_BUFFER, mesh.getIndexDataSize(), mesh.getIndexData(),
+	GL_ARRAY_BUFFER, data.size(), data.data(),
 	GL_STATIC_DRAW);
 	return buf;
 }
 
-static GLuint createVAO(GLuint vertexBuffer, GLint vertexPosition,
-	GLint vertexNormal, GLint vertexTextureCoordinate) {
+static void setAttributePointer(GLint location,
+	const VertexAttributeDescription& attribute, GLsizei stride) {
+	GLint size;
+	GLenum type;
+	GLboolean normalized = GL_FALSE;
+	switch (attribute.format) {
+	case AttributeFormat::Float2: size = 2; type = GL_FLOAT; break;
+	case AttributeFormat::Float3: size = 3; type = GL_FLOAT; break;
+	case AttributeFormat::Unorm16x4:
+		size = 4; type = GL_UNSIGNED_SHORT; normalized = GL_TRUE; break;
+	case AttributeFormat::Snorm16x2:
+		size = 2; type = GL_SHORT; normalized = GL_TRUE; break;
+	case AttributeFormat::Half2: size = 2; type = GL_HALF_FLOAT; break;
+	default:
+		throw runtime_error("Unknown attribute format.");
+	}
+	glEnableVertexAttribArray(location);
+	glVertexAttribPointer(location, size, type, normalized, stride,
+		(const GLvoid*)(size_t)attribute.offset);
+}
+
+/*
+ * Attributes are described by the vertex layout of the format; locations
+ * maps their shader input to the attribute location in the program, or -1
+ * when the program does not use it.
+ */
+static GLuint createVAO(const vector<GLuint>& vertexBuffers,
+	VertexFormat format, const GLint* locations) {
 	GLuint vao;
 	glGenVertexArrays(1, &vao);
 	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
 
-	if (vertexPosition >= 0) {
-		glEnableVertexAttribArray(vertexPosition);
-		glVertexAttribPointer(vertexPosition, 3, GL_FLOAT, GL_FALSE,
-			(GLsizei)Vertex::Stride, (const GLvoid*) Vertex::PositionOffset);
-	}
-
-	if (vertexNormal >= 0) {
-		glEnableVertexAttribArray(vertexNormal);
-		glVertexAttribPointer(vertexNormal, 3, GL_FLOAT, GL_FALSE,
-			(GLsizei)Vertex::Stride, (const GLvoid*) Vertex::NormalOffset);
-	}
-
-	if (vertexTextureCoordinate >= 0) {
-		glEnableVertexAttribArray(vertexTextureCoordinate);
-		glVertexAttribPointer(vertexTextureCoordinate, 2, GL_FLOAT, GL_FALSE,
-			(GLsizei)Vertex::Stride, (const GLvoid*) Vertex::TextureCoordinateOffset);
+	VertexInputDescription input = getVertexInputDescription(format);
+	for (uint32_t s = 0; s < input.streamCount; s++) {
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[s]);
+		for (uint32_t a = 0; a < input.attributeCounts[s]; a++) {
+			const VertexAttributeDescription& attribute = input.attributes[s][a];
+			GLint location = locations[attribute.location];
+			if (location >= 0) {
+				setAttributePointer(location, attribute,
+					(GLsizei)input.strides[s]);
+			}
+		}
 	}
 
 	return vao;
 }
 
-static GLuint createVAOIndexed(GLuint vertexBuffer, GLuint indexBuffer,
-	GLint vertexPosition, GLint vertexNormal, GLint vertexTextureCoordinate) {
-	GLuint vao = createVAO(vertexBuffer, vertexPosition, vertexNormal,
-		vertexTextureCoordinate);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-	return vao;
-}
-
 GLPerMesh::GLPerMesh(const Mesh* mesh, GLint vertexPosition, GLint vertexNormal,
 	GLint vertexTextureCoordinate) :
-indexed(false)
+positionVao(0),
+indexed(false),
+indexType(GL_UNSIGNED_INT),
+indexSize(sizeof(uint32_t)),
+dynamic(false),
+vertexCount((uint32_t)mesh->getVertices().size()),
+copy(0),
+baseVertex(0),
+mapped(nullptr)
 {
+	for (GLsync& f : fences) {
+		f = nullptr;
+	}
 	switch (mesh->getTopology()) {
 	case Mesh::Topology::Points: primitiveType = GL_POINTS; break;
 	case Mesh::Topology::Lines: primitiveType = GL_LINES; break;
@@ -77,35 +138,148 @@ indexed(false)
 	}
 
 	elementCount = (uint32_t)mesh->getElementCount();
-	GLuint vertexBuffer = createVertexBuffer(*mesh);
-	buffers.push_back(vertexBuffer);
+	bounds = computeBoundingSphere(mesh->getVertexData(),
+		mesh->getVertices().size());
+	vertexFormat = mesh->getVertexFormat();
+	if (vertexFormat == VertexFormat::Packed) {
+		quantization = computeVertexQuantization(mesh->getVertexData(),
+			mesh->getVertices().size());
+	} else {
+		quantization.offset = glm::vec3();
+		quantization.scale = glm::vec3(1.f);
+	}
+	GLint locations[] = { vertexPosition, vertexNormal,
+		vertexTextureCoordinate };
+	if (dynamic_cast<const DynamicMesh*>(mesh)) {
+		dynamic = true;
+		buffers.push_back(createDynamicVertexBuffer(*mesh, dynamicCopies,
+			mapped));
+	} else {
+		buffers = createVertexBuffers(*mesh, quantization);
+	}
+	vao = createVAO(buffers, vertexFormat, locations);
 	const IndexedMesh* indexedMesh = dynamic_cast<const IndexedMesh*>(mesh);
 	if (indexedMesh) {
 		GLuint indexBuffer = createIndexBuffer(*indexedMesh);
 		buffers.push_back(indexBuffer);
-		vao = createVAOIndexed(vertexBuffer, indexBuffer,
-			vertexPosition, vertexNormal, vertexTextureCoordinate);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
 		indexed = true;
-	} else {
-		vao = createVAO(vertexBuffer, vertexPosition,
-			vertexNormal, vertexTextureCoordinate);
+		indexSize = indexedMesh->getIndexSize();
+		indexType = indexedMesh->getIndexType() == IndexType::UInt16
+			? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		submeshes = indexedMesh->getSubmeshes();
+		lods = indexedMesh->getLods();
+		meshlets = indexedMesh->getMeshlets();
 	}
 }
 
 GLPerMesh::~GLPerMesh() {
+	for (GLsync f : fences) {
+		if (f) glDeleteSync(f);
+	}
 	glDeleteBuffers((GLsizei)buffers.size(), buffers.data());
 	glDeleteVertexArrays(1, &vao);
+	if (positionVao) glDeleteVertexArrays(1, &positionVao);
 }
 
 void GLPerMesh::bind() {
 	glBindVertexArray(vao);
 }
 
-void GLPerMesh::draw() {
-	if (indexed) {
-		glDrawElements(primitiveType, elementCount, GL_UNSIGNED_INT, 0);
+void GLPerMesh::bindPositions(GLint vertexPosition) {
+	if (vertexFormat != VertexFormat::SplitPosition) {
+		throw runtime_error("Only split position meshes have a position stream.");
+	}
+	if (positionVao == 0) {
+		GLint locations[] = { vertexPosition, -1, -1 };
+		positionVao = createVAO(buffers, vertexFormat, locations);
+		if (indexed) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.back());
+		return;
+	}
+	glBindVertexArray(positionVao);
+}
+
+void GLPerMesh::draw(int submesh, unsigned lod) {
+	if (indexed && submesh >= 0 && submesh < (int)submeshes.size()) {
+		const Submesh& s = submeshes[submesh];
+		glDrawElementsBaseVertex(primitiveType, s.indexCount, indexType,
+			(const GLvoid*)(s.firstIndex * indexSize), baseVertex);
+	} else if (indexed && lod > 0 && lod < lods.size()) {
+		const LevelOfDetail& l = lods[lod];
+		glDrawElementsBaseVertex(primitiveType, l.indexCount, indexType,
+			(const GLvoid*)(l.firstIndex * indexSize), baseVertex);
+	} else if (indexed) {
+		glDrawElementsBaseVertex(primitiveType, elementCount, indexType, 0,
+			baseVertex);
 	} else {
-		glDrawArrays(primitiveType, 0, elementCount);
+		glDrawArrays(primitiveType, baseVertex, elementCount);
+	}
+}
+
+void GLPerMesh::drawMeshlets(const vector<uint32_t>& visible) {
+	drawCounts.clear();
+	drawOffsets.clear();
+	uint32_t end = ~0u;
+	for (uint32_t i : visible) {
+		const Meshlet& m = meshlets[i];
+		if (m.firstIndex == end) {
+			drawCounts.back() += m.indexCount;
+		} else {
+			drawCounts.push_back(m.indexCount);
+			drawOffsets.push_back(
+				(const GLvoid*)(m.firstIndex * indexSize));
+		}
+		end = m.firstIndex + m.indexCount;
+	}
+	if (drawCounts.empty()) return;
+	glMultiDrawElements(primitiveType, drawCounts.data(), indexType,
+		drawOffsets.data(), (GLsizei)drawCounts.size());
+}
+
+void GLPerMesh::updateVertices(const Vertex* vertices, size_t count) {
+	if (vertexFormat != VertexFormat::Float) {
+		throw runtime_error("Only float vertices can be updated.");
 	}
+	GLsizeiptr size = (GLsizeiptr)(count * sizeof(Vertex));
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, vertices);
 }
 
+void GLPerMesh::stream(DynamicMesh& mesh) {
+	if (mesh.getVertices().size() != vertexCount) {
+		throw runtime_error("Dynamic meshes can not change vertex count.");
+	}
+	mesh.takeChangedRanges(changed);
+	for (vector<VertexRange>& p : pending) {
+		p.insert(p.end(), changed.begin(), changed.end());
+	}
+
+	copy = (copy + 1) % dynamicCopies;
+	baseVertex = (GLint)(copy * vertexCount);
+	vector<VertexRange>& ranges = pending[copy];
+	if (ranges.empty()) return;
+
+	/*
+	 * The copy was last drawn dynamicCopies frames ago, so this rarely
+	 * waits.
+	 */
+	if (fences[copy]) {
+		glClientWaitSync(fences[copy], GL_SYNC_FLUSH_COMMANDS_BIT,
+			1000000000);
+		glDeleteSync(fences[copy]);
+		fences[copy] = nullptr;
+	}
+	mergeVertexRanges(ranges);
+	Vertex* target = mapped + copy * vertexCount;
+	for (const VertexRange& r : ranges) {
+		memcpy(target + r.first, mesh.getVertexData() + r.first,
+			r.count * sizeof(Vertex));
+	}
+	ranges.clear();
+}
+
+void GLPerMesh::fence() {
+	if (fences[copy]) glDeleteSync(fences[copy]);
+	fences[copy] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -3,7 +3,9 @@
 
 #include <glad/glad.h>
 #include <vector>
-#include <Engine/Mesh.h>
+#include <Engine/DynamicMesh.h>
+#include <Engine/IndexedMesh.h>
+#include <Engine/Bounds.h>
 
 class GLPerMesh {
 public:
@@ -12,14 +14,99 @@ public:
 	~GLPerMesh();
 
 	void bind();
-	void draw();
+
+	/*
+	 * Bind a vertex array of only the position stream of a
+	 * VertexFormat::SplitPosition mesh, for passes that need nothing else.
+	 * It is created on first use for the given attribute location.
+	 */
+	void bindPositions(GLint vertexPosition);
+	void draw(int submesh = -1, unsigned lod = 0);
+
+	/*
+	 * Draw the given meshlets with one glMultiDrawElements call. Meshlets
+	 * next to each other in the index buffer are merged into one range.
+	 */
+	void drawMeshlets(const std::vector<uint32_t>& visible);
+
+	/*
+	 * Replace the vertices of a VertexFormat::Float mesh. The old storage
+	 * is orphaned so the upload does not wait for draws still reading it.
+	 */
+	void updateVertices(const Engine::Vertex* vertices, size_t count);
+
+	/*
+	 * Upload the changes of the DynamicMesh this was created from. Its
+	 * vertices are kept in dynamicCopies copies of one persistently mapped
+	 * buffer; each frame the next copy gets the ranges changed since it was
+	 * last written, and draws read from it. Call once per frame before
+	 * drawing, and fence() after the last draw.
+	 */
+	void stream(Engine::DynamicMesh& mesh);
+
+	/*
+	 * Keep the copy drawn this frame from being written until the GPU has
+	 * finished reading it.
+	 */
+	void fence();
+
+	bool isDynamic() const {
+		return dynamic;
+	}
+
+	const std::vector<Engine::LevelOfDetail>& getLods() const {
+		return lods;
+	}
+
+	const Engine::BoundingSphere& getBounds() const {
+		return bounds;
+	}
+
+	const std::vector<Engine::Meshlet>& getMeshlets() const {
+		return meshlets;
+	}
+
+	Engine::VertexFormat getVertexFormat() const {
+		return vertexFormat;
+	}
+
+	/*
+	 * Position dequantisation for the shaders; identity for float vertices.
+	 */
+	const Engine::VertexQuantization& getQuantization() const {
+		return quantization;
+	}
+
+	/*
+	 * Enough copies that the one written is rarely still being drawn
+	 */
+	static const uint32_t dynamicCopies = 3;
 
 private:
 	GLenum primitiveType;
 	std::vector<GLuint> buffers;
 	GLuint vao;
+	GLuint positionVao;
 	uint32_t elementCount;
 	bool indexed;
+	GLenum indexType;
+	size_t indexSize;
+	Engine::VertexFormat vertexFormat;
+	Engine::VertexQuantization quantization;
+	std::vector<Engine::Submesh> submeshes;
+	std::vector<Engine::LevelOfDetail> lods;
+	std::vector<Engine::Meshlet> meshlets;
+	Engine::BoundingSphere bounds;
+	std::vector<GLsizei> drawCounts;
+	std::vector<const GLvoid*> drawOffsets;
+	bool dynamic;
+	uint32_t vertexCount;
+	uint32_t copy;
+	GLint baseVertex;
+	Engine::Vertex* mapped;
+	GLsync fences[dynamicCopies];
+	std::vector<Engine::VertexRange> pending[dynamicCopies];
+	std::vector<Engine::VertexRange> changed;
 };
 
 #endif
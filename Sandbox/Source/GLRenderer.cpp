@@ -1,20 +1,65 @@
 #include "GLRenderer.h"
+#include <Engine/DynamicMesh.h>
+#include <Engine/SkinnedMesh.h>
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
 
 using namespace std;
 using namespace Engine;
 
+/*
+ * Bytes of the atlas uploaded with it, smallest levels first, and in each
+ * frame after until it is complete
+ */
+static const size_t textureInitialBytes = 64 * 1024;
+static const size_t textureStreamBudget = 1024 * 1024;
+
+/*
+ * Bytes of virtual texture pages uploaded per frame, and pixels across the
+ * block of the screen each pixel of feedback stands for
+ */
+static const size_t pageUploadBudget = 1024 * 1024;
+static const uint32_t feedbackScale = 8;
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+/*
+ * Packed vertices (positionOffset.w = 1) store positions as unorm within
+ * the mesh bounds and normals octahedral encoded. Float vertices use an
+ * offset of 0 and a scale of 1.
+ */
+#define VERTEX_DEQUANTIZATION_SOURCE \
+	"uniform vec4 positionOffset;\n" \
+	"uniform vec4 positionScale;\n" \
+	"vec3 decodePosition(vec3 p) {\n" \
+	"	return positionOffset.xyz + positionScale.xyz * p;\n" \
+	"}\n" \
+	"vec3 decodeNormal(vec3 n) {\n" \
+	"	if (positionOffset.w == 0.0) return n;\n" \
+	"	vec3 o = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));\n" \
+	"	float t = max(-o.z, 0.0);\n" \
+	"	o.xy += vec2(o.x >= 0.0 ? -t : t, o.y >= 0.0 ? -t : t);\n" \
+	"	return o;\n" \
+	"}\n"
+
 const char* vertexShaderSource =
 	"#version 450\n"
+	"invariant gl_Position;\n"
 	"in vec3 vertexPosition;\n"
 	"in vec3 vertexNormal;\n"
 	"out vec3 fragmentNormal;\n"
 	"uniform mat4 worldViewProjectionMatrix;\n"
 	"uniform mat3 normalMatrix;\n"
+	VERTEX_DEQUANTIZATION_SOURCE
 	"void main() {\n"
-	"	fragmentNormal = normalize(normalMatrix * vertexNormal);\n"
-	"	gl_Position = worldViewProjectionMatrix * vec4(vertexPosition, 1);\n"
+	"	fragmentNormal = normalize(normalMatrix * decodeNormal(vertexNormal));\n"
+	"	gl_Position = worldViewProjectionMatrix * vec4(decodePosition(vertexPosition), 1);\n"
 	"}\n";
 
 const char* fragmentShaderSource =
@@ -31,6 +76,7 @@ const char* fragmentShaderSource =
 
 const char* texturedVertexShaderSource =
 	"#version 450\n"
+	"invariant gl_Position;\n"
 	"in vec3 vertexPosition;\n"
 	"in vec3 vertexNormal;\n"
 	"in vec2 vertexTextureCoordinate;\n"
@@ -40,14 +86,70 @@ const char* texturedVertexShaderSource =
 	"uniform mat3 normalMatrix;\n"
 	"uniform vec4 textureRegion;\n"
 	"uniform vec2 textureScale;\n"
+	VERTEX_DEQUANTIZATION_SOURCE
 	"void main() {\n"
-	"	fragmentNormal = normalize(normalMatrix * vertexNormal);\n"
+	"	fragmentNormal = normalize(normalMatrix * decodeNormal(vertexNormal));\n"
 	"	fragmentTextureCoordinate = fract(vertexTextureCoordinate * textureScale);\n"
 	"	fragmentTextureCoordinate *= vec2(textureRegion.z, textureRegion.w);\n"
 	"	fragmentTextureCoordinate += textureRegion.xy;\n"
-	"	gl_Position = worldViewProjectionMatrix * vec4(vertexPosition, 1);\n"
+	"	gl_Position = worldViewProjectionMatrix * vec4(decodePosition(vertexPosition), 1);\n"
 	"}\n";
 
+/*
+ * Depth prepass: positions only, computed exactly as the draw programs
+ * do, so the main pass passes the equal depth test.
+ */
+const char* depthVertexShaderSource =
+	"#version 450\n"
+	"invariant gl_Position;\n"
+	"in vec3 vertexPosition;\n"
+	"uniform mat4 worldViewProjectionMatrix;\n"
+	VERTEX_DEQUANTIZATION_SOURCE
+	"void main() {\n"
+	"	gl_Position = worldViewProjectionMatrix * vec4(decodePosition(vertexPosition), 1);\n"
+	"}\n";
+
+const char* depthFragmentShaderSource =
+	"#version 450\n"
+	"void main() {\n"
+	"}\n";
+
+/*
+ * Virtual textures are sampled from the page of the physical texture the indirection texture points at: the finest
+ * resident page covering the wanted one. One pixel of each feedbackScale
+ * square, offset by feedback.zw, writes the wanted page to feedback.
+ * virtualTextureSize is the width, height, page size and level count, and
+ * physicalTextureSize the padded page size, border and pixels across.
+ */
+#define VIRTUAL_TEXTURE_SOURCE \
+	"uniform sampler2D indirectionSampler;\n" \
+	"uniform sampler2D physicalSampler;\n" \
+	"uniform vec4 virtualTextureSize;\n" \
+	"uniform vec4 physicalTextureSize;\n" \
+	"uniform ivec4 feedback;\n" \
+	"layout(std430, binding = 1) buffer Feedback {\n" \
+	"	uint feedbackPages[];\n" \
+	"};\n" \
+	"vec3 sampleVirtual(vec2 uv) {\n" \
+	"	vec2 texel = uv * virtualTextureSize.xy;\n" \
+	"	vec2 dx = dFdx(texel), dy = dFdy(texel);\n" \
+	"	float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));\n" \
+	"	int level = int(clamp(lod, 0.0, virtualTextureSize.w - 1.0));\n" \
+	"	ivec2 pages = ivec2(virtualTextureSize.xy / virtualTextureSize.z) >> level;\n" \
+	"	ivec2 page = clamp(ivec2(texel / virtualTextureSize.z) >> level, ivec2(0), pages - 1);\n" \
+	"	ivec2 cell = ivec2(gl_FragCoord.xy);\n" \
+	"	if (cell % feedback.y == feedback.zw && cell.x / feedback.y < feedback.x) {\n" \
+	"		uint index = uint(cell.y / feedback.y * feedback.x + cell.x / feedback.y);\n" \
+	"		if (index < uint(feedbackPages.length())) {\n" \
+	"			feedbackPages[index] = uint(level + 1) << 28 | uint(page.y) << 14 | uint(page.x);\n" \
+	"		}\n" \
+	"	}\n" \
+	"	vec3 entry = round(texelFetch(indirectionSampler, page, level).xyz * 255.0);\n" \
+	"	vec2 inPage = mod(texel / exp2(entry.z), virtualTextureSize.z);\n" \
+	"	vec2 physical = entry.xy * physicalTextureSize.x + physicalTextureSize.y + inPage;\n" \
+	"	return textureLod(physicalSampler, physical / physicalTextureSize.z, 0.0).rgb;\n" \
+	"}\n"
+
 const char* texturedFragmentShaderSource =
 	"#version 450\n"
 	"in vec3 fragmentNormal;\n"
@@ -62,6 +164,25 @@ const char* texturedFragmentShaderSource =
 	"	color = texColor * 0.15 + texColor * light;\n"
 	"}\n";
 
+/*
+ * Used only while a virtual texture is set. Feedback is written by the
+ * fragments that pass the depth test, so only visible pages are asked for.
+ */
+const char* virtualTexturedFragmentShaderSource =
+	"#version 450\n"
+	"layout(early_fragment_tests) in;\n"
+	"in vec3 fragmentNormal;\n"
+	"in vec2 fragmentTextureCoordinate;\n"
+	"out vec3 color;\n"
+	"uniform vec3 lightDirection;\n"
+	"uniform vec3 lightColor;\n"
+	VIRTUAL_TEXTURE_SOURCE
+	"void main() {\n"
+	"	vec3 light = clamp(dot(lightDirection, fragmentNormal), 0.0, 1.0) * lightColor * 0.85;\n"
+	"	vec3 texColor = sampleVirtual(fragmentTextureCoordinate);\n"
+	"	color = texColor * 0.15 + texColor * light;\n"
+	"}\n";
+
 static GLuint createShader(GLenum type, const char* source) {
 	GLuint handle = glCreateShader(type);
 	glShaderSource(handle, 1, &source, nullptr);
@@ -83,7 +204,12 @@ static GLuint createShader(GLenum type, const char* source) {
 	return handle;
 }
 
-static GLuint createDrawProgram(const char* vshader, const char* fshader) {
+/*
+ * Attributes are bound at their locations in attributeProgram, if given, so
+ * meshes set up for that program draw with this one too.
+ */
+static GLuint createDrawProgram(const char* vshader, const char* fshader,
+	GLuint attributeProgram = 0) {
 	GLuint vertexShader = createShader(GL_VERTEX_SHADER, vshader);
 	GLuint fragmentShader = createShader(GL_FRAGMENT_SHADER, fshader);
 	GLuint handle = glCreateProgram();
@@ -99,6 +225,20 @@ static GLuint createDrawProgram(const char* vshader, const char* fshader) {
 		throw runtime_error("Unable to attach fragment shader.");
 	}
 
+	if (attributeProgram) {
+		GLint count = 0;
+		glGetProgramiv(attributeProgram, GL_ACTIVE_ATTRIBUTES, &count);
+		for (GLint i = 0; i < count; i++) {
+			char name[64];
+			GLint size;
+			GLenum type;
+			glGetActiveAttrib(attributeProgram, i, sizeof(name), nullptr, &size,
+				&type, name);
+			glBindAttribLocation(handle,
+				glGetAttribLocation(attributeProgram, name), name);
+		}
+	}
+
 	glLinkProgram(handle);
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
@@ -119,55 +259,121 @@ static GLuint createDrawProgram(const char* vshader, const char* fshader) {
 	return handle;
 }
 
-static GLuint createTexture(const Texture* tex) {
-	GLuint handle;
-	glGenTextures(1, &handle);
-	glBindTexture(GL_TEXTURE_2D, handle);
-
-	GLint internalFormat;
-	GLenum format;
-	switch(tex->getFormat()) {
+/*
+ * Sized format to allocate a texture with, and the format of the pixels
+ * of uncompressed textures.
+ */
+static void textureFormat(Texture::Format textureFormat, GLenum& internalFormat,
+	GLenum& format) {
+	switch(textureFormat) {
 	case Texture::Format::Grey:
-		internalFormat = GL_RED;
+		internalFormat = GL_R8;
 		format = GL_RED;
 		break;
 	case Texture::Format::GreyAlpha:
-		internalFormat = GL_RG;
+		internalFormat = GL_RG8;
 		format = GL_RG;
 		break;
 	case Texture::Format::RGBA:
-		internalFormat = GL_RGBA;
+		internalFormat = GL_RGBA8;
+		format = GL_RGBA;
+		break;
+	case Texture::Format::BC1:
+		internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		format = GL_RGBA;
+		break;
+	case Texture::Format::BC3:
+		internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		format = GL_RGBA;
+		break;
+	case Texture::Format::BC7:
+		internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
 		format = GL_RGBA;
 		break;
 	}
+}
 
-	glTexImage2D(
-		GL_TEXTURE_2D,
-		0,
-		internalFormat,
-		tex->getWidth(),
-		tex->getHeight(),
-		0,
-		format,
-		GL_UNSIGNED_BYTE,
-		tex->getPixelData()
-	);
+/*
+ * Allocate every level of a texture, leaving the pixels to be streamed in.
+ */
+static GLuint createTexture(const Texture* tex) {
+	GLuint handle;
+	glGenTextures(1, &handle);
+	glBindTexture(GL_TEXTURE_2D, handle);
+
+	GLenum internalFormat, format;
+	textureFormat(tex->getFormat(), internalFormat, format);
+	glTexStorage2D(GL_TEXTURE_2D, tex->getLevelCount(), internalFormat,
+		tex->getWidth(), tex->getHeight());
 
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+		tex->getLevelCount() - 1);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+		tex->getLevelCount() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 
 	return handle;
 }
 
+/*
+ * Copy rows of a level into the bound texture.
+ */
+static void uploadTextureRows(const TextureStreamer& streamer,
+	const TextureUpload& upload) {
+	const Texture& tex = streamer.getTexture();
+	GLenum internalFormat, format;
+	textureFormat(tex.getFormat(), internalFormat, format);
+	PixelRect rect = streamer.getRect(upload);
+
+	/* Compressed levels are stored with rows of blocks packed tight. */
+	if (Texture::isCompressed(tex.getFormat())) {
+		glCompressedTexSubImage2D(
+			GL_TEXTURE_2D,
+			upload.level,
+			rect.x,
+			rect.y,
+			rect.width,
+			rect.height,
+			internalFormat,
+			(GLsizei)streamer.getSize(upload),
+			streamer.getData(upload)
+		);
+		return;
+	}
+
+	/* Rows are read at the level's pitch instead of 4 byte aligned. */
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, tex.getLevel(upload.level).rowPitch
+		/ Texture::formatSize(tex.getFormat()));
+	glTexSubImage2D(
+		GL_TEXTURE_2D,
+		upload.level,
+		rect.x,
+		rect.y,
+		rect.width,
+		rect.height,
+		format,
+		GL_UNSIGNED_BYTE,
+		streamer.getData(upload)
+	);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
 GLRenderer::GLRenderer(GLWindow& window) :
 Renderer(),
 window(window),
 texture(0),
 haveTexture(false),
+haveVirtualTexture(false),
+feedbackFrame(0),
 particleSystem(nullptr)
 {
 	drawProgram = createDrawProgram(vertexShaderSource, fragmentShaderSource);
-	texturedDrawProgram = createDrawProgram(texturedVertexShaderSource, texturedFragmentShaderSource);
+	texturedProgram.program = createDrawProgram(texturedVertexShaderSource, texturedFragmentShaderSource);
+	virtualTexturedProgram.program = createDrawProgram(texturedVertexShaderSource,
+		virtualTexturedFragmentShaderSource, texturedProgram.program);
+	depthProgram = createDrawProgram(depthVertexShaderSource, depthFragmentShaderSource);
 
 	vertexPosition = glGetAttribLocation(drawProgram, "vertexPosition");
 	vertexNormal = glGetAttribLocation(drawProgram, "vertexNormal");
@@ -176,16 +382,34 @@ particleSystem(nullptr)
 	entityColorUniform = glGetUniformLocation(drawProgram, "entityColor");
 	lightDirectionUniform = glGetUniformLocation(drawProgram, "lightDirection");
 	lightColorUniform = glGetUniformLocation(drawProgram, "lightColor");
+	positionOffsetUniform = glGetUniformLocation(drawProgram, "positionOffset");
+	positionScaleUniform = glGetUniformLocation(drawProgram, "positionScale");
 
-	texturedVertexPosition = glGetAttribLocation(texturedDrawProgram, "vertexPosition");
-	texturedVertexNormal = glGetAttribLocation(texturedDrawProgram, "vertexNormal");
-	texturedVertexTextureCoordinate = glGetAttribLocation(texturedDrawProgram, "vertexTextureCoordinate");
-	texturedWorldViewProjectionMatrixUniform = glGetUniformLocation(texturedDrawProgram, "worldViewProjectionMatrix");
-	texturedNormalMatrixUniform = glGetUniformLocation(texturedDrawProgram, "normalMatrix");
-	texturedLightDirectionUniform = glGetUniformLocation(texturedDrawProgram, "lightDirection");
-	texturedLightColorUniform = glGetUniformLocation(texturedDrawProgram, "lightColor");
-	textureRegionUniform = glGetUniformLocation(texturedDrawProgram, "textureRegion");
-	textureScaleUniform = glGetUniformLocation(texturedDrawProgram, "textureScale");
+	texturedVertexPosition = glGetAttribLocation(texturedProgram.program, "vertexPosition");
+	texturedVertexNormal = glGetAttribLocation(texturedProgram.program, "vertexNormal");
+	texturedVertexTextureCoordinate = glGetAttribLocation(texturedProgram.program, "vertexTextureCoordinate");
+	for (TexturedProgram* textured : { &texturedProgram, &virtualTexturedProgram }) {
+		GLuint program = textured->program;
+		textured->worldViewProjectionMatrixUniform = glGetUniformLocation(program, "worldViewProjectionMatrix");
+		textured->normalMatrixUniform = glGetUniformLocation(program, "normalMatrix");
+		textured->lightDirectionUniform = glGetUniformLocation(program, "lightDirection");
+		textured->lightColorUniform = glGetUniformLocation(program, "lightColor");
+		textured->textureRegionUniform = glGetUniformLocation(program, "textureRegion");
+		textured->textureScaleUniform = glGetUniformLocation(program, "textureScale");
+		textured->positionOffsetUniform = glGetUniformLocation(program, "positionOffset");
+		textured->positionScaleUniform = glGetUniformLocation(program, "positionScale");
+	}
+	GLuint virtualProgram = virtualTexturedProgram.program;
+	indirectionSamplerUniform = glGetUniformLocation(virtualProgram, "indirectionSampler");
+	physicalSamplerUniform = glGetUniformLocation(virtualProgram, "physicalSampler");
+	virtualTextureSizeUniform = glGetUniformLocation(virtualProgram, "virtualTextureSize");
+	physicalTextureSizeUniform = glGetUniformLocation(virtualProgram, "physicalTextureSize");
+	feedbackUniform = glGetUniformLocation(virtualProgram, "feedback");
+
+	depthVertexPosition = glGetAttribLocation(depthProgram, "vertexPosition");
+	depthWorldViewProjectionMatrixUniform = glGetUniformLocation(depthProgram, "worldViewProjectionMatrix");
+	depthPositionOffsetUniform = glGetUniformLocation(depthProgram, "positionOffset");
+	depthPositionScaleUniform = glGetUniformLocation(depthProgram, "positionScale");
 
 	glUseProgram(drawProgram);
 
@@ -194,7 +418,11 @@ particleSystem(nullptr)
 
 GLRenderer::~GLRenderer() {
 	glDeleteProgram(drawProgram);
+	glDeleteProgram(texturedProgram.program);
+	glDeleteProgram(virtualTexturedProgram.program);
+	glDeleteProgram(depthProgram);
 	if (haveTexture) glDeleteTextures(1, &texture);
+	deleteVirtualTexture();
 }
 
 void GLRenderer::render() {
@@ -207,11 +435,16 @@ void GLRenderer::render() {
 	}
 #endif
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	for (const Entity* e : entities) {
+	streamTexture(textureStreamBudget);
+	streamVirtualTexture(pageUploadBudget);
+	skinEntities();
+	drawDepthPrepass();
+	const GLPerMesh* boundMesh = nullptr;
+	for (Entity* e : entities) {
 		const Material* material = e->getGeometry()->getMaterial();
 		const Mesh* mesh = e->getGeometry()->getMesh();
 		auto result = meshCache.find(mesh);
-		if (result == meshCache.end()) {
+		if (e->getSkeleton() == nullptr && result == meshCache.end()) {
 			shared_ptr<GLPerMesh> perMesh;
 			if (material->isTextured()) {
 				perMesh = make_shared<GLPerMesh>(mesh,
@@ -224,6 +457,30 @@ void GLRenderer::render() {
 			meshCache[mesh] = perMesh;
 		}
 
+		shared_ptr<GLPerMesh> perMesh;
+		bool skinned = e->getSkeleton() != nullptr;
+		if (skinned) {
+			SkinnedEntity& s = skinnedEntities[e];
+			perMesh = s.perMesh;
+			perMesh->updateVertices(s.vertices.data(), s.vertices.size());
+		} else {
+			perMesh = meshCache[mesh];
+		}
+
+		/*
+		 * Dynamic meshes stream their changes once per frame, however many
+		 * entities draw them.
+		 */
+		bool dynamic = perMesh->isDynamic();
+		if (dynamic && find(streamedMeshes.begin(), streamedMeshes.end(),
+			perMesh.get()) == streamedMeshes.end()) {
+			perMesh->stream(*static_cast<DynamicMesh*>(
+				e->getGeometry()->getMesh()));
+			streamedMeshes.push_back(perMesh.get());
+		}
+		bool whole = skinned || dynamic;
+		if (!whole && !isVisible(*e, perMesh->getBounds())) continue;
+
 		glm::mat4 worldMatrix = e->getNode()->getWorldMatrix()
 			* e->getScaleMatrix();
 		glm::mat4 worldViewProjectionMatrix = camera->getProjectionMatrix()
@@ -231,19 +488,32 @@ void GLRenderer::render() {
 		glm::mat3 normalMatrix =
 			glm::mat3(glm::transpose(glm::inverse(worldMatrix)));
 
+		const VertexQuantization& quantization = perMesh->getQuantization();
+		glm::vec4 positionOffset(quantization.offset,
+			perMesh->getVertexFormat() == VertexFormat::Packed ? 1.f : 0.f);
+		glm::vec4 positionScale(quantization.scale, 0.f);
+
 		if (material->isTextured()) {
-			glUseProgram(texturedDrawProgram);
-			glUniformMatrix4fv(texturedWorldViewProjectionMatrixUniform, 1, GL_FALSE,
+			const TexturedProgram& textured = haveVirtualTexture
+				? virtualTexturedProgram : texturedProgram;
+			glUseProgram(textured.program);
+			glUniformMatrix4fv(textured.worldViewProjectionMatrixUniform, 1, GL_FALSE,
 				glm::value_ptr(worldViewProjectionMatrix));
-			glUniformMatrix3fv(texturedNormalMatrixUniform, 1, GL_FALSE,
+			glUniformMatrix3fv(textured.normalMatrixUniform, 1, GL_FALSE,
 				glm::value_ptr(normalMatrix));
-			glUniform3fv(texturedLightDirectionUniform, 1,
+			glUniform3fv(textured.lightDirectionUniform, 1,
 				glm::value_ptr(lightSources[0]->getDirection()));
-			glUniform3fv(texturedLightColorUniform, 1,
+			glUniform3fv(textured.lightColorUniform, 1,
 				glm::value_ptr(lightSources[0]->getColor()));
-			TextureRect region = textureAtlas->getRegion(material->getTextureName());
-			glUniform4fv(textureRegionUniform, 1, (const GLfloat*)&region);
-			glUniform2fv(textureScaleUniform, 1, glm::value_ptr(material->getTextureScale()));
+			uint32_t regionId = material->getRegionId();
+			TextureRect region = regionId != RegionTable::none
+				? textureAtlas->getRegion(regionId) : TextureRect{ 0.f, 0.f, 1.f, 1.f };
+			glUniform4fv(textured.textureRegionUniform, 1, (const GLfloat*)&region);
+			glUniform2fv(textured.textureScaleUniform, 1, glm::value_ptr(material->getTextureScale()));
+			glUniform4fv(textured.positionOffsetUniform, 1,
+				glm::value_ptr(positionOffset));
+			glUniform4fv(textured.positionScaleUniform, 1,
+				glm::value_ptr(positionScale));
 		} else {
 			glUseProgram(drawProgram);
 			glUniformMatrix4fv(worldViewProjectionMatrixUniform, 1, GL_FALSE,
@@ -256,11 +526,40 @@ void GLRenderer::render() {
 				glm::value_ptr(lightSources[0]->getDirection()));
 			glUniform3fv(lightColorUniform, 1,
 				glm::value_ptr(lightSources[0]->getColor()));
+			glUniform4fv(positionOffsetUniform, 1,
+				glm::value_ptr(positionOffset));
+			glUniform4fv(positionScaleUniform, 1,
+				glm::value_ptr(positionScale));
 		}
 
-		shared_ptr<GLPerMesh> perMesh = meshCache[mesh];
-		perMesh->bind();
-		perMesh->draw();
+		if (perMesh.get() != boundMesh) {
+			perMesh->bind();
+			boundMesh = perMesh.get();
+		}
+		/*
+		 * Bounds, levels of detail and meshlet cones are of the bind pose
+		 * or the first upload, so skinned and dynamic meshes are drawn whole.
+		 */
+		int submesh = e->getGeometry()->getSubmesh();
+		unsigned lod = submesh < 0 && !whole ? selectLod(*e,
+			perMesh->getLods(), perMesh->getBounds(),
+			(float)window.getHeight()) : 0;
+		if (submesh < 0 && lod == 0 && !whole
+			&& !perMesh->getMeshlets().empty()) {
+			cullMeshlets(*e, perMesh->getMeshlets(), visibleMeshlets);
+			perMesh->drawMeshlets(visibleMeshlets);
+		} else {
+			perMesh->draw(submesh, lod);
+		}
+	}
+	for (GLPerMesh* perMesh : streamedMeshes) {
+		perMesh->fence();
+	}
+	streamedMeshes.clear();
+	if (haveVirtualTexture) {
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		feedbackFences[feedbackFrame % 2] =
+			glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 	}
 	if (particleSystem) particleSystem->draw(*camera);
 	window.present();
@@ -270,9 +569,277 @@ void GLRenderer::render() {
 	currentTime = seconds;
 }
 
+/*
+ * Lay down the depth of meshes with positions in their own stream,
+ * fetching only that stream, so the main pass shades each of their pixels
+ * once. Meshes are drawn from the first frame they have buffers in; the
+ * meshlets of the main pass are covered by their whole level.
+ */
+void GLRenderer::drawDepthPrepass() {
+	bool started = false;
+	for (Entity* e : entities) {
+		if (e->getSkeleton() != nullptr) continue;
+		auto result = meshCache.find(e->getGeometry()->getMesh());
+		if (result == meshCache.end()) continue;
+		GLPerMesh& perMesh = *result->second;
+		if (perMesh.getVertexFormat() != VertexFormat::SplitPosition
+			|| perMesh.isDynamic() || !isVisible(*e, perMesh.getBounds())) {
+			continue;
+		}
+		if (!started) {
+			glUseProgram(depthProgram);
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			started = true;
+		}
+
+		glm::mat4 worldMatrix = e->getNode()->getWorldMatrix()
+			* e->getScaleMatrix();
+		glm::mat4 worldViewProjectionMatrix = camera->getProjectionMatrix()
+			* camera->getViewMatrix() * worldMatrix;
+		const VertexQuantization& quantization = perMesh.getQuantization();
+		glUniformMatrix4fv(depthWorldViewProjectionMatrixUniform, 1, GL_FALSE,
+			glm::value_ptr(worldViewProjectionMatrix));
+		glUniform4fv(depthPositionOffsetUniform, 1,
+			glm::value_ptr(glm::vec4(quantization.offset, 0.f)));
+		glUniform4fv(depthPositionScaleUniform, 1,
+			glm::value_ptr(glm::vec4(quantization.scale, 0.f)));
+
+		perMesh.bindPositions(depthVertexPosition);
+		int submesh = e->getGeometry()->getSubmesh();
+		unsigned lod = submesh < 0 ? selectLod(*e, perMesh.getLods(),
+			perMesh.getBounds(), (float)window.getHeight()) : 0;
+		perMesh.draw(submesh, lod);
+	}
+	if (started) glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void GLRenderer::skinEntities() {
+	for (vector<SkinningJob>& jobs : skinningJobs) {
+		jobs.clear();
+	}
+	for (Entity* e : entities) {
+		const Skeleton* skeleton = e->getSkeleton();
+		if (skeleton == nullptr) continue;
+		const SkinnedMesh* mesh = dynamic_cast<const SkinnedMesh*>(
+			e->getGeometry()->getMesh());
+		if (mesh == nullptr) {
+			throw runtime_error("Entity with a skeleton has no skinned mesh.");
+		}
+
+		SkinnedEntity& skinned = skinnedEntities[e];
+		if (!skinned.perMesh) {
+			if (e->getGeometry()->getMaterial()->isTextured()) {
+				skinned.perMesh = make_shared<GLPerMesh>(mesh,
+					texturedVertexPosition, texturedVertexNormal,
+					texturedVertexTextureCoordinate);
+			} else {
+				skinned.perMesh = make_shared<GLPerMesh>(mesh,
+					vertexPosition, vertexNormal, -1);
+			}
+			skinned.vertices.resize(mesh->getVertices().size());
+		}
+
+		SkinningJob job;
+		job.bindPose = mesh->getVertexData();
+		job.weights = mesh->getSkinWeights().data();
+		job.vertexCount = mesh->getVertices().size();
+		job.jointMatrices = nullptr;
+		job.jointDualQuaternions = nullptr;
+		job.skinned = skinned.vertices.data();
+		if (e->getSkinningMethod() == SkinningMethod::LinearBlend) {
+			skeleton->computeJointMatrices(skinned.jointMatrices);
+			job.jointMatrices = skinned.jointMatrices.data();
+		} else {
+			skeleton->computeJointDualQuaternions(
+				skinned.jointDualQuaternions);
+			job.jointDualQuaternions = skinned.jointDualQuaternions.data();
+		}
+		skinningJobs[(size_t)e->getSkinningMethod()].push_back(job);
+	}
+	skinVertices(skinningJobs[0].data(), skinningJobs[0].size(),
+		SkinningMethod::LinearBlend);
+	skinVertices(skinningJobs[1].data(), skinningJobs[1].size(),
+		SkinningMethod::DualQuaternion);
+}
+
 void GLRenderer::setTextureAtlas(const Engine::TextureAtlas* atlas) {
 	Renderer::setTextureAtlas(atlas);
+	if (virtualTexture) return;
 	if (haveTexture) glDeleteTextures(1, &texture);
 	texture = createTexture(atlas->getTexture());
 	haveTexture = true;
+	textureStreamer.reset(new TextureStreamer(*atlas->getTexture()));
+	streamTexture(textureInitialBytes);
+}
+
+/*
+ * Upload the next rows of the atlas, up to budget bytes, and let sampling
+ * reach down to the finest level that is complete.
+ */
+void GLRenderer::streamTexture(size_t budget) {
+	if (!textureStreamer || textureStreamer->isComplete()) return;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	TextureUpload upload;
+	while (textureStreamer->next(budget, upload)) {
+		uploadTextureRows(*textureStreamer, upload);
+		budget -= min(budget, textureStreamer->getSize(upload));
+	}
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD,
+		(GLfloat)textureStreamer->getResidentLevel());
+}
+
+/*
+ * Allocate the indirection texture, one texel per page with a level per
+ * level of the virtual texture, the physical texture of page slots, and
+ * the feedback buffers. The pages are uploaded as update hands them out.
+ */
+void GLRenderer::setVirtualTexture(VirtualTexture* vt) {
+	Renderer::setVirtualTexture(vt);
+	deleteVirtualTexture();
+	if (!vt) return;
+
+	const VirtualTextureFile& file = vt->getFile();
+	if (!supportsTextureFormat(file.getFormat())) {
+		throw runtime_error("Virtual texture pages can not be sampled.");
+	}
+	GLenum internalFormat, format;
+	textureFormat(file.getFormat(), internalFormat, format);
+
+	glActiveTexture(GL_TEXTURE1);
+	glGenTextures(1, &indirectionTexture);
+	glBindTexture(GL_TEXTURE_2D, indirectionTexture);
+	glTexStorage2D(GL_TEXTURE_2D, file.getLevelCount(), GL_RGBA8,
+		file.getPagesX(0), file.getPagesY(0));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+		file.getLevelCount() - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+		GL_NEAREST_MIPMAP_NEAREST);
+
+	glActiveTexture(GL_TEXTURE2);
+	glGenTextures(1, &physicalTexture);
+	glBindTexture(GL_TEXTURE_2D, physicalTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, vt->getPhysicalSize(),
+		vt->getPhysicalSize());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glActiveTexture(GL_TEXTURE0);
+
+	/* Pixels beyond the window size at this point write no feedback. */
+	feedbackWidth = (window.getWidth() + feedbackScale - 1) / feedbackScale;
+	uint32_t feedbackHeight =
+		(window.getHeight() + feedbackScale - 1) / feedbackScale;
+	feedback.resize((size_t)feedbackWidth * feedbackHeight);
+	glGenBuffers(2, feedbackBuffers);
+	for (GLuint buffer : feedbackBuffers) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER,
+			feedback.size() * sizeof(uint32_t), nullptr, GL_DYNAMIC_READ);
+	}
+	feedbackFences[0] = feedbackFences[1] = nullptr;
+	haveVirtualTexture = true;
+
+	glUseProgram(virtualTexturedProgram.program);
+	glUniform1i(indirectionSamplerUniform, 1);
+	glUniform1i(physicalSamplerUniform, 2);
+	glUniform4f(virtualTextureSizeUniform, (GLfloat)file.getWidth(),
+		(GLfloat)file.getHeight(), (GLfloat)file.getPageSize(),
+		(GLfloat)file.getLevelCount());
+	glUniform4f(physicalTextureSizeUniform, (GLfloat)file.getPaddedSize(),
+		(GLfloat)file.getBorder(), (GLfloat)vt->getPhysicalSize(), 0.f);
+}
+
+void GLRenderer::deleteVirtualTexture() {
+	if (!haveVirtualTexture) return;
+	glDeleteTextures(1, &indirectionTexture);
+	glDeleteTextures(1, &physicalTexture);
+	glDeleteBuffers(2, feedbackBuffers);
+	for (GLsync fence : feedbackFences) {
+		if (fence) glDeleteSync(fence);
+	}
+	haveVirtualTexture = false;
+}
+
+/*
+ * Queue the pages wanted by the feedback of two frames ago, then upload
+ * the pages read since, up to budget bytes, and the indirection texels
+ * they change. This frame writes its feedback into the buffer just read.
+ */
+void GLRenderer::streamVirtualTexture(size_t budget) {
+	if (!haveVirtualTexture) return;
+	feedbackFrame++;
+	GLuint buffer = feedbackBuffers[feedbackFrame % 2];
+	GLsync& fence = feedbackFences[feedbackFrame % 2];
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	if (fence) {
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(fence);
+		fence = nullptr;
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+			feedback.size() * sizeof(uint32_t), feedback.data());
+		virtualTexture->requestPages(feedback.data(), feedback.size());
+	}
+	GLuint none = 0;
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER,
+		GL_UNSIGNED_INT, &none);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffer);
+
+	const VirtualTextureFile& file = virtualTexture->getFile();
+	GLenum internalFormat, format;
+	textureFormat(file.getFormat(), internalFormat, format);
+	GLsizei padded = file.getPaddedSize();
+	uint32_t slotsPerSide = virtualTexture->getSlotsPerSide();
+	virtualTexture->update(budget, pageUploads);
+	glActiveTexture(GL_TEXTURE2);
+	for (const PageUpload& upload : pageUploads) {
+		GLint x = upload.slot % slotsPerSide * padded;
+		GLint y = upload.slot / slotsPerSide * padded;
+		if (Texture::isCompressed(file.getFormat())) {
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, padded, padded,
+				internalFormat, (GLsizei)file.getPageBytes(), upload.data);
+		} else {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, padded, padded, format,
+				GL_UNSIGNED_BYTE, upload.data);
+		}
+	}
+
+	glActiveTexture(GL_TEXTURE1);
+	for (uint32_t level = 0; level < file.getLevelCount(); level++) {
+		PixelRect rect;
+		if (!virtualTexture->getChangedRect(level, rect)) continue;
+		uint32_t pagesX = file.getPagesX(level);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, pagesX);
+		glTexSubImage2D(GL_TEXTURE_2D, level, rect.x, rect.y, rect.width,
+			rect.height, GL_RGBA, GL_UNSIGNED_BYTE,
+			virtualTexture->getIndirection(level) + (size_t)rect.y * pagesX
+				+ rect.x);
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	virtualTexture->clearChanges();
+	glActiveTexture(GL_TEXTURE0);
+
+	/*
+	 * Each frame a different pixel of every block writes feedback, so
+	 * small details are seen within a few frames.
+	 */
+	uint32_t cell = feedbackFrame * 7 % (feedbackScale * feedbackScale);
+	glUseProgram(virtualTexturedProgram.program);
+	glUniform4i(feedbackUniform, feedbackWidth, feedbackScale,
+		cell % feedbackScale, cell / feedbackScale);
+}
+
+bool GLRenderer::supportsTextureFormat(Texture::Format format) const {
+	switch (format) {
+	case Texture::Format::BC1:
+	case Texture::Format::BC3:
+		return glfwExtensionSupported("GL_EXT_texture_compression_s3tc") != 0;
+	case Texture::Format::BC7:
+		return GLAD_GL_VERSION_4_2
+			|| glfwExtensionSupported("GL_ARB_texture_compression_bptc") != 0;
+	default:
+		return true;
+	}
 }
@@ -2,6 +2,7 @@
 #define GLRENDERER_H
 
 #include <Engine/Renderer.h>
+#include <Engine/TextureStreamer.h>
 #include <unordered_map>
 #include <memory>
 #include "GLPerMesh.h"
@@ -16,29 +17,87 @@ public:
 	void render() override;
 
 	void setTextureAtlas(const Engine::TextureAtlas* atlas) override;
+	void setVirtualTexture(Engine::VirtualTexture* vt) override;
+	bool supportsTextureFormat(Engine::Texture::Format format) const override;
 	void setParticleSystem(ParticleSystem* ps) {
 		particleSystem = ps;
 	}
 
 private:
+	/*
+	 * CPU skinned vertices of an entity with a skeleton, uploaded to its
+	 * own buffers every frame.
+	 */
+	struct SkinnedEntity {
+		std::shared_ptr<GLPerMesh> perMesh;
+		std::vector<Engine::Vertex> vertices;
+		std::vector<glm::mat4> jointMatrices;
+		std::vector<glm::fdualquat> jointDualQuaternions;
+	};
+
+	/*
+	 * Program for textured materials and its uniforms, one sampling the
+	 * texture and one the virtual texture.
+	 */
+	struct TexturedProgram {
+		GLuint program;
+		GLint worldViewProjectionMatrixUniform,
+			  normalMatrixUniform,
+			  lightDirectionUniform,
+			  lightColorUniform,
+			  textureRegionUniform,
+			  textureScaleUniform,
+			  positionOffsetUniform,
+			  positionScaleUniform;
+	};
+
+	void drawDepthPrepass();
+	void skinEntities();
+	void streamTexture(size_t budget);
+	void streamVirtualTexture(size_t budget);
+	void deleteVirtualTexture();
+
 	GLWindow& window;
-	GLuint drawProgram, texturedDrawProgram;
+	GLuint drawProgram, depthProgram;
+	TexturedProgram texturedProgram, virtualTexturedProgram;
 	GLint vertexPosition, vertexNormal;
 	GLint texturedVertexPosition, texturedVertexNormal, texturedVertexTextureCoordinate;
 	GLint worldViewProjectionMatrixUniform,
 		  normalMatrixUniform,
 		  entityColorUniform,
 		  lightDirectionUniform,
-		  lightColorUniform;
-	GLint texturedWorldViewProjectionMatrixUniform,
-		  texturedNormalMatrixUniform,
-		  texturedLightDirectionUniform,
-		  texturedLightColorUniform,
-		  textureRegionUniform,
-		  textureScaleUniform;
+		  lightColorUniform,
+		  positionOffsetUniform,
+		  positionScaleUniform;
+	GLint indirectionSamplerUniform,
+		  physicalSamplerUniform,
+		  virtualTextureSizeUniform,
+		  physicalTextureSizeUniform,
+		  feedbackUniform;
+	GLint depthVertexPosition,
+		  depthWorldViewProjectionMatrixUniform,
+		  depthPositionOffsetUniform,
+		  depthPositionScaleUniform;
 	std::unordered_map<const Engine::Mesh*, std::shared_ptr<GLPerMesh>> meshCache;
+	std::unordered_map<const Engine::Entity*, SkinnedEntity> skinnedEntities;
+	std::vector<Engine::SkinningJob> skinningJobs[2];
+	std::vector<GLPerMesh*> streamedMeshes;
 	GLuint texture;
 	bool haveTexture;
+	std::unique_ptr<Engine::TextureStreamer> textureStreamer;
+	GLuint indirectionTexture, physicalTexture;
+	bool haveVirtualTexture;
+	/*
+	 * Feedback is written to one buffer while the other, from the frame
+	 * before, is still being drawn. Each is read back once its fence is
+	 * passed.
+	 */
+	GLuint feedbackBuffers[2];
+	GLsync feedbackFences[2];
+	unsigned feedbackFrame;
+	uint32_t feedbackWidth;
+	std::vector<uint32_t> feedback;
+	std::vector<Engine::PageUpload> pageUploads;
 
 	ParticleSystem* particleSystem;
 	double currentTime;
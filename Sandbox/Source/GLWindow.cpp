@@ -47,6 +47,7 @@ void GLWindow::init() {
 
 	glfwSwapInterval(1);
 	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
 	glEnable(GL_CULL_FACE);
 	glClearColor(0.5f, 0.5f, 0.5f, 1.f);
 	glViewport(0, 0, width, height);
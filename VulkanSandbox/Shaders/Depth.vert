@@ -0,0 +1,23 @@
+#version 450 core
+
+layout (location = 0) in vec3 vertexPosition;
+
+layout (set = 0, binding = 0) uniform EntityData {
+	mat4 mvp;
+	mat4 normal;
+	vec4 color;
+	vec4 positionOffset;
+	vec4 positionScale;
+} entityData;
+
+invariant gl_Position;
+
+vec3 decodePosition(vec3 p) {
+    return entityData.positionOffset.xyz + entityData.positionScale.xyz * p;
+}
+
+void main() {
+    gl_Position = entityData.mvp * vec4(decodePosition(vertexPosition), 1.0);
+    gl_Position.z = (gl_Position.z + gl_Position.w) / 2.0;
+    gl_Position.y = -gl_Position.y;
+}
@@ -15,15 +15,31 @@ layout (set = 0, binding = 0) uniform EntityData {
 	mat4 mvp;
 	mat4 normal;
 	vec4 color;
+	vec4 positionOffset;
+	vec4 positionScale;
 	TextureRect textureRegion;
 	vec2 textureScale;
 } entityData;
 
+invariant gl_Position;
+
+vec3 decodePosition(vec3 p) {
+    return entityData.positionOffset.xyz + entityData.positionScale.xyz * p;
+}
+
+vec3 decodeNormal(vec3 n) {
+    if (entityData.positionOffset.w == 0.0) return n;
+    vec3 o = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+    float t = max(-o.z, 0.0);
+    o.xy += vec2(o.x >= 0.0 ? -t : t, o.y >= 0.0 ? -t : t);
+    return o;
+}
+
 void main() {
-    gl_Position = entityData.mvp * vec4(vertexPosition, 1.0);
+    gl_Position = entityData.mvp * vec4(decodePosition(vertexPosition), 1.0);
     gl_Position.z = (gl_Position.z + gl_Position.w) / 2.0;
     gl_Position.y = -gl_Position.y;
-    fragmentNormal = normalize(mat3(entityData.normal) * vertexNormal);
+    fragmentNormal = normalize(mat3(entityData.normal) * decodeNormal(vertexNormal));
     fragmentTextureCoordinate = fract(vertexTextureCoordinate * entityData.textureScale);
 	fragmentTextureCoordinate *= vec2(entityData.textureRegion.w, entityData.textureRegion.h);
 	fragmentTextureCoordinate += vec2(entityData.textureRegion.x, entityData.textureRegion.y);
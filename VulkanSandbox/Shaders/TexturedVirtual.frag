@@ -0,0 +1,67 @@
+#version 450 core
+
+layout (early_fragment_tests) in;
+
+layout (location = 0) in vec3 fragmentNormal;
+layout (location = 1) in vec2 fragmentTextureCoordinate;
+
+layout (location = 0) out vec3 color;
+
+/*
+ * Textured.frag sampling a virtual texture instead of the atlas.
+ * virtualTextureSize is the width, height, page size and level count of
+ * the virtual texture, and physicalTextureSize the padded page size,
+ * border and pixels across the physical image. One pixel of each
+ * feedback.y square, offset by feedback.zw, writes the page it wants into
+ * a row of feedback.x pages. Fragments are tested early, so hidden ones
+ * write no feedback.
+ */
+layout (set = 0, binding = 1) uniform LightData {
+	vec4 direction;
+    vec4 color;
+	vec4 virtualTextureSize;
+	vec4 physicalTextureSize;
+	ivec4 feedback;
+} lightData;
+
+layout (set = 0, binding = 3) uniform sampler2D indirectionSampler;
+layout (set = 0, binding = 4) uniform sampler2D physicalSampler;
+
+layout (std430, set = 0, binding = 5) buffer Feedback {
+	uint feedbackPages[];
+};
+
+/*
+ * Sample the finest resident page covering the wanted one, which the
+ * indirection holds the slot and level of.
+ */
+vec3 sampleVirtual(vec2 uv) {
+	vec4 size = lightData.virtualTextureSize;
+	vec2 texel = uv * size.xy;
+	vec2 dx = dFdx(texel), dy = dFdy(texel);
+	float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));
+	int level = int(clamp(lod, 0.0, size.w - 1.0));
+	ivec2 pages = ivec2(size.xy / size.z) >> level;
+	ivec2 page = clamp(ivec2(texel / size.z) >> level, ivec2(0), pages - 1);
+
+	ivec4 feedback = lightData.feedback;
+	ivec2 cell = ivec2(gl_FragCoord.xy);
+	if (cell % feedback.y == feedback.zw && cell.x / feedback.y < feedback.x) {
+		uint index = uint(cell.y / feedback.y * feedback.x + cell.x / feedback.y);
+		if (index < uint(feedbackPages.length())) {
+			feedbackPages[index] = uint(level + 1) << 28 | uint(page.y) << 14 | uint(page.x);
+		}
+	}
+
+	vec3 entry = round(texelFetch(indirectionSampler, page, level).xyz * 255.0);
+	vec2 inPage = mod(texel / exp2(entry.z), size.z);
+	vec4 physical = lightData.physicalTextureSize;
+	vec2 position = entry.xy * physical.x + physical.y + inPage;
+	return textureLod(physicalSampler, position / physical.z, 0.0).rgb;
+}
+
+void main() {
+    vec3 light = clamp(dot(lightData.direction.xyz, fragmentNormal), 0.0, 1.0) * lightData.color.rgb * 0.85;
+    vec3 texColor = sampleVirtual(fragmentTextureCoordinate);
+    color = texColor * 0.15 + texColor * light;
+}
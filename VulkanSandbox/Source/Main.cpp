@@ -1,5 +1,11 @@
 #include <Engine/MeshGeneration.h>
+#include <Engine/Meshlets.h>
+#include <Engine/Primitives.h>
 #include <Engine/Entity.h>
+#include <Engine/Skeleton.h>
+#include <Engine/Animation.h>
+#include <Engine/DynamicMesh.h>
+#include <Engine/StaticBatch.h>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
@@ -7,6 +13,7 @@
 #include <cstring>
 #include <sstream>
 #include <fstream>
+#include <memory>
 #include "VulkanContext.h"
 #include "VulkanWindow.h"
 #include "VulkanRenderer.h"
@@ -15,6 +22,36 @@
 using namespace std;
 using namespace Engine;
 
+static const unsigned pondSize = 64;
+static const float waveWidth = 4.f;
+
+/*
+ * Move the crest of a wave across the pond from row previous to row crest,
+ * rewriting only the rows the wave covered or covers now.
+ */
+static void moveWave(DynamicMesh& pond, float previous, float crest) {
+	const float height = 0.05f;
+	int first = max((int)floorf(min(previous, crest) - waveWidth), 0);
+	int last = min((int)ceilf(max(previous, crest) + waveWidth),
+		(int)pondSize);
+	if (first > last) return;
+	uint32_t stride = pondSize + 1;
+	Vertex* v = pond.editVertices(first * stride, (last - first + 1) * stride);
+	for (int r = first; r <= last; r++) {
+		float d = r - crest;
+		float y = 0.f, slope = 0.f;
+		if (fabsf(d) < waveWidth) {
+			float a = glm::pi<float>() * d / waveWidth;
+			y = height * (1.f + cosf(a));
+			slope = -height * glm::pi<float>() / waveWidth * sinf(a) * pondSize;
+		}
+		for (unsigned c = 0; c <= pondSize; c++, v++) {
+			v->position.y = y;
+			v->normal = glm::normalize(glm::vec3(0.f, 1.f, -slope));
+		}
+	}
+}
+
 class KeyHandler : public KeyEventHandler {
 public:
 	KeyHandler(Window& window) : window(window) {
@@ -73,15 +110,55 @@ int main(int argc, char** argv) {
 		Window& window = vkContext.createWindow(1024, 768, 0);
 		Renderer& renderer = window.getRenderer();
 
-		TextureAtlas atlas("../Assets/textureAtlas.png", "../Assets/textureAtlas.meta");
+		/* Block compress the atlas when the renderer samples it as is. */
+		TextureLoadFlags compression = TextureLoadFlags::None;
+		if (renderer.supportsTextureFormat(Texture::Format::BC7)) {
+			compression = TextureLoadFlags::CompressQuality;
+		} else if (renderer.supportsTextureFormat(Texture::Format::BC1)
+			&& renderer.supportsTextureFormat(Texture::Format::BC3)) {
+			compression = TextureLoadFlags::CompressFast;
+		}
+		TextureAtlas atlas("../Assets/textureAtlas.png",
+			"../Assets/textureAtlas.meta",
+			TextureLoadFlags::Mipmaps | TextureLoadFlags::BinaryCache
+				| compression);
+
+		/*
+		 * With --virtual-texture, page the atlas in as it is seen, cutting
+		 * it into a page file again whenever the image has changed.
+		 */
+		unique_ptr<VirtualTexture> virtualTexture;
+		if (argc > 1 && strcmp(argv[1], "--virtual-texture") == 0) {
+			const char* pageFile = "../Assets/textureAtlas.vtex";
+			const char* sourceFile = "../Assets/textureAtlas.png";
+			Texture::Format pageFormat =
+				renderer.supportsTextureFormat(Texture::Format::BC7)
+					? Texture::Format::BC7 : Texture::Format::RGBA;
+			if (!isVirtualTextureCurrent(pageFile, sourceFile, pageFormat)) {
+				TextureAtlas source(sourceFile, "../Assets/textureAtlas.meta",
+					TextureLoadFlags::Mipmaps | TextureLoadFlags::ForceRGBA);
+				writeVirtualTexture(pageFile, sourceFile, *source.getTexture(),
+					pageFormat);
+			}
+			virtualTexture.reset(new VirtualTexture(pageFile));
+			renderer.setVirtualTexture(virtualTexture.get());
+		}
 		renderer.setTextureAtlas(&atlas);
 
 		KeyHandler keyHandler(window);
 
-		Mesh cubeMesh = generateCube();
+		IndexedMesh cubeMesh = generateCube();
 		IndexedMesh sphereMesh = generateSphere(3);
-		IndexedMesh supriseMesh = loadMesh("../Assets/monkey.obj");
-		IndexedMesh terrainMesh = loadMesh("../Assets/terrain.obj");
+		MeshLoadFlags meshFlags = MeshLoadFlags::OptimizeVertexCache
+			| MeshLoadFlags::BinaryCache;
+		IndexedMesh supriseMesh = loadMesh("../Assets/monkey.obj", meshFlags, 3);
+		IndexedMesh terrainMesh = loadMesh("../Assets/terrain.obj", meshFlags,
+			4);
+		buildMeshlets(terrainMesh);
+		terrainMesh.setVertexFormat(VertexFormat::Packed);
+		supriseMesh.setVertexFormat(VertexFormat::SplitPosition);
+		SkinnedMesh tentacleMesh = generateSkinnedCylinder(4);
+		DynamicMesh pondMesh(generateGrid(pondSize, pondSize));
 
 		Material red;
 		red.setColor(1.f, 0.f, 0.f, 1.f);
@@ -100,25 +177,74 @@ int main(int argc, char** argv) {
 		Geometry stretchedCube(&cubeMesh, &green);
 		Geometry sphereGeometry(&sphereMesh, &globe);
 		Geometry redSuprise(&supriseMesh, &red);
+		Geometry greenTentacle(&tentacleMesh, &green);
+		Geometry bluePond(&pondMesh, &blue);
 
 		Node terrain;
 		Node cube1(&terrain);
 		Node cube2(&cube1);
 		Node sphere(&cube1);
 		Node suprise(&cube2);
+		Node tentacle(&cube1);
+		Node pond(&terrain);
+		Node tentacleJoints[4];
 		cube1.translate(0.f, 30.f, 0.f);
 		cube2.translate(2.f, 0.f, 0.f);
 		cube2.rotate(glm::radians(45.f), glm::vec3(0.f, 1.f, 0.f));
 		sphere.translate(0.f, 2.f, 0.f);
 		suprise.translate(0.f, 5.f, 0.f);
+		tentacle.translate(-2.f, 0.f, 0.f);
+		pond.translate(0.f, 28.f, -4.f);
+		Skeleton tentacleSkeleton(&tentacle);
+		for (int i = 0; i < 4; i++) {
+			tentacleJoints[i].setParent(i == 0 ? &tentacle
+				: &tentacleJoints[i - 1]);
+			if (i > 0) tentacleJoints[i].translate(0.f, 1.f, 0.f);
+			tentacleSkeleton.addJoint(&tentacleJoints[i], glm::mat4());
+		}
 		terrain.update();
+		tentacleSkeleton.setBindPose();
+
+		/*
+		 * Sway the tentacle, each joint a little behind the one below
+		 */
+		AnimationClip sway;
+		vector<float> swayTimes;
+		vector<glm::quat> swayRotations[3];
+		for (int k = 0; k <= 16; k++) {
+			float t = glm::two_pi<float>() * k / 16.f;
+			swayTimes.push_back(t);
+			for (int i = 0; i < 3; i++) {
+				swayRotations[i].push_back(glm::angleAxis(
+					0.6f * sinf(t + i + 1), glm::vec3(0.f, 0.f, 1.f)));
+			}
+		}
+		for (int i = 0; i < 3; i++) {
+			sway.addRotationTrack(swayTimes, swayRotations[i]);
+		}
+		AnimationPlayer swayPlayer(&sway);
+		for (uint32_t i = 0; i < 3; i++) {
+			swayPlayer.setTarget(AnimationChannel::Rotation, i,
+				&tentacleJoints[i + 1]);
+		}
 
 		Entity e0(&terrain, &greenTerrain),
 			   e1(&cube1, &cubeGeometry),
 			   e2(&cube2, &stretchedCube),
 			   e3(&sphere, &sphereGeometry),
-			   e4(&suprise, &redSuprise);
+			   e4(&suprise, &redSuprise),
+			   e5(&tentacle, &greenTentacle),
+			   e6(&pond, &bluePond);
+		e5.setSkeleton(&tentacleSkeleton, SkinningMethod::DualQuaternion);
 		e2.setScale(0.2f, 2.f, 0.2f);
+		e6.setScale(8.f, 1.f, 8.f);
+
+		/*
+		 * Terrain, cubes and sphere never move: draw them as merged cells
+		 */
+		StaticBatch staticBatch;
+		staticBatch.build({ &e0, &e1, &e2, &e3 }, 128.f,
+			"../Assets/scene.staticbatch");
 
 		LightSource light;
 		light.setDirection(-0.5f, 1.f, 0.f);
@@ -134,15 +260,17 @@ int main(int argc, char** argv) {
 		perspectiveHandler.resize(window.getWidth(), window.getHeight());
 		camera.update();
 
-		renderer.addEntity(&e0);
-		renderer.addEntity(&e1);
-		renderer.addEntity(&e2);
-		renderer.addEntity(&e3);
+		for (Entity* e : staticBatch.getEntities()) {
+			renderer.addEntity(e);
+		}
 		renderer.addEntity(&e4);
+		renderer.addEntity(&e5);
+		renderer.addEntity(&e6);
 		renderer.addLightSource(&light);
 		renderer.setCamera(&camera);
 
 		float yaw = 0.f, pitch = 0.f;
+		float waveCrest = -waveWidth;
 		double time = glfwGetTime();
 		while (!window.shouldClose()) {
 			renderer.render();
@@ -152,6 +280,15 @@ int main(int argc, char** argv) {
 			float delta = (float)(seconds - time);
 			time = seconds;
 
+			swayPlayer.advance(delta);
+			swayPlayer.apply();
+			tentacle.update();
+
+			float crest = fmodf(waveCrest + waveWidth + delta * 12.f,
+				pondSize + 2.f * waveWidth) - waveWidth;
+			moveWave(pondMesh, waveCrest, crest);
+			waveCrest = crest;
+
 			if (window.isCursorHidden()) {
 				glm::vec3 cameraDirection = quatTransform(
 					cameraNode.getOrientation(), glm::vec3(0.f, 0.f, -1.f));
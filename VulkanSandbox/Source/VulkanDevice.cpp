@@ -145,6 +145,11 @@ VulkanDevice::VulkanDevice(const VulkanContext& context,
 		deviceCreateInfo.ppEnabledExtensionNames = &swapchainExtension;
 		features.shaderClipDistance = VK_TRUE;
 		features.samplerAnisotropy = VK_TRUE;
+
+		VkPhysicalDeviceFeatures supported;
+		vkGetPhysicalDeviceFeatures(physicalDevice, &supported);
+		features.multiDrawIndirect = supported.multiDrawIndirect;
+		features.fragmentStoresAndAtomics = supported.fragmentStoresAndAtomics;
 	}
 	deviceCreateInfo.pEnabledFeatures = &features;
 }
@@ -35,6 +35,13 @@ public:
 		return memoryProperties;
 	}
 
+	/*
+	 * Features enabled on the logical device.
+	 */
+	const VkPhysicalDeviceFeatures& getFeatures() const {
+		return features;
+	}
+
 	VkDevice getHandle() const {
 		return device;
 	}
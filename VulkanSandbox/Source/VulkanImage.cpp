@@ -1,4 +1,5 @@
 #include "VulkanImage.h"
+#include "VulkanBuffer.h"
 #include "VulkanUtil.h"
 #include <stdexcept>
 
@@ -7,11 +8,13 @@ using namespace std;
 VulkanImage::VulkanImage(const VulkanDevice& device, uint32_t w, uint32_t h,
 						 VkFormat format, VkImageTiling tiling,
 						 VkImageUsageFlags usage,
-						 VkMemoryPropertyFlags properties, VkImageLayout initialLayout) :
+						 VkMemoryPropertyFlags properties, VkImageLayout initialLayout,
+						 uint32_t mipLevels) :
 	device(device),
 	handle(VK_NULL_HANDLE),
 	width(w),
 	height(h),
+	mipLevels(mipLevels),
 	format(format),
 	tiling(tiling),
 	layout(initialLayout),
@@ -24,7 +27,7 @@ VulkanImage::VulkanImage(const VulkanDevice& device, uint32_t w, uint32_t h,
 	imageInfo.extent.width = width;
 	imageInfo.extent.height = height;
 	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
+	imageInfo.mipLevels = mipLevels;
 	imageInfo.arrayLayers = 1;
 	imageInfo.format = format;
 	imageInfo.tiling = tiling;
@@ -75,14 +78,28 @@ VulkanImage::~VulkanImage() {
 }
 
 void VulkanImage::recordTransition(VkImageLayout to, VkCommandBuffer cmdBuffer) {
+	recordBarrier(layout, to, 0, mipLevels, cmdBuffer);
+	layout = to;
+}
+
+void VulkanImage::recordLevelTransition(VkImageLayout to, uint32_t baseLevel,
+										uint32_t levelCount,
+										VkCommandBuffer cmdBuffer) {
+	recordBarrier(layout, to, baseLevel, levelCount, cmdBuffer);
+}
+
+void VulkanImage::recordBarrier(VkImageLayout from, VkImageLayout to,
+								uint32_t baseLevel, uint32_t levelCount,
+								VkCommandBuffer cmdBuffer) {
 	VkImageMemoryBarrier barrier = {};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = layout;
+	barrier.oldLayout = from;
 	barrier.newLayout = to;
 	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.image = handle;
-	barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+	barrier.subresourceRange =
+		{VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, 1};
 	barrier.srcAccessMask = 0;
 	barrier.dstAccessMask = 0;
 
@@ -103,6 +120,11 @@ void VulkanImage::recordTransition(VkImageLayout to, VkCommandBuffer cmdBuffer)
 		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 		dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	} else if (barrier.oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL &&
+			   barrier.newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+		barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
 	} else if (barrier.newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
 		barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
 								VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
@@ -115,8 +137,6 @@ void VulkanImage::recordTransition(VkImageLayout to, VkCommandBuffer cmdBuffer)
 	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
 						 dstStageMask, 0, 0, nullptr,
 						 0, nullptr, 1, &barrier);
-
-	layout = to;
 }
 
 void VulkanImage::recordTransfer(VulkanImage& from, VkCommandBuffer cmdBuffer) {
@@ -142,6 +162,16 @@ void VulkanImage::recordTransfer(VulkanImage& from, VkCommandBuffer cmdBuffer) {
 				   handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 }
 
+void VulkanImage::recordTransfer(const VulkanBuffer& from,
+								 const vector<VkBufferImageCopy>& regions,
+								 VkCommandBuffer cmdBuffer) {
+	recordTransition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cmdBuffer);
+	
+	vkCmdCopyBufferToImage(cmdBuffer, from.getHandle(),
+						   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, handle,
+						   (uint32_t)regions.size(), regions.data());
+}
+
 void* VulkanImage::mapMemory(VkDeviceSize offset, VkDeviceSize size) {
 	void* mapped;
 	VkResult result = vkMapMemory(device.getHandle(), memory, offset, size, 0,
@@ -3,13 +3,17 @@
 
 #include <vulkan/vulkan.h>
 #include "VulkanDevice.h"
+#include <vector>
+
+class VulkanBuffer;
 
 class VulkanImage {
 public:
 	VulkanImage(const VulkanDevice& device, uint32_t w, uint32_t h,
 				VkFormat format, VkImageTiling tiling,
 				VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-				VkImageLayout initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED);
+				VkImageLayout initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED,
+				uint32_t mipLevels = 1);
 	~VulkanImage();
 	
 	VkImage getHandle() const {
@@ -28,6 +32,10 @@ public:
 		return height;
 	}
 	
+	uint32_t getMipLevels() const {
+		return mipLevels;
+	}
+	
 	VkFormat getFormat() const {
 		return format;
 	}
@@ -41,7 +49,18 @@ public:
 	}
 	
 	void recordTransition(VkImageLayout to, VkCommandBuffer cmdBuffer);
+	/*
+	 * Move only some mip levels from the layout of the image to another,
+	 * as they finish streaming in. The layout of the image stays as it
+	 * was; moved levels are the caller's to track.
+	 */
+	void recordLevelTransition(VkImageLayout to, uint32_t baseLevel,
+							   uint32_t levelCount, VkCommandBuffer cmdBuffer);
 	void recordTransfer(VulkanImage& from, VkCommandBuffer cmdBuffer);
+	/* Copy regions of the buffer, such as one per mip level. */
+	void recordTransfer(const VulkanBuffer& from,
+						const std::vector<VkBufferImageCopy>& regions,
+						VkCommandBuffer cmdBuffer);
 	
 	void* mapMemory(VkDeviceSize offset, VkDeviceSize size);
 	void unmapMemory();
@@ -50,10 +69,15 @@ public:
 	void transferTransition(VulkanImage& from, VkImageLayout to);
 	
 private:
+	void recordBarrier(VkImageLayout from, VkImageLayout to,
+					   uint32_t baseLevel, uint32_t levelCount,
+					   VkCommandBuffer cmdBuffer);
+
 	const VulkanDevice& device;
 	VkImage handle;
 	VkDeviceSize size;
 	uint32_t width, height;
+	uint32_t mipLevels;
 	VkFormat format;
 	VkImageTiling tiling;
 	VkImageLayout layout;
@@ -1,5 +1,8 @@
 #include "VulkanPerMesh.h"
 #include <Engine/IndexedMesh.h>
+#include <Engine/VertexLayout.h>
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
 using namespace std;
@@ -7,10 +10,17 @@ using namespace Engine;
 
 VulkanPerMesh::VulkanPerMesh(const VulkanDevice& device, const Engine::Mesh* mesh) :
 	device(device),
+	vertexStreamCount(0),
 	topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST),
 	indexed(false),
-	elementCount(0)
+	indexType(VK_INDEX_TYPE_UINT32),
+	elementCount(0),
+	dynamic(dynamic_cast<const DynamicMesh*>(mesh) != nullptr),
+	vertexCount((uint32_t)mesh->getVertices().size())
 {
+	if (dynamic && mesh->getVertexFormat() != VertexFormat::Float) {
+		throw runtime_error("Dynamic meshes must use float vertices.");
+	}
 	createBuffers(mesh);
 
 	switch (mesh->getTopology()) {
@@ -42,45 +52,190 @@ VulkanPerMesh::~VulkanPerMesh() {
 }
 
 void VulkanPerMesh::createBuffers(const Mesh* mesh) {
-	VulkanBuffer* vertexBuffer = new VulkanBuffer(device,
-		mesh->getVertexDataSize(),
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-			| VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-	vertexBuffer->transfer(0, VK_WHOLE_SIZE, (void*)mesh->getVertexData());
-	buffers.push_back(vertexBuffer);
+	bounds = computeBoundingSphere(mesh->getVertexData(),
+		mesh->getVertices().size());
+
+	vertexFormat = mesh->getVertexFormat();
+	if (vertexFormat == VertexFormat::Packed) {
+		quantization = computeVertexQuantization(mesh->getVertexData(),
+			mesh->getVertices().size());
+	} else {
+		quantization.offset = glm::vec3();
+		quantization.scale = glm::vec3(1.f);
+	}
+
+	/*
+	 * One vertex buffer per stream of the vertex format
+	 */
+	vector<vector<uint8_t>> streams = writeVertexStreams(
+		mesh->getVertexData(), mesh->getVertices().size(), vertexFormat,
+		quantization);
+	vertexStreamCount = (uint32_t)streams.size();
+	for (vector<uint8_t>& stream : streams) {
+		VulkanBuffer* vertexBuffer = new VulkanBuffer(device,
+			stream.size(),
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+				| VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		vertexBuffer->transfer(0, VK_WHOLE_SIZE, stream.data());
+		buffers.push_back(vertexBuffer);
+	}
 
 	const IndexedMesh* indexedMesh = dynamic_cast<const IndexedMesh*>(mesh);
 	if (indexedMesh) {
 		indexed = true;
 		elementCount = (uint32_t)indexedMesh->getElementCount();
+		submeshes = indexedMesh->getSubmeshes();
+		lods = indexedMesh->getLods();
+		meshlets = indexedMesh->getMeshlets();
+
+		indexType = indexedMesh->getIndexType() == IndexType::UInt16
+			? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+		vector<uint8_t> indexData(indexedMesh->getIndexBufferSize());
+		indexedMesh->writeIndexBuffer(indexData.data());
 
 		VulkanBuffer* indexBuffer = new VulkanBuffer(device,
-			indexedMesh->getIndexDataSize(),
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+			indexData.size(),
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT
 				| VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 				| VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-		indexBuffer->transfer(0, VK_WHOLE_SIZE,
-			(void*)indexedMesh->getIndexData());
+		indexBuffer->transfer(0, VK_WHOLE_SIZE, indexData.data());
 		buffers.push_back(indexBuffer);
 	} else {
 		elementCount = (uint32_t)mesh->getElementCount();
 	}
 }
 
-void VulkanPerMesh::record(VkCommandBuffer cmdBuffer) {
-	VkDeviceSize offsets = {};
-	VkBuffer bufferHandle = buffers[0]->getHandle();
-	vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &bufferHandle, &offsets);
+void VulkanPerMesh::bind(VkCommandBuffer cmdBuffer) {
+	VkDeviceSize offsets[maxVertexStreams] = {};
+	VkBuffer bufferHandles[maxVertexStreams];
+	for (uint32_t i = 0; i < vertexStreamCount; i++) {
+		bufferHandles[i] = buffers[i]->getHandle();
+	}
+	vkCmdBindVertexBuffers(cmdBuffer, 0, vertexStreamCount, bufferHandles,
+		offsets);
 
 	if (indexed) {
-		vkCmdBindIndexBuffer(cmdBuffer, buffers[1]->getHandle(), 0,
-			VK_INDEX_TYPE_UINT32);
+		vkCmdBindIndexBuffer(cmdBuffer,
+			buffers[vertexStreamCount]->getHandle(), 0, indexType);
+	}
+}
+
+void VulkanPerMesh::bind(VkCommandBuffer cmdBuffer, VkBuffer vertexBuffer) {
+	if (vertexFormat != VertexFormat::Float) {
+		throw runtime_error("Only float vertices can be replaced.");
+	}
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vertexBuffer, &offset);
+
+	if (indexed) {
+		vkCmdBindIndexBuffer(cmdBuffer,
+			buffers[vertexStreamCount]->getHandle(), 0, indexType);
+	}
+}
+
+void VulkanPerMesh::bindPositions(VkCommandBuffer cmdBuffer) {
+	if (vertexFormat != VertexFormat::SplitPosition) {
+		throw runtime_error("Only split position meshes have a position stream.");
+	}
+	VkDeviceSize offset = 0;
+	VkBuffer positions = buffers[0]->getHandle();
+	vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &positions, &offset);
+
+	if (indexed) {
+		vkCmdBindIndexBuffer(cmdBuffer,
+			buffers[vertexStreamCount]->getHandle(), 0, indexType);
+	}
+}
+
+void VulkanPerMesh::draw(VkCommandBuffer cmdBuffer, int submesh,
+	unsigned lod) {
+	if (indexed && submesh >= 0 && submesh < (int)submeshes.size()) {
+		const Submesh& s = submeshes[submesh];
+		vkCmdDrawIndexed(cmdBuffer, s.indexCount, 1, s.firstIndex, 0, 0);
+	} else if (indexed && lod > 0 && lod < lods.size()) {
+		const LevelOfDetail& l = lods[lod];
+		vkCmdDrawIndexed(cmdBuffer, l.indexCount, 1, l.firstIndex, 0, 0);
+	} else if (indexed) {
 		vkCmdDrawIndexed(cmdBuffer, elementCount, 1, 0, 0, 0);
 	} else {
 		vkCmdDraw(cmdBuffer, elementCount, 1, 0, 0);
 	}
 }
+
+void VulkanPerMesh::record(VkCommandBuffer cmdBuffer) {
+	bind(cmdBuffer);
+	draw(cmdBuffer);
+}
+
+uint32_t VulkanPerMesh::writeMeshletDraws(const vector<uint32_t>& visible,
+	VkDrawIndexedIndirectCommand* commands) const {
+	uint32_t count = 0;
+	uint32_t end = ~0u;
+	for (uint32_t i : visible) {
+		const Meshlet& m = meshlets[i];
+		if (m.firstIndex == end) {
+			commands[count - 1].indexCount += m.indexCount;
+		} else {
+			commands[count++] = { m.indexCount, 1, m.firstIndex, 0, 0 };
+		}
+		end = m.firstIndex + m.indexCount;
+	}
+	return count;
+}
+
+void VulkanPerMesh::drawIndirect(VkCommandBuffer cmdBuffer,
+	VkBuffer indirectBuffer, VkDeviceSize offset, uint32_t count) {
+	uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	if (device.getFeatures().multiDrawIndirect) {
+		vkCmdDrawIndexedIndirect(cmdBuffer, indirectBuffer, offset, count,
+			stride);
+	} else {
+		for (uint32_t i = 0; i < count; i++) {
+			vkCmdDrawIndexedIndirect(cmdBuffer, indirectBuffer,
+				offset + i * stride, 1, stride);
+		}
+	}
+}
+
+bool VulkanPerMesh::recordUpdate(VkCommandBuffer cmdBuffer,
+	DynamicMesh& mesh, VulkanUploadRing& ring) {
+	if (mesh.getVertices().size() != vertexCount) {
+		throw runtime_error("Dynamic meshes can not change vertex count.");
+	}
+	mesh.takeChangedRanges(changed);
+	pending.insert(pending.end(), changed.begin(), changed.end());
+	mergeVertexRanges(pending);
+
+	/*
+	 * Ranges are staged in pieces no larger than a ring region, so every
+	 * range fits into some frame.
+	 */
+	uint32_t maxCount = (uint32_t)(ring.getFrameSize() / sizeof(Vertex));
+	copies.clear();
+	size_t kept = 0;
+	for (size_t i = 0; i < pending.size(); i++) {
+		VertexRange r = pending[i];
+		while (r.count > 0) {
+			uint32_t count = min(r.count, maxCount);
+			VkDeviceSize size = count * sizeof(Vertex);
+			VkDeviceSize offset;
+			void* staged = ring.allocate(size, offset);
+			if (staged == nullptr) break;
+			memcpy(staged, mesh.getVertexData() + r.first, size);
+			copies.push_back({ offset, r.first * sizeof(Vertex), size });
+			r.first += count;
+			r.count -= count;
+		}
+		if (r.count > 0) pending[kept++] = r;
+	}
+	pending.resize(kept);
+	if (copies.empty()) return false;
+
+	vkCmdCopyBuffer(cmdBuffer, ring.getHandle(), buffers[0]->getHandle(),
+		(uint32_t)copies.size(), copies.data());
+	return true;
+}
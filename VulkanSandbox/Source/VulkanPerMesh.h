@@ -2,26 +2,107 @@
 #define VULKANPERMESH_H
 
 #include <vector>
-#include <Engine/Mesh.h>
+#include <Engine/DynamicMesh.h>
+#include <Engine/IndexedMesh.h>
+#include <Engine/Bounds.h>
 #include <vulkan/vulkan.h>
 
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
+#include "VulkanUploadRing.h"
 
 class VulkanPerMesh {
 public:
 	VulkanPerMesh(const VulkanDevice& device, const Engine::Mesh* mesh);
 	virtual ~VulkanPerMesh();
 
+	void bind(VkCommandBuffer cmdBuffer);
+
+	/*
+	 * Bind vertexBuffer in place of the vertices of a VertexFormat::Float
+	 * mesh, keeping its indices. Used to draw skinned vertices.
+	 */
+	void bind(VkCommandBuffer cmdBuffer, VkBuffer vertexBuffer);
+
+	/*
+	 * Bind only the position stream of a VertexFormat::SplitPosition mesh,
+	 * and its indices, for passes that need nothing else.
+	 */
+	void bindPositions(VkCommandBuffer cmdBuffer);
+	void draw(VkCommandBuffer cmdBuffer, int submesh = -1, unsigned lod = 0);
 	void record(VkCommandBuffer cmdBuffer);
 
+	/*
+	 * Write indirect draw commands for the given meshlets, merging meshlets
+	 * next to each other in the index buffer, and return the number of
+	 * commands written (at most visible.size()).
+	 */
+	uint32_t writeMeshletDraws(const std::vector<uint32_t>& visible,
+		VkDrawIndexedIndirectCommand* commands) const;
+
+	/*
+	 * Draw count commands from an indirect buffer, in one call when the
+	 * device supports multiDrawIndirect.
+	 */
+	void drawIndirect(VkCommandBuffer cmdBuffer, VkBuffer indirectBuffer,
+		VkDeviceSize offset, uint32_t count);
+
+	/*
+	 * Stage the ranges of the DynamicMesh this was created from that
+	 * changed since the last call in the ring, and record their copies into
+	 * the vertex buffer. Ranges that do not fit in the ring this frame are
+	 * kept for the next. Returns whether any copies were recorded.
+	 */
+	bool recordUpdate(VkCommandBuffer cmdBuffer, Engine::DynamicMesh& mesh,
+		VulkanUploadRing& ring);
+
+	bool isDynamic() const {
+		return dynamic;
+	}
+
+	const std::vector<Engine::LevelOfDetail>& getLods() const {
+		return lods;
+	}
+
+	const Engine::BoundingSphere& getBounds() const {
+		return bounds;
+	}
+
+	const std::vector<Engine::Meshlet>& getMeshlets() const {
+		return meshlets;
+	}
+
+	Engine::VertexFormat getVertexFormat() const {
+		return vertexFormat;
+	}
+
+	/*
+	 * Position dequantisation for the shaders; identity for float vertices.
+	 */
+	const Engine::VertexQuantization& getQuantization() const {
+		return quantization;
+	}
+
 private:
 	const VulkanDevice& device;
 
 	std::vector<VulkanBuffer*> buffers;
+	uint32_t vertexStreamCount;
 	VkPrimitiveTopology topology;
 	bool indexed;
+	VkIndexType indexType;
+	Engine::VertexFormat vertexFormat;
+	Engine::VertexQuantization quantization;
 	uint32_t elementCount;
+	std::vector<Engine::Submesh> submeshes;
+	std::vector<Engine::LevelOfDetail> lods;
+	std::vector<Engine::Meshlet> meshlets;
+	Engine::BoundingSphere bounds;
+	bool dynamic;
+	uint32_t vertexCount;
+	std::vector<Engine::VertexRange> pending;
+	std::vector<Engine::VertexRange> changed;
+	std::vector<VkBufferCopy> copies;
 
 	void createBuffers(const Engine::Mesh* mesh);
 };
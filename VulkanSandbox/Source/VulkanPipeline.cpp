@@ -1,30 +1,65 @@
 #include "VulkanPipeline.h"
-#include <Engine/Vertex.h>
 #include <stdexcept>
+#include <vector>
 
-using Engine::Vertex;
+using namespace Engine;
 using namespace std;
 
+static VkFormat vertexAttributeFormat(AttributeFormat format) {
+	switch (format) {
+	case AttributeFormat::Float2: return VK_FORMAT_R32G32_SFLOAT;
+	case AttributeFormat::Float3: return VK_FORMAT_R32G32B32_SFLOAT;
+	case AttributeFormat::Unorm16x4: return VK_FORMAT_R16G16B16A16_UNORM;
+	case AttributeFormat::Snorm16x2: return VK_FORMAT_R16G16_SNORM;
+	case AttributeFormat::Half2: return VK_FORMAT_R16G16_SFLOAT;
+	default:
+		throw runtime_error("Unknown attribute format.");
+	}
+}
+
+/*
+ * One binding per stream of the vertex input. Only attributes feeding the
+ * first locationCount shader inputs are used. A program without a fragment
+ * stage only writes depth.
+ */
 VulkanPipeline::VulkanPipeline(const VulkanShaderProgram& program,
 	VkRenderPass renderPass, VkPipelineLayout pipelineLayout,
-	VkPrimitiveTopology topology, uint32_t vertexAttributeCount,
-	const VkVertexInputAttributeDescription* pVertexAttributes) :
+	VkPrimitiveTopology topology, const VertexInputDescription& vertexInput,
+	uint32_t locationCount) :
 	device(program.getDevice().getHandle())
 {
-	VkVertexInputBindingDescription vertexBindingDescription = {};
-	vertexBindingDescription.binding = 0;
-	vertexBindingDescription.stride = (uint32_t)Vertex::Stride;
-	vertexBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	vector<VkVertexInputBindingDescription> bindings;
+	vector<VkVertexInputAttributeDescription> attributes;
+	for (uint32_t s = 0; s < vertexInput.streamCount; s++) {
+		VkVertexInputBindingDescription binding = {};
+		binding.binding = s;
+		binding.stride = vertexInput.strides[s];
+		binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		bindings.push_back(binding);
+
+		for (uint32_t a = 0; a < vertexInput.attributeCounts[s]; a++) {
+			const VertexAttributeDescription& attribute =
+				vertexInput.attributes[s][a];
+			if (attribute.location >= locationCount) continue;
+			VkVertexInputAttributeDescription description = {};
+			description.location = attribute.location;
+			description.binding = s;
+			description.format = vertexAttributeFormat(attribute.format);
+			description.offset = attribute.offset;
+			attributes.push_back(description);
+		}
+	}
 
 	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {};
 	vertexInputStateCreateInfo.sType =
 		VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
-	vertexInputStateCreateInfo.pVertexBindingDescriptions =
-		&vertexBindingDescription;
-	vertexInputStateCreateInfo.vertexAttributeDescriptionCount = vertexAttributeCount;
+	vertexInputStateCreateInfo.vertexBindingDescriptionCount =
+		(uint32_t)bindings.size();
+	vertexInputStateCreateInfo.pVertexBindingDescriptions = bindings.data();
+	vertexInputStateCreateInfo.vertexAttributeDescriptionCount =
+		(uint32_t)attributes.size();
 	vertexInputStateCreateInfo.pVertexAttributeDescriptions =
-		pVertexAttributes;
+		attributes.data();
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo = {};
 	inputAssemblyStateCreateInfo.sType =
@@ -97,7 +132,8 @@ VulkanPipeline::VulkanPipeline(const VulkanShaderProgram& program,
 	colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
 	colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
 	colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
-	colorBlendAttachmentState.colorWriteMask = 0xf;
+	colorBlendAttachmentState.colorWriteMask =
+		program.getShaderStageCreateInfos().size() > 1 ? 0xf : 0;
 
 	VkPipelineColorBlendStateCreateInfo colorBlendState = {};
 	colorBlendState.sType =
@@ -145,6 +181,28 @@ VulkanPipeline::VulkanPipeline(const VulkanShaderProgram& program,
 	}
 }
 
+VulkanPipeline::VulkanPipeline(const VulkanShaderProgram& program,
+	VkPipelineLayout pipelineLayout) :
+	device(program.getDevice().getHandle())
+{
+	if (program.getShaderStageCreateInfos().size() != 1) {
+		throw runtime_error("Compute pipeline needs exactly one stage.");
+	}
+
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage = program.getShaderStageCreateInfos()[0];
+	pipelineCreateInfo.layout = pipelineLayout;
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1,
+		&pipelineCreateInfo, nullptr, &handle);
+	if (result != VK_SUCCESS) {
+		throw runtime_error("Failed to create compute pipeline.");
+	}
+}
+
 VulkanPipeline::~VulkanPipeline() {
 	vkDestroyPipeline(device, handle, nullptr);
 }
\ No newline at end of file
@@ -3,13 +3,20 @@
 
 #include <vulkan/vulkan.h>
 #include "VulkanShaderProgram.h"
+#include <Engine/VertexLayout.h>
 
 class VulkanPipeline {
 public:
 	VulkanPipeline(const VulkanShaderProgram& program, VkRenderPass renderPass,
 		VkPipelineLayout pipelineLayout, VkPrimitiveTopology topology,
-		uint32_t vertexAttributeCount,
-		const VkVertexInputAttributeDescription* pVertexAttributes);
+		const Engine::VertexInputDescription& vertexInput,
+		uint32_t locationCount);
+
+	/*
+	 * Compute pipeline from the single compute stage of program
+	 */
+	VulkanPipeline(const VulkanShaderProgram& program,
+		VkPipelineLayout pipelineLayout);
 	~VulkanPipeline();
 
 	VkPipeline getHandle() const {
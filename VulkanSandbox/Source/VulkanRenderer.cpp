@@ -2,10 +2,30 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <cstring>
 
 using namespace std;
 using namespace Engine;
 
+/*
+ * Staging space for dynamic mesh changes and texture levels, per frame
+ */
+static const VkDeviceSize uploadRingFrameSize = 4 * 1024 * 1024;
+
+/*
+ * Bytes of the atlas uploaded with it, smallest levels first, and in each
+ * frame after until it is complete
+ */
+static const VkDeviceSize textureInitialBytes = 64 * 1024;
+static const VkDeviceSize textureStreamBudget = 1024 * 1024;
+
+/*
+ * Bytes of virtual texture pages uploaded per frame, and pixels across the
+ * block of the screen each pixel of feedback stands for
+ */
+static const VkDeviceSize pageUploadBudget = 1024 * 1024;
+static const uint32_t feedbackScale = 8;
+
 static vector<char> readFile(const string& filename) {
     ifstream file(filename, ios::ate | ios::binary);
 
@@ -29,9 +49,15 @@ VulkanRenderer::VulkanRenderer(VulkanWindow& window) :
 	window(window),
 	program(VulkanShaderProgram(*window.device)),
 	texturedProgram(VulkanShaderProgram(*window.device)),
+	virtualTexturedProgram(VulkanShaderProgram(*window.device)),
+	depthProgram(VulkanShaderProgram(*window.device)),
+	skinning(*window.device),
+	uploadRing(*window.device, uploadRingFrameSize),
 	descriptorPool(VK_NULL_HANDLE),
 	renderingCompleteSemaphore(VK_NULL_HANDLE),
-	texture(nullptr)
+	texture(nullptr),
+	virtualTextureImages(nullptr),
+	feedbackFrame(0)
 {
 	vector<char> vertexShaderCode = readFile("Shaders/Simple.vert.spv");
 	vector<char> fragmentShaderCode = readFile("Shaders/Simple.frag.spv");
@@ -43,6 +69,18 @@ VulkanRenderer::VulkanRenderer(VulkanWindow& window) :
 	texturedProgram.addShaderStage(vertexShaderCode, VK_SHADER_STAGE_VERTEX_BIT);
 	texturedProgram.addShaderStage(fragmentShaderCode, VK_SHADER_STAGE_FRAGMENT_BIT);
 
+	/* Only devices that can store from fragment shaders get the variant. */
+	if (window.device->getFeatures().fragmentStoresAndAtomics) {
+		fragmentShaderCode = readFile("Shaders/TexturedVirtual.frag.spv");
+		virtualTexturedProgram.addShaderStage(vertexShaderCode,
+			VK_SHADER_STAGE_VERTEX_BIT);
+		virtualTexturedProgram.addShaderStage(fragmentShaderCode,
+			VK_SHADER_STAGE_FRAGMENT_BIT);
+	}
+
+	vertexShaderCode = readFile("Shaders/Depth.vert.spv");
+	depthProgram.addShaderStage(vertexShaderCode, VK_SHADER_STAGE_VERTEX_BIT);
+
 	entityDataStride = 0;
 	while (entityDataStride < sizeof(EntityData)) {
 		entityDataStride += window.device->getProperties().limits
@@ -68,6 +106,23 @@ VulkanRenderer::VulkanRenderer(VulkanWindow& window) :
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 			| VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
+	indirectBuffer = nullptr;
+	indirectCapacity = 0;
+
+	/* Pixels beyond the window size at this point write no feedback. */
+	feedbackWidth = (window.getWidth() + feedbackScale - 1) / feedbackScale;
+	feedbackCount = feedbackWidth
+		* ((window.getHeight() + feedbackScale - 1) / feedbackScale);
+	feedbackBuffer = new VulkanBuffer(*window.device,
+		feedbackCount * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+			| VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	void* feedback = feedbackBuffer->mapMemory(0,
+		feedbackCount * sizeof(uint32_t));
+	memset(feedback, 0, feedbackCount * sizeof(uint32_t));
+	feedbackBuffer->unmapMemory();
+
 	createDescriptorPool();
 	createDescriptorSetLayout();
 	createPipelineLayout();
@@ -89,11 +144,22 @@ VulkanRenderer::~VulkanRenderer() {
 	vkDestroyDescriptorPool(window.device->getHandle(), descriptorPool, nullptr);
 	delete entityDataBuffer;
 	delete lightDataBuffer;
+	delete indirectBuffer;
+	delete feedbackBuffer;
 	delete texture;
+	delete virtualTextureImages;
 	vkDestroySemaphore(window.device->getHandle(), renderingCompleteSemaphore, nullptr);
 	vkDestroySampler(window.device->getHandle(), textureSampler, nullptr);
-	delete simplePipeline;
-	delete texturedPipeline;
+	for (VulkanPipeline* p : simplePipelines) {
+		delete p;
+	}
+	for (VulkanPipeline* p : texturedPipelines) {
+		delete p;
+	}
+	for (VulkanPipeline* p : virtualTexturedPipelines) {
+		delete p;
+	}
+	delete depthPipeline;
 }
 
 void VulkanRenderer::render() {
@@ -113,6 +179,15 @@ void VulkanRenderer::render() {
 	
 	window.swapchain->transitionColor(window.presentCommandBuffer);
 
+	/*
+	 * Skinning dispatches go before the render pass, which cannot contain
+	 * compute work.
+	 */
+	skinning.record(window.presentCommandBuffer, entities);
+	recordDynamicMeshUpdates();
+	recordTextureStreaming();
+	recordVirtualTexture();
+
 	VkClearValue clearValue[] = { { 0.5f, 0.5f, 0.5f, 1.f }, { 1.f, 0.f } };
 	VkRenderPassBeginInfo renderPassBeginInfo = {};
 	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -134,8 +209,36 @@ void VulkanRenderer::render() {
 	LightData& lightData = *((LightData*) ((char*) mapped));
 	lightData.direction = glm::vec4(lightSources[0]->getDirection(), 0.0);
 	lightData.color = glm::vec4(lightSources[0]->getColor(), 1.0);
+	lightData.virtualTextureSize = glm::vec4(0.f);
+	if (virtualTextureImages) {
+		const VirtualTextureFile& file = virtualTexture->getFile();
+		lightData.virtualTextureSize = glm::vec4((float)file.getWidth(),
+			(float)file.getHeight(), (float)file.getPageSize(),
+			(float)file.getLevelCount());
+		lightData.physicalTextureSize = glm::vec4(
+			(float)file.getPaddedSize(), (float)file.getBorder(),
+			(float)virtualTexture->getPhysicalSize(), 0.f);
+
+		/*
+		 * Each frame a different pixel of every block writes feedback, so
+		 * small details are seen within a few frames.
+		 */
+		uint32_t cell = feedbackFrame * 7 % (feedbackScale * feedbackScale);
+		lightData.feedback = glm::ivec4(feedbackWidth, feedbackScale,
+			cell % feedbackScale, cell / feedbackScale);
+	}
 	lightDataBuffer->unmapMemory();
 
+	VkDeviceSize meshletCount = 0;
+	for (const Entity* e : entities) {
+		const Mesh* mesh = e->getGeometry()->getMesh();
+		shared_ptr<VulkanPerMesh>& perMesh = meshCache[mesh];
+		if (!perMesh) {
+			perMesh = make_shared<VulkanPerMesh>(*window.device, mesh);
+		}
+		meshletCount += perMesh->getMeshlets().size();
+	}
+
 	VkDeviceSize neededSize = entities.size() * entityDataStride;
 	mapped = entityDataBuffer->mapMemory(0, neededSize);
 	for (int i = 0; i < entities.size(); i++) {
@@ -147,11 +250,19 @@ void VulkanRenderer::render() {
 		data.mvp = camera->getProjectionMatrix() * camera->getViewMatrix()
 			* worldMatrix;
 		data.normal = glm::transpose(glm::inverse(worldMatrix));
+		const VulkanPerMesh& perMesh = *meshCache[e.getGeometry()->getMesh()];
+		const VertexQuantization& quantization = perMesh.getQuantization();
+		data.positionOffset = glm::vec4(quantization.offset,
+			perMesh.getVertexFormat() == VertexFormat::Packed ? 1.f : 0.f);
+		data.positionScale = glm::vec4(quantization.scale, 0.f);
 		if (e.getGeometry()->getMaterial()) {
 			const Material* material = e.getGeometry()->getMaterial();
 			data.color = material->getColor();
-			if (!material->getTextureName().empty()) {
-				data.textureRegion = textureAtlas->getRegion(material->getTextureName());
+			if (material->isTextured()) {
+				uint32_t regionId = material->getRegionId();
+				data.textureRegion = regionId != RegionTable::none
+					? textureAtlas->getRegion(regionId)
+					: TextureRect{ 0.f, 0.f, 1.f, 1.f };
 				data.textureScale = material->getTextureScale();
 			}
 		} else {
@@ -160,27 +271,49 @@ void VulkanRenderer::render() {
 	}
 	entityDataBuffer->unmapMemory();
 
-	for (int i = 0; i < entities.size(); i++) {
-		const Entity& e = *entities[i];
-
-		const Mesh* mesh = e.getGeometry()->getMesh();
-		auto found = meshCache.find(mesh);
-		if (found == meshCache.end()) {
-			shared_ptr<VulkanPerMesh> perMesh =
-				make_shared<VulkanPerMesh>(*window.device, mesh);
-			meshCache[mesh] = perMesh;
+	/*
+	 * Indirect draws for culled meshlets, at most one command per meshlet
+	 * of every entity. The previous frame has finished, so the buffer can
+	 * be reallocated and rewritten.
+	 */
+	VkDrawIndexedIndirectCommand* commands = nullptr;
+	if (meshletCount > 0) {
+		if (meshletCount > indirectCapacity) {
+			delete indirectBuffer;
+			indirectCapacity = meshletCount;
+			indirectBuffer = new VulkanBuffer(*window.device,
+				indirectCapacity * sizeof(VkDrawIndexedIndirectCommand),
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 		}
+		commands = (VkDrawIndexedIndirectCommand*)indirectBuffer->mapMemory(
+			0, meshletCount * sizeof(VkDrawIndexedIndirectCommand));
+	}
+	uint32_t commandCount = 0;
 
-		shared_ptr<VulkanPerMesh>& perMesh = meshCache[mesh];
+	recordDepthPrepass();
+
+	const VulkanPerMesh* boundMesh = nullptr;
+	for (int i = 0; i < entities.size(); i++) {
+		Entity& e = *entities[i];
+
+		shared_ptr<VulkanPerMesh>& perMesh =
+			meshCache[e.getGeometry()->getMesh()];
+		bool skinned = e.getSkeleton() != nullptr;
+		bool whole = skinned || perMesh->isDynamic();
+		if (!whole && !isVisible(e, perMesh->getBounds())) continue;
 
 		uint32_t uniformOffset = (uint32_t)(i * entityDataStride);
 
+		size_t format = (size_t)perMesh->getVertexFormat();
 		VkPipeline pipeline;
-		if (!e.getGeometry()->getMaterial()->getTextureName().empty()) {
-			pipeline = texturedPipeline->getHandle();
+		if (e.getGeometry()->getMaterial()->isTextured()) {
+			pipeline = virtualTextureImages
+				? virtualTexturedPipelines[format]->getHandle()
+				: texturedPipelines[format]->getHandle();
 		}
 		else {
-			pipeline = simplePipeline->getHandle();
+			pipeline = simplePipelines[format]->getHandle();
 		}
 
 		vkCmdBindPipeline(window.presentCommandBuffer,
@@ -193,10 +326,56 @@ void VulkanRenderer::render() {
 		vkCmdSetViewport(window.presentCommandBuffer, 0, 1, &window.viewport);
 		vkCmdSetScissor(window.presentCommandBuffer, 0, 1, &window.scissor);
 
-		perMesh->record(window.presentCommandBuffer);
+		if (skinned) {
+			perMesh->bind(window.presentCommandBuffer,
+				skinning.getSkinnedBuffer(&e));
+			boundMesh = nullptr;
+		} else if (perMesh.get() != boundMesh) {
+			perMesh->bind(window.presentCommandBuffer);
+			boundMesh = perMesh.get();
+		}
+
+		/*
+		 * Bounds, levels of detail and meshlet cones are of the bind pose
+		 * or the first upload, so skinned and dynamic meshes are drawn whole.
+		 */
+		int submesh = e.getGeometry()->getSubmesh();
+		unsigned lod = submesh < 0 && !whole ? selectLod(e,
+			perMesh->getLods(), perMesh->getBounds(),
+			(float)window.getHeight()) : 0;
+		if (submesh < 0 && lod == 0 && !whole
+			&& !perMesh->getMeshlets().empty()) {
+			cullMeshlets(e, perMesh->getMeshlets(), visibleMeshlets);
+			uint32_t count = perMesh->writeMeshletDraws(visibleMeshlets,
+				commands + commandCount);
+			if (count > 0) {
+				perMesh->drawIndirect(window.presentCommandBuffer,
+					indirectBuffer->getHandle(),
+					commandCount * sizeof(VkDrawIndexedIndirectCommand), count);
+			}
+			commandCount += count;
+		} else {
+			perMesh->draw(window.presentCommandBuffer, submesh, lod);
+		}
 	}
+	if (commands) indirectBuffer->unmapMemory();
 
 	vkCmdEndRenderPass(window.presentCommandBuffer);
+
+	if (virtualTextureImages) {
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = feedbackBuffer->getHandle();
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(window.presentCommandBuffer,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
 	
 	window.swapchain->transitionPresent(window.presentCommandBuffer);
 
@@ -228,27 +407,197 @@ void VulkanRenderer::render() {
 	window.swapchain->present(renderingCompleteSemaphore);
 }
 
+/*
+ * Lay down the depth of meshes with positions in their own stream,
+ * fetching only that stream, so the main pass shades each of their pixels
+ * once. The meshlets of the main pass are covered by their whole level.
+ */
+void VulkanRenderer::recordDepthPrepass() {
+	bool started = false;
+	for (int i = 0; i < entities.size(); i++) {
+		Entity& e = *entities[i];
+		VulkanPerMesh& perMesh = *meshCache[e.getGeometry()->getMesh()];
+		if (e.getSkeleton() != nullptr
+			|| perMesh.getVertexFormat() != VertexFormat::SplitPosition
+			|| perMesh.isDynamic() || !isVisible(e, perMesh.getBounds())) {
+			continue;
+		}
+		if (!started) {
+			vkCmdBindPipeline(window.presentCommandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS, depthPipeline->getHandle());
+			vkCmdSetViewport(window.presentCommandBuffer, 0, 1,
+				&window.viewport);
+			vkCmdSetScissor(window.presentCommandBuffer, 0, 1,
+				&window.scissor);
+			started = true;
+		}
+
+		uint32_t uniformOffset = (uint32_t)(i * entityDataStride);
+		vkCmdBindDescriptorSets(window.presentCommandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+			&descriptorSet, 1, &uniformOffset);
+
+		perMesh.bindPositions(window.presentCommandBuffer);
+		int submesh = e.getGeometry()->getSubmesh();
+		unsigned lod = submesh < 0 ? selectLod(e, perMesh.getLods(),
+			perMesh.getBounds(), (float)window.getHeight()) : 0;
+		perMesh.draw(window.presentCommandBuffer, submesh, lod);
+	}
+}
+
+/*
+ * Copy the changed vertex ranges of dynamic meshes into their vertex
+ * buffers. Draws of the previous frame may still read those buffers, so
+ * the copies wait for vertex input to finish, and vertex input of this
+ * frame waits for the copies.
+ */
+void VulkanRenderer::recordDynamicMeshUpdates() {
+	uploadRing.beginFrame();
+	bool barrierRecorded = false;
+	bool copied = false;
+	for (Entity* e : entities) {
+		DynamicMesh* mesh = dynamic_cast<DynamicMesh*>(
+			e->getGeometry()->getMesh());
+		if (mesh == nullptr) continue;
+		shared_ptr<VulkanPerMesh>& perMesh = meshCache[mesh];
+		if (!perMesh) {
+			perMesh = make_shared<VulkanPerMesh>(*window.device, mesh);
+		}
+		if (!barrierRecorded) {
+			vkCmdPipelineBarrier(window.presentCommandBuffer,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0,
+				nullptr);
+			barrierRecorded = true;
+		}
+		copied |= perMesh->recordUpdate(window.presentCommandBuffer, *mesh,
+			uploadRing);
+	}
+	if (!copied) return;
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(window.presentCommandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+		1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+/*
+ * Copy the next rows of the atlas from the upload ring. The previous frame
+ * has finished and nothing is bound yet, so the descriptor can be pointed
+ * at a view with the levels that are now complete.
+ */
+void VulkanRenderer::recordTextureStreaming() {
+	if (!texture || texture->isComplete()) return;
+	if (texture->recordStreaming(uploadRing, textureStreamBudget,
+		window.presentCommandBuffer)) {
+		updateImageDescriptors();
+	}
+}
+
+/*
+ * Queue the pages wanted by the feedback of the previous frame, which has
+ * finished, clear the feedback for this frame, and record uploads of the
+ * pages read since.
+ */
+void VulkanRenderer::recordVirtualTexture() {
+	if (!virtualTextureImages) return;
+	feedbackFrame++;
+	VkDeviceSize size = feedbackCount * sizeof(uint32_t);
+	const uint32_t* feedback =
+		(const uint32_t*)feedbackBuffer->mapMemory(0, size);
+	virtualTexture->requestPages(feedback, feedbackCount);
+	feedbackBuffer->unmapMemory();
+
+	vkCmdFillBuffer(window.presentCommandBuffer, feedbackBuffer->getHandle(),
+		0, size, 0);
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = feedbackBuffer->getHandle();
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(window.presentCommandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	virtualTextureImages->recordUpdate(uploadRing, pageUploadBudget,
+		window.presentCommandBuffer);
+}
+
+/*
+ * Point the image bindings at the atlas and at the images of the virtual
+ * texture. Every binding the shaders declare must be valid, so one
+ * without an image of its own takes one of the others.
+ */
+void VulkanRenderer::updateImageDescriptors() {
+	VkImageView atlasView = texture ? texture->getImageView() : VK_NULL_HANDLE;
+	if (virtualTextureImages) {
+		imageInfos[1].imageView = virtualTextureImages->getIndirectionView();
+		imageInfos[2].imageView = virtualTextureImages->getPhysicalView();
+	} else {
+		imageInfos[1].imageView = atlasView;
+		imageInfos[2].imageView = atlasView;
+	}
+	imageInfos[0].imageView = atlasView != VK_NULL_HANDLE
+		? atlasView : imageInfos[2].imageView;
+	if (imageInfos[0].imageView == VK_NULL_HANDLE) return;
+	vkUpdateDescriptorSets(window.device->getHandle(), 3,
+		imageWriteDescriptors, 0, nullptr);
+}
+
 void VulkanRenderer::setTextureAtlas(const Engine::TextureAtlas* atlas) {
 	Renderer::setTextureAtlas(atlas);
+	if (virtualTexture) return;
 	if (texture) delete texture;
-	texture = new VulkanTexture(*window.device, atlas->getTexture());
-	imageInfo.imageView = texture->getImageView();
-	vkUpdateDescriptorSets(window.device->getHandle(), 1, &imageWriteDescriptor,
-		0, nullptr);
+	texture = new VulkanTexture(*window.device, atlas->getTexture(),
+		textureInitialBytes);
+	updateImageDescriptors();
+}
+
+void VulkanRenderer::setVirtualTexture(VirtualTexture* vt) {
+	Renderer::setVirtualTexture(vt);
+	delete virtualTextureImages;
+	virtualTextureImages = nullptr;
+	if (vt) {
+		if (!supportsTextureFormat(vt->getFile().getFormat())) {
+			throw runtime_error("Virtual texture pages can not be sampled.");
+		}
+		if (!window.device->getFeatures().fragmentStoresAndAtomics) {
+			throw runtime_error("Virtual textures need stores from fragment shaders.");
+		}
+		virtualTextureImages = new VulkanVirtualTexture(*window.device, *vt);
+	}
+	updateImageDescriptors();
+}
+
+bool VulkanRenderer::supportsTextureFormat(Texture::Format format) const {
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(window.device->getPhysicalDevice(),
+		VulkanTexture::toVulkanFormat(format), &properties);
+	return (properties.optimalTilingFeatures
+		& VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
 }
 
 void VulkanRenderer::createDescriptorPool() {
-	VkDescriptorPoolSize poolSizes[3];
+	VkDescriptorPoolSize poolSizes[4];
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	poolSizes[0].descriptorCount = 1;
 	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	poolSizes[1].descriptorCount = 1;
 	poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[2].descriptorCount = 1;
+	poolSizes[2].descriptorCount = 3;
+	poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[3].descriptorCount = 1;
 
 	VkDescriptorPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolInfo.poolSizeCount = 3;
+	poolInfo.poolSizeCount = 4;
 	poolInfo.pPoolSizes = poolSizes;
 	poolInfo.maxSets = 2;
 
@@ -260,7 +609,7 @@ void VulkanRenderer::createDescriptorPool() {
 }
 
 void VulkanRenderer::createDescriptorSetLayout() {
-    VkDescriptorSetLayoutBinding layoutBindings[3];
+    VkDescriptorSetLayoutBinding layoutBindings[6];
     layoutBindings[0].binding = 0;
     layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     layoutBindings[0].descriptorCount = 1;
@@ -279,9 +628,20 @@ void VulkanRenderer::createDescriptorSetLayout() {
 	layoutBindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	layoutBindings[2].pImmutableSamplers = nullptr;
 
+	/* Indirection and physical images, and feedback, of virtual textures */
+	for (uint32_t binding = 3; binding < 6; binding++) {
+		layoutBindings[binding].binding = binding;
+		layoutBindings[binding].descriptorType = binding < 5
+			? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+			: VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		layoutBindings[binding].descriptorCount = 1;
+		layoutBindings[binding].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		layoutBindings[binding].pImmutableSamplers = nullptr;
+	}
+
     VkDescriptorSetLayoutCreateInfo layoutInfo = {};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = 3;
+	layoutInfo.bindingCount = 6;
     layoutInfo.pBindings = layoutBindings;
 
 	VkResult result = vkCreateDescriptorSetLayout(window.device->getHandle(), &layoutInfo,
@@ -337,7 +697,7 @@ void VulkanRenderer::createSampler() {
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
 	VkResult result = vkCreateSampler(
 		window.device->getHandle(), &samplerInfo, nullptr, &textureSampler);
@@ -357,7 +717,12 @@ void VulkanRenderer::setupDescriptors() {
 	lightBufferInfo.offset = 0;
 	lightBufferInfo.range = lightDataStride;
 
-	VkWriteDescriptorSet descriptorWrites[2];
+	VkDescriptorBufferInfo feedbackBufferInfo = {};
+	feedbackBufferInfo.buffer = feedbackBuffer->getHandle();
+	feedbackBufferInfo.offset = 0;
+	feedbackBufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet descriptorWrites[3];
 	descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 	descriptorWrites[0].pNext = nullptr;
 	descriptorWrites[0].dstSet = descriptorSet;
@@ -379,44 +744,68 @@ void VulkanRenderer::setupDescriptors() {
 	descriptorWrites[1].pBufferInfo = &lightBufferInfo;
 	descriptorWrites[1].pImageInfo = nullptr;
 	descriptorWrites[1].pTexelBufferView = nullptr;
+
+	descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[2].pNext = nullptr;
+	descriptorWrites[2].dstSet = descriptorSet;
+	descriptorWrites[2].dstBinding = 5;
+	descriptorWrites[2].dstArrayElement = 0;
+	descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrites[2].descriptorCount = 1;
+	descriptorWrites[2].pBufferInfo = &feedbackBufferInfo;
+	descriptorWrites[2].pImageInfo = nullptr;
+	descriptorWrites[2].pTexelBufferView = nullptr;
 	
-	vkUpdateDescriptorSets(window.device->getHandle(), 2, descriptorWrites, 0, nullptr);
-
-	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	imageInfo.imageView = VK_NULL_HANDLE;
-	imageInfo.sampler = textureSampler;
-
-	imageWriteDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	imageWriteDescriptor.pNext = nullptr;
-	imageWriteDescriptor.dstSet = descriptorSet;
-	imageWriteDescriptor.dstBinding = 2;
-	imageWriteDescriptor.dstArrayElement = 0;
-	imageWriteDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	imageWriteDescriptor.descriptorCount = 1;
-	imageWriteDescriptor.pBufferInfo = nullptr;
-	imageWriteDescriptor.pImageInfo = &imageInfo;
-	imageWriteDescriptor.pTexelBufferView = nullptr;
+	vkUpdateDescriptorSets(window.device->getHandle(), 3, descriptorWrites, 0, nullptr);
+
+	/*
+	 * Pages carry a border for filtering, and the indirection is only
+	 * fetched, so every image shares the atlas sampler.
+	 */
+	for (uint32_t i = 0; i < 3; i++) {
+		imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfos[i].imageView = VK_NULL_HANDLE;
+		imageInfos[i].sampler = textureSampler;
+
+		imageWriteDescriptors[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		imageWriteDescriptors[i].pNext = nullptr;
+		imageWriteDescriptors[i].dstSet = descriptorSet;
+		imageWriteDescriptors[i].dstBinding = i == 0 ? 2 : i + 2;
+		imageWriteDescriptors[i].dstArrayElement = 0;
+		imageWriteDescriptors[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		imageWriteDescriptors[i].descriptorCount = 1;
+		imageWriteDescriptors[i].pBufferInfo = nullptr;
+		imageWriteDescriptors[i].pImageInfo = &imageInfos[i];
+		imageWriteDescriptors[i].pTexelBufferView = nullptr;
+	}
 }
 
 void VulkanRenderer::createPipelines() {
-	VkVertexInputAttributeDescription attribs[3];
-	attribs[0].location = 0;
-	attribs[0].binding = 0;
-	attribs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attribs[0].offset = (uint32_t)Vertex::PositionOffset;
-
-	attribs[1].location = 1;
-	attribs[1].binding = 0;
-	attribs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attribs[1].offset = (uint32_t)Vertex::NormalOffset;
-
-	attribs[2].location = 2;
-	attribs[2].binding = 0;
-	attribs[2].format = VK_FORMAT_R32G32_SFLOAT;
-	attribs[2].offset = (uint32_t)Vertex::TextureCoordinateOffset;
-
-	simplePipeline = new VulkanPipeline(program, window.renderPass, pipelineLayout,
-		VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 2, attribs);
-	texturedPipeline = new VulkanPipeline(texturedProgram, window.renderPass,
-		pipelineLayout, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 3, attribs);
-}
\ No newline at end of file
+	/*
+	 * One pipeline per vertex format and program. The shaders dequantise
+	 * when positionOffset.w is set, so packed meshes share them.
+	 */
+	const VertexFormat formats[] = { VertexFormat::Float, VertexFormat::Packed,
+		VertexFormat::SplitPosition };
+	for (VertexFormat format : formats) {
+		VertexInputDescription input = getVertexInputDescription(format);
+		simplePipelines.push_back(new VulkanPipeline(program,
+			window.renderPass, pipelineLayout,
+			VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, input, 2));
+		texturedPipelines.push_back(new VulkanPipeline(texturedProgram,
+			window.renderPass, pipelineLayout,
+			VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, input, 3));
+		if (window.device->getFeatures().fragmentStoresAndAtomics) {
+			virtualTexturedPipelines.push_back(new VulkanPipeline(
+				virtualTexturedProgram, window.renderPass, pipelineLayout,
+				VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, input, 3));
+		}
+	}
+
+	/* The depth prepass binds the position stream alone. */
+	VertexInputDescription positions =
+		getVertexInputDescription(VertexFormat::SplitPosition);
+	positions.streamCount = 1;
+	depthPipeline = new VulkanPipeline(depthProgram, window.renderPass,
+		pipelineLayout, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, positions, 1);
+}
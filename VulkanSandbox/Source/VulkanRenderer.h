@@ -6,9 +6,13 @@
 #include "VulkanShaderProgram.h"
 #include "VulkanTexture.h"
 #include "VulkanPipeline.h"
+#include "VulkanSkinning.h"
+#include "VulkanUploadRing.h"
+#include "VulkanVirtualTexture.h"
 #include <Engine/Renderer.h>
 #include <unordered_map>
 #include <memory>
+#include <vector>
 
 class VulkanRenderer : public Engine::Renderer {
 public:
@@ -18,14 +22,27 @@ public:
 	void render() override;
 
 	void setTextureAtlas(const Engine::TextureAtlas* atlas) override;
+	void setVirtualTexture(Engine::VirtualTexture* vt) override;
+	bool supportsTextureFormat(Engine::Texture::Format format) const override;
 
 private:
 	VulkanWindow& window;
 
-	VulkanShaderProgram program, texturedProgram;
-	VulkanPipeline* simplePipeline, * texturedPipeline;
+	VulkanShaderProgram program, texturedProgram, virtualTexturedProgram,
+		depthProgram;
+	/*
+	 * Textured materials sample the virtual texture when one is set, with
+	 * pipelines that exist only on devices with fragment stores.
+	 */
+	std::vector<VulkanPipeline*> simplePipelines, texturedPipelines,
+		virtualTexturedPipelines;
+	VulkanPipeline* depthPipeline;
 	VulkanBuffer* entityDataBuffer;
 	VulkanBuffer* lightDataBuffer;
+	VulkanBuffer* indirectBuffer;
+	VkDeviceSize indirectCapacity;
+	VulkanSkinning skinning;
+	VulkanUploadRing uploadRing;
 	VkDescriptorPool descriptorPool;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkPipelineLayout pipelineLayout;
@@ -35,13 +52,22 @@ private:
 		glm::mat4 mvp;
 		glm::mat4 normal;
 		glm::vec4 color;
+		glm::vec4 positionOffset;
+		glm::vec4 positionScale;
 		Engine::TextureRect textureRegion;
 		glm::vec2 textureScale;
 	};
 
+	/*
+	 * Per frame data of the fragment stage. Only the virtual texture
+	 * variant reads past the light.
+	 */
 	struct LightData {
 		glm::vec4 direction;
 		glm::vec4 color;
+		glm::vec4 virtualTextureSize;
+		glm::vec4 physicalTextureSize;
+		glm::ivec4 feedback;
 	};
 
 	VkDeviceSize entityDataStride, lightDataStride;
@@ -49,12 +75,28 @@ private:
 	
 	VkSampler textureSampler;
 	VulkanTexture* texture;
-	VkDescriptorImageInfo imageInfo;
-	VkWriteDescriptorSet imageWriteDescriptor;
+	VulkanVirtualTexture* virtualTextureImages;
+	/* The atlas, then the indirection and physical images */
+	VkDescriptorImageInfo imageInfos[3];
+	VkWriteDescriptorSet imageWriteDescriptors[3];
+
+	/*
+	 * Pages wanted by one pixel of each block of the screen, written by
+	 * one frame and read by the next, once it has finished.
+	 */
+	VulkanBuffer* feedbackBuffer;
+	uint32_t feedbackWidth;
+	uint32_t feedbackCount;
+	uint32_t feedbackFrame;
 
 	std::unordered_map<const Engine::Mesh*, std::shared_ptr<VulkanPerMesh>>
 	meshCache;
 
+	void recordDepthPrepass();
+	void recordDynamicMeshUpdates();
+	void recordTextureStreaming();
+	void recordVirtualTexture();
+	void updateImageDescriptors();
 	void createDescriptorPool();
 	void createDescriptorSetLayout();
 	void createPipelineLayout();
@@ -0,0 +1,263 @@
+#include "VulkanSkinning.h"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace Engine;
+
+/* Descriptor sets per pool; another pool is created when one is full. */
+static const uint32_t setsPerPool = 64;
+static const uint32_t workGroupSize = 64;
+
+static vector<char> readFile(const string& filename) {
+	ifstream file(filename, ios::ate | ios::binary);
+	if (!file.is_open()) {
+		throw runtime_error("failed to open file!");
+	}
+	vector<char> buffer((size_t)file.tellg());
+	file.seekg(0);
+	file.read(buffer.data(), buffer.size());
+	return buffer;
+}
+
+static VulkanBuffer* createStorageBuffer(const VulkanDevice& device,
+	VkDeviceSize size, const void* data) {
+	VulkanBuffer* buffer = new VulkanBuffer(device, size,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			| VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	buffer->transfer(0, VK_WHOLE_SIZE, const_cast<void*>(data));
+	return buffer;
+}
+
+VulkanSkinning::VulkanSkinning(const VulkanDevice& device) :
+	device(device),
+	program(device),
+	poolSetCount(0),
+	pipeline(nullptr)
+{
+	program.addShaderStage(readFile("Shaders/Skinning.comp.spv"),
+		VK_SHADER_STAGE_COMPUTE_BIT);
+	createDescriptorSetLayout();
+	createPipelineLayout();
+	pipeline = new VulkanPipeline(program, pipelineLayout);
+}
+
+VulkanSkinning::~VulkanSkinning() {
+	for (auto& i : instances) {
+		delete i.second.bindPose;
+		delete i.second.weights;
+		delete i.second.joints;
+		delete i.second.skinned;
+	}
+	delete pipeline;
+	for (VkDescriptorPool pool : descriptorPools) {
+		vkDestroyDescriptorPool(device.getHandle(), pool, nullptr);
+	}
+	vkDestroyPipelineLayout(device.getHandle(), pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device.getHandle(), descriptorSetLayout,
+		nullptr);
+}
+
+void VulkanSkinning::record(VkCommandBuffer cmdBuffer,
+	const vector<Entity*>& entities) {
+	bool dispatched = false;
+	for (const Entity* e : entities) {
+		const Skeleton* skeleton = e->getSkeleton();
+		if (skeleton == nullptr) continue;
+		const SkinnedMesh* mesh = dynamic_cast<const SkinnedMesh*>(
+			e->getGeometry()->getMesh());
+		if (mesh == nullptr) {
+			throw runtime_error("Entity with a skeleton has no skinned mesh.");
+		}
+		Instance& instance = getInstance(e, mesh);
+		if (skeleton->getJointCount() > instance.jointCount) {
+			throw runtime_error("Skeleton gained joints after first use.");
+		}
+
+		/*
+		 * Joints are mat4 columns for linear blending and [real, dual]
+		 * pairs for dual quaternions; the shader reads both as vec4.
+		 */
+		PushConstants constants;
+		constants.vertexCount = instance.vertexCount;
+		constants.method = (uint32_t)e->getSkinningMethod();
+		const void* joints;
+		VkDeviceSize jointsSize;
+		if (e->getSkinningMethod() == SkinningMethod::LinearBlend) {
+			skeleton->computeJointMatrices(jointMatrices);
+			joints = jointMatrices.data();
+			jointsSize = jointMatrices.size() * sizeof(glm::mat4);
+		} else {
+			skeleton->computeJointDualQuaternions(jointDualQuaternions);
+			joints = jointDualQuaternions.data();
+			jointsSize = jointDualQuaternions.size() * sizeof(glm::fdualquat);
+		}
+		if (jointsSize == 0) continue;
+		void* mapped = instance.joints->mapMemory(0, jointsSize);
+		memcpy(mapped, joints, jointsSize);
+		instance.joints->unmapMemory();
+
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+			pipeline->getHandle());
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+			pipelineLayout, 0, 1, &instance.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, pipelineLayout,
+			VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &constants);
+		vkCmdDispatch(cmdBuffer,
+			(instance.vertexCount + workGroupSize - 1) / workGroupSize, 1, 1);
+		dispatched = true;
+	}
+	if (!dispatched) return;
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0,
+		nullptr);
+}
+
+VulkanSkinning::Instance& VulkanSkinning::getInstance(const Entity* entity,
+	const SkinnedMesh* mesh) {
+	auto result = instances.find(entity);
+	if (result != instances.end()) {
+		return result->second;
+	}
+	if (mesh->getVertexFormat() != VertexFormat::Float) {
+		throw runtime_error("Skinned meshes must use float vertices.");
+	}
+
+	Instance instance;
+	instance.vertexCount = (uint32_t)mesh->getVertices().size();
+	instance.jointCount = (uint32_t)entity->getSkeleton()->getJointCount();
+	instance.bindPose = createStorageBuffer(device,
+		mesh->getVertexDataSize(), mesh->getVertexData());
+	instance.weights = createStorageBuffer(device,
+		mesh->getSkinWeights().size() * sizeof(SkinWeights),
+		mesh->getSkinWeights().data());
+	instance.joints = new VulkanBuffer(device,
+		max(instance.jointCount, 1u) * sizeof(glm::mat4),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	instance.skinned = new VulkanBuffer(device, mesh->getVertexDataSize(),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	instance.descriptorSet = allocateDescriptorSet();
+
+	VulkanBuffer* buffers[] = { instance.bindPose, instance.weights,
+		instance.joints, instance.skinned };
+	VkDescriptorBufferInfo bufferInfos[4];
+	VkWriteDescriptorSet descriptorWrites[4];
+	for (uint32_t i = 0; i < 4; i++) {
+		bufferInfos[i].buffer = buffers[i]->getHandle();
+		bufferInfos[i].offset = 0;
+		bufferInfos[i].range = VK_WHOLE_SIZE;
+
+		descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[i].pNext = nullptr;
+		descriptorWrites[i].dstSet = instance.descriptorSet;
+		descriptorWrites[i].dstBinding = i;
+		descriptorWrites[i].dstArrayElement = 0;
+		descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[i].descriptorCount = 1;
+		descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+		descriptorWrites[i].pImageInfo = nullptr;
+		descriptorWrites[i].pTexelBufferView = nullptr;
+	}
+	vkUpdateDescriptorSets(device.getHandle(), 4, descriptorWrites, 0,
+		nullptr);
+
+	return instances[entity] = instance;
+}
+
+VkDescriptorSet VulkanSkinning::allocateDescriptorSet() {
+	if (descriptorPools.empty() || poolSetCount == setsPerPool) {
+		createDescriptorPool();
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPools.back();
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &descriptorSetLayout;
+	VkDescriptorSet descriptorSet;
+	VkResult result = vkAllocateDescriptorSets(device.getHandle(), &allocInfo,
+		&descriptorSet);
+	if (result != VK_SUCCESS) {
+		throw runtime_error("Failed to allocate description set.");
+	}
+	poolSetCount++;
+	return descriptorSet;
+}
+
+void VulkanSkinning::createDescriptorSetLayout() {
+	/*
+	 * Bind pose vertices, skin weights, joints and skinned vertices
+	 */
+	VkDescriptorSetLayoutBinding layoutBindings[4];
+	for (uint32_t i = 0; i < 4; i++) {
+		layoutBindings[i].binding = i;
+		layoutBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		layoutBindings[i].descriptorCount = 1;
+		layoutBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		layoutBindings[i].pImmutableSamplers = nullptr;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 4;
+	layoutInfo.pBindings = layoutBindings;
+
+	VkResult result = vkCreateDescriptorSetLayout(device.getHandle(),
+		&layoutInfo, nullptr, &descriptorSetLayout);
+	if (result != VK_SUCCESS) {
+		throw runtime_error("Failed to create descriptor set layout.");
+	}
+}
+
+void VulkanSkinning::createPipelineLayout() {
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushConstants);
+
+	VkPipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.setLayoutCount = 1;
+	layoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+	layoutCreateInfo.pushConstantRangeCount = 1;
+	layoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	VkResult result = vkCreatePipelineLayout(device.getHandle(),
+		&layoutCreateInfo, nullptr, &pipelineLayout);
+	if (result != VK_SUCCESS) {
+		throw runtime_error("Failed to create pipeline layout.");
+	}
+}
+
+void VulkanSkinning::createDescriptorPool() {
+	VkDescriptorPoolSize poolSize;
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = 4 * setsPerPool;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = setsPerPool;
+
+	VkDescriptorPool pool;
+	VkResult result = vkCreateDescriptorPool(device.getHandle(), &poolInfo,
+		nullptr, &pool);
+	if (result != VK_SUCCESS) {
+		throw runtime_error("Failed to create descriptor pool.");
+	}
+	descriptorPools.push_back(pool);
+	poolSetCount = 0;
+}
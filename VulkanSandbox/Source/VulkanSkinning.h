@@ -0,0 +1,75 @@
+#ifndef VULKANSKINNING_H
+#define VULKANSKINNING_H
+
+#include <vulkan/vulkan.h>
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanPipeline.h"
+#include "VulkanShaderProgram.h"
+#include <Engine/Entity.h>
+#include <Engine/SkinnedMesh.h>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Compute pass skinning the vertices of entities with a skeleton. Each
+ * entity gets its own output buffer, which is drawn in place of the bind
+ * pose vertices of its mesh.
+ */
+class VulkanSkinning {
+public:
+	VulkanSkinning(const VulkanDevice& device);
+	~VulkanSkinning();
+
+	/*
+	 * Upload the joint transforms of the skinned entities and record their
+	 * dispatches, followed by a barrier for the vertex input. Must be
+	 * recorded outside a render pass, and the previous frame must have
+	 * finished.
+	 */
+	void record(VkCommandBuffer cmdBuffer,
+		const std::vector<Engine::Entity*>& entities);
+
+	/*
+	 * Skinned vertices of an entity passed to the last record
+	 */
+	VkBuffer getSkinnedBuffer(const Engine::Entity* entity) const {
+		return instances.at(entity).skinned->getHandle();
+	}
+
+private:
+	struct Instance {
+		VulkanBuffer* bindPose;
+		VulkanBuffer* weights;
+		VulkanBuffer* joints;
+		VulkanBuffer* skinned;
+		VkDescriptorSet descriptorSet;
+		uint32_t vertexCount;
+		uint32_t jointCount;
+	};
+
+	struct PushConstants {
+		uint32_t vertexCount;
+		uint32_t method;
+	};
+
+	const VulkanDevice& device;
+	VulkanShaderProgram program;
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkPipelineLayout pipelineLayout;
+	std::vector<VkDescriptorPool> descriptorPools;
+	uint32_t poolSetCount;
+	VulkanPipeline* pipeline;
+	std::unordered_map<const Engine::Entity*, Instance> instances;
+	std::vector<glm::mat4> jointMatrices;
+	std::vector<glm::fdualquat> jointDualQuaternions;
+
+	Instance& getInstance(const Engine::Entity* entity,
+		const Engine::SkinnedMesh* mesh);
+	void createDescriptorSetLayout();
+	void createPipelineLayout();
+	VkDescriptorSet allocateDescriptorSet();
+	void createDescriptorPool();
+};
+
+#endif
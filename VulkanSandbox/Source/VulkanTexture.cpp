@@ -1,35 +1,80 @@
 #include "VulkanTexture.h"
 #include "VulkanUtil.h"
+#include "VulkanBuffer.h"
+#include <algorithm>
 #include <stdexcept>
 #include <cstring>
+#include <vector>
 
 using namespace std;
 using namespace Engine;
 
-VulkanTexture::VulkanTexture(const VulkanDevice& device, const Texture* texture) :
-	device(device)
+/*
+ * Staging copies start on a multiple of every texel and block size.
+ */
+static const VkDeviceSize stagingAlignment = 16;
+
+/*
+ * Copy of the rows of an upload from a buffer holding only those rows, at
+ * the pitch of their level.
+ */
+static VkBufferImageCopy rowCopy(const TextureStreamer& streamer,
+	const TextureUpload& upload, VkDeviceSize bufferOffset) {
+	const Texture& texture = streamer.getTexture();
+	PixelRect rect = streamer.getRect(upload);
+	VkBufferImageCopy region = {};
+	region.bufferOffset = bufferOffset;
+	/* Rows of compressed blocks are packed tight. */
+	region.bufferRowLength = Texture::isCompressed(texture.getFormat())
+		? 0 : texture.getLevel(upload.level).rowPitch
+			/ Texture::formatSize(texture.getFormat());
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = upload.level;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {(int32_t)rect.x, (int32_t)rect.y, 0};
+	region.imageExtent = {rect.width, rect.height, 1};
+	return region;
+}
+
+VulkanTexture::VulkanTexture(const VulkanDevice& device, const Texture* texture,
+	VkDeviceSize initialBytes) :
+	device(device),
+	format(toVulkanFormat(texture->getFormat())),
+	streamer(*texture),
+	view(VK_NULL_HANDLE)
 {
-	switch (texture->getFormat()) {
-	case Texture::Format::Grey: format = VK_FORMAT_R8_UNORM; break;
-	case Texture::Format::GreyAlpha: format = VK_FORMAT_R8G8_UNORM; break;
-	case Texture::Format::RGBA: format = VK_FORMAT_R8G8B8A8_UNORM; break;
+	uint32_t levelCount = texture->getLevelCount();
+	vector<TextureUpload> uploads;
+	vector<VkDeviceSize> offsets;
+	VkDeviceSize size = 0;
+	TextureUpload upload;
+	while (streamer.next((size_t)min<VkDeviceSize>(initialBytes - size,
+		SIZE_MAX), upload)) {
+		size = (size + stagingAlignment - 1) & ~(stagingAlignment - 1);
+		uploads.push_back(upload);
+		offsets.push_back(size);
+		size += streamer.getSize(upload);
+		if (size >= initialBytes) break;
 	}
-	
-	VulkanImage* stagingImage = new VulkanImage(
+
+	VulkanBuffer* stagingBuffer = new VulkanBuffer(
 		device,
-		texture->getWidth(),
-		texture->getHeight(),
-		format,
-		VK_IMAGE_TILING_LINEAR,
-		VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
 		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
 	);
 	
-	VkDeviceSize size = stagingImage->getSize();
-	void* mapped = stagingImage->mapMemory(0, size);
-	memcpy(mapped, texture->getPixelData(), size);
-	stagingImage->unmapMemory();
+	vector<VkBufferImageCopy> regions;
+	uint8_t* mapped = (uint8_t*)stagingBuffer->mapMemory(0, size);
+	for (size_t i = 0; i < uploads.size(); i++) {
+		memcpy(mapped + offsets[i], streamer.getData(uploads[i]),
+			streamer.getSize(uploads[i]));
+		regions.push_back(rowCopy(streamer, uploads[i], offsets[i]));
+	}
+	stagingBuffer->unmapMemory();
 	
 	image = new VulkanImage(
 		device,
@@ -38,15 +83,22 @@ VulkanTexture::VulkanTexture(const VulkanDevice& device, const Texture* texture)
 		format,
 		VK_IMAGE_TILING_OPTIMAL,
 		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		VK_IMAGE_LAYOUT_PREINITIALIZED,
+		levelCount
 	);
 	
+	/*
+	 * Levels wait for their rows in the transfer layout, and move to the
+	 * shader layout once they are complete.
+	 */
 	VkCommandBuffer cmdBuffer = beginSingleUseCmdBuffer(
 		device.getHandle(), device.getPresentCommandPool());
 	
-	image->recordTransfer(*stagingImage, cmdBuffer);
-	image->recordTransition(
-		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cmdBuffer);
+	image->recordTransfer(*stagingBuffer, regions, cmdBuffer);
+	uint32_t resident = streamer.getResidentLevel();
+	image->recordLevelTransition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		resident, levelCount - resident, cmdBuffer);
 	
 	endSingleUseCmdBuffer(
 		device.getHandle(),
@@ -55,16 +107,67 @@ VulkanTexture::VulkanTexture(const VulkanDevice& device, const Texture* texture)
 		cmdBuffer
 	);
 	
-	delete stagingImage;
+	delete stagingBuffer;
 	
+	createView();
+}
+
+VkFormat VulkanTexture::toVulkanFormat(Texture::Format format) {
+	switch (format) {
+	case Texture::Format::Grey: return VK_FORMAT_R8_UNORM;
+	case Texture::Format::GreyAlpha: return VK_FORMAT_R8G8_UNORM;
+	case Texture::Format::BC1: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	case Texture::Format::BC3: return VK_FORMAT_BC3_UNORM_BLOCK;
+	case Texture::Format::BC7: return VK_FORMAT_BC7_UNORM_BLOCK;
+	default: return VK_FORMAT_R8G8B8A8_UNORM;
+	}
+}
+
+bool VulkanTexture::recordStreaming(VulkanUploadRing& ring, VkDeviceSize budget,
+	VkCommandBuffer cmdBuffer) {
+	if (streamer.isComplete()) return false;
+	uint32_t resident = streamer.getResidentLevel();
+
+	vector<VkBufferImageCopy> regions;
+	TextureUpload upload;
+	while (streamer.next((size_t)min(budget, ring.getAvailable()), upload)) {
+		VkDeviceSize size = streamer.getSize(upload);
+		VkDeviceSize offset;
+		void* mapped = ring.allocate(size, offset);
+		memcpy(mapped, streamer.getData(upload), size);
+		regions.push_back(rowCopy(streamer, upload, offset));
+		budget -= size;
+	}
+	if (!regions.empty()) {
+		vkCmdCopyBufferToImage(cmdBuffer, ring.getHandle(), image->getHandle(),
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(),
+			regions.data());
+	}
+
+	uint32_t nowResident = streamer.getResidentLevel();
+	if (nowResident == resident) return false;
+	image->recordLevelTransition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		nowResident, resident - nowResident, cmdBuffer);
+	vkDestroyImageView(device.getHandle(), view, nullptr);
+	createView();
+	return true;
+}
+
+/*
+ * The view starts at the finest complete level, which clamps sampling to
+ * the levels that have arrived and keeps the levels still in the
+ * transfer layout out of it.
+ */
+void VulkanTexture::createView() {
+	uint32_t resident = streamer.getResidentLevel();
 	VkImageViewCreateInfo viewInfo = {};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewInfo.image = image->getHandle();
 	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 	viewInfo.format = format;
 	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	viewInfo.subresourceRange.baseMipLevel = 0;
-	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.baseMipLevel = resident;
+	viewInfo.subresourceRange.levelCount = image->getMipLevels() - resident;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
 	viewInfo.subresourceRange.layerCount = 1;
 	
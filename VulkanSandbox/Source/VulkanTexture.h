@@ -3,12 +3,20 @@
 
 #include "VulkanImage.h"
 #include "VulkanDevice.h"
-#include <Engine/Texture.h>
+#include "VulkanUploadRing.h"
+#include <Engine/TextureStreamer.h>
 
 class VulkanTexture {
 public:
-	VulkanTexture(const VulkanDevice& device, const Engine::Texture* texture);
+	/*
+	 * Create the image with every level, uploading up to initialBytes of
+	 * them, smallest first. The rest are left to recordStreaming.
+	 */
+	VulkanTexture(const VulkanDevice& device, const Engine::Texture* texture,
+		VkDeviceSize initialBytes = VK_WHOLE_SIZE);
 	~VulkanTexture();
+
+	static VkFormat toVulkanFormat(Engine::Texture::Format format);
 	
 	VkFormat getFormat() const {
 		return format;
@@ -25,10 +33,26 @@ public:
 	VkImageView getImageView() const {
 		return view;
 	}
+
+	/*
+	 * Record copies of up to budget bytes of the levels still missing,
+	 * staged in the upload ring. Returns true when levels are complete and
+	 * the view was replaced to include them, so descriptors using it must
+	 * be updated before they are bound.
+	 */
+	bool recordStreaming(VulkanUploadRing& ring, VkDeviceSize budget,
+		VkCommandBuffer cmdBuffer);
+
+	bool isComplete() const {
+		return streamer.isComplete();
+	}
 	
 private:
+	void createView();
+
 	const VulkanDevice& device;
 	VkFormat format;
+	Engine::TextureStreamer streamer;
 	VulkanImage* image;
 	VkImageView view;
 };
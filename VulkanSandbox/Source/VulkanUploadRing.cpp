@@ -0,0 +1,40 @@
+#include "VulkanUploadRing.h"
+
+/*
+ * Offsets are kept aligned for copies of any vertex or index type
+ */
+static const VkDeviceSize allocationAlignment = 16;
+
+VulkanUploadRing::VulkanUploadRing(const VulkanDevice& device,
+	VkDeviceSize frameSize, uint32_t frameCount) :
+	buffer(nullptr),
+	mapped(nullptr),
+	frameSize(frameSize),
+	frameCount(frameCount),
+	frame(0),
+	used(0)
+{
+	buffer = new VulkanBuffer(device, frameSize * frameCount,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+			| VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	mapped = (uint8_t*)buffer->mapMemory(0, VK_WHOLE_SIZE);
+}
+
+VulkanUploadRing::~VulkanUploadRing() {
+	buffer->unmapMemory();
+	delete buffer;
+}
+
+void VulkanUploadRing::beginFrame() {
+	frame = (frame + 1) % frameCount;
+	used = 0;
+}
+
+void* VulkanUploadRing::allocate(VkDeviceSize size, VkDeviceSize& offset) {
+	if (used + size > frameSize) return nullptr;
+	offset = frame * frameSize + used;
+	used = (used + size + allocationAlignment - 1)
+		& ~(allocationAlignment - 1);
+	return mapped + offset;
+}
@@ -0,0 +1,57 @@
+#ifndef VULKANUPLOADRING_H
+#define VULKANUPLOADRING_H
+
+#include <vulkan/vulkan.h>
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+
+/*
+ * Host visible staging buffer split into one region per frame in flight,
+ * mapped for as long as it exists. Uploads are allocated one after another
+ * in the region of the current frame and copied from there by commands
+ * recorded in that frame.
+ */
+class VulkanUploadRing {
+public:
+	VulkanUploadRing(const VulkanDevice& device, VkDeviceSize frameSize,
+		uint32_t frameCount = 2);
+	~VulkanUploadRing();
+
+	/*
+	 * Move to the region of the next frame. The commands of the frame that
+	 * used it last must have finished.
+	 */
+	void beginFrame();
+
+	/*
+	 * Space for size bytes in the region of the current frame, or nullptr
+	 * when the region is full. offset receives the position of the space
+	 * in the buffer.
+	 */
+	void* allocate(VkDeviceSize size, VkDeviceSize& offset);
+
+	/*
+	 * Bytes that can still be allocated in the region of the current frame.
+	 */
+	VkDeviceSize getAvailable() const {
+		return used < frameSize ? frameSize - used : 0;
+	}
+
+	VkDeviceSize getFrameSize() const {
+		return frameSize;
+	}
+
+	VkBuffer getHandle() const {
+		return buffer->getHandle();
+	}
+
+private:
+	VulkanBuffer* buffer;
+	uint8_t* mapped;
+	VkDeviceSize frameSize;
+	uint32_t frameCount;
+	uint32_t frame;
+	VkDeviceSize used;
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "VulkanVirtualTexture.h"
+#include "VulkanTexture.h"
+#include "VulkanUtil.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+using namespace std;
+using namespace Engine;
+
+/*
+ * Copy of a rectangle of one level from rows packed tight in a buffer.
+ */
+static VkBufferImageCopy rectCopy(const PixelRect& rect, uint32_t level,
+	VkDeviceSize bufferOffset) {
+	VkBufferImageCopy region = {};
+	region.bufferOffset = bufferOffset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = level;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {(int32_t)rect.x, (int32_t)rect.y, 0};
+	region.imageExtent = {rect.width, rect.height, 1};
+	return region;
+}
+
+VulkanVirtualTexture::VulkanVirtualTexture(const VulkanDevice& device,
+	VirtualTexture& texture) :
+	device(device),
+	texture(texture),
+	indirectionView(VK_NULL_HANDLE),
+	physicalView(VK_NULL_HANDLE)
+{
+	const VirtualTextureFile& file = texture.getFile();
+	indirection = new VulkanImage(
+		device,
+		file.getPagesX(0),
+		file.getPagesY(0),
+		VK_FORMAT_R8G8B8A8_UNORM,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		VK_IMAGE_LAYOUT_PREINITIALIZED,
+		file.getLevelCount()
+	);
+	physical = new VulkanImage(
+		device,
+		texture.getPhysicalSize(),
+		texture.getPhysicalSize(),
+		VulkanTexture::toVulkanFormat(file.getFormat()),
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	);
+
+	/*
+	 * The first update hands out every page of the last level, and every
+	 * indirection texel changes with them.
+	 */
+	texture.update(0, uploads);
+	VkDeviceSize size = 0;
+	for (uint32_t level = 0; level < file.getLevelCount(); level++) {
+		size += (VkDeviceSize)file.getPagesX(level) * file.getPagesY(level)
+			* sizeof(uint32_t) + 16;
+	}
+	size += uploads.size() * (file.getPageBytes() + 16);
+	VulkanUploadRing staging(device, size, 1);
+
+	VkCommandBuffer cmdBuffer = beginSingleUseCmdBuffer(
+		device.getHandle(), device.getPresentCommandPool());
+	recordCopies(staging, cmdBuffer);
+	endSingleUseCmdBuffer(
+		device.getHandle(),
+		device.getPresentQueue(),
+		device.getPresentCommandPool(),
+		cmdBuffer
+	);
+
+	indirectionView = createView(*indirection);
+	physicalView = createView(*physical);
+}
+
+VulkanVirtualTexture::~VulkanVirtualTexture() {
+	vkDestroyImageView(device.getHandle(), indirectionView, nullptr);
+	vkDestroyImageView(device.getHandle(), physicalView, nullptr);
+	delete indirection;
+	delete physical;
+}
+
+void VulkanVirtualTexture::recordUpdate(VulkanUploadRing& ring,
+	VkDeviceSize budget, VkCommandBuffer cmdBuffer) {
+	/* The rest of the ring is left for the indirection. */
+	VkDeviceSize available = ring.getAvailable() / 2;
+	if (available < texture.getFile().getPageBytes()) return;
+	texture.update((size_t)min(budget, available), uploads);
+	recordCopies(ring, cmdBuffer);
+}
+
+/*
+ * Stage the pages of uploads and the changed rectangles of the
+ * indirection, and copy them into the images. Images that are copied
+ * into go through the transfer layout and back.
+ */
+void VulkanVirtualTexture::recordCopies(VulkanUploadRing& ring,
+	VkCommandBuffer cmdBuffer) {
+	const VirtualTextureFile& file = texture.getFile();
+	uint32_t padded = file.getPaddedSize();
+	uint32_t slotsPerSide = texture.getSlotsPerSide();
+
+	vector<VkBufferImageCopy> pageCopies;
+	for (const PageUpload& upload : uploads) {
+		VkDeviceSize offset;
+		void* mapped = ring.allocate(file.getPageBytes(), offset);
+		if (!mapped) {
+			throw runtime_error("Virtual texture pages do not fit the upload ring.");
+		}
+		memcpy(mapped, upload.data, file.getPageBytes());
+		PixelRect slot = { upload.slot % slotsPerSide * padded,
+			upload.slot / slotsPerSide * padded, padded, padded };
+		pageCopies.push_back(rectCopy(slot, 0, offset));
+	}
+
+	vector<VkBufferImageCopy> indirectionCopies;
+	for (uint32_t level = 0; level < file.getLevelCount(); level++) {
+		PixelRect rect;
+		if (!texture.getChangedRect(level, rect)) continue;
+		VkDeviceSize offset;
+		uint32_t* mapped = (uint32_t*)ring.allocate(
+			(VkDeviceSize)rect.width * rect.height * sizeof(uint32_t), offset);
+		if (!mapped) {
+			throw runtime_error("Virtual texture indirection does not fit the upload ring.");
+		}
+		uint32_t pagesX = file.getPagesX(level);
+		const uint32_t* texels = texture.getIndirection(level);
+		for (uint32_t y = 0; y < rect.height; y++) {
+			memcpy(mapped + (size_t)y * rect.width,
+				texels + (size_t)(rect.y + y) * pagesX + rect.x,
+				rect.width * sizeof(uint32_t));
+		}
+		indirectionCopies.push_back(rectCopy(rect, level, offset));
+	}
+	texture.clearChanges();
+
+	if (!pageCopies.empty()) {
+		physical->recordTransition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			cmdBuffer);
+		vkCmdCopyBufferToImage(cmdBuffer, ring.getHandle(),
+			physical->getHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			(uint32_t)pageCopies.size(), pageCopies.data());
+		physical->recordTransition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			cmdBuffer);
+	}
+	if (!indirectionCopies.empty()) {
+		indirection->recordTransition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			cmdBuffer);
+		vkCmdCopyBufferToImage(cmdBuffer, ring.getHandle(),
+			indirection->getHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			(uint32_t)indirectionCopies.size(), indirectionCopies.data());
+		indirection->recordTransition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			cmdBuffer);
+	}
+}
+
+VkImageView VulkanVirtualTexture::createView(const VulkanImage& image) {
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image.getHandle();
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = image.getFormat();
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = image.getMipLevels();
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	VkImageView view;
+	VkResult result =
+		vkCreateImageView(device.getHandle(), &viewInfo, nullptr, &view);
+	if (result != VK_SUCCESS) {
+		throw runtime_error("Failed to create virtual texture image view.");
+	}
+	return view;
+}
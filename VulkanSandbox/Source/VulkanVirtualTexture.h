@@ -0,0 +1,54 @@
+#ifndef VULKANVIRTUALTEXTURE_H
+#define VULKANVIRTUALTEXTURE_H
+
+#include "VulkanImage.h"
+#include "VulkanDevice.h"
+#include "VulkanUploadRing.h"
+#include <Engine/VirtualTexture.h>
+#include <vector>
+
+/*
+ * Images of a virtual texture: the indirection, a level per level of the
+ * virtual texture with one texel per page, and the physical image of page
+ * slots. Both are in the shader layout between frames.
+ */
+class VulkanVirtualTexture {
+public:
+	/*
+	 * Create the images and upload the pages of the last level, which the
+	 * virtual texture hands out first.
+	 */
+	VulkanVirtualTexture(const VulkanDevice& device,
+		Engine::VirtualTexture& texture);
+	~VulkanVirtualTexture();
+
+	VkImageView getIndirectionView() const {
+		return indirectionView;
+	}
+
+	VkImageView getPhysicalView() const {
+		return physicalView;
+	}
+
+	/*
+	 * Place the pages read since the last frame, up to budget bytes and
+	 * half of what is left in the ring, and record copies of them and of
+	 * the indirection texels they change, staged in the ring.
+	 */
+	void recordUpdate(VulkanUploadRing& ring, VkDeviceSize budget,
+		VkCommandBuffer cmdBuffer);
+
+private:
+	void recordCopies(VulkanUploadRing& ring, VkCommandBuffer cmdBuffer);
+	VkImageView createView(const VulkanImage& image);
+
+	const VulkanDevice& device;
+	Engine::VirtualTexture& texture;
+	VulkanImage* indirection;
+	VulkanImage* physical;
+	VkImageView indirectionView;
+	VkImageView physicalView;
+	std::vector<Engine::PageUpload> uploads;
+};
+
+#endif